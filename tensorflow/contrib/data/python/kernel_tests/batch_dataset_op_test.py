@@ -18,11 +18,13 @@ from __future__ import division
 from __future__ import print_function
 
 import math
+import threading
 
 import numpy as np
 
 from tensorflow.contrib.data.python.kernel_tests import dataset_serialization_test_base
 from tensorflow.contrib.data.python.ops import batching
+from tensorflow.core.protobuf import config_pb2
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
@@ -30,6 +32,7 @@ from tensorflow.python.framework import errors
 from tensorflow.python.framework import sparse_tensor
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import math_ops
+from tensorflow.python.ops import script_ops
 from tensorflow.python.ops import string_ops
 from tensorflow.python.platform import test
 
@@ -387,6 +390,38 @@ class BatchDatasetTest(test.TestCase):
   def testBatchAndMapDatasetWithParallelBatching(self):
     return self._testBatchAndMapDatasetHelper(num_parallel_batches=10)
 
+  def testMapAndBatchSloppy(self):
+    event = threading.Event()
+
+    def _map_py_fn(x):
+      if x == 0:
+        event.wait()
+      return x
+
+    iterator = (
+        dataset_ops.Dataset.range(8).apply(
+            batching.map_and_batch(
+                lambda x: script_ops.py_func(_map_py_fn, [x], x.dtype),
+                batch_size=2,
+                num_parallel_batches=2,
+                sloppy=True)).make_initializable_iterator())
+    init_op = iterator.initializer
+    get_next = iterator.get_next()
+
+    # Element 0 blocks one inter-op thread until the event is set.
+    config = config_pb2.ConfigProto(inter_op_parallelism_threads=4)
+    with self.test_session(config=config) as sess:
+      sess.run(init_op)
+      # The batch of element 0 is held up, but the other batch in flight keeps
+      # being produced and restarted.
+      self.assertAllEqual([2, 3], sess.run(get_next))
+      self.assertAllEqual([4, 5], sess.run(get_next))
+      self.assertAllEqual([6, 7], sess.run(get_next))
+      event.set()
+      self.assertAllEqual([0, 1], sess.run(get_next))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
   def testMapAndBatchSparse(self):
 
     def _sparse(i):
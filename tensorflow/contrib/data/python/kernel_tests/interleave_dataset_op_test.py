@@ -19,6 +19,7 @@ from __future__ import print_function
 
 import itertools
 import math
+import multiprocessing
 import threading
 import time
 
@@ -27,6 +28,7 @@ from six.moves import zip_longest
 
 from tensorflow.contrib.data.python.kernel_tests import dataset_serialization_test_base
 from tensorflow.contrib.data.python.ops import interleave_ops
+from tensorflow.contrib.data.python.ops import optimization
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import errors
@@ -677,6 +679,50 @@ class ParallelInterleaveDatasetTest(test.TestCase):
   def testTooManyReadersSloppy(self):
     self._testTooManyReaders(sloppy=True)
 
+  def _testAllWorkersMakeProgress(self, sloppy=False):
+    # Each input element blocks, as a reader waiting on I/O would, until all
+    # of them have started. This only finishes if the workers run at once,
+    # although there are more of them than CPUs.
+    cycle_length = multiprocessing.cpu_count() + 4
+    num_started = [0]
+    started = threading.Condition()
+
+    def _wait_for_all_workers(x):
+      with started:
+        num_started[0] += 1
+        started.notify_all()
+        deadline = time.time() + 60
+        while num_started[0] < cycle_length and time.time() < deadline:
+          started.wait(deadline - time.time())
+        if num_started[0] < cycle_length:
+          raise ValueError("Only %d of %d workers started." %
+                           (num_started[0], cycle_length))
+      return x
+
+    def interleave_fn(x):
+      return dataset_ops.Dataset.from_tensors(x).map(
+          lambda y: script_ops.py_func(_wait_for_all_workers, [y], y.dtype))
+
+    dataset = dataset_ops.Dataset.range(cycle_length).apply(
+        interleave_ops.parallel_interleave(
+            interleave_fn, cycle_length=cycle_length, sloppy=sloppy))
+    iterator = dataset.make_one_shot_iterator()
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      output_values = [sess.run(get_next) for _ in range(cycle_length)]
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+    if sloppy:
+      output_values.sort()
+    self.assertEqual(list(range(cycle_length)), output_values)
+
+  def testAllWorkersMakeProgress(self):
+    self._testAllWorkersMakeProgress()
+
+  def testAllWorkersMakeProgressSloppy(self):
+    self._testAllWorkersMakeProgress(sloppy=True)
+
   def testSparse(self):
     def _map_fn(i):
       return sparse_tensor.SparseTensor(
@@ -702,6 +748,24 @@ class ParallelInterleaveDatasetTest(test.TestCase):
       with self.assertRaises(errors.OutOfRangeError):
         sess.run(get_next)
 
+  def testAutotuneBufferOutputElements(self):
+    dataset = dataset_ops.Dataset.range(4).apply(
+        interleave_ops.parallel_interleave(
+            lambda x: dataset_ops.Dataset.from_tensors(x).repeat(10),
+            cycle_length=2,
+            buffer_output_elements=optimization.AUTOTUNE))
+    iterator = dataset.make_initializable_iterator()
+    init_op = iterator.initializer
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      sess.run(init_op)
+      for expected_element in self._interleave([[i] * 10 for i in range(4)],
+                                               2, 1):
+        self.assertEqual(expected_element, sess.run(get_next))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
   def testErrorsInOutputFn(self):
     with self.test_session() as sess:
       self._clear_coordination_events()
@@ -18,11 +18,17 @@ from __future__ import division
 from __future__ import print_function
 
 import os
+import threading
+import time
 
 import numpy as np
 
 from tensorflow.contrib.data.python.kernel_tests import dataset_serialization_test_base
 from tensorflow.contrib.data.python.ops import error_ops
+from tensorflow.contrib.data.python.ops import map_ops
+from tensorflow.contrib.data.python.ops import optimization
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.client import session
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
@@ -34,6 +40,7 @@ from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import io_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import random_ops
+from tensorflow.python.ops import script_ops
 from tensorflow.python.ops import variable_scope
 from tensorflow.python.platform import test
 from tensorflow.python.util import compat
@@ -77,6 +84,53 @@ class MapDatasetTest(test.TestCase):
       with self.assertRaises(errors.OutOfRangeError):
         sess.run(get_next)
 
+  def testParallelMapAutotune(self):
+    dataset = (
+        dataset_ops.Dataset.range(100).map(
+            lambda x: x * x, num_parallel_calls=optimization.AUTOTUNE)
+        .prefetch(optimization.AUTOTUNE))
+    iterator = dataset.make_initializable_iterator()
+    init_op = iterator.initializer
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      sess.run(init_op)
+      for i in range(100):
+        self.assertEqual(i * i, sess.run(get_next))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
+  def testParallelMapSloppy(self):
+    event = threading.Event()
+
+    def _map_py_fn(x):
+      if x == 0:
+        event.wait()
+      return x * x
+
+    dataset = dataset_ops.Dataset.range(10).apply(
+        map_ops.parallel_map(
+            lambda x: script_ops.py_func(_map_py_fn, [x], x.dtype),
+            num_parallel_calls=2,
+            sloppy=True))
+    iterator = dataset.make_initializable_iterator()
+    init_op = iterator.initializer
+    get_next = iterator.get_next()
+
+    # Element 0 blocks one inter-op thread until the event is set.
+    config = config_pb2.ConfigProto(inter_op_parallelism_threads=4)
+    with self.test_session(config=config) as sess:
+      sess.run(init_op)
+      # The elements after element 0 are produced in its place, until they are
+      # `2 * num_parallel_calls - 1` positions ahead of it.
+      self.assertEqual([1, 4, 9], sorted(sess.run(get_next) for _ in range(3)))
+      event.set()
+      self.assertEqual(0, sess.run(get_next))
+      self.assertEqual([i * i for i in range(4, 10)],
+                       sorted(sess.run(get_next) for _ in range(6)))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
   def testReadFileIgnoreError(self):
     def write_string_to_file(value, filename):
       with open(filename, "w") as f:
@@ -277,8 +331,23 @@ class ParallelMapDatasetSerializationTest(
     return (dataset_ops.Dataset.from_tensor_slices(components).map(
         _map_fn, num_parallel_calls=3).repeat(self._num_epochs).prefetch(5))
 
+  def _build_ds_with_autotune(self, multiplier=37.0):
+    components = (np.arange(self._tensor_slice_len), np.array([[1, 2, 3]]) *
+                  np.arange(self._tensor_slice_len)[:, np.newaxis],
+                  np.array(multiplier) * np.arange(self._tensor_slice_len))
+
+    def _map_fn(x, y, z):
+      return math_ops.square(x), math_ops.square(y), math_ops.square(z)
+
+    return (dataset_ops.Dataset.from_tensor_slices(components).map(
+        _map_fn, num_parallel_calls=optimization.AUTOTUNE).repeat(
+            self._num_epochs).prefetch(optimization.AUTOTUNE))
+
   def testSaveRestoreCore(self):
-    for ds_fn in [self._build_ds, self._build_ds_with_prefetch]:
+    for ds_fn in [
+        self._build_ds, self._build_ds_with_prefetch,
+        self._build_ds_with_autotune
+    ]:
       self.run_core_tests(
           ds_fn,
           lambda: ds_fn(multiplier=15.0),
@@ -297,6 +366,18 @@ class ParallelMapDatasetSerializationTest(
 
     self.verify_error_on_save(_build_ds, 15, errors.InvalidArgumentError)
 
+  def testSaveRestoreSloppy(self):
+
+    def _build_ds():
+      return dataset_ops.Dataset.range(50).apply(
+          map_ops.parallel_map(
+              lambda x: x * x, num_parallel_calls=3, sloppy=True))
+
+    # The order of the elements may differ, but none may be lost or repeated
+    # across checkpoints.
+    outputs = self.gen_outputs(_build_ds, [5, 17, 30], 50)
+    self.assertEqual([i * i for i in range(50)], sorted(outputs))
+
   def testCaptureVariableInMapFn(self):
 
     def _build_ds():
@@ -367,5 +448,51 @@ class IgnoreErrorsSerializationTest(
                         lambda: self._build_ds(diff_components), num_outputs)
 
 
+class MapDatasetBenchmark(test.Benchmark):
+
+  def benchmarkParallelMapHeavyTail(self):
+    # The cost of each element follows a Pareto distribution: most elements
+    # take about 0.1ms, and a few stragglers take up to 50ms.
+    num_elements = 2000
+    costs = np.minimum(
+        np.random.RandomState(42).pareto(1.5, size=num_elements) * 1e-4 + 1e-4,
+        0.05).astype(np.float32)
+
+    def _map_py_fn(cost):
+      time.sleep(cost)
+      return cost
+
+    for sloppy in [False, True]:
+      with ops.Graph().as_default():
+        dataset = dataset_ops.Dataset.from_tensor_slices(costs).apply(
+            map_ops.parallel_map(
+                lambda x: script_ops.py_func(_map_py_fn, [x], x.dtype),
+                num_parallel_calls=8,
+                sloppy=sloppy))
+        next_element = dataset.make_one_shot_iterator().get_next()
+
+        with session.Session() as sess:
+          latencies = []
+          for _ in range(num_elements):
+            start = time.time()
+            sess.run(next_element.op)
+            latencies.append(time.time() - start)
+
+          mode = "sloppy" if sloppy else "deterministic"
+          extras = {
+              "p50_latency": np.percentile(latencies, 50),
+              "p99_latency": np.percentile(latencies, 99),
+              "p999_latency": np.percentile(latencies, 99.9),
+              "elements_per_second": num_elements / np.sum(latencies),
+          }
+          print("Parallel map (%s) over heavy-tailed elements: %s" %
+                (mode, extras))
+          self.report_benchmark(
+              iters=num_elements,
+              wall_time=np.mean(latencies),
+              extras=extras,
+              name="benchmark_parallel_map_heavy_tail_%s" % mode)
+
+
 if __name__ == "__main__":
   test.main()
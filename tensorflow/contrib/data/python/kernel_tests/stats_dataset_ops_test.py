@@ -17,15 +17,19 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import time
+
 import numpy as np
 
 from tensorflow.contrib.data.python.kernel_tests import dataset_serialization_test_base
+from tensorflow.contrib.data.python.ops import optimization
 from tensorflow.contrib.data.python.ops import stats_ops
 from tensorflow.core.framework import summary_pb2
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.framework import errors
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import script_ops
 from tensorflow.python.platform import test
 
 
@@ -129,6 +133,39 @@ class StatsDatasetTest(test.TestCase):
       with self.assertRaises(errors.OutOfRangeError):
         sess.run(next_element)
 
+  def testAutotuneDecisions(self):
+
+    def _slow_identity(x):
+      time.sleep(0.005)
+      return x
+
+    dataset = dataset_ops.Dataset.range(200).map(
+        lambda x: script_ops.py_func(_slow_identity, [x], x.dtype)).prefetch(
+            optimization.AUTOTUNE)
+    iterator = dataset.make_initializable_iterator()
+    stats_aggregator = stats_ops.StatsAggregator()
+    stats_aggregator_subscriber = stats_aggregator.subscribe(iterator)
+    next_element = iterator.get_next()
+    summary_t = stats_aggregator.get_summary()
+
+    with self.test_session() as sess:
+      sess.run([iterator.initializer, stats_aggregator_subscriber])
+      for i in range(200):
+        self.assertEqual(i, sess.run(next_element))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(next_element)
+      # The consumer always waits for the slow producer, so the model grows
+      # the prefetch buffer and records each new size.
+      summary_proto = summary_pb2.Summary()
+      summary_proto.ParseFromString(sess.run(summary_t))
+      values = [
+          value for value in summary_proto.value
+          if value.tag == "Iterator::Prefetch::buffer_size"
+      ]
+      self.assertEqual(1, len(values))
+      self.assertGreater(values[0].histo.num, 0)
+      self.assertGreater(values[0].histo.max, 1)
+
   def testMultipleTags(self):
     dataset = dataset_ops.Dataset.range(100).apply(
         stats_ops.latency_stats("record_latency")).apply(
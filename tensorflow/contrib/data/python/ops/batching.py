@@ -348,9 +348,11 @@ class _RestructuredDataset(dataset_ops.Dataset):
 class _MapAndBatchDataset(dataset_ops.MapDataset):
   """A `Dataset` that maps a function over a batch of elements."""
 
-  def __init__(self, input_dataset, map_func, batch_size, num_parallel_batches):
+  def __init__(self, input_dataset, map_func, batch_size, num_parallel_batches,
+               sloppy):
     """See `Dataset.map()` for details."""
     super(_MapAndBatchDataset, self).__init__(input_dataset, map_func)
+    self._sloppy = sloppy
     self._batch_size = ops.convert_to_tensor(
         batch_size, dtype=dtypes.int64, name="batch_size")
     self._num_parallel_batches = ops.convert_to_tensor(
@@ -365,6 +367,7 @@ class _MapAndBatchDataset(dataset_ops.MapDataset):
         f=self._map_func,
         batch_size=self._batch_size,
         num_parallel_batches=self._num_parallel_batches,
+        sloppy=self._sloppy,
         output_types=nest.flatten(
             sparse.as_dense_types(self.output_types, self.output_classes)),
         output_shapes=nest.flatten(
@@ -384,7 +387,7 @@ class _MapAndBatchDataset(dataset_ops.MapDataset):
     return self._output_types
 
 
-def map_and_batch(map_func, batch_size, num_parallel_batches=1):
+def map_and_batch(map_func, batch_size, num_parallel_batches=1, sloppy=False):
   """Fused implementation of `map` and `batch`.
 
   Maps `map_func` across `batch_size` consecutive elements of this dataset
@@ -404,6 +407,10 @@ def map_and_batch(map_func, batch_size, num_parallel_batches=1):
       number of batches to create in parallel. On one hand, higher values can
       help mitigate the effect of stragglers. On the other hand, higher values
       can increase contention if CPU is scarce.
+    sloppy: If false, batches are produced in deterministic order. Otherwise,
+      the first of the `num_parallel_batches` batches being created to be
+      complete is produced first, so that a straggler only holds up its own
+      batch. The elements within a batch are always in order.
 
   Returns:
     A `Dataset` transformation function, which can be passed to
@@ -412,6 +419,6 @@ def map_and_batch(map_func, batch_size, num_parallel_batches=1):
 
   def _apply_fn(dataset):
     return _MapAndBatchDataset(dataset, map_func, batch_size,
-                               num_parallel_batches)
+                               num_parallel_batches, sloppy)
 
   return _apply_fn
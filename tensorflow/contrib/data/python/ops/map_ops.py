@@ -0,0 +1,93 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Parallel map dataset transformations."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.python.data.ops import dataset_ops
+from tensorflow.python.data.util import nest
+from tensorflow.python.data.util import sparse
+from tensorflow.python.ops import gen_dataset_ops
+
+
+class _ParallelMapDataset(dataset_ops.ParallelMapDataset):
+  """A `Dataset` that maps a function over its input in parallel."""
+
+  def __init__(self, input_dataset, map_func, num_parallel_calls, sloppy):
+    """See `tf.contrib.data.parallel_map()` for details."""
+    super(_ParallelMapDataset, self).__init__(input_dataset, map_func,
+                                              num_parallel_calls)
+    self._sloppy = sloppy
+
+  def _as_variant_tensor(self):
+    # pylint: disable=protected-access
+    input_t = self._input_dataset._as_variant_tensor()
+    return gen_dataset_ops.parallel_map_dataset(
+        input_t,
+        self._map_func.captured_inputs,
+        f=self._map_func,
+        num_parallel_calls=self._num_parallel_calls,
+        sloppy=self._sloppy,
+        output_types=nest.flatten(
+            sparse.as_dense_types(self.output_types, self.output_classes)),
+        output_shapes=nest.flatten(
+            sparse.as_dense_shapes(self.output_shapes, self.output_classes)))
+    # pylint: enable=protected-access
+
+
+def parallel_map(map_func, num_parallel_calls, sloppy=False):
+  """A version of `Dataset.map()` that can produce elements out of order.
+
+  `parallel_map()` maps `map_func` across its input, invoking it on
+  `num_parallel_calls` elements in parallel, like @{tf.data.Dataset.map}. The
+  `sloppy` argument can be used to reduce the effect of stragglers, such as an
+  unusually large image to decode, by producing each element as soon as
+  `map_func` has finished with it, rather than after all the elements before
+  it. The reordering is bounded: an element is produced at most
+  `2 * num_parallel_calls - 1` positions ahead of its place in the input. If
+  `num_parallel_calls` is `tf.contrib.data.AUTOTUNE`, the bound is
+  `2 * C - 1` positions, where `C` is the number of schedulable CPUs, whatever
+  value it is tuned to.
+
+  Example usage:
+
+  ```python
+  dataset = filenames.apply(
+      tf.contrib.data.parallel_map(decode_image, num_parallel_calls=8,
+                                   sloppy=True))
+  ```
+
+  WARNING: If `sloppy` is `True`, the order of produced elements is not
+  deterministic.
+
+  Args:
+    map_func: A function mapping a nested structure of tensors to another
+      nested structure of tensors.
+    num_parallel_calls: A `tf.int32` scalar `tf.Tensor`, representing the
+      number of elements to process in parallel. If set to
+      `tf.contrib.data.AUTOTUNE`, the value is tuned at runtime.
+    sloppy: If false, elements are produced in deterministic order. Otherwise,
+      the implementation is allowed, for the sake of expediency, to produce
+      elements in a non-deterministic order.
+
+  Returns:
+    A `Dataset` transformation function, which can be passed to
+    @{tf.data.Dataset.apply}.
+  """
+  def _apply_fn(dataset):
+    return _ParallelMapDataset(dataset, map_func, num_parallel_calls, sloppy)
+
+  return _apply_fn
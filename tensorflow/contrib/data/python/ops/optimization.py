@@ -0,0 +1,29 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Experimental API for optimizing `tf.data` pipelines."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+# A constant that can be passed as `num_parallel_calls` to
+# `tf.data.Dataset.map()`, as `buffer_size` to `tf.data.Dataset.prefetch()`,
+# or as `buffer_output_elements` to `tf.contrib.data.parallel_interleave()`,
+# to have the value tuned at runtime. The iterator then reports how its buffer
+# fills and drains to a model of the whole input pipeline, which adjusts the
+# tuned values periodically, keeping the total parallelism within the number
+# of schedulable CPUs. If a `tf.contrib.data.StatsAggregator` is attached to
+# the iterator, every change is recorded in it under the name of the iterator
+# and the tuned argument.
+AUTOTUNE = -1
@@ -28,6 +28,7 @@
 @@HashTable
 @@MutableHashTable
 @@MutableDenseHashTable
+@@MemmappedHashTable
 @@TableInitializerBase
 @@KeyValueTensorInitializer
 @@TextFileIndex
@@ -0,0 +1,115 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+// Utility that converts a text vocabulary file into a prebuilt immutable hash
+// table that the MemmappedHashTable op maps into memory instead of parsing the
+// vocabulary at startup.
+//
+//  tensorflow/contrib/util/convert_vocab_to_memmapped_table
+//        --in_vocab=vocab.txt --out_table=vocab.table
+//
+// Parameters:
+// in_vocab - name of the text vocabulary file.
+// out_table - name of the output table file.
+// key_dtype, value_dtype - types of the table keys (string or int64) and values
+// (int32, int64, float or double).
+// key_index, value_index, delimiter, vocab_size - how to parse the vocabulary,
+// with the same meaning as for InitializeTableFromTextFileV2: a line is split
+// on the delimiter and the fields at key_index and value_index are used; -1
+// stands for the line number and -2 for the whole line. The defaults map every
+// line to its line number.
+
+#include <vector>
+
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/memmapped_lookup_table.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+namespace tensorflow {
+namespace {
+
+int ParseFlagsAndConvertVocab(int argc, char* argv[]) {
+  string in_vocab = "";
+  string out_table = "";
+  string key_dtype_name = "string";
+  string value_dtype_name = "int64";
+  int32 key_index = -2;
+  int32 value_index = -1;
+  string delimiter = "\t";
+  int64 vocab_size = -1;
+  std::vector<Flag> flag_list = {
+      Flag("in_vocab", &in_vocab, "input vocabulary text file"),
+      Flag("out_table", &out_table, "output table file"),
+      Flag("key_dtype", &key_dtype_name, "type of the keys: string or int64"),
+      Flag("value_dtype", &value_dtype_name,
+           "type of the values: int32, int64, float or double"),
+      Flag("key_index", &key_index,
+           "column of the key, -1 for the line number, -2 for the whole line"),
+      Flag("value_index", &value_index,
+           "column of the value, -1 for the line number"),
+      Flag("delimiter", &delimiter, "single character column delimiter"),
+      Flag("vocab_size", &vocab_size,
+           "number of lines to read, or -1 for the whole file"),
+  };
+  string usage = Flags::Usage(argv[0], flag_list);
+  const bool parse_result = Flags::Parse(&argc, argv, flag_list);
+  // We need to call this to set up global state for TensorFlow.
+  port::InitMain(usage.c_str(), &argc, &argv);
+  if (!parse_result) {
+    LOG(ERROR) << "\n" << usage;
+    return -1;
+  }
+  if (argc > 1) {
+    LOG(ERROR) << "Unknown argument " << argv[1] << "\n" << usage;
+    return -1;
+  }
+  if (in_vocab.empty()) {
+    LOG(ERROR) << "in_vocab can't be empty";
+    return -1;
+  }
+  if (out_table.empty()) {
+    LOG(ERROR) << "out_table can't be empty";
+    return -1;
+  }
+  if (delimiter.size() != 1) {
+    LOG(ERROR) << "delimiter must be a single character";
+    return -1;
+  }
+  DataType key_dtype;
+  DataType value_dtype;
+  if (!DataTypeFromString(key_dtype_name, &key_dtype) ||
+      !DataTypeFromString(value_dtype_name, &value_dtype)) {
+    LOG(ERROR) << "Unknown key or value type " << key_dtype_name << ", "
+               << value_dtype_name;
+    return -1;
+  }
+  const auto result = lookup::ConvertTextFileToMemmappedHashTable(
+      in_vocab, vocab_size, delimiter[0], key_index, value_index, key_dtype,
+      value_dtype, Env::Default(), out_table);
+  if (!result.ok()) {
+    LOG(ERROR) << "Conversion failed " << result.error_message();
+    return -1;
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace tensorflow
+
+int main(int argc, char* argv[]) {
+  return tensorflow::ParseFlagsAndConvertVocab(argc, argv);
+}
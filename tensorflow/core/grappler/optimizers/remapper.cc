@@ -0,0 +1,525 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/remapper.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_def_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/op_types.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+namespace grappler {
+
+namespace {
+
+// A Conv2D and the nodes following it that can be fused into a _FusedConv2D.
+// Each node is the only consumer of the previous one.
+struct FusedConv2D {
+  const NodeDef* conv2d = nullptr;
+  const NodeDef* bias_add = nullptr;
+  const NodeDef* batch_norm = nullptr;
+  const NodeDef* activation = nullptr;
+};
+
+bool IsOnCpu(const NodeDef& node) {
+  DeviceNameUtils::ParsedName parsed_name;
+  return DeviceNameUtils::ParseFullName(node.device(), &parsed_name) &&
+         parsed_name.has_type && parsed_name.type == DEVICE_CPU;
+}
+
+// Returns attribute 'name' of 'node', or its default value in the op
+// definition if it has been stripped from 'node'. Returns nullptr if it has
+// neither.
+const AttrValue* GetAttrOrDefault(const NodeDef& node, const string& name) {
+  const auto it = node.attr().find(name);
+  if (it != node.attr().end()) return &it->second;
+  const OpDef* op_def = nullptr;
+  if (!OpRegistry::Global()->LookUpOpDef(node.op(), &op_def).ok()) {
+    return nullptr;
+  }
+  const OpDef::AttrDef* attr_def = FindAttr(name, *op_def);
+  if (attr_def == nullptr || !attr_def->has_default_value()) return nullptr;
+  return &attr_def->default_value();
+}
+
+// Returns true if Conv2D may run on an implementation that _FusedConv2D would
+// bypass: MKL, whose layout pass only rewrites Conv2D nodes, libxsmm, or
+// DeepConv2D, which the TF_USE_DEEP_CONV2D environment variable enables (see
+// kernels/deep_conv2d.cc).
+bool Conv2DMayUseSpecializedKernel() {
+#if defined(INTEL_MKL) || defined(TENSORFLOW_USE_LIBXSMM_CONVOLUTIONS)
+  return true;
+#else
+  const char* deep_conv = getenv("TF_USE_DEEP_CONV2D");
+  return deep_conv != nullptr && StringPiece(deep_conv) != "0";
+#endif
+}
+
+string GetDataFormat(const NodeDef& node) {
+  return node.attr().count("data_format") ? node.attr().at("data_format").s()
+                                          : "NHWC";
+}
+
+// Returns the consumer of 'node' if it is the only node reading any output of
+// 'node' (or depending on it through a control edge), and reads output 0 of
+// 'node' as its first input exactly once. Returns nullptr otherwise.
+const NodeDef* GetSoleConsumer(const NodeDef& node, const NodeMap& node_map) {
+  const auto& outputs = node_map.GetOutputs(node.name());
+  if (outputs.size() != 1) return nullptr;
+  const NodeDef* consumer = *outputs.begin();
+  int position;
+  if (consumer->input_size() == 0 ||
+      ParseNodeName(consumer->input(0), &position) != node.name() ||
+      position != 0) {
+    return nullptr;
+  }
+  for (int i = 1; i < consumer->input_size(); ++i) {
+    if (NodeName(consumer->input(i)) == node.name()) return nullptr;
+  }
+  return consumer;
+}
+
+// Returns true if only output 0 of 'node' is read by other nodes.
+bool OnlyFirstOutputIsUsed(const NodeDef& node, const NodeMap& node_map) {
+  for (const NodeDef* consumer : node_map.GetOutputs(node.name())) {
+    for (const string& input : consumer->input()) {
+      int position;
+      if (ParseNodeName(input, &position) == node.name() && position > 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Finds the longest chain Conv2D -> [BiasAdd] -> [FusedBatchNorm] ->
+// [Relu | Relu6] starting at 'conv2d' that has at least a BiasAdd or a
+// FusedBatchNorm, and whose intermediate results are not used anywhere else.
+bool FindFusedConv2D(const NodeDef& conv2d, const NodeMap& node_map,
+                     const std::unordered_set<string>& nodes_to_preserve,
+                     FusedConv2D* fused) {
+  if (!IsConv2D(conv2d) || !IsOnCpu(conv2d) ||
+      GetDataFormat(conv2d) != "NHWC") {
+    return false;
+  }
+  // There is no CPU Conv2D kernel for double, so only float graphs ran before.
+  const DataType dtype = GetDataTypeFromAttr(conv2d, "T");
+  if (dtype != DT_FLOAT) return false;
+  if (conv2d.attr().count("dilations")) {
+    for (int64 dilation : conv2d.attr().at("dilations").list().i()) {
+      if (dilation != 1) return false;
+    }
+  }
+
+  // Returns the consumer of 'node' if 'node' can be fused into it.
+  auto next_node = [&](const NodeDef& node) -> const NodeDef* {
+    if (nodes_to_preserve.count(node.name())) return nullptr;
+    const NodeDef* consumer = GetSoleConsumer(node, node_map);
+    if (consumer == nullptr || consumer->device() != conv2d.device() ||
+        GetDataTypeFromAttr(*consumer, "T") != dtype) {
+      return nullptr;
+    }
+    return consumer;
+  };
+
+  *fused = FusedConv2D();
+  fused->conv2d = &conv2d;
+  const NodeDef* tail = &conv2d;
+  const NodeDef* node = next_node(*tail);
+  if (node != nullptr && IsBiasAdd(*node) && GetDataFormat(*node) == "NHWC") {
+    fused->bias_add = node;
+    tail = node;
+    node = next_node(*tail);
+  }
+  const AttrValue* is_training =
+      node != nullptr ? GetAttrOrDefault(*node, "is_training") : nullptr;
+  if (node != nullptr && IsFusedBatchNorm(*node) &&
+      GetDataFormat(*node) == "NHWC" && is_training != nullptr &&
+      !is_training->b() &&
+      (!node->attr().count("U") ||
+       node->attr().at("U").type() == dtype) &&
+      OnlyFirstOutputIsUsed(*node, node_map)) {
+    fused->batch_norm = node;
+    tail = node;
+    node = next_node(*tail);
+  }
+  if (fused->bias_add == nullptr && fused->batch_norm == nullptr) {
+    return false;
+  }
+  if (node != nullptr && (IsRelu(*node) || IsRelu6(*node))) {
+    fused->activation = node;
+  }
+  return true;
+}
+
+// Returns the _FusedConv2D node which replaces 'fused'. It takes the name of
+// the last node of the chain, so that the consumers of the chain still find
+// its result.
+NodeDef MakeFusedConv2DNode(const FusedConv2D& fused) {
+  const NodeDef& conv2d = *fused.conv2d;
+  const NodeDef* nodes[] = {fused.conv2d, fused.bias_add, fused.batch_norm,
+                            fused.activation};
+
+  NodeDef fused_node;
+  for (const NodeDef* node : nodes) {
+    if (node != nullptr) fused_node.set_name(node->name());
+  }
+  fused_node.set_op("_FusedConv2D");
+  fused_node.set_device(conv2d.device());
+  fused_node.add_input(conv2d.input(0));
+  fused_node.add_input(conv2d.input(1));
+
+  auto* attr = fused_node.mutable_attr();
+  (*attr)["T"] = conv2d.attr().at("T");
+  (*attr)["strides"] = conv2d.attr().at("strides");
+  (*attr)["padding"] = conv2d.attr().at("padding");
+  (*attr)["data_format"].set_s("NHWC");
+  if (conv2d.attr().count("dilations")) {
+    (*attr)["dilations"] = conv2d.attr().at("dilations");
+  }
+
+  auto* fused_ops = (*attr)["fused_ops"].mutable_list();
+  int num_args = 0;
+  if (fused.bias_add != nullptr) {
+    fused_ops->add_s("BiasAdd");
+    fused_node.add_input(fused.bias_add->input(1));
+    num_args += 1;
+  }
+  if (fused.batch_norm != nullptr) {
+    fused_ops->add_s("FusedBatchNorm");
+    // scale, offset, mean and variance.
+    for (int i = 1; i <= 4; ++i) {
+      fused_node.add_input(fused.batch_norm->input(i));
+    }
+    num_args += 4;
+    const AttrValue* epsilon = GetAttrOrDefault(*fused.batch_norm, "epsilon");
+    if (epsilon != nullptr) (*attr)["epsilon"] = *epsilon;
+  }
+  if (fused.activation != nullptr) {
+    fused_ops->add_s(fused.activation->op());
+  }
+  (*attr)["num_args"].set_i(num_args);
+
+  // Keeps the control dependencies of all the fused nodes.
+  for (const NodeDef* node : nodes) {
+    if (node == nullptr) continue;
+    for (const string& input : node->input()) {
+      if (IsControlInput(input)) fused_node.add_input(input);
+    }
+  }
+  DedupControlInputs(&fused_node);
+  return fused_node;
+}
+
+// Returns the number of inputs of 'node' if it is an elementwise op that
+// _FusedElementwise can evaluate (see kernels/cwise_op_fused.cc), and 0
+// otherwise.
+int NumFusableElementwiseInputs(const NodeDef& node) {
+  static const std::unordered_map<string, int>* kNumInputs =
+      new std::unordered_map<string, int>({{"Add", 2},
+                                           {"Sub", 2},
+                                           {"Mul", 2},
+                                           {"Div", 2},
+                                           {"RealDiv", 2},
+                                           {"Maximum", 2},
+                                           {"Minimum", 2},
+                                           {"SquaredDifference", 2},
+                                           {"Neg", 1},
+                                           {"Abs", 1},
+                                           {"Square", 1},
+                                           {"Sqrt", 1},
+                                           {"Rsqrt", 1},
+                                           {"Reciprocal", 1},
+                                           {"Exp", 1},
+                                           {"Log", 1},
+                                           {"Tanh", 1},
+                                           {"Sigmoid", 1},
+                                           {"Relu", 1},
+                                           {"Relu6", 1}});
+  const auto it = kNumInputs->find(node.op());
+  if (it == kNumInputs->end() || !IsOnCpu(node) ||
+      NumNonControlInputs(node) != it->second) {
+    return 0;
+  }
+  const DataType dtype = GetDataTypeFromAttr(node, "T");
+  if (dtype != DT_FLOAT && dtype != DT_DOUBLE) return 0;
+  return it->second;
+}
+
+// Upper bound on the number of ops of a _FusedElementwise, which keeps its
+// intermediate values in L1.
+constexpr int kMaxFusedElementwiseOps = 32;
+
+// Finds the groups of elementwise ops to rewrite into _FusedElementwise
+// nodes, ignoring the nodes in 'excluded'. Each group is a DAG of at least two
+// nodes in topological order; only its last node, the root, has consumers
+// outside of the group, and the others are not in 'nodes_to_preserve'.
+//
+// Groups are grown backwards from their root through producers whose
+// consumers are all in the group, so that no intermediate result has to be
+// written out. Roots are visited after all their elementwise consumers, which
+// lets each group extend as far up as possible.
+std::vector<std::vector<const NodeDef*>> FindFusedElementwise(
+    const GraphDef& graph, const NodeMap& node_map,
+    const std::unordered_set<string>& nodes_to_preserve,
+    const std::unordered_set<string>& excluded) {
+  std::unordered_map<string, const NodeDef*> fusable;
+  for (const NodeDef& node : graph.node()) {
+    if (!excluded.count(node.name()) && NumFusableElementwiseInputs(node)) {
+      fusable[node.name()] = &node;
+    }
+  }
+  // Returns the distinct fusable nodes that 'node' reads.
+  auto fusable_inputs = [&fusable](const NodeDef& node) {
+    std::vector<const NodeDef*> inputs;
+    for (const string& input : node.input()) {
+      if (IsControlInput(input)) continue;
+      const auto it = fusable.find(NodeName(input));
+      if (it != fusable.end() && std::find(inputs.begin(), inputs.end(),
+                                           it->second) == inputs.end()) {
+        inputs.push_back(it->second);
+      }
+    }
+    return inputs;
+  };
+
+  // Number of fusable consumers of each fusable node that are not in a group
+  // yet.
+  std::unordered_map<const NodeDef*, int> num_pending_consumers;
+  for (const auto& entry : fusable) {
+    for (const NodeDef* input : fusable_inputs(*entry.second)) {
+      ++num_pending_consumers[input];
+    }
+  }
+  std::deque<const NodeDef*> roots;
+  for (const NodeDef& node : graph.node()) {
+    if (fusable.count(node.name()) && !num_pending_consumers[&node]) {
+      roots.push_back(&node);
+    }
+  }
+
+  std::vector<std::vector<const NodeDef*>> groups;
+  std::unordered_set<const NodeDef*> grouped;
+  while (!roots.empty()) {
+    const NodeDef* root = roots.front();
+    roots.pop_front();
+    if (grouped.count(root)) continue;
+
+    // Absorbs producers until no more of them have all their consumers in
+    // the group.
+    std::unordered_set<const NodeDef*> members = {root};
+    bool grown = true;
+    while (grown) {
+      grown = false;
+      for (const NodeDef* member : std::vector<const NodeDef*>(
+               members.begin(), members.end())) {
+        for (const NodeDef* input : fusable_inputs(*member)) {
+          if (members.size() >= kMaxFusedElementwiseOps) break;
+          if (members.count(input) || grouped.count(input) ||
+              nodes_to_preserve.count(input->name()) ||
+              input->device() != root->device() ||
+              GetDataTypeFromAttr(*input, "T") !=
+                  GetDataTypeFromAttr(*root, "T")) {
+            continue;
+          }
+          bool all_consumers_in_group = true;
+          for (const NodeDef* consumer : node_map.GetOutputs(input->name())) {
+            all_consumers_in_group &= members.count(consumer) > 0;
+          }
+          if (all_consumers_in_group) {
+            members.insert(input);
+            grown = true;
+          }
+        }
+      }
+    }
+
+    // Orders the group so that each node comes after its inputs, and makes
+    // the producers outside of it ready once all their consumers are grouped.
+    std::vector<const NodeDef*> group;
+    std::unordered_set<const NodeDef*> ordered;
+    std::function<void(const NodeDef*)> order = [&](const NodeDef* node) {
+      if (!ordered.insert(node).second) return;
+      for (const NodeDef* input : fusable_inputs(*node)) {
+        if (members.count(input)) order(input);
+      }
+      group.push_back(node);
+    };
+    order(root);
+    for (const NodeDef* member : group) {
+      grouped.insert(member);
+      for (const NodeDef* input : fusable_inputs(*member)) {
+        if (!members.count(input) && --num_pending_consumers[input] == 0) {
+          roots.push_back(input);
+        }
+      }
+    }
+    if (group.size() >= 2) groups.push_back(std::move(group));
+  }
+  return groups;
+}
+
+// Returns the _FusedElementwise node which evaluates 'group', as returned by
+// FindFusedElementwise. It takes the name of the root of the group.
+NodeDef MakeFusedElementwiseNode(const std::vector<const NodeDef*>& group) {
+  const NodeDef& root = *group.back();
+  NodeDef fused_node;
+  fused_node.set_name(root.name());
+  fused_node.set_op("_FusedElementwise");
+  fused_node.set_device(root.device());
+
+  // Value ids of the inputs of the fused node, keyed by tensor name, then of
+  // the results of the nodes of the group, keyed by node name.
+  std::unordered_map<string, int> value_ids;
+  for (const NodeDef* node : group) {
+    for (const string& input : node->input()) {
+      if (IsControlInput(input)) continue;
+      int position;
+      const string input_node = ParseNodeName(input, &position);
+      const string tensor = strings::StrCat(input_node, ":", position);
+      if (std::find_if(group.begin(), group.end(),
+                       [&input_node](const NodeDef* member) {
+                         return member->name() == input_node;
+                       }) != group.end() ||
+          value_ids.count(tensor)) {
+        continue;
+      }
+      value_ids[tensor] = fused_node.input_size();
+      fused_node.add_input(input);
+    }
+  }
+  const int num_inputs = fused_node.input_size();
+  for (int i = 0; i < group.size(); ++i) {
+    value_ids[strings::StrCat(group[i]->name(), ":0")] = num_inputs + i;
+  }
+
+  auto* attr = fused_node.mutable_attr();
+  (*attr)["T"] = root.attr().at("T");
+  (*attr)["N"].set_i(num_inputs);
+  auto* ops = (*attr)["ops"].mutable_list();
+  auto* operands = (*attr)["operands"].mutable_list();
+  for (const NodeDef* node : group) {
+    ops->add_s(node->op());
+    const int num_operands = NumNonControlInputs(*node);
+    for (int i = 0; i < 2; ++i) {
+      if (i < num_operands) {
+        int position;
+        const string input_node = ParseNodeName(node->input(i), &position);
+        operands->add_i(
+            value_ids.at(strings::StrCat(input_node, ":", position)));
+      } else {
+        operands->add_i(-1);
+      }
+    }
+  }
+
+  // Keeps the control dependencies of all the fused nodes.
+  for (const NodeDef* node : group) {
+    for (const string& input : node->input()) {
+      if (IsControlInput(input)) fused_node.add_input(input);
+    }
+  }
+  DedupControlInputs(&fused_node);
+  return fused_node;
+}
+
+}  // namespace
+
+Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
+                          GraphDef* optimized_graph) {
+  *optimized_graph = item.graph;
+  NodeMap node_map(optimized_graph);
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+
+  // Fused nodes, keyed by the name of the node they replace.
+  std::unordered_map<string, NodeDef> fused_nodes;
+  std::unordered_set<string> nodes_to_delete;
+  const bool fuse_conv2d = !Conv2DMayUseSpecializedKernel();
+  for (const NodeDef& node : optimized_graph->node()) {
+    FusedConv2D fused;
+    if (!fuse_conv2d ||
+        !FindFusedConv2D(node, node_map, nodes_to_preserve, &fused)) {
+      continue;
+    }
+    NodeDef fused_node = MakeFusedConv2DNode(fused);
+    for (const NodeDef* fused_away :
+         {fused.conv2d, fused.bias_add, fused.batch_norm, fused.activation}) {
+      if (fused_away != nullptr && fused_away->name() != fused_node.name()) {
+        nodes_to_delete.insert(fused_away->name());
+      }
+    }
+    VLOG(2) << "Fused " << fused_node.op() << " into " << fused_node.name();
+    fused_nodes[fused_node.name()] = std::move(fused_node);
+  }
+
+  std::unordered_set<string> already_fused = nodes_to_delete;
+  for (const auto& entry : fused_nodes) {
+    already_fused.insert(entry.first);
+  }
+  for (const auto& group : FindFusedElementwise(
+           *optimized_graph, node_map, nodes_to_preserve, already_fused)) {
+    NodeDef fused_node = MakeFusedElementwiseNode(group);
+    for (const NodeDef* fused_away : group) {
+      if (fused_away->name() != fused_node.name()) {
+        nodes_to_delete.insert(fused_away->name());
+      }
+    }
+    VLOG(2) << "Fused " << group.size() << " elementwise ops into "
+            << fused_node.name();
+    fused_nodes[fused_node.name()] = std::move(fused_node);
+  }
+  if (fused_nodes.empty()) {
+    return Status::OK();
+  }
+
+  protobuf::RepeatedPtrField<NodeDef> nodes;
+  nodes.Swap(optimized_graph->mutable_node());
+  for (NodeDef& node : nodes) {
+    if (nodes_to_delete.count(node.name())) continue;
+    auto it = fused_nodes.find(node.name());
+    if (it != fused_nodes.end()) {
+      optimized_graph->add_node()->Swap(&it->second);
+    } else {
+      optimized_graph->add_node()->Swap(&node);
+    }
+  }
+  return Status::OK();
+}
+
+void Remapper::Feedback(Cluster* /*cluster*/, const GrapplerItem& /*item*/,
+                        const GraphDef& /*optimized_graph*/,
+                        double /*result*/) {
+  // Nothing to do for Remapper.
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
@@ -0,0 +1,50 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_GRAPPLER_OPTIMIZERS_REMAPPER_H_
+#define TENSORFLOW_GRAPPLER_OPTIMIZERS_REMAPPER_H_
+
+#include "tensorflow/core/grappler/optimizers/graph_optimizer.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// Replaces patterns of ops with fused ops that compute the same result with
+// fewer passes over memory. Currently rewrites:
+//  - a Conv2D followed by a BiasAdd and/or an inference mode FusedBatchNorm,
+//    and optionally by a Relu or Relu6, into a single _FusedConv2D;
+//  - groups of connected elementwise ops (Mul, Add, Sigmoid, ...) whose
+//    intermediate results are not used elsewhere into a single
+//    _FusedElementwise, which does not write those results to memory.
+// Only nodes placed on CPU are rewritten, since the fused ops have no GPU
+// kernels.
+class Remapper : public GraphOptimizer {
+ public:
+  Remapper() {}
+  ~Remapper() override {}
+
+  string name() const override { return "remapper"; };
+
+  Status Optimize(Cluster* cluster, const GrapplerItem& item,
+                  GraphDef* optimized_graph) override;
+
+  void Feedback(Cluster* cluster, const GrapplerItem& item,
+                const GraphDef& optimized_graph, double result) override;
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_GRAPPLER_OPTIMIZERS_REMAPPER_H_
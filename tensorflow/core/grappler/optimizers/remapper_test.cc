@@ -0,0 +1,414 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/optimizers/remapper.h"
+
+#include <stdlib.h>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/grappler/utils/grappler_test.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+class RemapperTest : public GrapplerTest {
+ protected:
+  // Values are uniform in [0, 1), so they are also valid variances.
+  Output RandomConst(const Scope& s, const string& name,
+                     const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    return ops::Const(s.WithOpName(name), Input::Initializer(t));
+  }
+
+  // Builds input -> Conv2D -> [BiasAdd] -> [FusedBatchNorm] -> [Relu].
+  void BuildConvChain(const string& device, bool bias_add, bool batch_norm,
+                      bool relu, GraphDef* graph) {
+    Scope s = Scope::NewRootScope().WithDevice(device);
+    Output input = RandomConst(s, "input", {2, 9, 9, 3});
+    Output filter = RandomConst(s, "filter", {3, 3, 3, 8});
+    Output output = ops::Conv2D(s.WithOpName("conv"), input, filter,
+                                {1, 1, 1, 1}, "SAME");
+    if (bias_add) {
+      Output bias = RandomConst(s, "bias", {8});
+      output = ops::BiasAdd(s.WithOpName("bias_add"), output, bias);
+    }
+    if (batch_norm) {
+      Output scale = RandomConst(s, "scale", {8});
+      Output offset = RandomConst(s, "offset", {8});
+      Output mean = RandomConst(s, "mean", {8});
+      Output variance = RandomConst(s, "variance", {8});
+      output = ops::FusedBatchNorm(s.WithOpName("batch_norm"), output, scale,
+                                   offset, mean, variance,
+                                   ops::FusedBatchNorm::IsTraining(false))
+                   .y;
+    }
+    if (relu) {
+      output = ops::Relu(s.WithOpName("relu"), output);
+    }
+    ops::Identity(s.WithOpName("fetch"), output);
+    TF_CHECK_OK(s.ToGraphDef(graph));
+  }
+
+  const NodeDef* FindNode(const GraphDef& graph, const string& name) {
+    for (const NodeDef& node : graph.node()) {
+      if (node.name() == name) return &node;
+    }
+    return nullptr;
+  }
+};
+
+// MKL builds rewrite Conv2D into their own layout-aware kernels, so the
+// remapper leaves convolutions alone there.
+#ifndef INTEL_MKL
+TEST_F(RemapperTest, FuseConv2DBiasAddRelu) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", true, false, true, &item.graph);
+  item.fetch = {"fetch"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size() - 2, output.node_size());
+  EXPECT_EQ(nullptr, FindNode(output, "conv"));
+  EXPECT_EQ(nullptr, FindNode(output, "bias_add"));
+  const NodeDef* fused = FindNode(output, "relu");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("_FusedConv2D", fused->op());
+  ASSERT_EQ(3, fused->input_size());
+  EXPECT_EQ("input", fused->input(0));
+  EXPECT_EQ("filter", fused->input(1));
+  EXPECT_EQ("bias", fused->input(2));
+  EXPECT_EQ(1, fused->attr().at("num_args").i());
+  const auto& fused_ops = fused->attr().at("fused_ops").list();
+  ASSERT_EQ(2, fused_ops.s_size());
+  EXPECT_EQ("BiasAdd", fused_ops.s(0));
+  EXPECT_EQ("Relu", fused_ops.s(1));
+
+  auto expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-5);
+}
+
+TEST_F(RemapperTest, FuseConv2DBatchNorm) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", false, true, false, &item.graph);
+  item.fetch = {"fetch"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(nullptr, FindNode(output, "conv"));
+  const NodeDef* fused = FindNode(output, "batch_norm");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("_FusedConv2D", fused->op());
+  ASSERT_EQ(6, fused->input_size());
+  EXPECT_EQ("scale", fused->input(2));
+  EXPECT_EQ("offset", fused->input(3));
+  EXPECT_EQ("mean", fused->input(4));
+  EXPECT_EQ("variance", fused->input(5));
+  EXPECT_EQ(4, fused->attr().at("num_args").i());
+
+  auto expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-4);
+}
+
+TEST_F(RemapperTest, FuseConv2DBiasAddBatchNormRelu) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", true, true, true, &item.graph);
+  item.fetch = {"fetch"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size() - 3, output.node_size());
+  const NodeDef* fused = FindNode(output, "relu");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("_FusedConv2D", fused->op());
+  EXPECT_EQ(7, fused->input_size());
+  EXPECT_EQ(5, fused->attr().at("num_args").i());
+  EXPECT_EQ(3, fused->attr().at("fused_ops").list().s_size());
+
+  auto expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-4);
+}
+
+#endif  // INTEL_MKL
+
+TEST_F(RemapperTest, NoFusionOnGpu) {
+  GrapplerItem item;
+  BuildConvChain("/device:GPU:0", true, false, true, &item.graph);
+  item.fetch = {"fetch"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_FusedConv2D", node.op());
+  }
+}
+
+#ifndef INTEL_MKL
+TEST_F(RemapperTest, PreservedIntermediateIsNotFused) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", true, false, true, &item.graph);
+  // The result of the BiasAdd must stay visible, so only Conv2D and BiasAdd
+  // can be fused.
+  item.fetch = {"fetch", "bias_add"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  const NodeDef* fused = FindNode(output, "bias_add");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("_FusedConv2D", fused->op());
+  EXPECT_EQ(1, fused->attr().at("fused_ops").list().s_size());
+  const NodeDef* relu = FindNode(output, "relu");
+  ASSERT_NE(nullptr, relu);
+  EXPECT_EQ("Relu", relu->op());
+}
+
+TEST_F(RemapperTest, StrippedEpsilonUsesDefault) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", false, true, false, &item.graph);
+  item.fetch = {"fetch"};
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "batch_norm") node.mutable_attr()->erase("epsilon");
+  }
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  const NodeDef* fused = FindNode(output, "batch_norm");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("_FusedConv2D", fused->op());
+  EXPECT_FLOAT_EQ(0.0001f, fused->attr().at("epsilon").f());
+
+  auto expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-4);
+}
+#endif  // INTEL_MKL
+
+TEST_F(RemapperTest, StrippedIsTrainingIsNotFused) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", false, true, false, &item.graph);
+  item.fetch = {"fetch"};
+  // is_training defaults to true, and training batch norm cannot be folded.
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    if (node.name() == "batch_norm") node.mutable_attr()->erase("is_training");
+  }
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_FusedConv2D", node.op());
+  }
+}
+
+TEST_F(RemapperTest, DoubleConv2DIsNotFused) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", true, false, true, &item.graph);
+  item.fetch = {"fetch"};
+  for (NodeDef& node : *item.graph.mutable_node()) {
+    auto* attr = node.mutable_attr();
+    if (attr->count("T")) (*attr)["T"].set_type(DT_DOUBLE);
+  }
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_FusedConv2D", node.op());
+  }
+}
+
+TEST_F(RemapperTest, NoFusionWithDeepConv2D) {
+  GrapplerItem item;
+  BuildConvChain("/device:CPU:0", true, false, true, &item.graph);
+  item.fetch = {"fetch"};
+
+  // _FusedConv2D would bypass the Winograd kernels selected by this variable.
+  setenv("TF_USE_DEEP_CONV2D", "1", 1);
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+  unsetenv("TF_USE_DEEP_CONV2D");
+
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_FusedConv2D", node.op());
+  }
+}
+
+TEST_F(RemapperTest, SharedIntermediateIsNotFused) {
+  Scope s = Scope::NewRootScope().WithDevice("/device:CPU:0");
+  Output input = RandomConst(s, "input", {1, 5, 5, 2});
+  Output filter = RandomConst(s, "filter", {1, 1, 2, 4});
+  Output bias = RandomConst(s, "bias", {4});
+  Output conv = ops::Conv2D(s.WithOpName("conv"), input, filter, {1, 1, 1, 1},
+                            "VALID");
+  Output bias_add = ops::BiasAdd(s.WithOpName("bias_add"), conv, bias);
+  // The convolution result has a second consumer.
+  Output other = ops::Relu(s.WithOpName("other"), conv);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"bias_add", "other"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_FusedConv2D", node.op());
+  }
+}
+
+// Builds Swish(x * w + b), with x * w + b also consumed by "other" if
+// 'shared' is true.
+void BuildSwish(const string& device, bool shared, GraphDef* graph) {
+  Scope s = Scope::NewRootScope().WithDevice(device);
+  Tensor x(DT_FLOAT, {2, 3, 8});
+  x.flat<float>().setRandom();
+  Tensor w(DT_FLOAT, {3, 1});
+  w.flat<float>().setRandom();
+  Output mul = ops::Mul(s.WithOpName("mul"),
+                        ops::Const(s.WithOpName("x"), Input::Initializer(x)),
+                        ops::Const(s.WithOpName("w"), Input::Initializer(w)));
+  Output add = ops::Add(s.WithOpName("add"), mul,
+                        ops::Const(s.WithOpName("b"), 0.5f));
+  Output sigmoid = ops::Sigmoid(s.WithOpName("sigmoid"), add);
+  ops::Mul(s.WithOpName("swish"), add, sigmoid);
+  if (shared) {
+    ops::Identity(s.WithOpName("other"), add);
+  }
+  TF_CHECK_OK(s.ToGraphDef(graph));
+}
+
+TEST_F(RemapperTest, FuseElementwise) {
+  GrapplerItem item;
+  BuildSwish("/device:CPU:0", false, &item.graph);
+  item.fetch = {"swish"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size() - 3, output.node_size());
+  EXPECT_EQ(nullptr, FindNode(output, "mul"));
+  EXPECT_EQ(nullptr, FindNode(output, "add"));
+  EXPECT_EQ(nullptr, FindNode(output, "sigmoid"));
+  const NodeDef* fused = FindNode(output, "swish");
+  ASSERT_NE(nullptr, fused);
+  EXPECT_EQ("_FusedElementwise", fused->op());
+  ASSERT_EQ(3, fused->input_size());
+  EXPECT_EQ("x", fused->input(0));
+  EXPECT_EQ("w", fused->input(1));
+  EXPECT_EQ("b", fused->input(2));
+  EXPECT_EQ(3, fused->attr().at("N").i());
+  const auto& ops = fused->attr().at("ops").list();
+  ASSERT_EQ(4, ops.s_size());
+  EXPECT_EQ("Mul", ops.s(0));
+  EXPECT_EQ("Add", ops.s(1));
+  EXPECT_EQ("Sigmoid", ops.s(2));
+  EXPECT_EQ("Mul", ops.s(3));
+  const auto& operands = fused->attr().at("operands").list();
+  const std::vector<int> expected_operands = {0, 1, 3, 2, 4, -1, 4, 5};
+  ASSERT_EQ(expected_operands.size(), operands.i_size());
+  for (int i = 0; i < expected_operands.size(); ++i) {
+    EXPECT_EQ(expected_operands[i], operands.i(i));
+  }
+
+  auto expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-6);
+}
+
+TEST_F(RemapperTest, SharedElementwiseIntermediateIsNotFusedAway) {
+  GrapplerItem item;
+  BuildSwish("/device:CPU:0", true, &item.graph);
+  item.fetch = {"swish", "other"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  // The result of "add" is still needed, so the ops before and after it are
+  // fused separately.
+  EXPECT_EQ(item.graph.node_size() - 2, output.node_size());
+  const NodeDef* add = FindNode(output, "add");
+  ASSERT_NE(nullptr, add);
+  EXPECT_EQ("_FusedElementwise", add->op());
+  EXPECT_EQ(2, add->attr().at("ops").list().s_size());
+  const NodeDef* swish = FindNode(output, "swish");
+  ASSERT_NE(nullptr, swish);
+  EXPECT_EQ("_FusedElementwise", swish->op());
+  ASSERT_EQ(1, swish->input_size());
+  EXPECT_EQ("add", swish->input(0));
+  EXPECT_EQ(2, swish->attr().at("ops").list().s_size());
+
+  auto expected = EvaluateNodes(item.graph, item.fetch);
+  auto tensors = EvaluateNodes(output, item.fetch);
+  ASSERT_EQ(2, tensors.size());
+  test::ExpectTensorNear<float>(expected[0], tensors[0], 1e-6);
+  test::ExpectTensorNear<float>(expected[1], tensors[1], 1e-6);
+}
+
+TEST_F(RemapperTest, NoElementwiseFusionOnGpu) {
+  GrapplerItem item;
+  BuildSwish("/device:GPU:0", false, &item.graph);
+  item.fetch = {"swish"};
+
+  Remapper optimizer;
+  GraphDef output;
+  TF_EXPECT_OK(optimizer.Optimize(nullptr, item, &output));
+
+  EXPECT_EQ(item.graph.node_size(), output.node_size());
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("_FusedElementwise", node.op());
+  }
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
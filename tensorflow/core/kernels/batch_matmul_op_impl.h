@@ -17,6 +17,7 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <type_traits>
 #include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op.h"
@@ -191,6 +192,189 @@ struct SequentialMatMulKernel {
   }
 };
 
+// Calls f(0), ..., f(N - 1) with the loop unrolled at compile time, so that
+// arrays indexed by the loop variable stay in registers.
+template <int N>
+struct SmallMatMulUnroll {
+  template <typename F>
+  static EIGEN_ALWAYS_INLINE void Run(const F& f) {
+    SmallMatMulUnroll<N - 1>::Run(f);
+    f(N - 1);
+  }
+};
+
+template <>
+struct SmallMatMulUnroll<0> {
+  template <typename F>
+  static EIGEN_ALWAYS_INLINE void Run(const F& f) {}
+};
+
+// Register-blocked kernel for the small matrix products of a large batch.
+// Computes kRows x (kPackets * packet size) of z at (row, col), keeping the
+// accumulators in registers over the whole depth.
+template <typename Scalar, int kRows, int kPackets>
+struct SmallMatMulBlock {
+  typedef typename Eigen::internal::packet_traits<Scalar>::type Packet;
+  static constexpr int kPacketSize =
+      Eigen::internal::packet_traits<Scalar>::size;
+
+  static EIGEN_ALWAYS_INLINE void Run(const Scalar* x, int64 x_row_stride,
+                                      int64 x_depth_stride, const Scalar* y,
+                                      int64 n, int64 depth, Scalar* z) {
+    Packet acc[kRows][kPackets];
+    SmallMatMulUnroll<kRows>::Run([&](int r) {
+      SmallMatMulUnroll<kPackets>::Run([&](int c) {
+        acc[r][c] = Eigen::internal::pset1<Packet>(Scalar(0));
+      });
+    });
+    for (int64 p = 0; p < depth; ++p) {
+      Packet b[kPackets];
+      SmallMatMulUnroll<kPackets>::Run([&](int c) {
+        b[c] = Eigen::internal::ploadu<Packet>(y + p * n + c * kPacketSize);
+      });
+      const Scalar* x_p = x + p * x_depth_stride;
+      SmallMatMulUnroll<kRows>::Run([&](int r) {
+        const Packet a = Eigen::internal::pset1<Packet>(x_p[r * x_row_stride]);
+        SmallMatMulUnroll<kPackets>::Run([&](int c) {
+          acc[r][c] = Eigen::internal::pmadd(a, b[c], acc[r][c]);
+        });
+      });
+    }
+    SmallMatMulUnroll<kRows>::Run([&](int r) {
+      SmallMatMulUnroll<kPackets>::Run([&](int c) {
+        Eigen::internal::pstoreu(z + r * n + c * kPacketSize, acc[r][c]);
+      });
+    });
+  }
+};
+
+// Computes z = op(x) * y for one matrix of the batch, where y is row-major
+// depth x n and op(x) is addressed through strides, so that an adjoint x
+// needs no copy. kM, kN and kDepth are the dimensions when known at compile
+// time, or 0 when they are only known at run time.
+template <typename Scalar, int kM, int kN, int kDepth>
+void SmallMatMul(const Scalar* x, int64 x_row_stride, int64 x_depth_stride,
+                 const Scalar* y, int64 rows, int64 cols, int64 inner,
+                 Scalar* z) {
+  const int64 m = kM > 0 ? kM : rows;
+  const int64 n = kN > 0 ? kN : cols;
+  const int64 depth = kDepth > 0 ? kDepth : inner;
+  constexpr int kPacketSize = Eigen::internal::packet_traits<Scalar>::size;
+  constexpr int kRows = 4;
+  constexpr int kPackets = 2;
+  const int64 m_blocked = m - m % kRows;
+  int64 col = 0;
+  for (; col + kPackets * kPacketSize <= n; col += kPackets * kPacketSize) {
+    int64 row = 0;
+    for (; row < m_blocked; row += kRows) {
+      SmallMatMulBlock<Scalar, kRows, kPackets>::Run(
+          x + row * x_row_stride, x_row_stride, x_depth_stride, y + col, n,
+          depth, z + row * n + col);
+    }
+    for (; row < m; ++row) {
+      SmallMatMulBlock<Scalar, 1, kPackets>::Run(
+          x + row * x_row_stride, x_row_stride, x_depth_stride, y + col, n,
+          depth, z + row * n + col);
+    }
+  }
+  for (; col + kPacketSize <= n; col += kPacketSize) {
+    int64 row = 0;
+    for (; row < m_blocked; row += kRows) {
+      SmallMatMulBlock<Scalar, kRows, 1>::Run(x + row * x_row_stride,
+                                              x_row_stride, x_depth_stride,
+                                              y + col, n, depth,
+                                              z + row * n + col);
+    }
+    for (; row < m; ++row) {
+      SmallMatMulBlock<Scalar, 1, 1>::Run(x + row * x_row_stride,
+                                          x_row_stride, x_depth_stride,
+                                          y + col, n, depth,
+                                          z + row * n + col);
+    }
+  }
+  // Columns that do not fill a packet.
+  for (; col < n; ++col) {
+    for (int64 row = 0; row < m; ++row) {
+      Scalar sum(0);
+      for (int64 p = 0; p < depth; ++p) {
+        sum += x[row * x_row_stride + p * x_depth_stride] * y[p * n + col];
+      }
+      z[row * n + col] = sum;
+    }
+  }
+}
+
+// Batch matmul kernel for large batches of small real matrices, which
+// computes each product with the register-blocked SmallMatMul above instead
+// of going through the packing and blocking of Eigen's general matrix
+// product. Only used when IsSupported() returns true.
+template <typename Scalar,
+          bool IsFloat = std::is_floating_point<Scalar>::value>
+struct SmallMatMulKernel {
+  static bool IsSupported(int64 m, int64 n, int64 depth) { return false; }
+
+  static void Run(const Tensor& in_x, const Tensor& in_y, bool adj_x,
+                  bool adj_y, Tensor* out, int start, int limit) {}
+};
+
+template <typename Scalar>
+struct SmallMatMulKernel<Scalar, true> {
+  static constexpr int kPacketSize =
+      Eigen::internal::packet_traits<Scalar>::size;
+  // Beyond this size the right hand side no longer fits in L1, and Eigen's
+  // blocking pays off (see the BM_BatchMatmul benchmarks).
+  static constexpr int64 kMaxDim = 64;
+
+  static bool IsSupported(int64 m, int64 n, int64 depth) {
+    return m <= kMaxDim && n <= kMaxDim && depth <= kMaxDim &&
+           n % kPacketSize == 0;
+  }
+
+  static void Run(const Tensor& in_x, const Tensor& in_y, bool adj_x,
+                  bool adj_y, Tensor* out, int start, int limit) {
+    const int64 m = out->dim_size(1);
+    const int64 n = out->dim_size(2);
+    const int64 depth = in_x.dim_size(adj_x ? 1 : 2);
+    const int64 x_row_stride = adj_x ? 1 : depth;
+    const int64 x_depth_stride = adj_x ? m : 1;
+    const Scalar* x_data = in_x.flat<Scalar>().data();
+    const Scalar* y_data = in_y.flat<Scalar>().data();
+    Scalar* z_data = out->flat<Scalar>().data();
+
+    // The kernel reads rows of y, so an adjoint y is transposed into a buffer
+    // first.
+    std::vector<Scalar> y_transposed(adj_y ? depth * n : 0);
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic,
+                          Eigen::RowMajor>
+        Matrix;
+    for (int i = start; i < limit; ++i) {
+      const Scalar* x = x_data + i * m * depth;
+      const Scalar* y = y_data + i * depth * n;
+      if (adj_y) {
+        Eigen::Map<Matrix>(y_transposed.data(), depth, n) =
+            Eigen::Map<const Matrix>(y, n, depth).transpose();
+        y = y_transposed.data();
+      }
+      Scalar* z = z_data + i * m * n;
+      // Fixed sizes for the most common square products, e.g. attention
+      // heads.
+      if (m == n && n == depth && n == 64) {
+        SmallMatMul<Scalar, 64, 64, 64>(x, x_row_stride, x_depth_stride, y, m,
+                                        n, depth, z);
+      } else if (m == n && n == depth && n == 32) {
+        SmallMatMul<Scalar, 32, 32, 32>(x, x_row_stride, x_depth_stride, y, m,
+                                        n, depth, z);
+      } else if (m == n && n == depth && n == 16) {
+        SmallMatMul<Scalar, 16, 16, 16>(x, x_row_stride, x_depth_stride, y, m,
+                                        n, depth, z);
+      } else {
+        SmallMatMul<Scalar, 0, 0, 0>(x, x_row_stride, x_depth_stride, y, m, n,
+                                     depth, z);
+      }
+    }
+  }
+};
+
 }  // namespace
 
 template <typename Device, typename Scalar>
@@ -223,11 +407,19 @@ struct LaunchBatchMatMul<CPUDevice, Scalar> {
     } else {
       // Parallelize over outer dims. For small matrices and large batches, it
       // is counter-productive to parallelize the inner matrix multiplies.
+      const bool use_small_kernel = SmallMatMulKernel<Scalar>::IsSupported(
+          out->dim_size(1), out->dim_size(2), in_x.dim_size(adj_x ? 1 : 2));
       Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
             cost_per_unit,
-            [&in_x, &in_y, adj_x, adj_y, out](int start, int limit) {
-              SequentialMatMulKernel<Scalar>::Run(in_x, in_y, adj_x, adj_y, out,
-                                                  start, limit);
+            [&in_x, &in_y, adj_x, adj_y, out, use_small_kernel](int start,
+                                                                 int limit) {
+              if (use_small_kernel) {
+                SmallMatMulKernel<Scalar>::Run(in_x, in_y, adj_x, adj_y, out,
+                                               start, limit);
+              } else {
+                SequentialMatMulKernel<Scalar>::Run(in_x, in_y, adj_x, adj_y,
+                                                    out, start, limit);
+              }
             });
     }
     if (conjugate_result) {
@@ -104,6 +104,17 @@ BM_BatchMatmul(32, 256, 256, 256, false, false);
 BM_BatchMatmul(32, 1024, 1024, 1024, false, false);
 BM_BatchMatmul(32, 2048, 2048, 2048, false, false);
 
+// Large batches of small matrices, as in attention layers.
+BM_BatchMatmul(4096, 64, 64, 64, false, false);
+BM_BatchMatmul(4096, 64, 64, 64, true, false);
+BM_BatchMatmul(4096, 64, 64, 64, false, true);
+BM_BatchMatmul(8192, 32, 32, 32, false, false);
+BM_BatchMatmul(16384, 16, 16, 16, false, false);
+BM_BatchMatmul(16384, 8, 8, 8, false, false);
+BM_BatchMatmul(4096, 48, 64, 32, false, false);
+BM_BatchMatmul(2048, 100, 64, 100, false, false);
+BM_BatchMatmul(1024, 128, 128, 128, false, false);
+
 // Matrix-vector multiplies.
 BM_BatchMatmul(1, 10000, 200, 1, false, false);
 BM_BatchMatmul(8, 10000, 200, 1, false, false);
@@ -46,6 +46,15 @@ void ConcatCPU(
     const std::vector<std::unique_ptr<typename TTypes<T, 2>::ConstMatrix>>&
         inputs,
     typename TTypes<T, 2>::Matrix* output);
+
+// The inverse of ConcatCPU: splits the columns of `input` into `outputs`,
+// which have as many rows as input and widths that add up to its width.
+template <typename T>
+void SplitCPU(
+    DeviceBase* d, typename TTypes<T, 2>::ConstMatrix input,
+    const std::vector<std::unique_ptr<typename TTypes<T, 2>::Matrix>>&
+        outputs);
+
 #if GOOGLE_CUDA
 template <typename T>
 void ConcatGPU(
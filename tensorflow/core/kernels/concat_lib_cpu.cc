@@ -16,9 +16,19 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include "tensorflow/core/kernels/concat_lib_cpu.h"
+#include <string.h>
+#include <algorithm>
 #include <vector>
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/concat_lib.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+// Copies much larger than the cache use non-temporal stores where available.
+#undef USE_STREAMING_COPY
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define USE_STREAMING_COPY 1
+#include <emmintrin.h>
+#endif
 
 namespace tensorflow {
 
@@ -45,6 +55,156 @@ struct MemCpyCopier<ResourceHandle> {
   }
 };
 
+// Copies n bytes. Pieces of many-input concats and many-output splits are
+// often only a few elements wide, and then an inline copy is much cheaper
+// than a call to memcpy.
+inline void CopySmall(char* dst, const char* src, size_t n) {
+  if (n > 64) {
+    memcpy(dst, src, n);
+    return;
+  }
+  for (; n >= 8; n -= 8, dst += 8, src += 8) memcpy(dst, src, 8);
+  for (; n > 0; --n) *dst++ = *src++;
+}
+
+// Copies n bytes with non-temporal stores, which do not pull the destination
+// into the cache, for copies too large to stay in it anyway.
+inline void StreamingCopy(char* dst, const char* src, size_t n) {
+#ifdef USE_STREAMING_COPY
+  const size_t head =
+      std::min(n, (16 - reinterpret_cast<uintptr_t>(dst) % 16) % 16);
+  memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  n -= head;
+  for (; n >= 64; n -= 64, dst += 64, src += 64) {
+    const __m128i* s = reinterpret_cast<const __m128i*>(src);
+    __m128i* d = reinterpret_cast<__m128i*>(dst);
+    const __m128i a = _mm_loadu_si128(s);
+    const __m128i b = _mm_loadu_si128(s + 1);
+    const __m128i c = _mm_loadu_si128(s + 2);
+    const __m128i e = _mm_loadu_si128(s + 3);
+    _mm_stream_si128(d, a);
+    _mm_stream_si128(d + 1, b);
+    _mm_stream_si128(d + 2, c);
+    _mm_stream_si128(d + 3, e);
+  }
+  memcpy(dst, src, n);
+  // Non-temporal stores are weakly ordered; make them visible before the
+  // copy is reported done.
+  _mm_sfence();
+#else
+  memcpy(dst, src, n);
+#endif
+}
+
+template <typename T>
+struct StreamingCopier {
+  inline void Copy(T* dst, const T* src, int input_index, size_t n) {
+    StreamingCopy(reinterpret_cast<char*>(dst),
+                  reinterpret_cast<const char*>(src), n * sizeof(T));
+  }
+};
+
+// Concats and splits of types that can be memcpy'd are done as byte copies
+// between a joined matrix and its pieces: row r of the joined matrix is the
+// concatenation of row r of every piece.
+struct JoinedMatrix {
+  char* joined;
+  int64 num_rows;
+  int64 row_bytes;
+  std::vector<char*> pieces;
+  std::vector<int64> piece_bytes;
+};
+
+// Whether the pieces are copied into the joined matrix, or out of it.
+enum CopyDirection { kConcat, kSplit };
+
+// Pieces with at most this many bytes on average are copied row by row with
+// CopySmall.
+constexpr int64 kSmallPieceBytes = 128;
+// Outputs of at least this many bytes, in pieces of at least
+// kStreamingMinPieceBytes on average, are written with StreamingCopy.
+constexpr int64 kStreamingMinBytes = 16 << 20;
+constexpr int64 kStreamingMinPieceBytes = 4096;
+
+// Copies whole rows, one pass over all pieces per row; the threads share
+// the rows. Suits many narrow pieces.
+template <CopyDirection direction>
+void CopyRows(DeviceBase* d, const JoinedMatrix& m) {
+  const size_t num_pieces = m.pieces.size();
+  auto work = [&m, num_pieces](int64 start, int64 end) {
+    for (int64 r = start; r < end; ++r) {
+      char* joined = m.joined + r * m.row_bytes;
+      for (size_t j = 0; j < num_pieces; ++j) {
+        const int64 n = m.piece_bytes[j];
+        char* piece = m.pieces[j] + r * n;
+        if (direction == kConcat) {
+          CopySmall(joined, piece, n);
+        } else {
+          CopySmall(piece, joined, n);
+        }
+        joined += n;
+      }
+    }
+  };
+  auto worker_threads = d->tensorflow_cpu_worker_threads();
+  // Charge every piece a few bytes' worth of overhead.
+  Shard(worker_threads->num_threads, worker_threads->workers, m.num_rows,
+        m.row_bytes + 16 * num_pieces, work);
+}
+
+// Copies the joined matrix as one range of bytes that the threads share,
+// whatever its shape. Suits few wide pieces.
+template <CopyDirection direction, typename CopyFn>
+void CopyBytes(DeviceBase* d, const JoinedMatrix& m, CopyFn copy) {
+  const int64 num_pieces = m.pieces.size();
+  auto work = [&m, num_pieces, &copy](int64 start, int64 end) {
+    int64 r = start / m.row_bytes;
+    int64 offset = start - r * m.row_bytes;
+    int64 j = 0;
+    while (offset >= m.piece_bytes[j]) offset -= m.piece_bytes[j++];
+    while (start < end) {
+      const int64 n = std::min(m.piece_bytes[j] - offset, end - start);
+      char* joined = m.joined + start;
+      char* piece = m.pieces[j] + r * m.piece_bytes[j] + offset;
+      if (direction == kConcat) {
+        copy(joined, piece, n);
+      } else {
+        copy(piece, joined, n);
+      }
+      start += n;
+      offset = 0;
+      if (++j == num_pieces) {
+        j = 0;
+        ++r;
+      }
+    }
+  };
+  auto worker_threads = d->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers,
+        m.num_rows * m.row_bytes, /*cost_per_unit=*/1, work);
+}
+
+enum JoinedCopyKind { kSmallPieces, kStreaming, kDefault };
+
+JoinedCopyKind ChooseCopyKind(const JoinedMatrix& m) {
+  const int64 num_pieces = m.pieces.size();
+  if (m.row_bytes <= kSmallPieceBytes * num_pieces) return kSmallPieces;
+  if (m.num_rows * m.row_bytes >= kStreamingMinBytes &&
+      m.row_bytes >= kStreamingMinPieceBytes * num_pieces) {
+    return kStreaming;
+  }
+  return kDefault;
+}
+
+template <typename T, typename Matrix>
+void AddPiece(Matrix* piece, JoinedMatrix* m) {
+  m->pieces.push_back(
+      const_cast<char*>(reinterpret_cast<const char*>(piece->data())));
+  m->piece_bytes.push_back(piece->dimension(1) * sizeof(T));
+}
+
 }  // namespace
 
 template <typename T>
@@ -56,12 +216,71 @@ void ConcatCPU(
   if (std::is_same<T, string>::value) {
     // use a large cost here to force strings to be handled by separate threads
     ConcatCPUImpl<T>(d, inputs, 100000, MemCpyCopier<T>(), output);
+  } else if (DataTypeCanUseMemcpy(DataTypeToEnum<T>::v()) &&
+             output->size() > 0) {
+    JoinedMatrix m{reinterpret_cast<char*>(output->data()),
+                   output->dimension(0),
+                   static_cast<int64>(output->dimension(1) * sizeof(T))};
+    for (const auto& input : inputs) AddPiece<T>(input.get(), &m);
+    switch (ChooseCopyKind(m)) {
+      case kSmallPieces:
+        CopyRows<kConcat>(d, m);
+        break;
+      case kStreaming:
+        ConcatCPUImpl<T>(d, inputs, sizeof(T) /* cost_per_unit */,
+                         StreamingCopier<T>(), output);
+        break;
+      default:
+        ConcatCPUImpl<T>(d, inputs, sizeof(T) /* cost_per_unit */,
+                         MemCpyCopier<T>(), output);
+    }
   } else {
     ConcatCPUImpl<T>(d, inputs, sizeof(T) /* cost_per_unit */,
                      MemCpyCopier<T>(), output);
   }
 }
 
+template <typename T>
+void SplitCPU(
+    DeviceBase* d, typename TTypes<T, 2>::ConstMatrix input,
+    const std::vector<std::unique_ptr<typename TTypes<T, 2>::Matrix>>&
+        outputs) {
+  if (input.size() == 0) return;
+  if (!DataTypeCanUseMemcpy(DataTypeToEnum<T>::v())) {
+    auto work = [&input, &outputs](int64 start, int64 end) {
+      for (int64 r = start; r < end; ++r) {
+        const T* in = &input(r, 0);
+        for (const auto& output : outputs) {
+          const int64 n = output->dimension(1);
+          std::copy(in, in + n, output->data() + r * n);
+          in += n;
+        }
+      }
+    };
+    auto worker_threads = d->tensorflow_cpu_worker_threads();
+    // As in ConcatCPU, strings are expensive enough to be worth a thread.
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          input.dimension(0), 100000, work);
+    return;
+  }
+  JoinedMatrix m{const_cast<char*>(reinterpret_cast<const char*>(input.data())),
+                 input.dimension(0),
+                 static_cast<int64>(input.dimension(1) * sizeof(T))};
+  for (const auto& output : outputs) AddPiece<T>(output.get(), &m);
+  switch (ChooseCopyKind(m)) {
+    case kSmallPieces:
+      CopyRows<kSplit>(d, m);
+      break;
+    case kStreaming:
+      CopyBytes<kSplit>(d, m, StreamingCopy);
+      break;
+    default:
+      CopyBytes<kSplit>(d, m, [](char* dst, const char* src, size_t n) {
+        memcpy(dst, src, n);
+      });
+  }
+}
+
 #define REGISTER(T)                                                            \
   template void ConcatCPU<T>(                                                  \
       DeviceBase*,                                                             \
@@ -74,6 +293,14 @@ REGISTER(quint16)
 REGISTER(qint16)
 REGISTER(qint32)
 
+#define REGISTER_SPLIT(T)                                                  \
+  template void SplitCPU<T>(                                               \
+      DeviceBase*, typename TTypes<T, 2>::ConstMatrix,                     \
+      const std::vector<std::unique_ptr<typename TTypes<T, 2>::Matrix>>&);
+TF_CALL_ALL_TYPES(REGISTER_SPLIT)
+REGISTER_SPLIT(quint8)
+#undef REGISTER_SPLIT
+
 #if defined(IS_MOBILE_PLATFORM) && !defined(SUPPORT_SELECTIVE_REGISTRATION) && \
     !defined(__ANDROID_TYPES_FULL__)
     // Primarily used for SavedModel support on mobile. Registering it here only
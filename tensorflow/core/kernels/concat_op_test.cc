@@ -126,6 +126,50 @@ static void BM_ConcatManyDim1bfloat16(int iters, int dim2) {
 
 BENCHMARK(BM_ConcatManyDim1bfloat16)->Arg(18)->Arg(34)->Arg(60);
 
+// Concatenates `num_inputs` float inputs of shape [dim1, dim2] along
+// dimension 1, which exercises the per-row copy paths of ConcatCPU.
+static void ConcatWideHelper(int iters, int num_inputs, int dim1, int dim2) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor concat_dim(DT_INT32, TensorShape({}));
+  concat_dim.scalar<int32>()() = 1;
+  std::vector<NodeBuilder::NodeOut> inputs;
+  inputs.reserve(num_inputs);
+  for (int i = 0; i < num_inputs; ++i) {
+    Tensor in(DT_FLOAT, TensorShape({dim1, dim2}));
+    in.flat<float>().setRandom();
+    inputs.push_back(test::graph::Constant(g, in));
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Concat")
+                  .Input(test::graph::Constant(g, concat_dim))
+                  .Input(inputs)
+                  .Attr("N", num_inputs)
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &node));
+  testing::BytesProcessed(static_cast<int64>(iters) * num_inputs * dim1 *
+                          dim2 * sizeof(float));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+// Many tiny inputs: 512 inputs of `dim2` floats per row.
+static void BM_ConcatTinyInputsFloat(int iters, int dim2) {
+  ConcatWideHelper(iters, 512, 1024, dim2);
+}
+
+BENCHMARK(BM_ConcatTinyInputsFloat)->Arg(1)->Arg(4)->Arg(16);
+
+// Few huge inputs: `num_inputs` inputs of 16M floats in total.
+static void BM_ConcatHugeInputsFloat(int iters, int num_inputs) {
+  ConcatWideHelper(iters, num_inputs, 16, (1 << 20) / num_inputs);
+}
+
+BENCHMARK(BM_ConcatHugeInputsFloat)->Arg(2)->Arg(4)->Arg(8);
+
 static void MemcpyAlternativeHelper(int iters, int concat_dimension, int dim2) {
   testing::StopTiming();
 
@@ -30,6 +30,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/conv_2d.h"
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
 #include "tensorflow/core/kernels/deep_conv2d.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #ifdef TENSORFLOW_USE_LIBXSMM_CONVOLUTIONS
@@ -79,12 +80,14 @@ struct LaunchGeneric {
 
       Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dim_pair;
       dim_pair[0] = Eigen::IndexPair<Eigen::DenseIndex>(1, 0);
-      functor::MatMulConvFunctor<Device, T>()(
-          ctx->eigen_device<Device>(),
-          output->shaped<T, 2>({conv_width, filter.dim_size(3)}),
-          input.shaped<T, 2>({conv_width, filter.dim_size(2)}),
-          filter.shaped<T, 2>({filter.dim_size(2), filter.dim_size(3)}),
-          dim_pair);
+      auto out = output->shaped<T, 2>({conv_width, filter.dim_size(3)});
+      auto in0 = input.shaped<T, 2>({conv_width, filter.dim_size(2)});
+      auto in1 = filter.shaped<T, 2>({filter.dim_size(2), filter.dim_size(3)});
+      if (!functor::DispatchToCPUISA<T>::MatMul(ctx->eigen_device<Device>(),
+                                                out, in0, in1, dim_pair)) {
+        functor::MatMulConvFunctor<Device, T>()(ctx->eigen_device<Device>(),
+                                                out, in0, in1, dim_pair);
+      }
     } else if (filter.dim_size(0) == input.dim_size(1) &&
                filter.dim_size(1) == input.dim_size(2) && row_dilation == 1 &&
                col_dilation == 1 && padding == VALID) {
@@ -95,12 +98,19 @@ struct LaunchGeneric {
 
       Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dim_pair;
       dim_pair[0] = Eigen::IndexPair<Eigen::DenseIndex>(1, 0);
-      functor::MatMulConvFunctor<Device, T>()(
-          ctx->eigen_device<Device>(),
-          output->shaped<T, 2>({input.dim_size(0), filter.dim_size(3)}),
-          input.shaped<T, 2>({input.dim_size(0), k}),
-          filter.shaped<T, 2>({k, filter.dim_size(3)}), dim_pair);
-    } else {
+      auto out = output->shaped<T, 2>({input.dim_size(0), filter.dim_size(3)});
+      auto in0 = input.shaped<T, 2>({input.dim_size(0), k});
+      auto in1 = filter.shaped<T, 2>({k, filter.dim_size(3)});
+      if (!functor::DispatchToCPUISA<T>::MatMul(ctx->eigen_device<Device>(),
+                                                out, in0, in1, dim_pair)) {
+        functor::MatMulConvFunctor<Device, T>()(ctx->eigen_device<Device>(),
+                                                out, in0, in1, dim_pair);
+      }
+    } else if (!functor::DispatchToCPUISA<T>::SpatialConvolution(
+                   ctx->eigen_device<Device>(), output->tensor<T, 4>(),
+                   input.tensor<T, 4>(), filter.tensor<T, 4>(), row_stride,
+                   col_stride, row_dilation, col_dilation,
+                   BrainPadding2EigenPadding(padding))) {
       functor::SpatialConvolution<Device, T>()(
           ctx->eigen_device<Device>(), output->tensor<T, 4>(),
           input.tensor<T, 4>(), filter.tensor<T, 4>(), row_stride, col_stride,
@@ -156,9 +166,13 @@ class LaunchDeepConvOp<CPUDevice, float> {
                   int dilation_cols, int stride_rows, int stride_cols,
                   Tensor* output, TensorFormat data_format) {
     if (data_format != FORMAT_NHWC || dilation_rows != 1 ||
-        dilation_cols != 1 ||
-        !CanUseDeepConv2D(stride_rows, stride_cols, filter_rows, filter_cols,
-                          in_depth, out_depth, out_rows, out_cols)) {
+        dilation_cols != 1) {
+      return false;
+    }
+    const DeepConv2DAlgorithm algorithm = SelectDeepConv2DAlgorithm(
+        stride_rows, stride_cols, filter_rows, filter_cols, in_depth,
+        out_depth, out_rows, out_cols, batch);
+    if (algorithm == DeepConv2DAlgorithm::kDefault) {
       return false;
     }
 
@@ -174,6 +188,7 @@ class LaunchDeepConvOp<CPUDevice, float> {
     args.out_rows = out_rows;
     args.out_cols = out_cols;
     args.out_depth = out_depth;
+    args.algorithm = algorithm;
 
     auto input_ptr = input.template flat<float>().data();
     auto filter_ptr = filter.template flat<float>().data();
@@ -19,6 +19,7 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include <string.h>
+#include <algorithm>
 #include <map>
 #include <vector>
 #include "tensorflow/core/framework/common_shape_fns.h"
@@ -34,9 +35,11 @@ limitations under the License.
 #include "tensorflow/core/kernels/gemm_functors.h"
 #include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/util/mirror_pad_mode.h"
 #include "tensorflow/core/util/padding.h"
 #include "tensorflow/core/util/tensor_format.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -894,4 +897,398 @@ TF_CALL_float(REGISTER_FUSED);
 
 TF_CALL_float(REGISTER_PAD_ONLY_FUSED);
 
+namespace {
+
+// Activations that _FusedConv2D can apply to the convolution output.
+enum class FusedActivation { kNone, kRelu, kRelu6 };
+
+// Shape of a _FusedConv2D convolution of an NHWC input.
+struct FusedConv2DDims {
+  int64 batch;
+  int64 in_rows;
+  int64 in_cols;
+  int64 in_depth;
+  int64 filter_rows;
+  int64 filter_cols;
+  int64 out_depth;
+  int64 stride_rows;
+  int64 stride_cols;
+  int64 pad_rows;
+  int64 pad_cols;
+  int64 out_rows;
+  int64 out_cols;
+};
+
+// Computes output = activation(output * scale + offset) for a block of
+// 'num_rows' rows of 'depth' channels, 'row_stride' elements apart, where
+// 'scale' and 'offset' hold one value per channel. 'scale' is only read if
+// kHasScale is true, i.e. if a batch normalization was folded into it.
+template <typename T, bool kHasScale, FusedActivation kActivation>
+void ApplyFusedOutputStage(const T* scale, const T* offset, int64 num_rows,
+                           int64 depth, int64 row_stride, T* output) {
+  typedef Eigen::Array<T, Eigen::Dynamic, 1> Array;
+  Eigen::Map<const Array> scale_array(scale, kHasScale ? depth : 0);
+  Eigen::Map<const Array> offset_array(offset, depth);
+  for (int64 i = 0; i < num_rows; ++i) {
+    Eigen::Map<Array> row(output + i * row_stride, depth);
+    if (kHasScale) {
+      row = row * scale_array + offset_array;
+    } else {
+      row += offset_array;
+    }
+    if (kActivation == FusedActivation::kRelu) {
+      row = row.cwiseMax(static_cast<T>(0));
+    } else if (kActivation == FusedActivation::kRelu6) {
+      row = row.cwiseMax(static_cast<T>(0)).cwiseMin(static_cast<T>(6));
+    }
+  }
+}
+
+template <typename T>
+using FusedOutputStageFn = void (*)(const T* scale, const T* offset,
+                                    int64 num_rows, int64 depth,
+                                    int64 row_stride, T* output);
+
+template <typename T, bool kHasScale>
+FusedOutputStageFn<T> GetFusedOutputStage(FusedActivation activation) {
+  switch (activation) {
+    case FusedActivation::kRelu:
+      return ApplyFusedOutputStage<T, kHasScale, FusedActivation::kRelu>;
+    case FusedActivation::kRelu6:
+      return ApplyFusedOutputStage<T, kHasScale, FusedActivation::kRelu6>;
+    default:
+      return ApplyFusedOutputStage<T, kHasScale, FusedActivation::kNone>;
+  }
+}
+
+// Copies the input patches of output pixels [patch_start, patch_start +
+// num_patches) into the rows of the row-major matrix 'im2col', with zeros for
+// the filter taps which fall into the padding.
+template <typename T>
+void FusedConv2DIm2Col(const FusedConv2DDims& dims, const T* input,
+                       int64 patch_start, int64 num_patches, T* im2col) {
+  const int64 row_size = dims.filter_cols * dims.in_depth;
+  for (int64 patch = patch_start; patch < patch_start + num_patches;
+       ++patch) {
+    const int64 out_c = patch % dims.out_cols;
+    const int64 out_r = (patch / dims.out_cols) % dims.out_rows;
+    const int64 b = patch / (dims.out_cols * dims.out_rows);
+    const int64 in_r_origin = out_r * dims.stride_rows - dims.pad_rows;
+    const int64 in_c_origin = out_c * dims.stride_cols - dims.pad_cols;
+
+    // Range of filter cols which fall inside the input.
+    const int64 f_c_start = std::max<int64>(0, -in_c_origin);
+    const int64 f_c_end =
+        std::min<int64>(dims.filter_cols, dims.in_cols - in_c_origin);
+    const int64 head_size = f_c_start * dims.in_depth;
+    const int64 copy_size = (f_c_end - f_c_start) * dims.in_depth;
+
+    for (int64 f_r = 0; f_r < dims.filter_rows; ++f_r) {
+      const int64 in_r = in_r_origin + f_r;
+      if (in_r < 0 || in_r >= dims.in_rows || copy_size <= 0) {
+        std::fill_n(im2col, row_size, T(0));
+      } else {
+        const T* in = input + ((b * dims.in_rows + in_r) * dims.in_cols +
+                               in_c_origin + f_c_start) *
+                                  dims.in_depth;
+        std::fill_n(im2col, head_size, T(0));
+        std::copy_n(in, copy_size, im2col + head_size);
+        std::fill_n(im2col + head_size + copy_size,
+                    row_size - head_size - copy_size, T(0));
+      }
+      im2col += row_size;
+    }
+  }
+}
+
+// Computes output pixels [patch_start, patch_limit) and output channels
+// [depth_start, depth_limit) of a _FusedConv2D, 'block_size' pixels at a
+// time. Each block of input patches is lowered to a matrix in 'im2col_buffer'
+// (1x1 convolutions with unit strides use the input in place), multiplied by
+// the filter, and passed through 'output_stage' while the block of the output
+// is still in cache.
+template <typename T>
+void FusedConv2DBlocks(const FusedConv2DDims& dims, const T* input,
+                       const T* filter, const T* scale, const T* offset,
+                       FusedOutputStageFn<T> output_stage, int64 patch_start,
+                       int64 patch_limit, int64 depth_start, int64 depth_limit,
+                       int64 block_size, T* im2col_buffer, T* output) {
+  typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+  const int64 patch_size = dims.filter_rows * dims.filter_cols * dims.in_depth;
+  const int64 depth = depth_limit - depth_start;
+  const bool is_pointwise = dims.filter_rows == 1 && dims.filter_cols == 1 &&
+                            dims.stride_rows == 1 && dims.stride_cols == 1;
+
+  Eigen::Map<const Matrix> filter_matrix(filter, patch_size, dims.out_depth);
+  const auto filter_block = filter_matrix.middleCols(depth_start, depth);
+
+  for (int64 start = patch_start; start < patch_limit; start += block_size) {
+    const int64 num_patches = std::min(block_size, patch_limit - start);
+    const T* patches = input + start * dims.in_depth;
+    if (!is_pointwise) {
+      FusedConv2DIm2Col(dims, input, start, num_patches, im2col_buffer);
+      patches = im2col_buffer;
+    }
+    Eigen::Map<Matrix> output_matrix(output + start * dims.out_depth,
+                                     num_patches, dims.out_depth);
+    output_matrix.middleCols(depth_start, depth).noalias() =
+        Eigen::Map<const Matrix>(patches, num_patches, patch_size) *
+        filter_block;
+    output_stage(scale + depth_start, offset + depth_start, num_patches, depth,
+                 dims.out_depth, output_matrix.data() + depth_start);
+  }
+}
+
+}  // namespace
+
+// Implements the convolution of _FusedConv2D, which the grappler remapper
+// creates from Conv2D nodes followed by BiasAdd and/or an inference mode
+// FusedBatchNorm, optionally followed by Relu or Relu6. The bias and the batch
+// normalization are folded into one per-channel scale and offset, which are
+// applied together with the activation to each block of the GEMM output right
+// after it is computed, instead of in separate passes over the whole output.
+template <typename T>
+class FusedConv2DOp : public OpKernel {
+ public:
+  explicit FusedConv2DOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("strides", &strides_));
+    OP_REQUIRES(context, strides_.size() == 4,
+                errors::InvalidArgument("Sliding window strides field must "
+                                        "specify 4 dimensions"));
+    OP_REQUIRES(context, strides_[0] == 1 && strides_[3] == 1,
+                errors::InvalidArgument(
+                    "Current implementation does not yet support "
+                    "strides in the batch and depth dimensions."));
+    OP_REQUIRES(context, strides_[1] > 0 && strides_[2] > 0,
+                errors::InvalidArgument(
+                    "Row and column strides should be larger than 0."));
+    OP_REQUIRES_OK(context, context->GetAttr("padding", &padding_));
+
+    string data_format;
+    OP_REQUIRES_OK(context, context->GetAttr("data_format", &data_format));
+    OP_REQUIRES(context, data_format == "NHWC",
+                errors::Unimplemented(
+                    "_FusedConv2D on CPU only supports the NHWC format"));
+    std::vector<int32> dilations;
+    OP_REQUIRES_OK(context, context->GetAttr("dilations", &dilations));
+    OP_REQUIRES(context,
+                dilations.size() == 4 &&
+                    std::all_of(dilations.begin(), dilations.end(),
+                                [](int32 d) { return d == 1; }),
+                errors::Unimplemented(
+                    "_FusedConv2D on CPU does not support dilations"));
+
+    // 'fused_ops' is an optional "BiasAdd", then an optional
+    // "FusedBatchNorm", then an optional "Relu" or "Relu6".
+    std::vector<string> fused_ops;
+    OP_REQUIRES_OK(context, context->GetAttr("fused_ops", &fused_ops));
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+    auto op = fused_ops.begin();
+    has_bias_ = op != fused_ops.end() && *op == "BiasAdd";
+    if (has_bias_) ++op;
+    has_batch_norm_ = op != fused_ops.end() && *op == "FusedBatchNorm";
+    if (has_batch_norm_) ++op;
+    activation_ = FusedActivation::kNone;
+    if (op != fused_ops.end() && *op == "Relu") {
+      activation_ = FusedActivation::kRelu;
+      ++op;
+    } else if (op != fused_ops.end() && *op == "Relu6") {
+      activation_ = FusedActivation::kRelu6;
+      ++op;
+    }
+    OP_REQUIRES(context,
+                op == fused_ops.end() && (has_bias_ || has_batch_norm_),
+                errors::Unimplemented("Unsupported fused_ops: [",
+                                      str_util::Join(fused_ops, ", "), "]"));
+    const int expected_num_args =
+        (has_bias_ ? 1 : 0) + (has_batch_norm_ ? 4 : 0);
+    OP_REQUIRES(context, num_args == expected_num_args,
+                errors::InvalidArgument("Expected ", expected_num_args,
+                                        " arguments for fused_ops [",
+                                        str_util::Join(fused_ops, ", "),
+                                        "], but got ", num_args));
+    if (has_batch_norm_) {
+      OP_REQUIRES_OK(context, context->GetAttr("epsilon", &epsilon_));
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Input tensor is of the following dimensions:
+    // [ batch, in_rows, in_cols, in_depth ]
+    const Tensor& input = context->input(0);
+    // Input filter is of the following dimensions:
+    // [ filter_rows, filter_cols, in_depth, out_depth]
+    const Tensor& filter = context->input(1);
+
+    OP_REQUIRES(context, input.dims() == 4,
+                errors::InvalidArgument("input must be 4-dimensional",
+                                        input.shape().DebugString()));
+    OP_REQUIRES(context, filter.dims() == 4,
+                errors::InvalidArgument("filter must be 4-dimensional: ",
+                                        filter.shape().DebugString()));
+    OP_REQUIRES(context, input.dim_size(3) == filter.dim_size(2),
+                errors::InvalidArgument(
+                    "input and filter must have the same depth: ",
+                    input.dim_size(3), " vs ", filter.dim_size(2)));
+
+    FusedConv2DDims dims;
+    dims.batch = input.dim_size(0);
+    dims.in_rows = input.dim_size(1);
+    dims.in_cols = input.dim_size(2);
+    dims.in_depth = input.dim_size(3);
+    dims.filter_rows = filter.dim_size(0);
+    dims.filter_cols = filter.dim_size(1);
+    dims.out_depth = filter.dim_size(3);
+    dims.stride_rows = strides_[1];
+    dims.stride_cols = strides_[2];
+    OP_REQUIRES_OK(context, GetWindowedOutputSize(
+                                dims.in_rows, dims.filter_rows,
+                                dims.stride_rows, padding_, &dims.out_rows,
+                                &dims.pad_rows));
+    OP_REQUIRES_OK(context, GetWindowedOutputSize(
+                                dims.in_cols, dims.filter_cols,
+                                dims.stride_cols, padding_, &dims.out_cols,
+                                &dims.pad_cols));
+
+    // Folds the fused ops into output = activation(conv * scale + offset).
+    const int num_args = context->num_inputs() - 2;
+    for (int i = 0; i < num_args; ++i) {
+      const Tensor& arg = context->input(2 + i);
+      OP_REQUIRES(context,
+                  TensorShapeUtils::IsVector(arg.shape()) &&
+                      arg.dim_size(0) == dims.out_depth,
+                  errors::InvalidArgument(
+                      "Argument ", i, " must be a vector of size ",
+                      dims.out_depth, ": ", arg.shape().DebugString()));
+    }
+    std::vector<T> scale(dims.out_depth, T(1));
+    std::vector<T> offset(dims.out_depth, T(0));
+    if (has_bias_) {
+      auto bias = context->input(2).vec<T>();
+      for (int64 d = 0; d < dims.out_depth; ++d) offset[d] = bias(d);
+    }
+    if (has_batch_norm_) {
+      // y = (x - mean) * gamma / sqrt(variance + epsilon) + beta.
+      const int bn = has_bias_ ? 3 : 2;
+      auto gamma = context->input(bn).vec<T>();
+      auto beta = context->input(bn + 1).vec<T>();
+      auto mean = context->input(bn + 2).vec<T>();
+      auto variance = context->input(bn + 3).vec<T>();
+      for (int64 d = 0; d < dims.out_depth; ++d) {
+        scale[d] = gamma(d) / Eigen::numext::sqrt(
+                                  variance(d) + static_cast<T>(epsilon_));
+        offset[d] = (offset[d] - mean(d)) * scale[d] + beta(d);
+      }
+    }
+
+    TensorShape out_shape = ShapeFromFormat(
+        FORMAT_NHWC, dims.batch, dims.out_rows, dims.out_cols, dims.out_depth);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, out_shape, &output));
+    if (out_shape.num_elements() == 0) {
+      return;
+    }
+
+    const FusedOutputStageFn<T> output_stage =
+        has_batch_norm_ ? GetFusedOutputStage<T, true>(activation_)
+                        : GetFusedOutputStage<T, false>(activation_);
+
+    // Splits the output into row blocks of about kOutputBlockSize bytes, which
+    // stay in L2 between the GEMM and the output stage, and those blocks into
+    // one contiguous range per thread. Blocks have at least kMinBlockRows rows
+    // so that packing the filter for each GEMM stays cheap. If there are fewer
+    // blocks than threads, e.g. for the later layers of a network at batch
+    // size 1, the threads also split the output channels.
+    static constexpr int64 kOutputBlockSize = 128 * 1024;
+    static constexpr int64 kMinBlockRows = 64;
+    const int64 num_patches = dims.batch * dims.out_rows * dims.out_cols;
+    const int64 patch_size =
+        dims.filter_rows * dims.filter_cols * dims.in_depth;
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 num_threads = worker_threads.num_threads;
+    int64 block_size = std::max<int64>(
+        kMinBlockRows, kOutputBlockSize / (dims.out_depth * sizeof(T)));
+    block_size = std::min(block_size,
+                          std::max<int64>(kMinBlockRows,
+                                          (num_patches + num_threads - 1) /
+                                              num_threads));
+    block_size = std::min(block_size, num_patches);
+    const int64 num_blocks = (num_patches + block_size - 1) / block_size;
+    const int64 num_patch_tasks = std::min(num_blocks, num_threads);
+    // Output channels are split in multiples of 16, which keeps the GEMM
+    // output columns aligned to full SIMD registers.
+    const int64 num_depth_tasks =
+        std::max<int64>(1, std::min(num_threads / num_patch_tasks,
+                                    dims.out_depth / 16));
+    const int64 num_tasks = num_patch_tasks * num_depth_tasks;
+
+    Tensor im2col_buffer;
+    const bool is_pointwise = dims.filter_rows == 1 &&
+                              dims.filter_cols == 1 && dims.stride_rows == 1 &&
+                              dims.stride_cols == 1;
+    if (!is_pointwise) {
+      OP_REQUIRES_OK(context, context->allocate_temp(
+                                  DataTypeToEnum<T>::value,
+                                  TensorShape({num_tasks, block_size,
+                                               patch_size}),
+                                  &im2col_buffer));
+    }
+
+    const T* input_data = input.flat<T>().data();
+    const T* filter_data = filter.flat<T>().data();
+    const T* scale_data = scale.data();
+    const T* offset_data = offset.data();
+    T* im2col_data = is_pointwise ? nullptr : im2col_buffer.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    auto task = [&](int64 start, int64 limit) {
+      for (int64 t = start; t < limit; ++t) {
+        const int64 p = t / num_depth_tasks;
+        const int64 d = t % num_depth_tasks;
+        const int64 patch_start =
+            p * num_blocks / num_patch_tasks * block_size;
+        const int64 patch_limit = std::min(
+            num_patches, (p + 1) * num_blocks / num_patch_tasks * block_size);
+        const int64 depth_start =
+            d * dims.out_depth / num_depth_tasks / 16 * 16;
+        const int64 depth_limit =
+            d + 1 == num_depth_tasks
+                ? dims.out_depth
+                : (d + 1) * dims.out_depth / num_depth_tasks / 16 * 16;
+        FusedConv2DBlocks<T>(
+            dims, input_data, filter_data, scale_data, offset_data,
+            output_stage, patch_start, patch_limit, depth_start, depth_limit,
+            block_size,
+            im2col_data == nullptr
+                ? nullptr
+                : im2col_data + t * block_size * patch_size,
+            output_data);
+      }
+    };
+    // Each task is a large chunk of work, so Shard runs each on its own
+    // thread.
+    const int64 cost_per_task =
+        num_patches * patch_size * dims.out_depth / num_tasks;
+    Shard(num_threads, worker_threads.workers, num_tasks, cost_per_task, task);
+  }
+
+ private:
+  std::vector<int32> strides_;
+  Padding padding_;
+  bool has_bias_;
+  bool has_batch_norm_;
+  FusedActivation activation_;
+  float epsilon_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusedConv2DOp);
+};
+
+#define REGISTER_FUSED_CONV2D(T)                                      \
+  REGISTER_KERNEL_BUILDER(                                            \
+      Name("_FusedConv2D").Device(DEVICE_CPU).TypeConstraint<T>("T"), \
+      FusedConv2DOp<T>);
+
+TF_CALL_float(REGISTER_FUSED_CONV2D);
+
 }  // namespace tensorflow
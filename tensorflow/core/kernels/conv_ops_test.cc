@@ -22,6 +22,8 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/platform/test.h"
@@ -464,4 +466,283 @@ TEST_F(ConvOpTest, HandwrittenConv) { HandwrittenConv(); }
 
 TEST_F(ConvOpTest, AnisotropicStride) { AnisotropicStrides(); }
 
+class FusedConv2DOpTest : public OpsTestBase {
+ protected:
+  // Runs Conv2D followed by the separate ops named in 'fused_ops' in a
+  // session, and compares the result with the one of _FusedConv2D.
+  void CompareFusedAndSeparate(int batch, int input_size, int input_depth,
+                               int filter_size, int filter_count, int stride,
+                               const string& padding,
+                               const std::vector<string>& fused_ops) {
+    Tensor input(DT_FLOAT, {batch, input_size, input_size + 1, input_depth});
+    input.flat<float>().setRandom();
+    Tensor filter(DT_FLOAT,
+                  {filter_size, filter_size, input_depth, filter_count});
+    filter.flat<float>().setRandom();
+    filter.flat<float>() -= filter.flat<float>().constant(0.5f);
+    std::vector<Tensor> args;
+    for (const string& fused_op : fused_ops) {
+      int num_args = 0;
+      if (fused_op == "BiasAdd") num_args = 1;
+      if (fused_op == "FusedBatchNorm") num_args = 4;
+      for (int i = 0; i < num_args; ++i) {
+        Tensor arg(DT_FLOAT, {filter_count});
+        arg.flat<float>().setRandom();
+        args.push_back(arg);
+      }
+    }
+
+    auto root = tensorflow::Scope::NewRootScope();
+    Output output = ops::Conv2D(
+        root.WithOpName("conv"), ops::Const(root, Input::Initializer(input)),
+        ops::Const(root, Input::Initializer(filter)), {1, stride, stride, 1},
+        padding);
+    auto arg = args.begin();
+    auto next_arg = [&]() {
+      return ops::Const(root, Input::Initializer(*arg++));
+    };
+    for (const string& fused_op : fused_ops) {
+      if (fused_op == "BiasAdd") {
+        output = ops::BiasAdd(root, output, next_arg());
+      } else if (fused_op == "FusedBatchNorm") {
+        Output scale = next_arg();
+        Output offset = next_arg();
+        Output mean = next_arg();
+        Output variance = next_arg();
+        output = ops::FusedBatchNorm(root, output, scale, offset, mean,
+                                     variance,
+                                     ops::FusedBatchNorm::IsTraining(false))
+                     .y;
+      } else if (fused_op == "Relu") {
+        output = ops::Relu(root, output);
+      } else {
+        output = ops::Relu6(root, output);
+      }
+    }
+    ops::Identity(root.WithOpName("unfused"), output);
+    tensorflow::GraphDef graph;
+    TF_ASSERT_OK(root.ToGraphDef(&graph));
+    std::unique_ptr<tensorflow::Session> session(
+        tensorflow::NewSession(tensorflow::SessionOptions()));
+    TF_ASSERT_OK(session->Create(graph));
+    std::vector<Tensor> unfused_tensors;
+    TF_ASSERT_OK(session->Run({}, {"unfused"}, {}, &unfused_tensors));
+
+    TF_ASSERT_OK(NodeDefBuilder("fused_conv", "_FusedConv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(static_cast<int>(args.size()), DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("num_args", static_cast<int>(args.size()))
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("padding", padding)
+                     .Attr("fused_ops", fused_ops)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    AddInputFromArray<float>(input.shape(), input.flat<float>());
+    AddInputFromArray<float>(filter.shape(), filter.flat<float>());
+    for (const Tensor& arg : args) {
+      AddInputFromArray<float>(arg.shape(), arg.flat<float>());
+    }
+    TF_ASSERT_OK(RunOpKernel());
+
+    test::ExpectTensorNear<float>(unfused_tensors[0], *GetOutput(0), 1e-4);
+  }
+};
+
+TEST_F(FusedConv2DOpTest, BiasAdd) {
+  CompareFusedAndSeparate(2, 9, 3, 3, 8, 1, "SAME", {"BiasAdd"});
+}
+
+TEST_F(FusedConv2DOpTest, BiasAddRelu) {
+  CompareFusedAndSeparate(2, 9, 3, 3, 8, 1, "SAME", {"BiasAdd", "Relu"});
+}
+
+TEST_F(FusedConv2DOpTest, BatchNormRelu6) {
+  CompareFusedAndSeparate(1, 12, 5, 3, 20, 2, "VALID",
+                          {"FusedBatchNorm", "Relu6"});
+}
+
+TEST_F(FusedConv2DOpTest, BiasAddBatchNormRelu) {
+  CompareFusedAndSeparate(3, 10, 7, 5, 17, 2, "SAME",
+                          {"BiasAdd", "FusedBatchNorm", "Relu"});
+}
+
+TEST_F(FusedConv2DOpTest, Pointwise) {
+  // 1x1 convolutions read the input in place.
+  CompareFusedAndSeparate(2, 14, 64, 1, 96, 1, "VALID",
+                          {"BiasAdd", "FusedBatchNorm", "Relu"});
+  CompareFusedAndSeparate(2, 14, 64, 1, 96, 2, "VALID", {"FusedBatchNorm"});
+}
+
+TEST_F(FusedConv2DOpTest, InvalidFusedOps) {
+  TF_ASSERT_OK(NodeDefBuilder("fused_conv", "_FusedConv2D")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(0, DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("num_args", 0)
+                   .Attr("strides", {1, 1, 1, 1})
+                   .Attr("padding", "SAME")
+                   .Attr("fused_ops", {"Relu"})
+                   .Finalize(node_def()));
+  EXPECT_FALSE(InitOp().ok());
+}
+
+// Benchmarks the 3x3, stride 1 convolutions of ResNet-50 with the default
+// Conv2D implementation, and with DeepConv2D enabled, which picks direct,
+// Winograd F(2x2, 3x3) or Winograd F(4x4, 3x3) convolution per shape.
+static void BM_ResNet50Conv3x3(int iters, int batch, int size, int depth,
+                               bool deep_conv) {
+  testing::StopTiming();
+  // NOTE: Read by DeepConv2D on every Conv2D call.
+  setenv("TF_USE_DEEP_CONV2D", deep_conv ? "1" : "0", 1);
+
+  Tensor input(DT_FLOAT, TensorShape({batch, size, size, depth}));
+  input.flat<float>().setRandom();
+  Tensor filter(DT_FLOAT, TensorShape({3, 3, depth, depth}));
+  filter.flat<float>().setRandom();
+
+  Graph* g = new Graph(OpRegistry::Global());
+  test::graph::Conv2D(g, test::graph::Constant(g, input),
+                      test::graph::Constant(g, filter));
+
+  const int64 flops = 2LL * batch * size * size * depth * depth * 9;
+  testing::ItemsProcessed(static_cast<int64>(iters) * flops);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+  testing::StopTiming();
+  unsetenv("TF_USE_DEEP_CONV2D");
+}
+
+#define BM_RESNET50_CONV3X3(BATCH, SIZE, DEPTH)                               \
+  static void BM_ResNet50Conv3x3_##BATCH##_##SIZE##_##DEPTH##_Default(        \
+      int iters) {                                                            \
+    BM_ResNet50Conv3x3(iters, BATCH, SIZE, DEPTH, false);                     \
+  }                                                                           \
+  static void BM_ResNet50Conv3x3_##BATCH##_##SIZE##_##DEPTH##_DeepConv(       \
+      int iters) {                                                            \
+    BM_ResNet50Conv3x3(iters, BATCH, SIZE, DEPTH, true);                      \
+  }                                                                           \
+  BENCHMARK(BM_ResNet50Conv3x3_##BATCH##_##SIZE##_##DEPTH##_Default);         \
+  BENCHMARK(BM_ResNet50Conv3x3_##BATCH##_##SIZE##_##DEPTH##_DeepConv)
+
+BM_RESNET50_CONV3X3(1, 56, 64);
+BM_RESNET50_CONV3X3(1, 28, 128);
+BM_RESNET50_CONV3X3(1, 14, 256);
+BM_RESNET50_CONV3X3(1, 7, 512);
+BM_RESNET50_CONV3X3(32, 56, 64);
+BM_RESNET50_CONV3X3(32, 28, 128);
+BM_RESNET50_CONV3X3(32, 14, 256);
+BM_RESNET50_CONV3X3(32, 7, 512);
+
+// Benchmarks a convolution layer followed by BiasAdd, an inference mode
+// FusedBatchNorm and Relu, run as separate ops or as one _FusedConv2D.
+// 'deep_conv' lets the separate Conv2D pick DeepConv2D, which the remapper
+// keeps by not fusing when TF_USE_DEEP_CONV2D is set.
+static void BM_ConvBiasBatchNormRelu(int iters, int batch, int size,
+                                     int in_depth, int filter_size,
+                                     int out_depth, bool fused,
+                                     bool deep_conv = false) {
+  testing::StopTiming();
+  if (deep_conv) setenv("TF_USE_DEEP_CONV2D", "1", 1);
+  Tensor input(DT_FLOAT, TensorShape({batch, size, size, in_depth}));
+  input.flat<float>().setRandom();
+  Tensor filter(DT_FLOAT,
+                TensorShape({filter_size, filter_size, in_depth, out_depth}));
+  filter.flat<float>().setRandom();
+  std::vector<Node*> args;
+  Graph* g = new Graph(OpRegistry::Global());
+  for (int i = 0; i < 5; ++i) {
+    Tensor arg(DT_FLOAT, TensorShape({out_depth}));
+    arg.flat<float>().setRandom();
+    args.push_back(test::graph::Constant(g, arg));
+  }
+  Node* input_node = test::graph::Constant(g, input);
+  Node* filter_node = test::graph::Constant(g, filter);
+
+  Node* node;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("fused_conv"), "_FusedConv2D")
+                    .Input(input_node)
+                    .Input(filter_node)
+                    .Input(std::vector<NodeBuilder::NodeOut>(args.begin(),
+                                                             args.end()))
+                    .Attr("T", DT_FLOAT)
+                    .Attr("strides", {1, 1, 1, 1})
+                    .Attr("padding", "SAME")
+                    .Attr("fused_ops", {"BiasAdd", "FusedBatchNorm", "Relu"})
+                    .Finalize(g, &node));
+  } else {
+    node = test::graph::Conv2D(g, input_node, filter_node);
+    TF_CHECK_OK(NodeBuilder(g->NewName("bias_add"), "BiasAdd")
+                    .Input(node)
+                    .Input(args[0])
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(g, &node));
+    TF_CHECK_OK(NodeBuilder(g->NewName("batch_norm"), "FusedBatchNorm")
+                    .Input(node)
+                    .Input(args[1])
+                    .Input(args[2])
+                    .Input(args[3])
+                    .Input(args[4])
+                    .Attr("T", DT_FLOAT)
+                    .Attr("is_training", false)
+                    .Finalize(g, &node));
+    TF_CHECK_OK(NodeBuilder(g->NewName("relu"), "Relu")
+                    .Input(node)
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(g, &node));
+  }
+
+  const int64 flops = 2LL * batch * size * size * in_depth * out_depth *
+                      filter_size * filter_size;
+  testing::ItemsProcessed(static_cast<int64>(iters) * flops);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+  testing::StopTiming();
+  if (deep_conv) unsetenv("TF_USE_DEEP_CONV2D");
+}
+
+#define BM_CONV_BIAS_BN_RELU(NAME, BATCH, SIZE, IN, FILTER, OUT)           \
+  static void BM_ConvBnRelu_##NAME##_##BATCH##_Separate(int iters) {       \
+    BM_ConvBiasBatchNormRelu(iters, BATCH, SIZE, IN, FILTER, OUT, false);  \
+  }                                                                        \
+  static void BM_ConvBnRelu_##NAME##_##BATCH##_Fused(int iters) {          \
+    BM_ConvBiasBatchNormRelu(iters, BATCH, SIZE, IN, FILTER, OUT, true);   \
+  }                                                                        \
+  BENCHMARK(BM_ConvBnRelu_##NAME##_##BATCH##_Separate);                    \
+  BENCHMARK(BM_ConvBnRelu_##NAME##_##BATCH##_Fused)
+
+// The 3x3 layers are also run against DeepConv2D, the other kernel
+// _FusedConv2D would replace.
+#define BM_CONV_BIAS_BN_RELU_DEEP_CONV(NAME, BATCH, SIZE, IN, OUT)            \
+  BM_CONV_BIAS_BN_RELU(NAME, BATCH, SIZE, IN, 3, OUT);                        \
+  static void BM_ConvBnRelu_##NAME##_##BATCH##_SeparateDeepConv(int iters) {  \
+    BM_ConvBiasBatchNormRelu(iters, BATCH, SIZE, IN, 3, OUT, false, true);    \
+  }                                                                           \
+  BENCHMARK(BM_ConvBnRelu_##NAME##_##BATCH##_SeparateDeepConv)
+
+// Layers of ResNet-50.
+BM_CONV_BIAS_BN_RELU(resnet50_1, 1, 56, 64, 1, 256);
+BM_CONV_BIAS_BN_RELU_DEEP_CONV(resnet50_2, 1, 28, 128, 128);
+BM_CONV_BIAS_BN_RELU(resnet50_3, 1, 14, 1024, 1, 256);
+BM_CONV_BIAS_BN_RELU(resnet50_4, 1, 7, 512, 1, 2048);
+BM_CONV_BIAS_BN_RELU(resnet50_1, 32, 56, 64, 1, 256);
+BM_CONV_BIAS_BN_RELU_DEEP_CONV(resnet50_2, 32, 28, 128, 128);
+BM_CONV_BIAS_BN_RELU(resnet50_3, 32, 14, 1024, 1, 256);
+BM_CONV_BIAS_BN_RELU(resnet50_4, 32, 7, 512, 1, 2048);
+
+// Layers of Inception v3.
+BM_CONV_BIAS_BN_RELU_DEEP_CONV(inception3_1, 1, 147, 32, 64);
+BM_CONV_BIAS_BN_RELU(inception3_2, 1, 35, 288, 1, 64);
+BM_CONV_BIAS_BN_RELU(inception3_3, 1, 17, 768, 1, 192);
+BM_CONV_BIAS_BN_RELU_DEEP_CONV(inception3_4, 1, 8, 448, 384);
+BM_CONV_BIAS_BN_RELU_DEEP_CONV(inception3_1, 32, 147, 32, 64);
+BM_CONV_BIAS_BN_RELU(inception3_2, 32, 35, 288, 1, 64);
+BM_CONV_BIAS_BN_RELU(inception3_3, 32, 17, 768, 1, 192);
+BM_CONV_BIAS_BN_RELU_DEEP_CONV(inception3_4, 32, 8, 448, 384);
+
 }  // namespace tensorflow
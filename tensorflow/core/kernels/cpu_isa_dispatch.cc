@@ -0,0 +1,176 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+namespace {
+
+bool CPUSupports(CPUISALevel level) {
+  using port::TestCPUFeature;
+  switch (level) {
+    case CPUISALevel::kBaseline:
+      return true;
+    case CPUISALevel::kAVX2:
+      return TestCPUFeature(port::AVX2) && TestCPUFeature(port::FMA);
+    case CPUISALevel::kAVX512:
+      // The feature set of the Skylake server parts, which the AVX-512
+      // kernels are compiled for.
+      return CPUSupports(CPUISALevel::kAVX2) &&
+             TestCPUFeature(port::AVX512F) && TestCPUFeature(port::AVX512CD) &&
+             TestCPUFeature(port::AVX512VL) && TestCPUFeature(port::AVX512BW) &&
+             TestCPUFeature(port::AVX512DQ);
+  }
+  return false;
+}
+
+CPUISALevel DetectCPUISALevel() {
+  CPUISALevel level = CompiledCPUISALevel();
+#ifdef TF_CPU_ISA_DISPATCH
+  for (CPUISALevel better : {CPUISALevel::kAVX2, CPUISALevel::kAVX512}) {
+    if (better > level && CPUSupports(better)) level = better;
+  }
+#endif  // TF_CPU_ISA_DISPATCH
+
+  string cap;
+  TF_CHECK_OK(ReadStringFromEnvVar("TF_CPU_ISA", "", &cap));
+  cap = str_util::Lowercase(cap);
+  if (cap == "baseline") {
+    level = CompiledCPUISALevel();
+  } else if (cap == "avx2") {
+    level = std::max(std::min(level, CPUISALevel::kAVX2),
+                     CompiledCPUISALevel());
+  } else if (!cap.empty() && cap != "avx512") {
+    LOG(WARNING) << "Ignoring unknown value of TF_CPU_ISA: " << cap;
+  }
+  return level;
+}
+
+const cpu_isa::Kernels* BestCPUISAKernels() {
+  static const cpu_isa::Kernels* kernels = [] {
+    const cpu_isa::Kernels* best = GetCPUISAKernels(GetCPUISALevel());
+    if (best != nullptr) {
+      VLOG(1) << "Using the " << best->name << " CPU kernels.";
+    }
+    return best;
+  }();
+  return kernels;
+}
+
+cpu_isa::ThreadPoolView MakeThreadPoolView(const CPUDevice& d) {
+  cpu_isa::ThreadPoolView view;
+  view.schedule = [&d](std::function<void()> fn) {
+    d.enqueueNoNotification(std::move(fn));
+  };
+  view.current_thread_id = [&d]() { return d.currentThreadId(); };
+  view.num_threads = d.numThreads();
+  return view;
+}
+
+}  // namespace
+
+CPUISALevel CompiledCPUISALevel() {
+#if defined(__AVX512F__) && defined(__AVX512CD__) && defined(__AVX512VL__) && \
+    defined(__AVX512BW__) && defined(__AVX512DQ__)
+  return CPUISALevel::kAVX512;
+#elif defined(__AVX2__) && defined(__FMA__)
+  return CPUISALevel::kAVX2;
+#else
+  return CPUISALevel::kBaseline;
+#endif
+}
+
+CPUISALevel GetCPUISALevel() {
+  static const CPUISALevel level = DetectCPUISALevel();
+  return level;
+}
+
+const cpu_isa::Kernels* GetCPUISAKernels(CPUISALevel level) {
+  if (level <= CompiledCPUISALevel()) return nullptr;
+#ifdef TF_CPU_ISA_DISPATCH
+  switch (level) {
+    case CPUISALevel::kAVX2:
+      return &cpu_isa::kAVX2Kernels;
+    case CPUISALevel::kAVX512:
+      return &cpu_isa::kAVX512Kernels;
+    default:
+      break;
+  }
+#endif  // TF_CPU_ISA_DISPATCH
+  return nullptr;
+}
+
+namespace functor {
+
+bool DispatchToCPUISA<float>::MatMul(
+    const CPUDevice& d, TTypes<float, 2>::Tensor out,
+    TTypes<float, 2>::ConstTensor in0, TTypes<float, 2>::ConstTensor in1,
+    const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair) {
+  const cpu_isa::Kernels* kernels = BestCPUISAKernels();
+  if (kernels == nullptr) return false;
+  kernels->matmul(MakeThreadPoolView(d), out.data(), in0.data(),
+                  in0.dimension(0), in0.dimension(1), in1.data(),
+                  in1.dimension(0), in1.dimension(1), dim_pair[0].first,
+                  dim_pair[0].second);
+  return true;
+}
+
+bool DispatchToCPUISA<float>::SpatialConvolution(
+    const CPUDevice& d, TTypes<float, 4>::Tensor output,
+    TTypes<float, 4>::ConstTensor input, TTypes<float, 4>::ConstTensor filter,
+    int row_stride, int col_stride, int row_dilation, int col_dilation,
+    const Eigen::PaddingType& padding) {
+  const cpu_isa::Kernels* kernels = BestCPUISAKernels();
+  if (kernels == nullptr) return false;
+  int64 dims[3][4];
+  for (int i = 0; i < 4; ++i) {
+    dims[0][i] = output.dimension(i);
+    dims[1][i] = input.dimension(i);
+    dims[2][i] = filter.dimension(i);
+  }
+  kernels->spatial_convolution(MakeThreadPoolView(d), output.data(),
+                               input.data(), filter.data(), dims, row_stride,
+                               col_stride, row_dilation, col_dilation,
+                               padding == Eigen::PADDING_SAME);
+  return true;
+}
+
+bool DispatchPhiloxToCPUISA(const uint32* counter, const uint32* key,
+                            int64 num_groups, uint32* out) {
+  const cpu_isa::Kernels* kernels = BestCPUISAKernels();
+  if (kernels == nullptr) return false;
+  kernels->philox(counter, key, num_groups, out);
+  return true;
+}
+
+bool DispatchPhiloxToCPUISA(const uint32* counter, const uint32* key,
+                            int64 num_groups, float* out) {
+  const cpu_isa::Kernels* kernels = BestCPUISAKernels();
+  if (kernels == nullptr) return false;
+  kernels->philox_uniform_float(counter, key, num_groups, out);
+  return true;
+}
+
+}  // namespace functor
+}  // namespace tensorflow
@@ -0,0 +1,104 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_CPU_ISA_DISPATCH_H_
+#define TENSORFLOW_CORE_KERNELS_CPU_ISA_DISPATCH_H_
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/kernels/cpu_isa_kernels.h"
+
+// Runtime selection of CPU kernels compiled for a better instruction set than
+// the rest of the binary, so that a single x86 build can use AVX2 or AVX-512
+// where available. The hot Eigen-based float kernels (matrix multiplication
+// and convolution) and the Philox generator of the random ops are compiled
+// once per instruction set in cpu_isa_kernels_*.cc, and DispatchToCPUISA
+// picks one of them the first time it is called, using port::TestCPUFeature.
+//
+// The environment variable TF_CPU_ISA (one of "baseline", "avx2" or "avx512")
+// caps the instruction set that is used, e.g. to compare with a native build.
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+enum class CPUISALevel { kBaseline = 0, kAVX2 = 1, kAVX512 = 2 };
+
+// Returns the instruction set level that this binary is compiled for, without
+// dispatching.
+CPUISALevel CompiledCPUISALevel();
+
+// Returns the best instruction set level that is supported by the CPU and
+// this binary, after applying TF_CPU_ISA.
+CPUISALevel GetCPUISALevel();
+
+// Returns the kernels for 'level', or nullptr if they are not better than
+// those of the rest of the binary or were not compiled in. The CPU must
+// support 'level', i.e. it must be at most GetCPUISALevel().
+const cpu_isa::Kernels* GetCPUISAKernels(CPUISALevel level);
+
+namespace functor {
+
+// Each function returns true if it has computed its result with the kernels
+// of GetCPUISALevel(), and false if the caller has to compute it.
+template <typename T>
+struct DispatchToCPUISA {
+  static bool MatMul(
+      const CPUDevice& d, typename TTypes<T, 2>::Tensor out,
+      typename TTypes<T, 2>::ConstTensor in0,
+      typename TTypes<T, 2>::ConstTensor in1,
+      const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair) {
+    return false;
+  }
+
+  static bool SpatialConvolution(const CPUDevice& d,
+                                 typename TTypes<T, 4>::Tensor output,
+                                 typename TTypes<T, 4>::ConstTensor input,
+                                 typename TTypes<T, 4>::ConstTensor filter,
+                                 int row_stride, int col_stride,
+                                 int row_dilation, int col_dilation,
+                                 const Eigen::PaddingType& padding) {
+    return false;
+  }
+};
+
+template <>
+struct DispatchToCPUISA<float> {
+  static bool MatMul(
+      const CPUDevice& d, TTypes<float, 2>::Tensor out,
+      TTypes<float, 2>::ConstTensor in0, TTypes<float, 2>::ConstTensor in1,
+      const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair);
+
+  static bool SpatialConvolution(const CPUDevice& d,
+                                 TTypes<float, 4>::Tensor output,
+                                 TTypes<float, 4>::ConstTensor input,
+                                 TTypes<float, 4>::ConstTensor filter,
+                                 int row_stride, int col_stride,
+                                 int row_dilation, int col_dilation,
+                                 const Eigen::PaddingType& padding);
+};
+
+// Writes the next 'num_groups' outputs of the Philox generator with 'counter'
+// and 'key' to 'out', as cpu_isa::PhiloxFn and cpu_isa::PhiloxUniformFloatFn
+// do. Returns false if the caller has to compute them.
+bool DispatchPhiloxToCPUISA(const uint32* counter, const uint32* key,
+                            int64 num_groups, uint32* out);
+bool DispatchPhiloxToCPUISA(const uint32* counter, const uint32* key,
+                            int64 num_groups, float* out);
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_CPU_ISA_DISPATCH_H_
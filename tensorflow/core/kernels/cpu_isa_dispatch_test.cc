@@ -0,0 +1,262 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
+
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/eigen_spatial_convolutions.h"
+#include "tensorflow/core/kernels/random_op_cpu.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+typedef Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> DimPair;
+
+Tensor RandomTensor(const TensorShape& shape) {
+  Tensor t(DT_FLOAT, shape);
+  t.flat<float>().setRandom();
+  return t;
+}
+
+TEST(CPUISADispatchTest, Levels) {
+  EXPECT_GE(GetCPUISALevel(), CompiledCPUISALevel());
+  EXPECT_EQ(nullptr, GetCPUISAKernels(CompiledCPUISALevel()));
+  if (GetCPUISALevel() > CompiledCPUISALevel()) {
+    EXPECT_NE(nullptr, GetCPUISAKernels(GetCPUISALevel()));
+  }
+}
+
+void TestMatMul(int64 m, int64 k, int64 n, bool transpose_a,
+                bool transpose_b) {
+  const Tensor a = RandomTensor(transpose_a ? TensorShape({k, m})
+                                            : TensorShape({m, k}));
+  const Tensor b = RandomTensor(transpose_b ? TensorShape({n, k})
+                                            : TensorShape({k, n}));
+  DimPair dim_pair;
+  dim_pair[0] = Eigen::IndexPair<Eigen::DenseIndex>(transpose_a ? 0 : 1,
+                                                    transpose_b ? 1 : 0);
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, 4);
+
+  Tensor expected(DT_FLOAT, TensorShape({m, n}));
+  expected.matrix<float>().device(device) =
+      a.matrix<float>().contract(b.matrix<float>(), dim_pair);
+  Tensor out(DT_FLOAT, TensorShape({m, n}));
+  if (!functor::DispatchToCPUISA<float>::MatMul(
+          device, out.matrix<float>(), a.matrix<float>(), b.matrix<float>(),
+          dim_pair)) {
+    out = expected;
+  }
+  test::ExpectClose(expected, out, 1e-4);
+}
+
+TEST(CPUISADispatchTest, MatMul) {
+  for (bool transpose_a : {false, true}) {
+    for (bool transpose_b : {false, true}) {
+      TestMatMul(1, 1, 1, transpose_a, transpose_b);
+      TestMatMul(17, 33, 65, transpose_a, transpose_b);
+      TestMatMul(128, 256, 64, transpose_a, transpose_b);
+    }
+  }
+}
+
+void TestConv(const TensorShape& input_shape, const TensorShape& filter_shape,
+              int stride, int dilation, Eigen::PaddingType padding) {
+  const Tensor input = RandomTensor(input_shape);
+  const Tensor filter = RandomTensor(filter_shape);
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, 4);
+
+  const auto expected_value = Eigen::SpatialConvolution(
+      input.tensor<float, 4>(), filter.tensor<float, 4>(), stride, stride,
+      padding, dilation, dilation);
+  Eigen::Tensor<float, 4, Eigen::RowMajor> expected_tensor = expected_value;
+  TensorShape output_shape;
+  for (int i = 0; i < 4; ++i) {
+    output_shape.AddDim(expected_tensor.dimension(i));
+  }
+  Tensor expected(DT_FLOAT, output_shape);
+  expected.tensor<float, 4>() = expected_tensor;
+  Tensor out(DT_FLOAT, output_shape);
+  if (!functor::DispatchToCPUISA<float>::SpatialConvolution(
+          device, out.tensor<float, 4>(), input.tensor<float, 4>(),
+          filter.tensor<float, 4>(), stride, stride, dilation, dilation,
+          padding)) {
+    out = expected;
+  }
+  test::ExpectClose(expected, out, 1e-4);
+}
+
+TEST(CPUISADispatchTest, SpatialConvolution) {
+  for (Eigen::PaddingType padding :
+       {Eigen::PADDING_VALID, Eigen::PADDING_SAME}) {
+    TestConv({2, 9, 9, 3}, {3, 3, 3, 8}, 1, 1, padding);
+    TestConv({1, 17, 13, 16}, {5, 3, 16, 4}, 2, 1, padding);
+    TestConv({1, 12, 12, 8}, {3, 3, 8, 8}, 1, 2, padding);
+  }
+}
+
+TEST(CPUISADispatchTest, Philox) {
+  random::PhiloxRandom gen(0x1234567890abull, 0xffffffffffffffffull);
+  // Crosses a carry out of the lowest word of the counter.
+  gen.Skip(0xffffff00ull);
+  const uint32 counter[4] = {gen.counter()[0], gen.counter()[1],
+                             gen.counter()[2], gen.counter()[3]};
+  const uint32 key[2] = {gen.key()[0], gen.key()[1]};
+  const int64 num_groups = 1000;
+  std::vector<uint32> bits(4 * num_groups);
+  std::vector<float> floats(4 * num_groups);
+  if (!functor::DispatchPhiloxToCPUISA(counter, key, num_groups,
+                                       bits.data())) {
+    return;
+  }
+  ASSERT_TRUE(functor::DispatchPhiloxToCPUISA(counter, key, num_groups,
+                                              floats.data()));
+  random::PhiloxRandom float_gen = gen;
+  random::UniformDistribution<random::PhiloxRandom, float> uniform;
+  for (int64 i = 0; i < num_groups; ++i) {
+    const auto expected_bits = gen();
+    const auto expected_floats = uniform(&float_gen);
+    for (int j = 0; j < 4; ++j) {
+      ASSERT_EQ(expected_bits[j], bits[4 * i + j]) << i;
+      ASSERT_EQ(expected_floats[j], floats[4 * i + j]) << i;
+    }
+  }
+}
+
+// Compares the kernels picked at run time with those of the rest of the
+// binary. Run a build with e.g. --copt=-mavx2 --copt=-mfma to compare with
+// native kernels.
+static void BM_MatMul(int iters, int m, int k, int n, bool dispatch) {
+  testing::StopTiming();
+  const Tensor a = RandomTensor(TensorShape({m, k}));
+  const Tensor b = RandomTensor(TensorShape({k, n}));
+  Tensor out(DT_FLOAT, TensorShape({m, n}));
+  DimPair dim_pair;
+  dim_pair[0] = Eigen::IndexPair<Eigen::DenseIndex>(1, 0);
+  const int num_threads = port::NumSchedulableCPUs();
+  Eigen::ThreadPool pool(num_threads);
+  Eigen::ThreadPoolDevice device(&pool, num_threads);
+  testing::ItemsProcessed(static_cast<int64>(iters) * m * k * n * 2);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    if (!dispatch || !functor::DispatchToCPUISA<float>::MatMul(
+                         device, out.matrix<float>(), a.matrix<float>(),
+                         b.matrix<float>(), dim_pair)) {
+      out.matrix<float>().device(device) =
+          a.matrix<float>().contract(b.matrix<float>(), dim_pair);
+    }
+  }
+}
+
+#define BM_MATMUL(M, K, N)                                                     \
+  static void BM_MatMul_Compiled_##M##_##K##_##N(int iters) {                  \
+    BM_MatMul(iters, M, K, N, false);                                          \
+  }                                                                            \
+  static void BM_MatMul_Dispatched_##M##_##K##_##N(int iters) {                \
+    BM_MatMul(iters, M, K, N, true);                                           \
+  }                                                                            \
+  BENCHMARK(BM_MatMul_Compiled_##M##_##K##_##N);                               \
+  BENCHMARK(BM_MatMul_Dispatched_##M##_##K##_##N);
+
+BM_MATMUL(32, 32, 32);
+BM_MATMUL(128, 128, 128);
+BM_MATMUL(512, 512, 512);
+BM_MATMUL(1024, 1024, 1024);
+BM_MATMUL(1, 1024, 1024);
+
+static void BM_Conv(int iters, int batch, int size, int depth, int filter_size,
+                    int out_depth, bool dispatch) {
+  testing::StopTiming();
+  const Tensor input = RandomTensor(TensorShape({batch, size, size, depth}));
+  const Tensor filter = RandomTensor(
+      TensorShape({filter_size, filter_size, depth, out_depth}));
+  Tensor out(DT_FLOAT, TensorShape({batch, size, size, out_depth}));
+  const int num_threads = port::NumSchedulableCPUs();
+  Eigen::ThreadPool pool(num_threads);
+  Eigen::ThreadPoolDevice device(&pool, num_threads);
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch * size * size *
+                          filter_size * filter_size * depth * out_depth * 2);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    if (!dispatch || !functor::DispatchToCPUISA<float>::SpatialConvolution(
+                         device, out.tensor<float, 4>(),
+                         input.tensor<float, 4>(), filter.tensor<float, 4>(),
+                         1, 1, 1, 1, Eigen::PADDING_SAME)) {
+      out.tensor<float, 4>().device(device) = Eigen::SpatialConvolution(
+          input.tensor<float, 4>(), filter.tensor<float, 4>(), 1, 1,
+          Eigen::PADDING_SAME);
+    }
+  }
+}
+
+#define BM_CONV(N, S, D, F, O)                                                 \
+  static void BM_Conv_Compiled_##N##_##S##_##D##_##F##_##O(int iters) {        \
+    BM_Conv(iters, N, S, D, F, O, false);                                      \
+  }                                                                            \
+  static void BM_Conv_Dispatched_##N##_##S##_##D##_##F##_##O(int iters) {      \
+    BM_Conv(iters, N, S, D, F, O, true);                                       \
+  }                                                                            \
+  BENCHMARK(BM_Conv_Compiled_##N##_##S##_##D##_##F##_##O);                     \
+  BENCHMARK(BM_Conv_Dispatched_##N##_##S##_##D##_##F##_##O);
+
+BM_CONV(8, 56, 64, 3, 64);
+BM_CONV(8, 28, 128, 3, 128);
+BM_CONV(8, 14, 256, 3, 256);
+BM_CONV(32, 7, 512, 3, 512);
+
+static void BM_PhiloxUniformFloat(int iters, bool dispatch) {
+  testing::StopTiming();
+  // The batch size of the random ops.
+  const int64 num_groups = 256;
+  std::vector<float> out(4 * num_groups);
+  const uint32 counter[4] = {0, 0, 0, 0};
+  const uint32 key[2] = {0x12345, 0};
+  testing::ItemsProcessed(static_cast<int64>(iters) * 4 * num_groups);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    if (!dispatch || !functor::DispatchPhiloxToCPUISA(counter, key,
+                                                      num_groups, out.data())) {
+      functor::philox_cpu::PhiloxGenerate<
+          functor::philox_cpu::UniformFloatOutput>(counter, key, num_groups,
+                                                   out.data());
+    }
+  }
+}
+
+static void BM_PhiloxUniformFloat_Compiled(int iters) {
+  BM_PhiloxUniformFloat(iters, false);
+}
+static void BM_PhiloxUniformFloat_Dispatched(int iters) {
+  BM_PhiloxUniformFloat(iters, true);
+}
+BENCHMARK(BM_PhiloxUniformFloat_Compiled);
+BENCHMARK(BM_PhiloxUniformFloat_Dispatched);
+
+}  // namespace
+}  // namespace tensorflow
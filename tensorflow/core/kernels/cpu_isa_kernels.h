@@ -0,0 +1,79 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_CPU_ISA_KERNELS_H_
+#define TENSORFLOW_CORE_KERNELS_CPU_ISA_KERNELS_H_
+
+#include <functional>
+
+#include "tensorflow/core/platform/types.h"
+
+// Interface between the CPU kernels that are compiled once more for a given
+// instruction set (see cpu_isa_kernels_impl.h) and the rest of the binary.
+// Those translation units see Eigen under a different namespace, so nothing
+// here may refer to Eigen types.
+
+namespace tensorflow {
+namespace cpu_isa {
+
+// The thread pool of an Eigen::ThreadPoolDevice.
+struct ThreadPoolView {
+  std::function<void(std::function<void()>)> schedule;
+  std::function<int()> current_thread_id;
+  int num_threads;
+};
+
+// Computes out = contract(in0, in1) over dimension in0_contract_dim of the
+// row-major matrix in0 and dimension in1_contract_dim of in1.
+typedef void (*MatMulFn)(const ThreadPoolView& pool, float* out,
+                         const float* in0, int64 in0_rows, int64 in0_cols,
+                         const float* in1, int64 in1_rows, int64 in1_cols,
+                         int in0_contract_dim, int in1_contract_dim);
+
+// Computes the NHWC convolution of input with the HWIO filter, as
+// Eigen::SpatialConvolution does. 'dims' are the NHWC/HWIO dimensions of
+// output, input and filter, in that order.
+typedef void (*SpatialConvolutionFn)(const ThreadPoolView& pool, float* output,
+                                     const float* input, const float* filter,
+                                     const int64 (&dims)[3][4], int row_stride,
+                                     int col_stride, int row_dilation,
+                                     int col_dilation, bool padding_same);
+
+// Writes the next num_groups outputs of the Philox4x32-10 generator with the
+// given counter and key (see random::PhiloxRandom) to 'out', either as the
+// raw words or converted to floats in [0, 1) as random::UniformDistribution
+// does.
+typedef void (*PhiloxFn)(const uint32* counter, const uint32* key,
+                         int64 num_groups, uint32* out);
+typedef void (*PhiloxUniformFloatFn)(const uint32* counter, const uint32* key,
+                                     int64 num_groups, float* out);
+
+struct Kernels {
+  const char* name;
+  MatMulFn matmul;
+  SpatialConvolutionFn spatial_convolution;
+  PhiloxFn philox;
+  PhiloxUniformFloatFn philox_uniform_float;
+};
+
+// Defined in cpu_isa_kernels_avx2.cc and cpu_isa_kernels_avx512.cc, which
+// are only linked in when TF_CPU_ISA_DISPATCH is defined.
+extern const Kernels kAVX2Kernels;
+extern const Kernels kAVX512Kernels;
+
+}  // namespace cpu_isa
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_CPU_ISA_KERNELS_H_
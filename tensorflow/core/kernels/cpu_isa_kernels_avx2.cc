@@ -0,0 +1,22 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Compiled with the flags of the AVX2 kernels, see cpu_isa_kernels_impl.h.
+
+#define TF_CPU_ISA_KERNELS kAVX2Kernels
+#define TF_CPU_ISA_NAME "AVX2"
+#define Eigen EigenForAVX2
+
+#include "tensorflow/core/kernels/cpu_isa_kernels_impl.h"
@@ -0,0 +1,136 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Implementation of the kernels declared in cpu_isa_kernels.h. This file is
+// included by one translation unit per instruction set, each compiled with
+// the corresponding -m flags, after defining:
+//   TF_CPU_ISA_KERNELS: the name of the cpu_isa::Kernels to define.
+//   TF_CPU_ISA_NAME: a string naming the instruction set.
+//   Eigen: a namespace to compile Eigen into instead of Eigen.
+//
+// Eigen selects its packet types with the preprocessor, so its templates are
+// instantiated with different code in each of these translation units. They
+// would violate the one definition rule (and the linker could pick e.g. the
+// AVX-512 version of a contraction for a CPU without AVX-512) if they were not
+// in a namespace of their own. For the same reason, these translation units
+// must not include any other header with inline code that uses Eigen.
+//
+// Eigen also instantiates templates of the standard library, such as
+// std::vector<float*> or std::function<long(long)>, which the rest of the
+// binary may instantiate as well. These translation units are compiled with
+// -fno-weak, which gives such instantiations internal linkage instead of
+// letting the linker pick any one copy for the whole binary.
+// cpu_isa_kernels_symbols_test checks that only TF_CPU_ISA_KERNELS and the
+// symbols of the renamed Eigen are exported.
+
+#ifndef TF_CPU_ISA_KERNELS
+#error "TF_CPU_ISA_KERNELS must be defined before including this file."
+#endif
+
+#define EIGEN_USE_THREADS
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/kernels/cpu_isa_kernels.h"
+#include "tensorflow/core/kernels/eigen_spatial_convolutions.h"
+#include "tensorflow/core/kernels/random_op_cpu.h"
+
+namespace tensorflow {
+namespace cpu_isa {
+namespace {
+
+// Adapts a ThreadPoolView to the thread pool interface of this copy of Eigen.
+class ThreadPoolAdapter : public Eigen::ThreadPoolInterface {
+ public:
+  explicit ThreadPoolAdapter(const ThreadPoolView& view) : view_(view) {}
+
+  void Schedule(std::function<void()> fn) override {
+    view_.schedule(std::move(fn));
+  }
+  int NumThreads() const override { return view_.num_threads; }
+  int CurrentThreadId() const override { return view_.current_thread_id(); }
+
+ private:
+  const ThreadPoolView& view_;
+};
+
+// The rest of the binary only guarantees the alignment of its own packets,
+// which may be smaller than those of this translation unit.
+typedef Eigen::TensorMap<Eigen::Tensor<float, 2, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+    Matrix;
+typedef Eigen::TensorMap<Eigen::Tensor<const float, 2, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+    ConstMatrix;
+typedef Eigen::TensorMap<Eigen::Tensor<float, 4, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+    Tensor4;
+typedef Eigen::TensorMap<Eigen::Tensor<const float, 4, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+    ConstTensor4;
+
+void MatMul(const ThreadPoolView& view, float* out, const float* in0,
+            int64 in0_rows, int64 in0_cols, const float* in1, int64 in1_rows,
+            int64 in1_cols, int in0_contract_dim, int in1_contract_dim) {
+  ThreadPoolAdapter pool(view);
+  Eigen::ThreadPoolDevice device(&pool, view.num_threads);
+  Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dim_pair;
+  dim_pair[0] = Eigen::IndexPair<Eigen::DenseIndex>(in0_contract_dim,
+                                                    in1_contract_dim);
+  Matrix out_matrix(out, in0_contract_dim == 0 ? in0_cols : in0_rows,
+                    in1_contract_dim == 0 ? in1_cols : in1_rows);
+  ConstMatrix in0_matrix(in0, in0_rows, in0_cols);
+  ConstMatrix in1_matrix(in1, in1_rows, in1_cols);
+  out_matrix.device(device) = in0_matrix.contract(in1_matrix, dim_pair);
+}
+
+void SpatialConvolution(const ThreadPoolView& view, float* output,
+                        const float* input, const float* filter,
+                        const int64 (&dims)[3][4], int row_stride,
+                        int col_stride, int row_dilation, int col_dilation,
+                        bool padding_same) {
+  ThreadPoolAdapter pool(view);
+  Eigen::ThreadPoolDevice device(&pool, view.num_threads);
+  Tensor4 output_tensor(output, dims[0][0], dims[0][1], dims[0][2],
+                        dims[0][3]);
+  // Eigen's rows and columns are swapped with respect to NHWC, as in
+  // SpatialConvolutionFunc.
+  output_tensor.device(device) = Eigen::SpatialConvolution(
+      ConstTensor4(input, dims[1][0], dims[1][1], dims[1][2], dims[1][3]),
+      ConstTensor4(filter, dims[2][0], dims[2][1], dims[2][2], dims[2][3]),
+      col_stride, row_stride,
+      padding_same ? Eigen::PADDING_SAME : Eigen::PADDING_VALID, col_dilation,
+      row_dilation);
+}
+
+void Philox(const uint32* counter, const uint32* key, int64 num_groups,
+            uint32* out) {
+  functor::philox_cpu::PhiloxGenerate<functor::philox_cpu::BitsOutput>(
+      counter, key, num_groups, out);
+}
+
+void PhiloxUniformFloat(const uint32* counter, const uint32* key,
+                        int64 num_groups, float* out) {
+  functor::philox_cpu::PhiloxGenerate<functor::philox_cpu::UniformFloatOutput>(
+      counter, key, num_groups, out);
+}
+
+}  // namespace
+
+const Kernels TF_CPU_ISA_KERNELS = {TF_CPU_ISA_NAME, &MatMul,
+                                    &SpatialConvolution, &Philox,
+                                    &PhiloxUniformFloat};
+
+}  // namespace cpu_isa
+}  // namespace tensorflow
@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# Checks that the archives of the CPU ISA kernels given as arguments export
+# no symbols but their cpu_isa::Kernels and those of their own copy of Eigen.
+# Any other global or weak definition, e.g. of a std::vector method, could be
+# picked by the linker for the rest of the binary, and run instructions the
+# CPU does not have. See cpu_isa_kernels_impl.h.
+
+set -e
+
+# Tools needed: nm
+NM="${NM}"
+[ -z "${NM}" ] && NM="nm"
+
+ALLOWED='^(_ZN10tensorflow7cpu_isa(12kAVX2Kernels|14kAVX512Kernels)E'
+ALLOWED+='|_Z[A-Z]*N[KVRO]*(12EigenForAVX2|14EigenForAVX512)'
+ALLOWED+='|DW\.ref\.__gxx_personality_v0$)'
+
+num_archives=0
+failed=0
+for archive in "$@"; do
+  case "${archive}" in
+    *.a) ;;
+    *) continue ;;
+  esac
+  num_archives=$((num_archives + 1))
+  # Defined symbols that are global (upper case) or weak (V, W, u).
+  exported=$("${NM}" --defined-only "${archive}" |
+             awk 'NF == 3 && $2 ~ /^[A-Zu]$/ { print $3 }' |
+             grep -Ev "${ALLOWED}" || true)
+  if [ -n "${exported}" ]; then
+    echo "${archive} exports symbols outside its namespaces:"
+    echo "${exported}" | sort -u
+    failed=1
+  fi
+done
+
+# The kernels are only built for x86-64 Linux.
+if [ "${num_archives}" -eq 0 ]; then
+  echo "No CPU ISA kernel archives to check."
+fi
+
+if [ "${failed}" -ne 0 ]; then
+  exit 1
+fi
+echo "PASS"
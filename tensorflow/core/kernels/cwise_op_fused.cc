@@ -0,0 +1,408 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/kernels/cwise_ops.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+enum class FusedOp {
+  kAdd,
+  kSub,
+  kMul,
+  kDiv,
+  kMaximum,
+  kMinimum,
+  kSquaredDifference,
+  kNeg,
+  kAbs,
+  kSquare,
+  kSqrt,
+  kRsqrt,
+  kReciprocal,
+  kExp,
+  kLog,
+  kTanh,
+  kSigmoid,
+  kRelu,
+  kRelu6,
+};
+
+struct FusedOpInfo {
+  const char* name;
+  FusedOp op;
+  int num_operands;
+  // Rough cost per element, in the units of Shard's cost_per_unit.
+  int cost;
+};
+
+// Must be kept in sync with the ops that the grappler remapper fuses.
+const FusedOpInfo kFusedOps[] = {
+    {"Add", FusedOp::kAdd, 2, 1},
+    {"Sub", FusedOp::kSub, 2, 1},
+    {"Mul", FusedOp::kMul, 2, 1},
+    {"Div", FusedOp::kDiv, 2, 4},
+    {"RealDiv", FusedOp::kDiv, 2, 4},
+    {"Maximum", FusedOp::kMaximum, 2, 1},
+    {"Minimum", FusedOp::kMinimum, 2, 1},
+    {"SquaredDifference", FusedOp::kSquaredDifference, 2, 2},
+    {"Neg", FusedOp::kNeg, 1, 1},
+    {"Abs", FusedOp::kAbs, 1, 1},
+    {"Square", FusedOp::kSquare, 1, 1},
+    {"Sqrt", FusedOp::kSqrt, 1, 4},
+    {"Rsqrt", FusedOp::kRsqrt, 1, 5},
+    {"Reciprocal", FusedOp::kReciprocal, 1, 4},
+    {"Exp", FusedOp::kExp, 1, 20},
+    {"Log", FusedOp::kLog, 1, 20},
+    {"Tanh", FusedOp::kTanh, 1, 20},
+    {"Sigmoid", FusedOp::kSigmoid, 1, 20},
+    {"Relu", FusedOp::kRelu, 1, 1},
+    {"Relu6", FusedOp::kRelu6, 1, 2},
+};
+
+const FusedOpInfo* FindFusedOp(const string& name) {
+  for (const FusedOpInfo& info : kFusedOps) {
+    if (name == info.name) return &info;
+  }
+  return nullptr;
+}
+
+struct Instruction {
+  FusedOp op;
+  // Ids of the values read by the instruction; operands[1] is -1 for unary
+  // ops.
+  int operands[2];
+};
+
+// Sets z[0, size) to op(x[0, size), y[0, size)), with the same Eigen functors
+// as the unfused kernels in cwise_ops.h and relu_op_functor.h. 'z' may alias
+// 'x' or 'y'.
+template <typename T>
+void Evaluate(FusedOp op, const T* x, const T* y, int64 size, T* z) {
+  typedef typename TTypes<T>::UnalignedConstFlat ConstFlat;
+  ConstFlat a(x, size);
+  typename TTypes<T>::UnalignedFlat out(z, size);
+  switch (op) {
+    case FusedOp::kAdd:
+      out = a.binaryExpr(ConstFlat(y, size),
+                         Eigen::internal::scalar_sum_op<T>());
+      break;
+    case FusedOp::kSub:
+      out = a.binaryExpr(ConstFlat(y, size),
+                         Eigen::internal::scalar_difference_op<T>());
+      break;
+    case FusedOp::kMul:
+      out = a.binaryExpr(ConstFlat(y, size),
+                         Eigen::internal::scalar_product_op<T>());
+      break;
+    case FusedOp::kDiv:
+      out = a.binaryExpr(ConstFlat(y, size),
+                         Eigen::internal::scalar_quotient_op<T>());
+      break;
+    case FusedOp::kMaximum:
+      out = a.binaryExpr(ConstFlat(y, size),
+                         Eigen::internal::scalar_max_op<T>());
+      break;
+    case FusedOp::kMinimum:
+      out = a.binaryExpr(ConstFlat(y, size),
+                         Eigen::internal::scalar_min_op<T>());
+      break;
+    case FusedOp::kSquaredDifference:
+      out = a.binaryExpr(ConstFlat(y, size),
+                         Eigen::internal::scalar_compose_op<
+                             T, Eigen::internal::scalar_square_op<T>,
+                             Eigen::internal::scalar_difference_op<T>>());
+      break;
+    case FusedOp::kNeg:
+      out = a.unaryExpr(Eigen::internal::scalar_opposite_op<T>());
+      break;
+    case FusedOp::kAbs:
+      out = a.unaryExpr(Eigen::internal::scalar_abs_op<T>());
+      break;
+    case FusedOp::kSquare:
+      out = a.unaryExpr(Eigen::internal::scalar_square_op<T>());
+      break;
+    case FusedOp::kSqrt:
+      out = a.unaryExpr(Eigen::internal::scalar_sqrt_op<T>());
+      break;
+    case FusedOp::kRsqrt:
+      out = a.unaryExpr(Eigen::internal::scalar_rsqrt_op<T>());
+      break;
+    case FusedOp::kReciprocal:
+      out = a.unaryExpr(Eigen::internal::scalar_inverse_op<T>());
+      break;
+    case FusedOp::kExp:
+      out = a.unaryExpr(Eigen::internal::scalar_exp_op<T>());
+      break;
+    case FusedOp::kLog:
+      out = a.unaryExpr(Eigen::internal::scalar_log_op<T>());
+      break;
+    case FusedOp::kTanh:
+      out = a.unaryExpr(Eigen::internal::scalar_tanh_op<T>());
+      break;
+    case FusedOp::kSigmoid:
+      out = a.unaryExpr(Eigen::internal::scalar_sigmoid_op<T>());
+      break;
+    case FusedOp::kRelu:
+      out = a.cwiseMax(static_cast<T>(0));
+      break;
+    case FusedOp::kRelu6:
+      out = a.cwiseMax(static_cast<T>(0)).cwiseMin(static_cast<T>(6));
+      break;
+  }
+}
+
+typedef gtl::InlinedVector<int64, 8> Dims;
+
+// An input of the kernel, as read in the layout of the output.
+template <typename T>
+struct BroadcastInput {
+  const T* data;
+  // True if the input has the shape of the output, and can be read in place.
+  bool in_place;
+  // Strides of the input along the dimensions of the output; 0 where the
+  // input is broadcast.
+  Dims strides;
+};
+
+// Copies elements [begin, begin + size) of 'input', broadcast to 'dims', to
+// 'dst', one run along the innermost dimension at a time.
+template <typename T>
+void Gather(const BroadcastInput<T>& input, const Dims& dims, int64 begin,
+            int64 size, T* dst) {
+  const int rank = dims.size();
+  const Dims& strides = input.strides;
+  Dims coords(rank);
+  int64 offset = 0;
+  for (int d = rank - 1; d >= 0; --d) {
+    coords[d] = begin % dims[d];
+    begin /= dims[d];
+    offset += coords[d] * strides[d];
+  }
+  while (size > 0) {
+    const int64 run = std::min(size, dims[rank - 1] - coords[rank - 1]);
+    if (strides[rank - 1] == 0) {
+      std::fill_n(dst, run, input.data[offset]);
+    } else {
+      std::copy_n(input.data + offset, run, dst);
+    }
+    dst += run;
+    size -= run;
+    coords[rank - 1] += run;
+    offset += run * strides[rank - 1];
+    for (int d = rank - 1; d > 0 && coords[d] == dims[d]; --d) {
+      offset += strides[d - 1] - coords[d] * strides[d];
+      coords[d] = 0;
+      ++coords[d - 1];
+    }
+  }
+}
+
+}  // namespace
+
+// Evaluates the program of a _FusedElementwise node one block of the output
+// at a time, so that the intermediate values of a block stay in L1 and only
+// the inputs and the output go through memory.
+template <typename T>
+class FusedElementwiseOp : public OpKernel {
+ public:
+  explicit FusedElementwiseOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    std::vector<string> ops;
+    std::vector<int> operands;
+    OP_REQUIRES_OK(context, context->GetAttr("ops", &ops));
+    OP_REQUIRES_OK(context, context->GetAttr("operands", &operands));
+    OP_REQUIRES(context, operands.size() == 2 * ops.size(),
+                errors::InvalidArgument(
+                    "_FusedElementwise needs 2 operands per op, got ",
+                    operands.size(), " operands for ", ops.size(), " ops"));
+    const int num_inputs = context->num_inputs();
+    cost_per_element_ = num_inputs;
+    for (int i = 0; i < ops.size(); ++i) {
+      const FusedOpInfo* info = FindFusedOp(ops[i]);
+      OP_REQUIRES(context, info != nullptr,
+                  errors::Unimplemented("_FusedElementwise does not support ",
+                                        ops[i]));
+      Instruction instruction;
+      instruction.op = info->op;
+      for (int j = 0; j < 2; ++j) {
+        const int operand = operands[2 * i + j];
+        instruction.operands[j] = operand;
+        if (j >= info->num_operands) {
+          OP_REQUIRES(context, operand == -1,
+                      errors::InvalidArgument("Too many operands for op ", i,
+                                              " (", ops[i], ")"));
+        } else {
+          OP_REQUIRES(
+              context, operand >= 0 && operand < num_inputs + i,
+              errors::InvalidArgument("Operand ", j, " of op ", i, " (",
+                                      ops[i], ") is not a valid value: ",
+                                      operand));
+        }
+      }
+      program_.push_back(instruction);
+      cost_per_element_ += info->cost;
+    }
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const int num_inputs = context->num_inputs();
+    TensorShape output_shape;
+    OP_REQUIRES_OK(context, BroadcastShape(context, &output_shape));
+
+    // The output can reuse the buffer of any input of the same shape: each
+    // block of an input is read before the same block of the output is
+    // written.
+    std::vector<int> candidate_inputs;
+    for (int i = 0; i < num_inputs; ++i) {
+      if (context->input(i).shape() == output_shape) {
+        candidate_inputs.push_back(i);
+      }
+    }
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->forward_input_or_allocate_output(
+                                candidate_inputs, 0, output_shape, &output));
+    const int64 num_elements = output_shape.num_elements();
+    if (num_elements == 0) return;
+
+    // Dimensions of size 1 do not change where elements are read from.
+    Dims dims;
+    for (int64 dim : output_shape.dim_sizes()) {
+      if (dim != 1) dims.push_back(dim);
+    }
+    std::vector<BroadcastInput<T>> inputs(num_inputs);
+    for (int i = 0; i < num_inputs; ++i) {
+      const Tensor& input = context->input(i);
+      BroadcastInput<T>& broadcast = inputs[i];
+      broadcast.data = input.flat<T>().data();
+      broadcast.in_place = input.NumElements() == num_elements;
+      if (broadcast.in_place) continue;
+      // Right-aligns the dimensions of the input with those of the output.
+      const int offset = output_shape.dims() - input.dims();
+      int64 stride = 1;
+      for (int d = output_shape.dims() - 1; d >= 0; --d) {
+        if (output_shape.dim_size(d) == 1) continue;
+        const int64 input_dim = d < offset ? 1 : input.dim_size(d - offset);
+        broadcast.strides.push_back(input_dim == 1 ? 0 : stride);
+        stride *= input_dim;
+      }
+      std::reverse(broadcast.strides.begin(), broadcast.strides.end());
+    }
+
+    const int num_values = num_inputs + program_.size();
+    T* output_data = output->flat<T>().data();
+    auto work = [&](int64 start, int64 limit) {
+      std::vector<T> scratch(num_values * kBlockSize);
+      std::vector<const T*> values(num_values);
+      for (int64 begin = start; begin < limit; begin += kBlockSize) {
+        const int64 size = std::min(kBlockSize, limit - begin);
+        for (int i = 0; i < num_inputs; ++i) {
+          if (inputs[i].in_place) {
+            values[i] = inputs[i].data + begin;
+          } else {
+            T* value = &scratch[i * kBlockSize];
+            Gather(inputs[i], dims, begin, size, value);
+            values[i] = value;
+          }
+        }
+        for (int i = 0; i < program_.size(); ++i) {
+          const Instruction& instruction = program_[i];
+          T* result = i + 1 == program_.size()
+                          ? output_data + begin
+                          : &scratch[(num_inputs + i) * kBlockSize];
+          Evaluate(instruction.op, values[instruction.operands[0]],
+                   instruction.operands[1] < 0
+                       ? nullptr
+                       : values[instruction.operands[1]],
+                   size, result);
+          values[num_inputs + i] = result;
+        }
+      }
+    };
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, num_elements,
+          cost_per_element_, work);
+  }
+
+ private:
+  // Number of elements evaluated at a time. Small enough for the values of a
+  // block to stay in L1 for programs of a few ops.
+  static constexpr int64 kBlockSize = 512;
+
+  // Sets 'output_shape' to the shape that all the inputs broadcast to.
+  Status BroadcastShape(OpKernelContext* context, TensorShape* output_shape) {
+    Dims dims;
+    for (int i = 0; i < context->num_inputs(); ++i) {
+      const TensorShape& shape = context->input(i).shape();
+      while (dims.size() < shape.dims()) {
+        dims.insert(dims.begin(), 1);
+      }
+      const int rank = dims.size();
+      for (int d = 0; d < shape.dims(); ++d) {
+        int64& dim = dims[rank - shape.dims() + d];
+        const int64 input_dim = shape.dim_size(d);
+        if (dim == 1) {
+          dim = input_dim;
+        } else if (input_dim != 1 && input_dim != dim) {
+          return errors::InvalidArgument(
+              "Incompatible shapes: input ", i, " has shape ",
+              shape.DebugString(), ", which does not broadcast to [",
+              str_util::Join(dims, ","), "]");
+        }
+      }
+    }
+    return TensorShapeUtils::MakeShape(dims.data(), dims.size(),
+                                       output_shape);
+  }
+
+  std::vector<Instruction> program_;
+  int64 cost_per_element_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FusedElementwiseOp);
+};
+
+template <typename T>
+constexpr int64 FusedElementwiseOp<T>::kBlockSize;
+
+#define REGISTER_KERNEL(T)                                  \
+  REGISTER_KERNEL_BUILDER(Name("_FusedElementwise")         \
+                              .Device(DEVICE_CPU)           \
+                              .TypeConstraint<T>("T"),      \
+                          FusedElementwiseOp<T>);
+
+TF_CALL_float(REGISTER_KERNEL);
+TF_CALL_double(REGISTER_KERNEL);
+#undef REGISTER_KERNEL
+
+}  // namespace tensorflow
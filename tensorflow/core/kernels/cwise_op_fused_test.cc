@@ -0,0 +1,240 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Ops read from positive inputs only, so that their results are finite.
+const char* const kPositiveOps[] = {"Sqrt", "Rsqrt", "Reciprocal", "Log",
+                                    "Div", "RealDiv"};
+
+bool NeedsPositiveInputs(const string& op) {
+  for (const char* positive_op : kPositiveOps) {
+    if (op == positive_op) return true;
+  }
+  return false;
+}
+
+class FusedElementwiseOpTest : public OpsTestBase {
+ protected:
+  // Returns a tensor of 'shape' with values in [-8, 8), or in [0.5, 8) if
+  // 'positive' is true. The range covers both bounds of Relu6.
+  Tensor Random(const TensorShape& shape, bool positive) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setRandom();
+    if (positive) {
+      t.flat<float>() = t.flat<float>() * 7.5f + 0.5f;
+    } else {
+      t.flat<float>() = t.flat<float>() * 16.0f - 8.0f;
+    }
+    return t;
+  }
+
+  // Runs the kernel of 'node' on copies of 'inputs' and returns its output.
+  Status Run(const NodeDef& node, const std::vector<Tensor>& inputs,
+             Tensor* output) {
+    set_node_def(node);
+    TF_RETURN_IF_ERROR(InitOp());
+    inputs_.clear();
+    for (const Tensor& input : inputs) {
+      AddInputFromArray<float>(input.shape(), input.flat<float>());
+    }
+    TF_RETURN_IF_ERROR(RunOpKernel());
+    *output = *GetOutput(0);
+    return Status::OK();
+  }
+
+  Tensor RunUnfused(const string& op, const std::vector<Tensor>& inputs) {
+    NodeDef node;
+    TF_CHECK_OK(NodeDefBuilder("unfused", op)
+                    .Input(FakeInput(inputs.size(), DT_FLOAT))
+                    .Finalize(&node));
+    Tensor output;
+    TF_CHECK_OK(Run(node, inputs, &output));
+    return output;
+  }
+
+  Status MakeFused(int num_inputs, const std::vector<string>& ops,
+                   const std::vector<int>& operands, NodeDef* node) {
+    return NodeDefBuilder("fused", "_FusedElementwise")
+        .Input(FakeInput(num_inputs, DT_FLOAT))
+        .Attr("ops", ops)
+        .Attr("operands", operands)
+        .Finalize(node);
+  }
+
+  Status RunFused(const std::vector<string>& ops,
+                  const std::vector<int>& operands,
+                  const std::vector<Tensor>& inputs, Tensor* output) {
+    NodeDef node;
+    TF_RETURN_IF_ERROR(MakeFused(inputs.size(), ops, operands, &node));
+    return Run(node, inputs, output);
+  }
+
+  // Both kernels use the same Eigen functors, but an element may take the
+  // vectorized path in one and the scalar path in the other, which can
+  // differ by an ulp or so.
+  void ExpectMatches(const Tensor& expected, const Tensor& output) {
+    test::ExpectClose(expected, output, 1e-6, 1e-5);
+  }
+};
+
+// 3 * 40 * 50 elements span several blocks of the kernel.
+const TensorShape kShape({3, 40, 50});
+
+TEST_F(FusedElementwiseOpTest, UnaryOpsMatchUnfusedKernels) {
+  for (const string op :
+       {"Neg", "Abs", "Square", "Sqrt", "Rsqrt", "Reciprocal", "Exp", "Log",
+        "Tanh", "Sigmoid", "Relu", "Relu6"}) {
+    SCOPED_TRACE(op);
+    std::vector<Tensor> inputs = {Random(kShape, NeedsPositiveInputs(op))};
+    // Exp is kept in range so that ulp differences stay within rtol.
+    if (op == "Exp") inputs[0].flat<float>() = inputs[0].flat<float>() / 4.0f;
+    const Tensor expected = RunUnfused(op, inputs);
+    Tensor output;
+    TF_ASSERT_OK(RunFused({op}, {0, -1}, inputs, &output));
+    ExpectMatches(expected, output);
+  }
+}
+
+TEST_F(FusedElementwiseOpTest, BinaryOpsMatchUnfusedKernels) {
+  // Same shapes, a broadcast row and column, and a scalar on either side.
+  const std::vector<std::pair<TensorShape, TensorShape>> shapes = {
+      {kShape, kShape},
+      {kShape, TensorShape({50})},
+      {TensorShape({40, 1}), kShape},
+      {TensorShape({3, 1, 50}), TensorShape({40, 1})},
+      {TensorShape({}), kShape},
+      {kShape, TensorShape({})}};
+  for (const string op : {"Add", "Sub", "Mul", "Div", "RealDiv", "Maximum",
+                          "Minimum", "SquaredDifference"}) {
+    for (const auto& shape : shapes) {
+      SCOPED_TRACE(strings::StrCat(op, " ", shape.first.DebugString(), " ",
+                                   shape.second.DebugString()));
+      const bool positive = NeedsPositiveInputs(op);
+      std::vector<Tensor> inputs = {Random(shape.first, positive),
+                                    Random(shape.second, positive)};
+      const Tensor expected = RunUnfused(op, inputs);
+      Tensor output;
+      TF_ASSERT_OK(RunFused({op}, {0, 1}, inputs, &output));
+      ExpectMatches(expected, output);
+    }
+  }
+}
+
+TEST_F(FusedElementwiseOpTest, ChainMatchesUnfusedKernels) {
+  // Relu6(Rsqrt(x) * y + Tanh(x)), with y broadcast along the rows.
+  std::vector<Tensor> inputs = {Random(kShape, true),
+                                Random(TensorShape({50}), false)};
+  const Tensor rsqrt = RunUnfused("Rsqrt", {inputs[0]});
+  const Tensor mul = RunUnfused("Mul", {rsqrt, inputs[1]});
+  const Tensor tanh = RunUnfused("Tanh", {inputs[0]});
+  const Tensor add = RunUnfused("Add", {mul, tanh});
+  const Tensor expected = RunUnfused("Relu6", {add});
+
+  Tensor output;
+  TF_ASSERT_OK(RunFused({"Rsqrt", "Mul", "Tanh", "Add", "Relu6"},
+                        {0, -1, 2, 1, 0, -1, 3, 4, 5, -1}, inputs, &output));
+  ExpectMatches(expected, output);
+}
+
+TEST_F(FusedElementwiseOpTest, ForwardsInputOfOutputShape) {
+  // The second input has the shape of the output, and is overwritten by the
+  // result block by block. The last op still reads it.
+  std::vector<Tensor> inputs = {Random(TensorShape({50}), false),
+                                Random(kShape, false)};
+  const Tensor mul = RunUnfused("Mul", {inputs[0], inputs[1]});
+  const Tensor expected = RunUnfused("Sub", {mul, inputs[1]});
+
+  NodeDef node;
+  TF_ASSERT_OK(MakeFused(2, {"Mul", "Sub"}, {0, 1, 2, 1}, &node));
+  set_node_def(node);
+  TF_ASSERT_OK(InitOp());
+  inputs_.clear();
+  AddInputFromArray<float>(inputs[0].shape(), inputs[0].flat<float>());
+  AddInputFromArray<float>(inputs[1].shape(), inputs[1].flat<float>());
+  const float* input_data = inputs_[1]->flat<float>().data();
+  TF_ASSERT_OK(RunOpKernel());
+
+  const Tensor& output = *GetOutput(0);
+  EXPECT_EQ(input_data, output.flat<float>().data());
+  ExpectMatches(expected, output);
+}
+
+TEST_F(FusedElementwiseOpTest, UnsupportedOp) {
+  NodeDef node;
+  TF_ASSERT_OK(MakeFused(2, {"MatMul"}, {0, 1}, &node));
+  set_node_def(node);
+  const Status status = InitOp();
+  EXPECT_EQ(error::UNIMPLEMENTED, status.code()) << status;
+}
+
+TEST_F(FusedElementwiseOpTest, InvalidOperands) {
+  struct Program {
+    int num_inputs;
+    std::vector<string> ops;
+    std::vector<int> operands;
+  };
+  const std::vector<Program> programs = {
+      // Not two operands per op.
+      {2, {"Add"}, {0, 1, -1}},
+      // Operand past the inputs.
+      {2, {"Add"}, {0, 2}},
+      // Operand is the result of the op itself.
+      {1, {"Neg"}, {1, -1}},
+      // Operand is the result of a later op.
+      {1, {"Neg", "Abs"}, {2, -1, 1, -1}},
+      // Negative operand.
+      {1, {"Neg"}, {-2, -1}},
+      // Unary op with a second operand.
+      {2, {"Neg"}, {0, 1}},
+      // Binary op with a single operand.
+      {2, {"Add"}, {0, -1}}};
+  for (const Program& program : programs) {
+    SCOPED_TRACE(strings::StrCat(str_util::Join(program.ops, ","), " ",
+                                 str_util::Join(program.operands, ",")));
+    NodeDef node;
+    TF_ASSERT_OK(
+        MakeFused(program.num_inputs, program.ops, program.operands, &node));
+    set_node_def(node);
+    const Status status = InitOp();
+    EXPECT_EQ(error::INVALID_ARGUMENT, status.code()) << status;
+  }
+}
+
+TEST_F(FusedElementwiseOpTest, IncompatibleShapes) {
+  Tensor output;
+  const Status status =
+      RunFused({"Add"}, {0, 1},
+               {Random(TensorShape({3, 4}), false),
+                Random(TensorShape({5}), false)},
+               &output);
+  EXPECT_EQ(error::INVALID_ARGUMENT, status.code()) << status;
+}
+
+}  // namespace
+}  // namespace tensorflow
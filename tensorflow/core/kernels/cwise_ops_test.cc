@@ -360,5 +360,47 @@ BM_BCAST_ADD_CROSS_CR_ALL(sycl);
 #undef BM_BCAST_ADD_CROSS_CR_ALL
 #undef BM_BCAST_ADD_CROSS_CR
 
+// Swish(x * w + b) with a [rows, cols] x and [cols] w and b, as separate ops
+// or as a single _FusedElementwise.
+Graph* Swish(int rows, int cols, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor x(DT_FLOAT, TensorShape({rows, cols}));
+  x.flat<float>().setRandom();
+  Tensor w(DT_FLOAT, TensorShape({cols}));
+  w.flat<float>().setRandom();
+  Tensor b(DT_FLOAT, TensorShape({cols}));
+  b.flat<float>().setRandom();
+  Node* x_node = test::graph::Constant(g, x);
+  Node* w_node = test::graph::Constant(g, w);
+  Node* b_node = test::graph::Constant(g, b);
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedElementwise")
+                    .Input({x_node, w_node, b_node})
+                    .Attr("T", DT_FLOAT)
+                    .Attr("ops", {"Mul", "Add", "Sigmoid", "Mul"})
+                    .Attr("operands", {0, 1, 3, 2, 4, -1, 4, 5})
+                    .Finalize(g, nullptr));
+  } else {
+    Node* mul = test::graph::Binary(g, "Mul", x_node, w_node);
+    Node* add = test::graph::Binary(g, "Add", mul, b_node);
+    test::graph::Binary(g, "Mul", add, test::graph::Unary(g, "Sigmoid", add));
+  }
+  return g;
+}
+
+#define BM_SWISH(DEVICE, R, C)                                            \
+  void BM_##DEVICE##_Swish_R##R##_C##C(int iters, int fused) {            \
+    const int64 tot = static_cast<int64>(iters) * R * C;                  \
+    testing::ItemsProcessed(tot);                                         \
+    testing::BytesProcessed(tot * sizeof(float));                         \
+    test::Benchmark(#DEVICE, Swish(R, C, fused)).Run(iters);              \
+  }                                                                       \
+  BENCHMARK(BM_##DEVICE##_Swish_R##R##_C##C)->Arg(0)->Arg(1);
+
+BM_SWISH(cpu, 512, 256);
+BM_SWISH(cpu, 2048, 1024);
+BM_SWISH(cpu, 4096, 4096);
+#undef BM_SWISH
+
 }  // namespace
 }  // namespace tensorflow
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tensorflow/core/framework/variant_op_registry.h"
 #include "tensorflow/core/graph/graph_constructor.h"
 #include "tensorflow/core/kernels/data/dataset.h"
+#include "tensorflow/core/kernels/data/model.h"
 #include "tensorflow/core/kernels/data/stats_aggregator.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
@@ -199,6 +200,14 @@ class IteratorResource : public ResourceBase {
       TF_RETURN_IF_ERROR(
           VerifyShapesCompatible(output_shapes_, iterator->output_shapes()));
     }
+    // Each iterator gets a fresh model, so that knobs tuned for a previous
+    // iterator do not carry over.
+    std::shared_ptr<model::Model> model(new model::Model);
+    {
+      mutex_lock l(mu_);
+      model->set_stats_aggregator(stats_aggregator_);
+      model_ = std::move(model);
+    }
     iterator_.reset(iterator.release());
     return Status::OK();
   }
@@ -206,6 +215,9 @@ class IteratorResource : public ResourceBase {
   void set_stats_aggregator(std::shared_ptr<StatsAggregator> stats_aggregator) {
     mutex_lock l(mu_);
     stats_aggregator_ = std::move(stats_aggregator);
+    if (model_) {
+      model_->set_stats_aggregator(stats_aggregator_);
+    }
   }
 
   std::shared_ptr<StatsAggregator> stats_aggregator() {
@@ -213,6 +225,11 @@ class IteratorResource : public ResourceBase {
     return stats_aggregator_;
   }
 
+  std::shared_ptr<model::Model> model() {
+    tf_shared_lock l(mu_);
+    return model_;
+  }
+
   string DebugString() override { return "Iterator resource"; }
 
   const DataTypeVector& output_dtypes() const { return output_dtypes_; }
@@ -232,6 +249,7 @@ class IteratorResource : public ResourceBase {
   std::shared_ptr<IteratorBase> iterator_;
   mutex mu_;
   std::shared_ptr<StatsAggregator> stats_aggregator_ GUARDED_BY(mu_);
+  std::shared_ptr<model::Model> model_ GUARDED_BY(mu_);
   std::shared_ptr<const FunctionLibraryDefinition> lib_def_ GUARDED_BY(mu_);
   const DataTypeVector output_dtypes_;
   const std::vector<PartialTensorShape> output_shapes_;
@@ -878,6 +896,7 @@ class IteratorGetNextOp : public AsyncOpKernel {
           };
           params.runner = *(ctx->runner());
           params.function_library = iterator->function_library();
+          params.model = iterator->model();
           DeviceBase* device = ctx->function_library()->device();
           params.allocator_getter = [device](AllocatorAttributes attrs) {
             return device->GetAllocator(attrs);
@@ -929,6 +948,7 @@ class IteratorGetNextSyncOp : public OpKernel {
     };
     params.runner = *(ctx->runner());
     params.function_library = iterator->function_library();
+    params.model = iterator->model();
     DeviceBase* device = ctx->function_library()->device();
     params.allocator_getter = [device](AllocatorAttributes attrs) {
       return device->GetAllocator(attrs);
@@ -0,0 +1,207 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/iterator_scheduler.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+IteratorScheduler::Client::~Client() {
+  std::vector<std::unique_ptr<Thread>> exited_threads;
+  {
+    mutex_lock l(scheduler_->mu_);
+    if (!pending_.empty()) {
+      pending_.clear();
+      auto clients = scheduler_->ready_.find(priority_);
+      clients->second.erase(
+          std::find(clients->second.begin(), clients->second.end(), this));
+      if (clients->second.empty()) {
+        scheduler_->ready_.erase(clients);
+      }
+    }
+    while (num_running_ > 0) {
+      scheduler_->done_cond_var_.wait(l);
+    }
+    // The threads that are now surplus exit once they are free.
+    scheduler_->num_threads_ -= num_reserved_threads_;
+    scheduler_->num_unused_reserved_threads_ -= num_reserved_threads_;
+    if (num_reserved_threads_ > 0) {
+      scheduler_->work_cond_var_.notify_all();
+    }
+    exited_threads = scheduler_->TakeExitedThreadsLocked();
+  }
+}
+
+void IteratorScheduler::Client::Schedule(std::function<void()> fn) {
+  mutex_lock l(scheduler_->mu_);
+  if (pending_.empty()) {
+    scheduler_->ready_[priority_].push_back(this);
+  }
+  pending_.push_back(std::move(fn));
+  scheduler_->work_cond_var_.notify_one();
+}
+
+IteratorScheduler::IteratorScheduler(Env* env, const string& name,
+                                     int num_shared_threads)
+    : env_(env), name_(name) {
+  CHECK_GT(num_shared_threads, 0);
+  mutex_lock l(mu_);
+  num_threads_ = num_shared_threads;
+  StartThreadsLocked();
+}
+
+IteratorScheduler::~IteratorScheduler() {
+  std::map<int64, std::unique_ptr<Thread>> threads;
+  {
+    mutex_lock l(mu_);
+    cancelled_ = true;
+    work_cond_var_.notify_all();
+    threads.swap(threads_);
+  }
+  // Joins the threads.
+  threads.clear();
+}
+
+IteratorScheduler* IteratorScheduler::Global() {
+  static IteratorScheduler* scheduler = new IteratorScheduler(
+      Env::Default(), "tf_data_iterator", port::NumSchedulableCPUs());
+  return scheduler;
+}
+
+std::unique_ptr<IteratorScheduler::Client> IteratorScheduler::NewClient(
+    int priority, int num_reserved_threads) {
+  CHECK_GE(num_reserved_threads, 0);
+  std::vector<std::unique_ptr<Thread>> exited_threads;
+  {
+    mutex_lock l(mu_);
+    num_threads_ += num_reserved_threads;
+    num_unused_reserved_threads_ += num_reserved_threads;
+    StartThreadsLocked();
+    exited_threads = TakeExitedThreadsLocked();
+  }
+  return std::unique_ptr<Client>(
+      new Client(this, priority, num_reserved_threads));
+}
+
+int IteratorScheduler::num_threads() {
+  mutex_lock l(mu_);
+  return num_threads_;
+}
+
+bool IteratorScheduler::MayRunLocked(const Client& client) {
+  // Every task beyond the reservation of its client runs on a shared thread,
+  // and the unused reserved threads must stay free.
+  return client.num_running_ < client.num_reserved_threads_ ||
+         num_running_ + num_unused_reserved_threads_ < num_threads_;
+}
+
+IteratorScheduler::Client* IteratorScheduler::NextClientLocked() {
+  for (auto clients = ready_.begin(); clients != ready_.end(); ++clients) {
+    std::deque<Client*>& queue = clients->second;
+    for (auto it = queue.begin(); it != queue.end(); ++it) {
+      Client* client = *it;
+      if (!MayRunLocked(*client)) continue;
+      queue.erase(it);
+      if (client->pending_.size() > 1) {
+        queue.push_back(client);
+      } else if (queue.empty()) {
+        ready_.erase(clients);
+      }
+      return client;
+    }
+  }
+  return nullptr;
+}
+
+void IteratorScheduler::StartThreadsLocked() {
+  // Threads that were about to exit are kept instead, if there are any.
+  while (num_live_threads_ < num_threads_) {
+    const int64 thread_id = next_thread_id_++;
+    threads_[thread_id].reset(env_->StartThread(
+        {}, name_, [this, thread_id]() { WorkerLoop(thread_id); }));
+    ++num_live_threads_;
+  }
+}
+
+std::vector<std::unique_ptr<Thread>>
+IteratorScheduler::TakeExitedThreadsLocked() {
+  std::vector<std::unique_ptr<Thread>> exited_threads;
+  for (int64 thread_id : exited_thread_ids_) {
+    auto thread = threads_.find(thread_id);
+    exited_threads.push_back(std::move(thread->second));
+    threads_.erase(thread);
+  }
+  exited_thread_ids_.clear();
+  return exited_threads;
+}
+
+void IteratorScheduler::WorkerLoop(int64 thread_id) {
+  while (true) {
+    Client* client;
+    std::function<void()> fn;
+    {
+      mutex_lock l(mu_);
+      while (true) {
+        if (cancelled_) return;
+        if (num_live_threads_ > num_threads_) {
+          --num_live_threads_;
+          exited_thread_ids_.push_back(thread_id);
+          // Another thread may have to take over a task this one would have
+          // run.
+          if (!ready_.empty()) {
+            work_cond_var_.notify_one();
+          }
+          return;
+        }
+        client = NextClientLocked();
+        if (client != nullptr) break;
+        work_cond_var_.wait(l);
+      }
+      fn = std::move(client->pending_.front());
+      client->pending_.pop_front();
+      if (client->num_running_ < client->num_reserved_threads_) {
+        --num_unused_reserved_threads_;
+      }
+      ++client->num_running_;
+      ++num_running_;
+      // The thread woken up for a queued task may have taken a task of
+      // another client, e.g. of a higher priority, so give the remaining
+      // tasks a chance to run on another free thread.
+      if (!ready_.empty()) {
+        work_cond_var_.notify_one();
+      }
+    }
+    fn();
+    mutex_lock l(mu_);
+    --num_running_;
+    if (--client->num_running_ < client->num_reserved_threads_) {
+      ++num_unused_reserved_threads_;
+    }
+    if (client->num_running_ == 0) {
+      done_cond_var_.notify_all();
+    }
+  }
+}
+
+int IteratorPriority(const string& prefix) {
+  // Each transformation adds a "::<Name>" component to the prefix of its
+  // input's iterator.
+  return -static_cast<int>(std::count(prefix.begin(), prefix.end(), ':'));
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,156 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_ITERATOR_SCHEDULER_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_ITERATOR_SCHEDULER_H_
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// An `IteratorScheduler` is a pool of threads that iterators use for their
+// background work, such as filling a prefetch buffer. All input pipelines of a
+// process share `IteratorScheduler::Global()`.
+//
+// Each iterator schedules its tasks through a `Client` with a priority. A free
+// thread runs a task of the highest priority client that may run one, taking
+// turns among clients of the same priority, one task each. Iterators should
+// schedule a task only while its result has somewhere to go (e.g. while their
+// buffer has room), and make each task produce a bounded amount of work, so
+// that idle stages do not occupy threads.
+//
+// The pool has a fixed number of shared threads, plus the threads reserved by
+// its current clients. A client may always have as many tasks running as it
+// reserved threads, and its other tasks wait for a shared thread. An iterator
+// whose tasks may block (e.g. on I/O) should reserve a thread for each task it
+// may have at once, so that those tasks neither wait for the shared threads
+// nor hold them up.
+//
+// Because the shared threads are bounded, a thread must never block waiting
+// for a queued task that runs on them: all of them may be blocked the same
+// way. A thread that needs the result of such a task should claim its work and
+// do it inline, and only block on work that is running on another thread.
+class IteratorScheduler {
+ public:
+  // The queue of tasks of one iterator.
+  class Client {
+   public:
+    // Drops the pending tasks of this client, waits for the running ones to
+    // finish, and releases its reserved threads. Must not be called from a
+    // task of this client.
+    ~Client();
+
+    // Queues `fn` to run on a thread of the scheduler.
+    void Schedule(std::function<void()> fn);
+
+   private:
+    friend class IteratorScheduler;
+
+    Client(IteratorScheduler* scheduler, int priority, int num_reserved_threads)
+        : scheduler_(scheduler),
+          priority_(priority),
+          num_reserved_threads_(num_reserved_threads) {}
+
+    IteratorScheduler* const scheduler_;
+    const int priority_;
+    const int num_reserved_threads_;
+    std::deque<std::function<void()>> pending_;  // Guarded by scheduler_->mu_.
+    int64 num_running_ = 0;                      // Guarded by scheduler_->mu_.
+
+    TF_DISALLOW_COPY_AND_ASSIGN(Client);
+  };
+
+  // Starts `num_shared_threads` threads named `name`.
+  IteratorScheduler(Env* env, const string& name, int num_shared_threads);
+
+  // Waits for the running tasks to finish, drops the pending ones and joins
+  // the threads. All clients must have been destroyed.
+  ~IteratorScheduler();
+
+  // Returns the scheduler shared by all iterators in the process, which has
+  // one shared thread per schedulable CPU.
+  static IteratorScheduler* Global();
+
+  // Returns a new client whose tasks run before those of clients with a lower
+  // `priority`, and which may always have `num_reserved_threads` tasks
+  // running. Starts the threads it reserves.
+  std::unique_ptr<Client> NewClient(int priority, int num_reserved_threads);
+
+  // Returns the number of shared threads plus the number of threads reserved
+  // by the current clients.
+  int num_threads();
+
+ private:
+  // Returns true if a thread may start a task of `client`.
+  bool MayRunLocked(const Client& client) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Returns the client whose task a free thread should run next, or nullptr
+  // if no queued task may run.
+  Client* NextClientLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void StartThreadsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  // Returns the threads that have exited since the last call, to be joined
+  // after releasing `mu_`.
+  std::vector<std::unique_ptr<Thread>> TakeExitedThreadsLocked()
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void WorkerLoop(int64 thread_id);
+
+  Env* const env_;
+  const string name_;
+  mutex mu_;
+  // Signalled when a task is queued, or when the pool shrinks.
+  condition_variable work_cond_var_;
+  // Signalled when the last running task of a client finishes.
+  condition_variable done_cond_var_;
+  // The clients with pending tasks, by decreasing priority. Within a
+  // priority, the client at the front runs next and then moves to the back.
+  std::map<int, std::deque<Client*>, std::greater<int>> ready_ GUARDED_BY(mu_);
+  // The number of threads the pool should have.
+  int num_threads_ GUARDED_BY(mu_) = 0;
+  // The number of threads started that are not exiting. Larger than
+  // `num_threads_` after a client releases its reserved threads, until that
+  // many threads have exited.
+  int num_live_threads_ GUARDED_BY(mu_) = 0;
+  // The number of tasks being run by the threads.
+  int64 num_running_ GUARDED_BY(mu_) = 0;
+  // The number of reserved threads that their clients are not using. These
+  // many threads are always free.
+  int64 num_unused_reserved_threads_ GUARDED_BY(mu_) = 0;
+  bool cancelled_ GUARDED_BY(mu_) = false;
+  int64 next_thread_id_ GUARDED_BY(mu_) = 0;
+  // The threads, by id.
+  std::map<int64, std::unique_ptr<Thread>> threads_ GUARDED_BY(mu_);
+  // The ids of the threads that have exited but are not joined yet.
+  std::vector<int64> exited_thread_ids_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(IteratorScheduler);
+};
+
+// Returns the priority of the iterator with the given `prefix` (e.g.
+// "Iterator::Prefetch::Map"): iterators closer to the consumer of the
+// pipeline get a higher priority, so that elements that are further along
+// are finished first, which keeps the number of elements in flight low.
+int IteratorPriority(const string& prefix);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_ITERATOR_SCHEDULER_H_
@@ -0,0 +1,259 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/iterator_scheduler.h"
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Occupies a thread of `scheduler` until `Release()`.
+class Blocker {
+ public:
+  explicit Blocker(IteratorScheduler* scheduler)
+      : client_(scheduler->NewClient(0, 0)) {
+    client_->Schedule([this]() {
+      started_.Notify();
+      released_.WaitForNotification();
+    });
+    started_.WaitForNotification();
+  }
+
+  ~Blocker() { Release(); }
+
+  void Release() {
+    if (!released_.HasBeenNotified()) released_.Notify();
+  }
+
+ private:
+  Notification started_;
+  Notification released_;
+  std::unique_ptr<IteratorScheduler::Client> client_;
+};
+
+// Records the order in which tasks run.
+class Recorder {
+ public:
+  explicit Recorder(int num_tasks) : counter_(num_tasks) {}
+
+  std::function<void()> Task(int id) {
+    return [this, id]() {
+      {
+        mutex_lock l(mu_);
+        order_.push_back(id);
+      }
+      counter_.DecrementCount();
+    };
+  }
+
+  std::vector<int> Wait() {
+    counter_.Wait();
+    mutex_lock l(mu_);
+    return order_;
+  }
+
+ private:
+  BlockingCounter counter_;
+  mutex mu_;
+  std::vector<int> order_ GUARDED_BY(mu_);
+};
+
+TEST(IteratorSchedulerTest, RunsAllTasks) {
+  IteratorScheduler scheduler(Env::Default(), "test", 4);
+  auto client = scheduler.NewClient(0, 0);
+  mutex mu;
+  int sum = 0;
+  BlockingCounter counter(100);
+  for (int i = 0; i < 100; ++i) {
+    client->Schedule([&mu, &sum, &counter, i]() {
+      {
+        mutex_lock l(mu);
+        sum += i;
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  mutex_lock l(mu);
+  EXPECT_EQ(4950, sum);
+}
+
+TEST(IteratorSchedulerTest, HigherPriorityRunsFirst) {
+  IteratorScheduler scheduler(Env::Default(), "test", 1);
+  auto low = scheduler.NewClient(-2, 0);
+  auto high = scheduler.NewClient(-1, 0);
+  Recorder recorder(4);
+  {
+    // The tasks queue up while the only thread is busy.
+    Blocker blocker(&scheduler);
+    low->Schedule(recorder.Task(0));
+    low->Schedule(recorder.Task(1));
+    high->Schedule(recorder.Task(2));
+    high->Schedule(recorder.Task(3));
+  }
+  EXPECT_EQ(std::vector<int>({2, 3, 0, 1}), recorder.Wait());
+}
+
+TEST(IteratorSchedulerTest, ClientsOfEqualPriorityTakeTurns) {
+  IteratorScheduler scheduler(Env::Default(), "test", 1);
+  auto first = scheduler.NewClient(0, 0);
+  auto second = scheduler.NewClient(0, 0);
+  Recorder recorder(6);
+  {
+    Blocker blocker(&scheduler);
+    first->Schedule(recorder.Task(0));
+    first->Schedule(recorder.Task(1));
+    first->Schedule(recorder.Task(2));
+    second->Schedule(recorder.Task(3));
+    second->Schedule(recorder.Task(4));
+    second->Schedule(recorder.Task(5));
+  }
+  EXPECT_EQ(std::vector<int>({0, 3, 1, 4, 2, 5}), recorder.Wait());
+}
+
+TEST(IteratorSchedulerTest, ReservedThreadsRunWhileSharedThreadsAreBusy) {
+  IteratorScheduler scheduler(Env::Default(), "test", 1);
+  Blocker blocker(&scheduler);
+  auto client = scheduler.NewClient(0, 3);
+  EXPECT_EQ(4, scheduler.num_threads());
+  // Each task blocks until all of them have started, so they only finish if
+  // they run at once.
+  BlockingCounter started(3);
+  BlockingCounter done(3);
+  for (int i = 0; i < 3; ++i) {
+    client->Schedule([&started, &done]() {
+      started.DecrementCount();
+      started.Wait();
+      done.DecrementCount();
+    });
+  }
+  done.Wait();
+}
+
+TEST(IteratorSchedulerTest, SharedTasksDoNotUseReservedThreads) {
+  IteratorScheduler scheduler(Env::Default(), "test", 1);
+  auto reserved = scheduler.NewClient(0, 1);
+  auto shared = scheduler.NewClient(1, 0);
+  Blocker blocker(&scheduler);
+  Notification shared_done;
+  shared->Schedule([&shared_done]() { shared_done.Notify(); });
+  // The reserved thread runs the tasks of its client, and not the queued
+  // task of the other client, although that one has a higher priority.
+  for (int i = 0; i < 10; ++i) {
+    Notification done;
+    reserved->Schedule([&done]() { done.Notify(); });
+    done.WaitForNotification();
+  }
+  EXPECT_FALSE(shared_done.HasBeenNotified());
+  blocker.Release();
+  shared_done.WaitForNotification();
+}
+
+TEST(IteratorSchedulerTest, ReservedThreadsAreReleased) {
+  IteratorScheduler scheduler(Env::Default(), "test", 2);
+  {
+    auto client = scheduler.NewClient(0, 3);
+    EXPECT_EQ(5, scheduler.num_threads());
+  }
+  EXPECT_EQ(2, scheduler.num_threads());
+  // The remaining threads still run tasks.
+  auto client = scheduler.NewClient(0, 0);
+  BlockingCounter counter(10);
+  for (int i = 0; i < 10; ++i) {
+    client->Schedule([&counter]() { counter.DecrementCount(); });
+  }
+  counter.Wait();
+}
+
+TEST(IteratorSchedulerTest, DestroyClientWithQueuedTasks) {
+  IteratorScheduler scheduler(Env::Default(), "test", 1);
+  Blocker blocker(&scheduler);
+  mutex mu;
+  int num_run = 0;
+  {
+    auto client = scheduler.NewClient(0, 0);
+    for (int i = 0; i < 10; ++i) {
+      client->Schedule([&mu, &num_run]() {
+        mutex_lock l(mu);
+        ++num_run;
+      });
+    }
+    // Drops the queued tasks without waiting for the blocked thread.
+  }
+  blocker.Release();
+  // Runs a task after the dropped ones would have run.
+  auto client = scheduler.NewClient(0, 0);
+  Notification done;
+  client->Schedule([&done]() { done.Notify(); });
+  done.WaitForNotification();
+  mutex_lock l(mu);
+  EXPECT_EQ(0, num_run);
+}
+
+TEST(IteratorSchedulerTest, DestroyClientWaitsForRunningTasks) {
+  IteratorScheduler scheduler(Env::Default(), "test", 2);
+  Notification started;
+  Notification release;
+  bool finished = false;
+  std::unique_ptr<Thread> releaser;
+  {
+    auto client = scheduler.NewClient(0, 0);
+    client->Schedule([&started, &release, &finished]() {
+      started.Notify();
+      release.WaitForNotification();
+      finished = true;
+    });
+    started.WaitForNotification();
+    releaser.reset(Env::Default()->StartThread(
+        {}, "releaser", [&release]() {
+          Env::Default()->SleepForMicroseconds(10000);
+          release.Notify();
+        }));
+  }
+  EXPECT_TRUE(finished);
+}
+
+TEST(IteratorSchedulerTest, GlobalScheduler) {
+  IteratorScheduler* scheduler = IteratorScheduler::Global();
+  ASSERT_NE(nullptr, scheduler);
+  EXPECT_EQ(scheduler, IteratorScheduler::Global());
+  const int num_threads = scheduler->num_threads();
+  EXPECT_GE(num_threads, port::NumSchedulableCPUs());
+  {
+    auto client = scheduler->NewClient(0, 2);
+    EXPECT_EQ(num_threads + 2, scheduler->num_threads());
+    BlockingCounter counter(10);
+    for (int i = 0; i < 10; ++i) {
+      client->Schedule([&counter]() { counter.DecrementCount(); });
+    }
+    counter.Wait();
+  }
+  EXPECT_EQ(num_threads, scheduler->num_threads());
+}
+
+TEST(IteratorSchedulerTest, IteratorPriority) {
+  EXPECT_GT(IteratorPriority("Iterator::Prefetch"),
+            IteratorPriority("Iterator::Prefetch::Map"));
+  EXPECT_EQ(IteratorPriority("Iterator::Prefetch::Map"),
+            IteratorPriority("Iterator::Map::Prefetch"));
+}
+
+}  // namespace
+}  // namespace tensorflow
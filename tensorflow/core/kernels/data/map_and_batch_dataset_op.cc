@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 #define EIGEN_USE_THREADS
 
+#include <chrono>
+
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -40,6 +42,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("f", &func_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("output_types", &output_types_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("output_shapes", &output_shapes_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("sloppy", &sloppy_));
   }
 
  protected:
@@ -70,7 +73,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
     OP_REQUIRES_OK(ctx, CapturedFunction::Create(
                             func_, std::move(other_arguments), &captured_func));
 
-    *output = new Dataset(input, batch_size, num_parallel_batches,
+    *output = new Dataset(input, batch_size, num_parallel_batches, sloppy_,
                           output_types_, output_shapes_,
                           std::move(captured_func), &ctx->eigen_cpu_device());
   }
@@ -79,13 +82,15 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
   class Dataset : public DatasetBase {
    public:
     Dataset(const DatasetBase* input, int64 batch_size,
-            int64 num_parallel_batches, const DataTypeVector& output_types,
+            int64 num_parallel_batches, bool sloppy,
+            const DataTypeVector& output_types,
             const std::vector<PartialTensorShape>& output_shapes,
             std::unique_ptr<CapturedFunction> captured_func,
             const Eigen::ThreadPoolDevice* device)
         : input_(input),
           batch_size_(batch_size),
           num_parallel_batches_(num_parallel_batches),
+          sloppy_(sloppy),
           output_types_(output_types),
           output_shapes_(output_shapes),
           captured_func_(std::move(captured_func)),
@@ -119,7 +124,8 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
             input_impl_(params.dataset->input_->MakeIterator(params.prefix)),
             invocation_results_(params.dataset->batch_size_ *
                                 params.dataset->num_parallel_batches_),
-            batch_results_(params.dataset->num_parallel_batches_) {}
+            batch_results_(params.dataset->num_parallel_batches_),
+            batch_signal_(std::make_shared<BatchSignal>()) {}
 
       ~Iterator() override {
         // TODO(mrry): Replace this cancellation logic with a
@@ -166,22 +172,26 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
           }
         }
 
+        int64 batch_index = current_batch_index_;
         int64 num_elements = 0;
-        Status status = WaitForBatch(current_batch_index_, &num_elements);
+        Status status =
+            dataset()->sloppy_
+                ? WaitForAnyBatch(&batch_index, &num_elements)
+                : WaitForBatch(current_batch_index_, &num_elements);
         if (num_elements == 0) {
           *end_of_sequence = true;
           return Status::OK();
         }
         if (!status.ok()) {
           // Deallocate tensors allocated for the output.
-          batch_results_[current_batch_index_].output.clear();
+          batch_results_[batch_index].output.clear();
         } else {
           if (num_elements < dataset()->batch_size_) {
             const std::vector<Tensor>& output =
-                batch_results_[current_batch_index_].output;
+                batch_results_[batch_index].output;
             for (size_t i = 0; i < output.size(); ++i) {
               TensorShape component_shape(
-                  batch_results_[current_batch_index_].output[i].shape());
+                  batch_results_[batch_index].output[i].shape());
               component_shape.set_dim(0, num_elements);
               Tensor component(ctx->allocator({}), output[i].dtype(),
                                component_shape);
@@ -190,16 +200,15 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
               out_tensors->emplace_back(std::move(component));
             }
             // Deallocate tensors allocated for the output.
-            batch_results_[current_batch_index_].output.clear();
+            batch_results_[batch_index].output.clear();
           } else {
-            *out_tensors =
-                std::move(batch_results_[current_batch_index_].output);
+            *out_tensors = std::move(batch_results_[batch_index].output);
           }
           *end_of_sequence = false;
         }
-        StartInvocationBatch(ctx, current_batch_index_);
+        StartInvocationBatch(ctx, batch_index);
         current_batch_index_ =
-            (current_batch_index_ + 1) % dataset()->num_parallel_batches_;
+            (batch_index + 1) % dataset()->num_parallel_batches_;
         return status;
       }
 
@@ -217,6 +226,15 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
         std::vector<Tensor> return_values;
       };
 
+      // Signalled whenever an invocation of `func_` finishes in sloppy mode,
+      // so that a caller can wait for whichever batch completes first. The
+      // callbacks share ownership, since they may still use it after the
+      // iterator has been destroyed.
+      struct BatchSignal {
+        mutex mu;
+        condition_variable cond_var;
+      };
+
       int64 ComputeInvocationIndex(int64 batch_index, int64 offset) {
         return batch_index * dataset()->batch_size_ + offset;
       }
@@ -280,12 +298,15 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
         // Call `captured_func_(input_element)`, store the result in
         // `result->return_values`, and notify `batch_result->counter`
         // to unblock a consumer.
+        std::shared_ptr<BatchSignal> batch_signal =
+            dataset()->sloppy_ ? batch_signal_ : nullptr;
         (*ctx->runner())(std::bind(
-            [this, result, batch_result, offset](
+            [this, result, batch_result, offset, batch_signal](
                 IteratorContext* ctx, std::vector<Tensor> input_element) {
               dataset()->captured_func_->RunAsync(
                   ctx, std::move(input_element), &result->return_values,
-                  [this, ctx, result, batch_result, offset](Status ret_status) {
+                  [this, ctx, result, batch_result, offset,
+                   batch_signal](Status ret_status) {
                     result->status.Update(ret_status);
                     if (ret_status.ok()) {
                       EnsureOutputAllocated(ctx, batch_result,
@@ -326,6 +347,10 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
                     // values).
                     result->return_values.clear();
                     batch_result->counter->DecrementCount();
+                    if (batch_signal) {
+                      mutex_lock l(batch_signal->mu);
+                      batch_signal->cond_var.notify_all();
+                    }
                   });
             },
             new IteratorContext(*ctx), std::move(input_element)));
@@ -377,17 +402,53 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
         return status;
       }
 
+      // Waits until some batch that has elements is complete, and sets
+      // `*batch_index` to the first such batch from `current_batch_index_`
+      // on. If all batches are complete and have no elements, the input is
+      // exhausted, and it sets `*num_elements` to zero.
+      Status WaitForAnyBatch(int64* batch_index, int64* num_elements)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        port::Tracing::TraceMe activity(strings::StrCat(prefix(), "::Wait"));
+        const int64 num_batches = dataset()->num_parallel_batches_;
+        mutex_lock l(batch_signal_->mu);
+        while (true) {
+          bool all_complete = true;
+          for (int64 i = 0; i < num_batches; ++i) {
+            *batch_index = (current_batch_index_ + i) % num_batches;
+            if (!batch_results_[*batch_index].counter->WaitFor(
+                    std::chrono::milliseconds(0))) {
+              all_complete = false;
+              continue;
+            }
+            // Batches are started in input order, so a complete batch
+            // without elements means that the batches started after it
+            // have none either, but those started before it may.
+            *num_elements = 0;
+            Status status = WaitForBatch(*batch_index, num_elements);
+            if (*num_elements > 0) return status;
+          }
+          if (all_complete) {
+            *batch_index = current_batch_index_;
+            *num_elements = 0;
+            return Status::OK();
+          }
+          batch_signal_->cond_var.wait(l);
+        }
+      }
+
       mutex mu_;
       int32 current_batch_index_ GUARDED_BY(mu_) = -1;
       const std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
       std::vector<InvocationResult> invocation_results_ GUARDED_BY(mu_);
       std::vector<BatchResult> batch_results_ GUARDED_BY(mu_);
+      const std::shared_ptr<BatchSignal> batch_signal_;
     };
 
     const DatasetBase* const input_;
     const NameAttrList func_;
     const int64 batch_size_;
     const int64 num_parallel_batches_;
+    const bool sloppy_;
     const DataTypeVector output_types_;
     const std::vector<PartialTensorShape> output_shapes_;
     const std::unique_ptr<CapturedFunction> captured_func_;
@@ -398,6 +459,7 @@ class MapAndBatchDatasetOp : public UnaryDatasetOpKernel {
   DataTypeVector output_types_;
   std::vector<PartialTensorShape> output_shapes_;
   NameAttrList func_;
+  bool sloppy_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("MapAndBatchDataset").Device(DEVICE_CPU),
@@ -0,0 +1,206 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/model.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/kernels/data/stats_aggregator.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace model {
+
+namespace {
+
+const int64 kDefaultOptimizationPeriodMs = 100;
+
+// A knob is starved if its consumer waited for more than one in
+// `kStarvedRatio` of the elements it took.
+const int64 kStarvedRatio = 10;
+
+// The activity of a knob since the last optimization step.
+struct Delta {
+  Tunable* tunable;
+  int64 num_produced;
+  int64 num_consumed;
+  int64 num_buffered;
+  int64 num_waits;
+
+  bool starved() const {
+    return num_consumed > 0 && num_waits * kStarvedRatio > num_consumed;
+  }
+
+  // Returns true if the consumer never waited and, on average, found at least
+  // one element ready, so that the knob can give up a thread.
+  bool can_donate() const {
+    return tunable->kind() == Tunable::Kind::kParallelism &&
+           tunable->value() > tunable->min() && num_consumed > 0 &&
+           num_waits == 0 && num_buffered >= num_consumed;
+  }
+};
+
+}  // namespace
+
+Model::Model(int64 cpu_budget, int64 optimization_period_ms)
+    : cpu_budget_(cpu_budget),
+      optimization_period_ms_(optimization_period_ms) {}
+
+Model::Model()
+    : Model(port::NumSchedulableCPUs(), kDefaultOptimizationPeriodMs) {}
+
+Model::~Model() {
+  mutex_lock l(mu_);
+  cancelled_ = true;
+  cond_var_.notify_all();
+}
+
+std::shared_ptr<Tunable> Model::AddTunable(const string& name,
+                                           Tunable::Kind kind, int64 min,
+                                           int64 max) {
+  std::shared_ptr<Tunable> tunable(
+      new Tunable(name, kind, min, std::max(min, max)));
+  mutex_lock l(mu_);
+  Entry entry;
+  entry.tunable = tunable;
+  entries_.push_back(entry);
+  if (!thread_) {
+    last_optimization_us_ = static_cast<int64>(Env::Default()->NowMicros());
+    thread_.reset(Env::Default()->StartThread(
+        {}, "tf_data_model", [this]() { OptimizerThread(); }));
+  }
+  return tunable;
+}
+
+void Model::set_stats_aggregator(
+    std::shared_ptr<StatsAggregator> stats_aggregator) {
+  mutex_lock l(mu_);
+  stats_aggregator_ = std::move(stats_aggregator);
+}
+
+void Model::OptimizerThread() {
+  while (true) {
+    {
+      mutex_lock l(mu_);
+      if (!cancelled_) {
+        WaitForMilliseconds(&l, &cond_var_, optimization_period_ms_);
+      }
+      if (cancelled_) return;
+    }
+    Optimize();
+  }
+}
+
+void Model::Optimize() {
+  mutex_lock l(mu_);
+  const int64 now_us = static_cast<int64>(Env::Default()->NowMicros());
+  const double period_s =
+      std::max<int64>(now_us - last_optimization_us_, 1) / 1e6;
+  last_optimization_us_ = now_us;
+
+  // Drop the knobs of destroyed iterators, keep the others alive for this
+  // step, and collect their activity since the last step.
+  std::vector<std::shared_ptr<Tunable>> tunables;
+  std::vector<Delta> deltas;
+  int64 parallelism = 0;
+  size_t num_entries = 0;
+  for (Entry& entry : entries_) {
+    std::shared_ptr<Tunable> tunable = entry.tunable.lock();
+    if (!tunable) continue;
+    Delta delta;
+    delta.tunable = tunable.get();
+    const int64 num_produced = tunable->num_produced_.load();
+    const int64 num_consumed = tunable->num_consumed_.load();
+    const int64 num_buffered = tunable->num_buffered_.load();
+    const int64 num_waits = tunable->num_waits_.load();
+    delta.num_produced = num_produced - entry.num_produced;
+    delta.num_consumed = num_consumed - entry.num_consumed;
+    delta.num_buffered = num_buffered - entry.num_buffered;
+    delta.num_waits = num_waits - entry.num_waits;
+    entry.num_produced = num_produced;
+    entry.num_consumed = num_consumed;
+    entry.num_buffered = num_buffered;
+    entry.num_waits = num_waits;
+    VLOG(2) << tunable->name() << ": value " << tunable->value()
+            << ", produced " << delta.num_produced / period_s
+            << "/s, consumed " << delta.num_consumed / period_s
+            << "/s, waited for " << delta.num_waits << " elements";
+    if (tunable->kind() == Tunable::Kind::kParallelism) {
+      parallelism += tunable->value();
+    }
+    entries_[num_entries++] = entry;
+    tunables.push_back(std::move(tunable));
+    deltas.push_back(delta);
+  }
+  entries_.resize(num_entries);
+
+  // Grow the most starved knobs first.
+  std::vector<Delta*> starved;
+  std::vector<Delta*> donors;
+  for (Delta& delta : deltas) {
+    if (delta.starved()) {
+      starved.push_back(&delta);
+    } else if (delta.can_donate()) {
+      donors.push_back(&delta);
+    }
+  }
+  std::sort(starved.begin(), starved.end(), [](const Delta* a, const Delta* b) {
+    return a->num_waits * b->num_consumed > b->num_waits * a->num_consumed;
+  });
+  // Take threads from the knobs with the most ready elements first, one
+  // thread from each per step.
+  std::sort(donors.begin(), donors.end(), [](const Delta* a, const Delta* b) {
+    return a->num_buffered * b->num_consumed >
+           b->num_buffered * a->num_consumed;
+  });
+
+  auto donor = donors.begin();
+  for (Delta* delta : starved) {
+    Tunable* tunable = delta->tunable;
+    const int64 value = tunable->value();
+    const int64 target = std::min(tunable->max(), 2 * value);
+    if (target <= value) continue;
+    if (tunable->kind() == Tunable::Kind::kBufferSize) {
+      SetValueLocked(tunable, target);
+      continue;
+    }
+    while (parallelism + target - value > cpu_budget_ &&
+           donor != donors.end()) {
+      Tunable* donor_tunable = (*donor)->tunable;
+      SetValueLocked(donor_tunable, donor_tunable->value() - 1);
+      --parallelism;
+      ++donor;
+    }
+    const int64 grant = std::min(
+        target - value, std::max<int64>(cpu_budget_ - parallelism, 0));
+    if (grant > 0) {
+      SetValueLocked(tunable, value + grant);
+      parallelism += grant;
+    }
+  }
+}
+
+void Model::SetValueLocked(Tunable* tunable, int64 value) {
+  VLOG(1) << "Setting " << tunable->name() << " from " << tunable->value()
+          << " to " << value;
+  tunable->value_.store(value, std::memory_order_relaxed);
+  if (stats_aggregator_) {
+    stats_aggregator_->AddToHistogram(tunable->name(),
+                                      {static_cast<double>(value)});
+  }
+}
+
+}  // namespace model
+}  // namespace tensorflow
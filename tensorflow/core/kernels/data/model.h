@@ -0,0 +1,161 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_KERNELS_DATA_MODEL_H_
+#define TENSORFLOW_CORE_KERNELS_DATA_MODEL_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class StatsAggregator;
+
+namespace model {
+
+// The value of `num_parallel_calls`, `buffer_size` or
+// `buffer_output_elements` that asks for the knob to be tuned at runtime.
+constexpr int64 kAutoTune = -1;
+
+// The largest buffer, in elements, that the model gives an iterator.
+constexpr int64 kMaxAutoTuneBufferSize = 64;
+
+// A `Tunable` is one knob of an iterator, such as the number of parallel calls
+// of a parallel map, together with the counters that the iterator updates so
+// that the `Model` can decide how to set it. All methods are thread-safe.
+class Tunable {
+ public:
+  enum class Kind {
+    // The number of concurrent invocations of a user-defined function. The
+    // values of all parallelism knobs of a model share its CPU budget.
+    kParallelism,
+    // The number of elements an iterator buffers ahead of its consumer.
+    kBufferSize,
+  };
+
+  Tunable(const string& name, Kind kind, int64 min, int64 max)
+      : name_(name), kind_(kind), min_(min), max_(max), value_(min) {}
+
+  const string& name() const { return name_; }
+  Kind kind() const { return kind_; }
+  int64 min() const { return min_; }
+  int64 max() const { return max_; }
+
+  // Returns the current value of the knob.
+  int64 value() const { return value_.load(std::memory_order_relaxed); }
+
+  // Records that the iterator has produced an element for its consumer.
+  void RecordProduced() {
+    num_produced_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Records that the consumer has taken an element, that `num_buffered`
+  // elements were ready when it asked for it, and whether it had to wait.
+  void RecordConsumed(int64 num_buffered, bool waited) {
+    num_consumed_.fetch_add(1, std::memory_order_relaxed);
+    num_buffered_.fetch_add(num_buffered, std::memory_order_relaxed);
+    if (waited) num_waits_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+ private:
+  friend class Model;
+
+  const string name_;
+  const Kind kind_;
+  const int64 min_;
+  const int64 max_;
+  std::atomic<int64> value_;
+  std::atomic<int64> num_produced_{0};
+  std::atomic<int64> num_consumed_{0};
+  std::atomic<int64> num_buffered_{0};
+  std::atomic<int64> num_waits_{0};
+};
+
+// A `Model` tunes the knobs of the iterators of one input pipeline that the
+// user set to `kAutoTune`. Each such iterator adds a `Tunable` to the model of
+// its `IteratorContext` and reports how its buffer fills and drains. A
+// background thread periodically compares the produce and consume rates of
+// every knob since its last step, and:
+//
+//  1. grows the knobs whose consumers had to wait for elements, most starved
+//     first, doubling them up to their maximum;
+//  2. keeps the sum of all parallelism knobs within `cpu_budget`, by moving
+//     parallelism from knobs whose consumers never waited and found elements
+//     ready to starved knobs once the budget is spent.
+//
+// Every change is added to the histogram named after the knob in the
+// `StatsAggregator` of the pipeline, if it has one.
+class Model {
+ public:
+  // Creates a model that shares `cpu_budget` threads among the parallelism
+  // knobs, and optimizes every `optimization_period_ms` milliseconds.
+  Model(int64 cpu_budget, int64 optimization_period_ms);
+
+  // Creates a model with a CPU budget of all schedulable CPUs.
+  Model();
+
+  ~Model();
+
+  // Adds a knob named `name` that the model sets within [min, max]. The knob
+  // starts at `min`, and the model stops tuning it once the returned pointer
+  // is destroyed.
+  std::shared_ptr<Tunable> AddTunable(const string& name, Tunable::Kind kind,
+                                      int64 min, int64 max);
+
+  // Sets the `StatsAggregator` that records the changes to the knobs.
+  void set_stats_aggregator(std::shared_ptr<StatsAggregator> stats_aggregator);
+
+  // Runs one step of the optimization. This is called periodically by a
+  // background thread once the model has a knob.
+  void Optimize();
+
+ private:
+  // A knob and the values of its counters at the last optimization step.
+  struct Entry {
+    std::weak_ptr<Tunable> tunable;
+    int64 num_produced = 0;
+    int64 num_consumed = 0;
+    int64 num_buffered = 0;
+    int64 num_waits = 0;
+  };
+
+  void OptimizerThread();
+
+  void SetValueLocked(Tunable* tunable, int64 value)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const int64 cpu_budget_;
+  const int64 optimization_period_ms_;
+  mutex mu_;
+  condition_variable cond_var_;
+  std::vector<Entry> entries_ GUARDED_BY(mu_);
+  std::shared_ptr<StatsAggregator> stats_aggregator_ GUARDED_BY(mu_);
+  int64 last_optimization_us_ GUARDED_BY(mu_) = 0;
+  bool cancelled_ GUARDED_BY(mu_) = false;
+  // The optimizer thread. This must be last to ensure the thread has exited
+  // before any other members are deallocated.
+  std::unique_ptr<Thread> thread_ GUARDED_BY(mu_);
+};
+
+}  // namespace model
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_DATA_MODEL_H_
@@ -0,0 +1,197 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/kernels/data/model.h"
+
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace model {
+namespace {
+
+// The background thread never runs a step of its own, so the tests decide
+// when `Optimize()` runs.
+const int64 kNeverMs = 24 * 60 * 60 * 1000;
+
+// Simulates a consumer that took `num_consumed` elements since the last step,
+// found `num_buffered` elements ready each time, and had to wait for
+// `num_waits` of them.
+void Consume(Tunable* tunable, int num_consumed, int64 num_buffered,
+             int num_waits) {
+  for (int i = 0; i < num_consumed; ++i) {
+    tunable->RecordProduced();
+    tunable->RecordConsumed(num_buffered, i < num_waits);
+  }
+}
+
+// A consumer that waited for every element.
+void Starve(Tunable* tunable) { Consume(tunable, 10, 0, 10); }
+
+// A consumer that never waited and found two elements ready every time.
+void Saturate(Tunable* tunable) { Consume(tunable, 10, 2, 0); }
+
+TEST(ModelTest, StarvedKnobDoublesUpToItsMax) {
+  Model model(16, kNeverMs);
+  auto knob = model.AddTunable("map", Tunable::Kind::kParallelism, 1, 6);
+  EXPECT_EQ(1, knob->value());
+  for (int64 expected : {2, 4, 6, 6}) {
+    Starve(knob.get());
+    model.Optimize();
+    EXPECT_EQ(expected, knob->value());
+  }
+}
+
+TEST(ModelTest, KnobIsUnchangedUnlessStarved) {
+  Model model(16, kNeverMs);
+  auto idle = model.AddTunable("idle", Tunable::Kind::kParallelism, 1, 8);
+  auto fed = model.AddTunable("fed", Tunable::Kind::kParallelism, 1, 8);
+  // One wait in ten elements is not starved.
+  auto waited = model.AddTunable("waited", Tunable::Kind::kParallelism, 1, 8);
+  Saturate(fed.get());
+  Consume(waited.get(), 10, 0, 1);
+  model.Optimize();
+  EXPECT_EQ(1, idle->value());
+  EXPECT_EQ(1, fed->value());
+  EXPECT_EQ(1, waited->value());
+}
+
+TEST(ModelTest, ParallelismStaysWithinCpuBudget) {
+  Model model(4, kNeverMs);
+  auto map = model.AddTunable("map", Tunable::Kind::kParallelism, 1, 16);
+  auto other = model.AddTunable("other", Tunable::Kind::kParallelism, 1, 16);
+  // The other knob holds one thread, so the starved one gets the remaining
+  // three: 1 -> 2 -> 3, and not 4.
+  for (int64 expected : {2, 3, 3}) {
+    Starve(map.get());
+    model.Optimize();
+    EXPECT_EQ(expected, map->value());
+    EXPECT_EQ(1, other->value());
+  }
+}
+
+TEST(ModelTest, SaturatedKnobDonatesToStarvedKnob) {
+  Model model(4, kNeverMs);
+  auto donor = model.AddTunable("donor", Tunable::Kind::kParallelism, 1, 16);
+  auto map = model.AddTunable("map", Tunable::Kind::kParallelism, 1, 16);
+  Starve(donor.get());
+  model.Optimize();
+  Starve(donor.get());
+  model.Optimize();
+  ASSERT_EQ(3, donor->value());
+  ASSERT_EQ(1, map->value());
+
+  // The budget is spent, so the starved knob takes one thread per step from
+  // the saturated one, until the donor is at its min.
+  Saturate(donor.get());
+  Starve(map.get());
+  model.Optimize();
+  EXPECT_EQ(2, donor->value());
+  EXPECT_EQ(2, map->value());
+
+  Saturate(donor.get());
+  Starve(map.get());
+  model.Optimize();
+  EXPECT_EQ(1, donor->value());
+  EXPECT_EQ(3, map->value());
+
+  Saturate(donor.get());
+  Starve(map.get());
+  model.Optimize();
+  EXPECT_EQ(1, donor->value());
+  EXPECT_EQ(3, map->value());
+}
+
+TEST(ModelTest, KnobWithoutReadyElementsDoesNotDonate) {
+  Model model(3, kNeverMs);
+  auto other = model.AddTunable("other", Tunable::Kind::kParallelism, 1, 16);
+  auto map = model.AddTunable("map", Tunable::Kind::kParallelism, 1, 16);
+  Starve(other.get());
+  model.Optimize();
+  ASSERT_EQ(2, other->value());
+
+  // The consumer of `other` never waited, but found less than one element
+  // ready on average, so it would starve with fewer threads.
+  Consume(other.get(), 10, 0, 0);
+  Starve(map.get());
+  model.Optimize();
+  EXPECT_EQ(2, other->value());
+  EXPECT_EQ(1, map->value());
+}
+
+TEST(ModelTest, MostStarvedKnobGrowsFirst) {
+  Model model(3, kNeverMs);
+  auto less = model.AddTunable("less", Tunable::Kind::kParallelism, 1, 16);
+  auto more = model.AddTunable("more", Tunable::Kind::kParallelism, 1, 16);
+  // Both are starved, but only one thread is left in the budget.
+  Consume(less.get(), 10, 0, 5);
+  Consume(more.get(), 10, 0, 9);
+  model.Optimize();
+  EXPECT_EQ(1, less->value());
+  EXPECT_EQ(2, more->value());
+}
+
+TEST(ModelTest, BufferSizeIsNotLimitedByCpuBudget) {
+  Model model(1, kNeverMs);
+  auto map = model.AddTunable("map", Tunable::Kind::kParallelism, 1, 16);
+  auto buffer = model.AddTunable("buffer", Tunable::Kind::kBufferSize, 1, 16);
+  Starve(map.get());
+  Starve(buffer.get());
+  model.Optimize();
+  EXPECT_EQ(1, map->value());
+  EXPECT_EQ(2, buffer->value());
+}
+
+TEST(ModelTest, BufferSizeNeverExceedsAutoTuneLimit) {
+  Model model(1, kNeverMs);
+  auto buffer = model.AddTunable("buffer", Tunable::Kind::kBufferSize, 1,
+                                 kMaxAutoTuneBufferSize);
+  for (int i = 0; i < 20; ++i) {
+    Starve(buffer.get());
+    model.Optimize();
+    EXPECT_LE(buffer->value(), kMaxAutoTuneBufferSize);
+  }
+  EXPECT_EQ(kMaxAutoTuneBufferSize, buffer->value());
+}
+
+TEST(ModelTest, MaxBelowMinIsMin) {
+  Model model(16, kNeverMs);
+  auto knob = model.AddTunable("map", Tunable::Kind::kParallelism, 4, 2);
+  EXPECT_EQ(4, knob->max());
+  Starve(knob.get());
+  model.Optimize();
+  EXPECT_EQ(4, knob->value());
+}
+
+TEST(ModelTest, DestroyedKnobReleasesItsThreads) {
+  Model model(4, kNeverMs);
+  auto old_map = model.AddTunable("old", Tunable::Kind::kParallelism, 1, 16);
+  auto map = model.AddTunable("map", Tunable::Kind::kParallelism, 1, 16);
+  Starve(old_map.get());
+  model.Optimize();
+  Starve(old_map.get());
+  model.Optimize();
+  ASSERT_EQ(3, old_map->value());
+
+  old_map.reset();
+  Starve(map.get());
+  model.Optimize();
+  EXPECT_EQ(2, map->value());
+  Starve(map.get());
+  model.Optimize();
+  EXPECT_EQ(4, map->value());
+}
+
+}  // namespace
+}  // namespace model
+}  // namespace tensorflow
@@ -20,7 +20,8 @@ limitations under the License.
 #include "tensorflow/core/kernels/data/captured_function.h"
 #include "tensorflow/core/kernels/data/dataset.h"
 #include "tensorflow/core/kernels/data/dataset_utils.h"
-#include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/kernels/data/iterator_scheduler.h"
+#include "tensorflow/core/kernels/data/model.h"
 #include "tensorflow/core/lib/random/random.h"
 
 namespace tensorflow {
@@ -69,8 +70,11 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
     OP_REQUIRES_OK(ctx, ParseScalarArgument(ctx, "buffer_output_elements",
                                             &buffer_output_elements));
     OP_REQUIRES(
-        ctx, buffer_output_elements > 0,
-        errors::InvalidArgument("`buffer_output_elements` must be > 0"));
+        ctx,
+        buffer_output_elements > 0 ||
+            buffer_output_elements == model::kAutoTune,
+        errors::InvalidArgument("`buffer_output_elements` must be > 0, or ",
+                                model::kAutoTune, " to tune it at runtime"));
 
     int64 prefetch_input_elements = 0;
     OP_REQUIRES_OK(ctx, ParseScalarArgument(ctx, "prefetch_input_elements",
@@ -129,7 +133,7 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
     }
 
    private:
-    int64 num_threads() const {
+    int64 num_workers() const {
       return cycle_length_ + prefetch_input_elements_;
     }
 
@@ -137,7 +141,9 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
     //  1. Thread creation is relatively expensive. (Not reusing
     //     threads causes a number of indirect costs such as poorer tcmalloc
     //     performance due to thread-local caches, etc.) We allocate a fixed
-    //     number of threads at the start and never change. This is why we've
+    //     number of workers at the start and never change, and run them on
+    //     the global `IteratorScheduler`, with one reserved thread per
+    //     worker. This is why we've
     //     fused functionality that is theoretically orthogonal (i.e.
     //     .prefetch()) into the implementation.
     //  2. Drop-in replacement for standard interleave. The goal will be to
@@ -147,26 +153,28 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
     //     flag, etc.)
     //  3. Performance across a variety of environments and I/O envelopes.
     //
-    // The actual implementation centers around a collection of worker threads
-    // and their corresponding worker state (tracked in the `workers_` vector).
-    // Worker threads repeatedly receive a vector of Tensors that are used as
-    // input to the flat-map function (`captured_func_`). The output of this
-    // function must be a dataset. The worker thread then repeatedly calls
-    // `GetNext()`, maintaining a buffer of elements to minimize the likelihood
-    // that a caller will block waiting for an element to be produced.
+    // The actual implementation centers around a collection of workers and
+    // their corresponding worker state (tracked in the `workers_` vector).
+    // Workers repeatedly receive a vector of Tensors that are used as input to
+    // the flat-map function (`captured_func_`). The output of this function
+    // must be a dataset. The worker then repeatedly calls `GetNext()`,
+    // maintaining a buffer of elements to minimize the likelihood that a
+    // caller will block waiting for an element to be produced. Each call is a
+    // separate task on the scheduler, which is queued only while the buffer
+    // of the worker has room.
     //
     // Pointers to these worker states are kept in 2 disjoint data structures:
     //  1. `interleave_` is a vector containing pointers to `WorkerState`s that
     //  we
-    //     are interleaving. Worker threads backing these WorkerStates should
-    //     be regularly producing values.
+    //     are interleaving. Workers backing these WorkerStates should be
+    //     regularly producing values.
     //  2. `staging_` is a deque containing pointers to WorkerStates that we
     //     will move to `interleave_` when an iterator in `interleave_` is
     //     exhausted.
     //
     // The client calls `GetNext[Internal]()` to retrieve an output element. The
     // internal implementation updates the state of `interleave_` and `staging_`
-    // as output iterators (run by the worker threads) are exhausted.
+    // as output iterators (run by the workers) are exhausted.
     //
     // `input_impl_` is the input iterator that generates arguments for the
     // flat-map function (`captured_func_`). It is set to an iterator at
@@ -186,15 +194,20 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
       explicit Iterator(const Params& params)
           : DatasetIterator<Dataset>(params),
             input_impl_(params.dataset->input_->MakeIterator(params.prefix)),
-            workers_(dataset()->num_threads()) {}
+            workers_(dataset()->num_workers()) {}
 
       ~Iterator() override {
-        mutex_lock l(mu_);
-        cancelled_ = true;
-        // Notify all workers in case they are blocked.
-        for (auto& worker : workers_) {
-          worker.cond_var.notify_all();
+        {
+          mutex_lock l(mu_);
+          cancelled_ = true;
+          // Notify all callers in case they are blocked.
+          for (auto& worker : workers_) {
+            worker.cond_var.notify_all();
+          }
+          sloppy_cond_var_.notify_all();
         }
+        // Drop the pending tasks of the workers and wait for the running ones.
+        scheduler_client_.reset();
       }
 
       // It is implemented so that it matches the deterministic interleave
@@ -203,8 +216,102 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
       Status GetNextInternal(IteratorContext* ctx,
                              std::vector<Tensor>* out_tensors,
                              bool* end_of_sequence) override {
-        mutex_lock l(mu_);
-        TF_RETURN_IF_ERROR(EnsureWorkerThreadsStarted(ctx));
+        bool waited = false;
+        while (true) {
+          // The worker whose next element we produce inline, after
+          // releasing `mu_`.
+          WorkerState* claimed_worker = nullptr;
+          {
+            mutex_lock l(mu_);
+            TF_RETURN_IF_ERROR(GetNextLocked(ctx, out_tensors, end_of_sequence,
+                                             &l, &waited, &claimed_worker));
+            if (!claimed_worker) return Status::OK();
+          }
+          RunWorker(ctx, claimed_worker);
+        }
+      }
+
+     private:
+      // The state of the task that produces the next element of a worker.
+      enum class ProducerState {
+        // Nothing is scheduled, because the buffer of the worker is full or it
+        // has no input.
+        kIdle,
+        // A task is queued on the scheduler.
+        kPending,
+        // A task of the scheduler or a GetNext call is producing an element.
+        kRunning,
+      };
+
+      // OutputElem contains the information from a call to GetNext by an output
+      // iterator.
+      struct OutputElem {
+        // The output iterator sets `status` if getting the output element
+        // fails.
+        Status status;
+        // The buffered data element.
+        std::vector<Tensor> output;
+
+        explicit OutputElem(const Status& s) : status(s) {}
+      };
+
+      // Workers operate on their relevant WorkerState structs.
+      //
+      // WorkerState's fields are all protected by mu_;
+      struct WorkerState {
+        // The arguments to be used to construct an output iterator.
+        std::vector<Tensor> input;
+        // The output iterator, once it has been constructed from `input`.
+        // Whoever runs the worker takes it out of here while it does so.
+        std::unique_ptr<IteratorBase> iterator;
+        // The buffered output elements.
+        std::deque<OutputElem> outputs;
+        // Set to true iff the worker expects to append more elements to
+        // outputs. is_producing can be false despite !outputs.empty().
+        // Concretely, all output elements will have been consumed only when:
+        // is_producing == false && outputs.empty();
+        bool is_producing = false;
+        ProducerState state = ProducerState::kIdle;
+        // Incremented whenever a task is queued or its work is claimed, so
+        // that a task that is no longer current does nothing.
+        int64 generation = 0;
+        // Condition variable used to coordinate between threads. The main
+        // thread waits on cond_var if it is waiting for the worker to produce
+        // an element into `outputs` (this implies sloppy_==false).
+        condition_variable cond_var;
+
+        inline bool MayHaveElements() const {
+          return is_producing || !outputs.empty();
+        }
+
+        // Sets inputs for a worker.
+        void SetInputs(const Status& s, std::vector<Tensor> input_arguments) {
+          if (s.ok()) {
+            DCHECK(!MayHaveElements())
+                << "Tried to start inputs, despite already producing!";
+            input = std::move(input_arguments);
+            is_producing = true;
+          } else {
+            outputs.emplace_back(s);
+          }
+        }
+      };
+
+      // Either returns the next element, or sets `*claimed_worker` to a worker
+      // whose next element the caller must produce before trying again.
+      Status GetNextLocked(IteratorContext* ctx,
+                           std::vector<Tensor>* out_tensors,
+                           bool* end_of_sequence, mutex_lock* l, bool* waited,
+                           WorkerState** claimed_worker)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (dataset()->buffer_output_elements_ == model::kAutoTune &&
+            !buffer_output_elements_ && ctx->model()) {
+          buffer_output_elements_ = ctx->model()->AddTunable(
+              strings::StrCat(prefix(), "::buffer_output_elements"),
+              model::Tunable::Kind::kBufferSize, 1,
+              model::kMaxAutoTuneBufferSize);
+        }
+        TF_RETURN_IF_ERROR(EnsureWorkersStarted(ctx));
         while (!cancelled_) {
           // Wait for an item to become available, blocking if necessary. If we
           // are allowed to be sloppy, we can skip over input datasets that do
@@ -229,10 +336,14 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
                 block_count_ = 0;
               }
               *end_of_sequence = false;
+              if (buffer_output_elements_) {
+                buffer_output_elements_->RecordConsumed(
+                    current_worker->outputs.size(), waited);
+              }
               Status s = current_worker->outputs.front().status;
               current_worker->outputs.front().output.swap(*out_tensors);
               current_worker->outputs.pop_front();
-              current_worker->cond_var.notify_one();
+              MaybeScheduleWorkerLocked(current_worker);
               return s;
             } else if (current_worker->is_producing && !dataset()->sloppy_) {
               // current_worker.outputs.empty(), and we must wait for this
@@ -255,6 +366,7 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
                   input_impl_.reset();
                 } else {
                   current_worker->SetInputs(s, std::move(args));
+                  MaybeScheduleWorkerLocked(current_worker);
                   staging_.emplace_back(current_worker);
                 }
               }
@@ -281,11 +393,41 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
           }
 
           if (must_wait_for_input) {
-            // Wait for elements to become available.
+            *waited = true;
+            // If the element we need is produced by a worker that is idle or
+            // queued, claim its work (leaving any queued task stale) and
+            // produce the element ourselves, rather than wait for a thread of
+            // the scheduler.
+            WorkerState* worker = nullptr;
             if (dataset()->sloppy_) {
-              sloppy_cond_var_.wait(l);
+              // Any worker may produce the next element. The queued tasks
+              // start on the reserved threads of the workers right away, so
+              // only claim an idle worker: claiming a queued task would hold
+              // up this call on one worker while the others have elements
+              // ready.
+              for (WorkerState* candidate : interleave_) {
+                if (candidate && candidate->is_producing &&
+                    candidate->state == ProducerState::kIdle) {
+                  worker = candidate;
+                  break;
+                }
+              }
+            } else if (interleave_[next_index_]->state !=
+                       ProducerState::kRunning) {
+              worker = interleave_[next_index_];
+            }
+            if (worker) {
+              worker->state = ProducerState::kRunning;
+              ++worker->generation;
+              *claimed_worker = worker;
+              return Status::OK();
+            }
+            // Otherwise wait for elements to become available. Every worker
+            // notifies when its task finishes.
+            if (dataset()->sloppy_) {
+              sloppy_cond_var_.wait(*l);
             } else {
-              interleave_[next_index_]->cond_var.wait(l);
+              interleave_[next_index_]->cond_var.wait(*l);
             }
           }
         }
@@ -293,63 +435,16 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
             "ParallelInterleaveDatasetOp::Dataset::Iterator::GetNext");
       }
 
-     private:
-      // OutputElem contains the information from a call to GetNext by an output
-      // iterator.
-      struct OutputElem {
-        // The output iterator sets `status` if getting the output element
-        // fails.
-        Status status;
-        // The buffered data element.
-        std::vector<Tensor> output;
-
-        explicit OutputElem(const Status& s) : status(s) {}
-      };
-
-      // Worker threads operate on their relevant WorkerState structs.
-      //
-      // WorkerState's fields are all protected by mu_;
-      struct WorkerState {
-        // The arguments to be used to construct an output iterator.
-        std::vector<Tensor> input;
-        // The buffered output elements.
-        std::deque<OutputElem> outputs;
-        // Set to true iff the worker thread expects to append more elements to
-        // outputs. is_producing can be false despite !outputs.empty().
-        // Concretely, all output elements will have been consumed only when:
-        // is_producing == false && outputs.empty();
-        bool is_producing = false;
-        // Condition variable used to coordinate between threads. The worker
-        // thread waits on this condition variable when it is either (1) waiting
-        // for the main thread to add arguments to `input`, or (2) waiting for
-        // the main thread to consume an element of `outputs`. The main thread
-        // waits on cond_var if it is waiting for the worker thread to produce
-        // an element into `outputs` (this implies sloppy_==false).
-        condition_variable cond_var;
-
-        inline bool MayHaveElements() const {
-          return is_producing || !outputs.empty();
-        }
-
-        // Sets inputs for a worker thread and notifies it to start processing.
-        void SetInputs(const Status& s, std::vector<Tensor> input_arguments) {
-          if (s.ok()) {
-            DCHECK(!MayHaveElements())
-                << "Tried to start inputs, despite already producing!";
-            input = std::move(input_arguments);
-            is_producing = true;
-            cond_var.notify_one();
-          } else {
-            outputs.emplace_back(s);
-          }
-        }
-      };
-
-      Status EnsureWorkerThreadsStarted(IteratorContext* ctx)
+      Status EnsureWorkersStarted(IteratorContext* ctx)
           EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-        if (worker_threads_.empty()) {
-          worker_threads_.reserve(dataset()->num_threads());
-          for (int64 i = 0; i < dataset()->num_threads(); ++i) {
+        if (!ctx_) {
+          // A copy of the context for the tasks of the workers.
+          ctx_.reset(new IteratorContext(*ctx));
+          // Each worker has at most one task at a time, which may block on
+          // I/O, so the workers reserve a thread each.
+          scheduler_client_ = IteratorScheduler::Global()->NewClient(
+              IteratorPriority(prefix()), dataset()->num_workers());
+          for (int64 i = 0; i < dataset()->num_workers(); ++i) {
             std::vector<Tensor> args;
             bool end_of_input = false;
             Status s = input_impl_->GetNext(ctx, &args, &end_of_input);
@@ -358,10 +453,7 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
               return Status::OK();
             }
             workers_[i].SetInputs(s, std::move(args));
-            worker_threads_.emplace_back(ctx->env()->StartThread(
-                {}, "worker_thread",
-                std::bind(&Iterator::WorkerThread, this,
-                          new IteratorContext(*ctx), i)));
+            MaybeScheduleWorkerLocked(&workers_[i]);
             if (i < dataset()->cycle_length_) {
               interleave_.push_back(&workers_[i]);
             } else {
@@ -374,75 +466,95 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
         return Status::OK();
       }
 
-      // Produces elements into the worker's output buffers.
-      void WorkerThread(IteratorContext* ctx_ptr, const int64 thread_index) {
-        // std::function arguments are copy-constructable, so we pass raw
-        // pointers, and then immediately wrap them to ensure correct ownership.
-        std::unique_ptr<IteratorContext> ctx(ctx_ptr);
-        auto cleanup = gtl::MakeCleanup([this, thread_index] {
-          mutex_lock l(mu_);
-          workers_[thread_index].cond_var.notify_all();
-        });
-
-        while (true) {
-          // 1. Wait for input.
-          std::vector<Tensor> input;
+      // Queues a task to produce the next element of `worker`, if it has
+      // input, there is room in its buffer, and nothing is queued or running
+      // for it yet.
+      void MaybeScheduleWorkerLocked(WorkerState* worker)
+          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (worker->state != ProducerState::kIdle || !worker->is_producing ||
+            cancelled_ ||
+            worker->outputs.size() >= BufferOutputElementsLocked()) {
+          return;
+        }
+        worker->state = ProducerState::kPending;
+        const int64 generation = ++worker->generation;
+        scheduler_client_->Schedule([this, worker, generation]() {
+          IteratorContext* ctx;
           {
             mutex_lock l(mu_);
-            while (!cancelled_ && !workers_[thread_index].is_producing) {
-              workers_[thread_index].cond_var.wait(l);
+            if (cancelled_ || worker->state != ProducerState::kPending ||
+                worker->generation != generation) {
+              return;
             }
-            if (cancelled_) return;
-            input.swap(workers_[thread_index].input);
+            worker->state = ProducerState::kRunning;
+            ctx = ctx_.get();
           }
+          RunWorker(ctx, worker);
+        });
+      }
 
-          // 2. Run the user defined function to produce a new iterator.
-          std::unique_ptr<IteratorBase> iterator;
-          Status s = dataset::MakeIteratorFromInputElement(
-              ctx.get(), input, thread_index, dataset()->captured_func_.get(),
-              prefix(), &iterator);
+      // Produces the next element of `worker` into its output buffer, first
+      // constructing its output iterator if needed. The caller must have set
+      // the state of `worker` to `kRunning`.
+      void RunWorker(IteratorContext* ctx, WorkerState* worker) {
+        std::vector<Tensor> input;
+        std::unique_ptr<IteratorBase> iterator;
+        int64 worker_index;
+        {
+          mutex_lock l(mu_);
+          input.swap(worker->input);
+          iterator.swap(worker->iterator);
+          worker_index = worker - workers_.data();
+        }
+
+        // 1. Run the user defined function to produce a new iterator.
+        Status s;
+        if (!iterator) {
+          s = dataset::MakeIteratorFromInputElement(
+              ctx, input, worker_index,
+              dataset()->captured_func_.get(), prefix(), &iterator);
           input.clear();  // Release memory as early as possible.
+        }
 
-          if (!s.ok()) {
-            mutex_lock l(mu_);
-            workers_[thread_index].outputs.emplace_back(s);
-            workers_[thread_index].is_producing = false;
-            workers_[thread_index].cond_var.notify_one();
-          } else {
-            // 3. Produce elements
-            bool end_of_sequence = false;
-            while (!end_of_sequence) {
-              // 3.a Produce an element!
-              std::vector<Tensor> output_elem;
-              s = iterator->GetNext(ctx.get(), &output_elem, &end_of_sequence);
-
-              // 3.b Make it available to the client.
-              {
-                mutex_lock l(mu_);
-
-                // Wait for space in the prefetch queue.
-                while (!cancelled_ && workers_[thread_index].outputs.size() ==
-                                          dataset()->buffer_output_elements_) {
-                  workers_[thread_index].cond_var.wait(l);
-                }
-                if (cancelled_) return;
-
-                // Output the element.
-                workers_[thread_index].is_producing = !end_of_sequence;
-                if (!end_of_sequence) {
-                  workers_[thread_index].outputs.emplace_back(s);
-                  workers_[thread_index].outputs.back().output.swap(
-                      output_elem);
-                }
-                if (dataset()->sloppy_) {
-                  sloppy_cond_var_.notify_one();
-                } else {
-                  workers_[thread_index].cond_var.notify_one();
-                }
-              }
-            }
+        // 2. Produce an element!
+        const bool iterator_failed = !s.ok();
+        bool end_of_sequence = false;
+        std::vector<Tensor> output_elem;
+        if (!iterator_failed) {
+          s = iterator->GetNext(ctx, &output_elem, &end_of_sequence);
+        }
+
+        // 3. Make it available to the client.
+        mutex_lock l(mu_);
+        if (iterator_failed) {
+          worker->outputs.emplace_back(s);
+          worker->is_producing = false;
+        } else if (end_of_sequence) {
+          worker->is_producing = false;
+        } else {
+          worker->outputs.emplace_back(s);
+          worker->outputs.back().output.swap(output_elem);
+          worker->iterator.swap(iterator);
+          if (buffer_output_elements_) {
+            buffer_output_elements_->RecordProduced();
           }
         }
+        worker->state = ProducerState::kIdle;
+        MaybeScheduleWorkerLocked(worker);
+        if (dataset()->sloppy_) {
+          sloppy_cond_var_.notify_one();
+        } else {
+          worker->cond_var.notify_one();
+        }
+      }
+
+      // Returns the number of elements each worker may buffer. A tuned
+      // `buffer_output_elements` starts at one element, which is also the
+      // value used when the iterator has no model to tune it.
+      size_t BufferOutputElementsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (buffer_output_elements_) return buffer_output_elements_->value();
+        if (dataset()->buffer_output_elements_ == model::kAutoTune) return 1;
+        return dataset()->buffer_output_elements_;
       }
 
       // Mutex & condition variable to guard mutable iterator internals and
@@ -457,7 +569,7 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
       // input_impl_ is reset when we have exhausted its input.
       std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
 
-      // The WorkerState structs the worker threads operate on.
+      // The WorkerState structs the workers operate on.
       // workers_ elements are in at most one of interleave_ and staging_.
       std::vector<WorkerState> workers_ GUARDED_BY(mu_);
 
@@ -470,12 +582,17 @@ class ParallelInterleaveDatasetOp : public UnaryDatasetOpKernel {
       size_t next_index_ GUARDED_BY(mu_) = 0;
       // The number of items produced so far within the block
       size_t block_count_ GUARDED_BY(mu_) = 0;
-      // Flag to instruct the worker threads to exit.
+      // Flag to instruct the workers to stop.
       bool cancelled_ GUARDED_BY(mu_) = false;
-      // The worker threads. This must be last to ensure the
-      // threads have exited before any other members are deallocated.
-      // TODO(b/65178177): Avoid allocating additional threads.
-      std::vector<std::unique_ptr<Thread>> worker_threads_ GUARDED_BY(mu_);
+      // A copy of the context of the first GetNext call, for the tasks of the
+      // workers.
+      std::unique_ptr<IteratorContext> ctx_ GUARDED_BY(mu_);
+      // Set when `buffer_output_elements` is tuned by the model.
+      std::shared_ptr<model::Tunable> buffer_output_elements_ GUARDED_BY(mu_);
+      // Runs the tasks of the workers. Set with `ctx_`. This must be last to
+      // ensure the tasks have finished before any other members are
+      // deallocated.
+      std::unique_ptr<IteratorScheduler::Client> scheduler_client_;
     };
 
     const DatasetBase* const input_;
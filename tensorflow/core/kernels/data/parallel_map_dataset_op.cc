@@ -19,13 +19,22 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/captured_function.h"
 #include "tensorflow/core/kernels/data/dataset.h"
+#include "tensorflow/core/kernels/data/model.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
 #include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/platform/cpu_info.h"
 
 namespace tensorflow {
 
 namespace {
 
+// In sloppy mode, the iterator keeps this many results per parallel call,
+// and returns an element at most `kSloppyWindowFactor * num_parallel_calls - 1`
+// positions ahead of its place in the input order. When `num_parallel_calls`
+// is tuned, the window is sized for `port::NumSchedulableCPUs()` calls, the
+// most it can be tuned to, so the bound uses that instead of the tuned value.
+const int64 kSloppyWindowFactor = 2;
+
 // See documentation in ../ops/dataset_ops.cc for a high-level
 // description of the following op.
 
@@ -37,6 +46,7 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("f", &func_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("output_types", &output_types_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("output_shapes", &output_shapes_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("sloppy", &sloppy_));
   }
 
  protected:
@@ -53,23 +63,26 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
     int32 num_parallel_calls;
     OP_REQUIRES_OK(ctx, ParseScalarArgument(ctx, "num_parallel_calls",
                                             &num_parallel_calls));
-    OP_REQUIRES(ctx, num_parallel_calls > 0,
+    OP_REQUIRES(ctx, num_parallel_calls > 0 ||
+                         num_parallel_calls == model::kAutoTune,
                 errors::InvalidArgument(
-                    "num_parallel_calls must be greater than zero."));
+                    "num_parallel_calls must be greater than zero, or ",
+                    model::kAutoTune, " to tune it at runtime."));
 
     std::unique_ptr<CapturedFunction> captured_func;
     OP_REQUIRES_OK(ctx, CapturedFunction::Create(
                             func_, std::move(other_arguments), &captured_func));
 
-    *output = new Dataset(ctx, input, func_, num_parallel_calls, output_types_,
-                          output_shapes_, std::move(captured_func));
+    *output = new Dataset(ctx, input, func_, num_parallel_calls, sloppy_,
+                          output_types_, output_shapes_,
+                          std::move(captured_func));
   }
 
  private:
   class Dataset : public GraphDatasetBase {
    public:
     Dataset(OpKernelContext* ctx, const DatasetBase* input,
-            const NameAttrList& func, int32 num_parallel_calls,
+            const NameAttrList& func, int32 num_parallel_calls, bool sloppy,
             const DataTypeVector& output_types,
             const std::vector<PartialTensorShape>& output_shapes,
             std::unique_ptr<CapturedFunction> captured_func)
@@ -77,6 +90,7 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
           input_(input),
           func_(func),
           num_parallel_calls_(num_parallel_calls),
+          sloppy_(sloppy),
           output_types_(output_types),
           output_shapes_(output_shapes),
           captured_func_(std::move(captured_func)) {
@@ -134,13 +148,18 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
       AttrValue other_arguments_types_attr;
       b->BuildAttrValue(other_arguments_types, &other_arguments_types_attr);
 
+      // Attr: sloppy
+      AttrValue sloppy;
+      b->BuildAttrValue(sloppy_, &sloppy);
+
       TF_RETURN_IF_ERROR(b->AddDataset(
           this,
           {std::make_pair(0, input_graph_node),
            std::make_pair(2, num_parallel_calls)},  // Single tensor inputs.
           {std::make_pair(1, other_arguments)},     // Tensor list inputs.
           {std::make_pair("f", f),
-           std::make_pair("Targuments", other_arguments_types_attr)},  // Attrs
+           std::make_pair("Targuments", other_arguments_types_attr),
+           std::make_pair("sloppy", sloppy)},  // Attrs
           output));
       return Status::OK();
     }
@@ -151,7 +170,8 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
       explicit Iterator(const Params& params)
           : DatasetIterator<Dataset>(params),
             input_impl_(params.dataset->input_->MakeIterator(params.prefix)),
-            invocation_results_(params.dataset->num_parallel_calls_) {}
+            invocation_results_(NumSlots(params.dataset)),
+            call_signal_(std::make_shared<CallSignal>()) {}
 
       ~Iterator() override {
         // TODO(mrry): Replace this cancellation logic with a
@@ -161,7 +181,7 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
         // potentially-blocking iterators, when we add these.
         {
           mutex_lock l(mu_);
-          for (size_t i = 0; i < dataset()->num_parallel_calls_; ++i) {
+          for (size_t i = 0; i < invocation_results_.size(); ++i) {
             if (invocation_results_[i].notification) {
               invocation_results_[i].notification->WaitForNotification();
             }
@@ -173,11 +193,43 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
                              std::vector<Tensor>* out_tensors,
                              bool* end_of_sequence) override {
         mutex_lock l(mu_);
+        if (dataset()->num_parallel_calls_ == model::kAutoTune &&
+            !num_parallel_calls_ && ctx->model()) {
+          num_parallel_calls_ = ctx->model()->AddTunable(
+              strings::StrCat(prefix(), "::num_parallel_calls"),
+              model::Tunable::Kind::kParallelism, 1, MaxParallelCallsLocked());
+        }
+        const int64 num_parallel_calls =
+            num_parallel_calls_
+                ? std::min<int64>(num_parallel_calls_->value(),
+                                  MaxParallelCallsLocked())
+                : MaxParallelCallsLocked();
+        if (num_parallel_calls_) {
+          // Report how many of the outstanding calls are done, and whether
+          // this call has to wait for one.
+          int64 num_ready = 0;
+          bool next_ready = false;
+          for (int64 i = num_outputs_consumed_; i < num_inputs_consumed_; ++i) {
+            const InvocationResult& result =
+                invocation_results_[i % invocation_results_.size()];
+            if (!result.consumed && IsReady(result)) {
+              ++num_ready;
+              if (i == num_outputs_consumed_) next_ready = true;
+            }
+          }
+          num_parallel_calls_->RecordConsumed(
+              num_ready, dataset()->sloppy_ ? num_ready == 0 : !next_ready);
+        }
 
-        // Ensure that there are `dataset()->num_parallel_calls_`
-        // invocations of `func_` outstanding at once.
-        while (input_impl_ && (num_inputs_consumed_ - num_outputs_consumed_ <
-                               dataset()->num_parallel_calls_)) {
+        // Ensure that there are `num_parallel_calls` invocations of `func_`
+        // outstanding at once, without starting one more than a window of
+        // `invocation_results_.size()` elements ahead of the oldest element
+        // that has not been returned.
+        while (input_impl_ &&
+               num_inputs_consumed_ - num_outputs_consumed_ <
+                   invocation_results_.size() &&
+               (num_inputs_consumed_ - num_outputs_consumed_ -
+                num_consumed_ahead_) < num_parallel_calls) {
           InvokeFunctionLocked(ctx);
         }
 
@@ -187,10 +239,17 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
         }
 
         // Read the next result out of `invocation_results_`, which
-        // acts as a circular buffer.
-        const size_t result_index =
-            num_outputs_consumed_ % dataset()->num_parallel_calls_;
-        InvocationResult* result = &invocation_results_[result_index];
+        // acts as a circular buffer. In sloppy mode, this is the oldest
+        // result that is ready, waiting for the first one if none is.
+        int64 result_element = num_outputs_consumed_;
+        if (dataset()->sloppy_) {
+          mutex_lock signal_lock(call_signal_->mu);
+          while ((result_element = NextReadyElementLocked()) < 0) {
+            call_signal_->cond_var.wait(signal_lock);
+          }
+        }
+        InvocationResult* result =
+            &invocation_results_[result_element % invocation_results_.size()];
         *end_of_sequence = false;
         if (result->notification) {
           result->notification->WaitForNotification();
@@ -198,7 +257,22 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
             std::swap(*out_tensors, result->return_values);
           }
         }
-        ++num_outputs_consumed_;
+        if (result_element == num_outputs_consumed_) {
+          ++num_outputs_consumed_;
+          // Skip the elements that were returned out of order.
+          while (num_outputs_consumed_ < num_inputs_consumed_) {
+            InvocationResult* next =
+                &invocation_results_[num_outputs_consumed_ %
+                                     invocation_results_.size()];
+            if (!next->consumed) break;
+            next->consumed = false;
+            --num_consumed_ahead_;
+            ++num_outputs_consumed_;
+          }
+        } else {
+          result->consumed = true;
+          ++num_consumed_ahead_;
+        }
         if (errors::IsOutOfRange(result->status)) {
           // `f` may deliberately raise `errors::OutOfRange` to indicate
           // that we should terminate the iteration early.
@@ -222,8 +296,21 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
                                                num_inputs_consumed_));
         TF_RETURN_IF_ERROR(writer->WriteScalar(
             full_name("num_outputs_consumed"), num_outputs_consumed_));
+        if (dataset()->num_parallel_calls_ == model::kAutoTune) {
+          // The number of slots depends on the machine, so restoring on
+          // another one needs it.
+          TF_RETURN_IF_ERROR(
+              writer->WriteScalar(full_name("invocation_results.size"),
+                                  invocation_results_.size()));
+        }
 
-        for (size_t i = 0; i < dataset()->num_parallel_calls_; i++) {
+        for (size_t i = 0; i < invocation_results_.size(); i++) {
+          if (invocation_results_[i].consumed) {
+            TF_RETURN_IF_ERROR(writer->WriteScalar(
+                full_name(
+                    strings::StrCat("invocation_results[", i, "]_consumed")),
+                ""));
+          }
           if (invocation_results_[i].notification) {
             invocation_results_[i].notification->WaitForNotification();
             TF_RETURN_IF_ERROR(
@@ -260,9 +347,27 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
                                               &num_inputs_consumed_));
         TF_RETURN_IF_ERROR(reader->ReadScalar(full_name("num_outputs_consumed"),
                                               &num_outputs_consumed_));
-        for (size_t i = 0; i < dataset()->num_parallel_calls_; i++) {
+        if (reader->Contains(full_name("invocation_results.size"))) {
+          int64 size;
+          TF_RETURN_IF_ERROR(reader->ReadScalar(
+              full_name("invocation_results.size"), &size));
+          if (size <= 0) {
+            return errors::InvalidArgument(
+                full_name("invocation_results.size"), ": ", size,
+                " is not a valid number of parallel calls.");
+          }
+          invocation_results_.clear();
+          invocation_results_.resize(size);
+        }
+        num_consumed_ahead_ = 0;
+        for (size_t i = 0; i < invocation_results_.size(); i++) {
           InvocationResult* result = &invocation_results_[i];
           *result = InvocationResult();
+          if (reader->Contains(full_name(
+                  strings::StrCat("invocation_results[", i, "]_consumed")))) {
+            result->consumed = true;
+            ++num_consumed_ahead_;
+          }
           if (!reader->Contains(full_name(
                   strings::StrCat("invocation_results[", i, "]_empty")))) {
             result->notification.reset(new Notification);
@@ -301,18 +406,48 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
         Status status;
         std::unique_ptr<Notification> notification;
         std::vector<Tensor> return_values;
+        // Set in sloppy mode when the result has been returned before an
+        // older one.
+        bool consumed = false;
       };
 
+      // Signalled whenever an invocation of `func_` finishes in sloppy mode,
+      // so that a caller can wait for whichever finishes first. The callbacks
+      // share ownership, since they may still use it after the iterator has
+      // been destroyed.
+      struct CallSignal {
+        mutex mu;
+        condition_variable cond_var;
+      };
+
+      static bool IsReady(const InvocationResult& result) {
+        return !result.notification || result.notification->HasBeenNotified();
+      }
+
+      // Returns the oldest element in the window that has not been returned
+      // and whose result is ready, or -1 if there is none.
+      int64 NextReadyElementLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        for (int64 i = num_outputs_consumed_; i < num_inputs_consumed_; ++i) {
+          const InvocationResult& result =
+              invocation_results_[i % invocation_results_.size()];
+          if (!result.consumed && IsReady(result)) return i;
+        }
+        return -1;
+      }
+
       void InvokeFunctionLocked(IteratorContext* ctx)
           EXCLUSIVE_LOCKS_REQUIRED(mu_) {
         DCHECK(input_impl_);
         DCHECK(num_inputs_consumed_ - num_outputs_consumed_ <
-               dataset()->num_parallel_calls_);
+               invocation_results_.size());
+        DCHECK(!invocation_results_[num_inputs_consumed_ %
+                                    invocation_results_.size()]
+                    .consumed);
 
         // The result of invoking the function will be written into the next
         // slot in `invocation_results_`, which acts as a circular buffer.
         const size_t result_index =
-            num_inputs_consumed_ % dataset()->num_parallel_calls_;
+            num_inputs_consumed_ % invocation_results_.size();
         InvocationResult* result = &invocation_results_[result_index];
         *result = InvocationResult();
 
@@ -333,11 +468,20 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
           // `result->return_values`, and notify `result->notification`
           // to unblock a consumer.
           result->notification.reset(new Notification);
+          std::shared_ptr<model::Tunable> num_parallel_calls =
+              num_parallel_calls_;
+          std::shared_ptr<CallSignal> call_signal =
+              dataset()->sloppy_ ? call_signal_ : nullptr;
           dataset()->captured_func_->RunAsync(
               ctx, std::move(input_element), &result->return_values,
-              [result, result_index](Status ret_status) {
+              [result, num_parallel_calls, call_signal](Status ret_status) {
                 result->status.Update(ret_status);
+                if (num_parallel_calls) num_parallel_calls->RecordProduced();
                 result->notification->Notify();
+                if (call_signal) {
+                  mutex_lock l(call_signal->mu);
+                  call_signal->cond_var.notify_all();
+                }
               });
         }
       }
@@ -381,16 +525,49 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
             strings::StrCat("invocation_results[", index, "].error_message"));
       }
 
+      // Returns the number of slots in `invocation_results_`. When
+      // `num_parallel_calls` is tuned, it never exceeds the number of
+      // schedulable CPUs, which is also the value used when the iterator
+      // has no model to tune it. In sloppy mode, there are
+      // `kSloppyWindowFactor` slots per call, so that the other calls can
+      // carry on for a while when one is slow.
+      static int64 NumSlots(const Dataset* dataset) {
+        const int64 max_parallel_calls =
+            dataset->num_parallel_calls_ == model::kAutoTune
+                ? port::NumSchedulableCPUs()
+                : dataset->num_parallel_calls_;
+        return dataset->sloppy_ ? kSloppyWindowFactor * max_parallel_calls
+                                : max_parallel_calls;
+      }
+
+      // Returns the largest number of calls that may be outstanding at once.
+      int64 MaxParallelCallsLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (dataset()->sloppy_) {
+          return std::max<int64>(
+              invocation_results_.size() / kSloppyWindowFactor, 1);
+        }
+        return invocation_results_.size();
+      }
+
       mutex mu_;
       std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(mu_);
       std::vector<InvocationResult> invocation_results_ GUARDED_BY(mu_);
+      // Set when `num_parallel_calls` is tuned by the model.
+      std::shared_ptr<model::Tunable> num_parallel_calls_ GUARDED_BY(mu_);
+      // The number of input elements that `func_` has been invoked on.
       int64 num_inputs_consumed_ GUARDED_BY(mu_) = 0;
+      // The number of elements up to which all have been returned.
       int64 num_outputs_consumed_ GUARDED_BY(mu_) = 0;
+      // The number of elements after `num_outputs_consumed_` that have been
+      // returned out of order.
+      int64 num_consumed_ahead_ GUARDED_BY(mu_) = 0;
+      const std::shared_ptr<CallSignal> call_signal_;
     };
 
     const DatasetBase* const input_;
     const NameAttrList func_;
     const int32 num_parallel_calls_;
+    const bool sloppy_;
     const DataTypeVector output_types_;
     const std::vector<PartialTensorShape> output_shapes_;
     const std::unique_ptr<CapturedFunction> captured_func_;
@@ -400,6 +577,7 @@ class ParallelMapDatasetOp : public UnaryDatasetOpKernel {
   DataTypeVector output_types_;
   std::vector<PartialTensorShape> output_shapes_;
   NameAttrList func_;
+  bool sloppy_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("ParallelMapDataset").Device(DEVICE_CPU),
@@ -17,6 +17,8 @@ limitations under the License.
 #include "tensorflow/core/framework/partial_tensor_shape.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/data/dataset.h"
+#include "tensorflow/core/kernels/data/iterator_scheduler.h"
+#include "tensorflow/core/kernels/data/model.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
 
 namespace tensorflow {
@@ -37,8 +39,10 @@ class PrefetchDatasetOp : public UnaryDatasetOpKernel {
     int64 buffer_size;
     OP_REQUIRES_OK(
         ctx, ParseScalarArgument<int64>(ctx, "buffer_size", &buffer_size));
-    OP_REQUIRES(ctx, buffer_size > 0,
-                errors::InvalidArgument("buffer_size must be > 0"));
+    OP_REQUIRES(ctx, buffer_size > 0 || buffer_size == model::kAutoTune,
+                errors::InvalidArgument("buffer_size must be > 0, or ",
+                                        model::kAutoTune,
+                                        " to tune it at runtime"));
 
     *output = new Dataset(ctx, input, buffer_size);
   }
@@ -88,8 +92,8 @@ class PrefetchDatasetOp : public UnaryDatasetOpKernel {
             input_impl_(params.dataset->input_->MakeIterator(params.prefix)) {}
 
       ~Iterator() override {
-        // Signal the prefetch thread to terminate it. We will then
-        // join that thread when we delete `this->prefetch_thread_`.
+        // Signal the producer to stop scheduling itself, then drop its
+        // pending task and wait for a running one to finish.
         //
         // TODO(mrry): Replace this cancellation logic with a
         // CancellationManager. The syntax would be more heavyweight,
@@ -101,48 +105,79 @@ class PrefetchDatasetOp : public UnaryDatasetOpKernel {
           cancelled_ = true;
           cond_var_.notify_all();
         }
+        scheduler_client_.reset();
       }
 
       Status GetNextInternal(IteratorContext* ctx,
                              std::vector<Tensor>* out_tensors,
                              bool* end_of_sequence) override {
-        mutex_lock l(mu_);
-        TF_RETURN_IF_ERROR(EnsurePrefetchThreadStarted(ctx));
-
-        while (true) {
-          // Wait until the next element in the buffer has been
-          // produced, or we are shutting down.
-          while (!cancelled_ && !prefetch_thread_finished_ && buffer_.empty()) {
-            cond_var_.wait(l);
+        bool waited;
+        {
+          mutex_lock l(mu_);
+          if (dataset()->buffer_size_ == model::kAutoTune && !buffer_limit_ &&
+              ctx->model()) {
+            buffer_limit_ = ctx->model()->AddTunable(
+                strings::StrCat(prefix(), "::buffer_size"),
+                model::Tunable::Kind::kBufferSize, 1,
+                model::kMaxAutoTuneBufferSize);
           }
-
-          if (cancelled_) {
-            return errors::Cancelled(
-                "PrefetchDatasetOp::Dataset::Iterator::GetNext");
+          if (!ctx_) {
+            ctx_.reset(new IteratorContext(*ctx));
+            // The producer runs on the shared threads: a GetNext call that
+            // finds its task queued produces the element inline instead.
+            scheduler_client_ = IteratorScheduler::Global()->NewClient(
+                IteratorPriority(prefix()), 0);
           }
+          waited = buffer_.empty();
+        }
 
-          if (!buffer_.empty()) {
-            // A new element is available. Forward the status from
-            // computing it, and (if we successfully got an element)
-            // the output values.
-            Status s = buffer_.front().status;
-            if (s.ok()) {
-              *out_tensors = std::move(buffer_.front().value);
+        while (true) {
+          {
+            mutex_lock l(mu_);
+            while (true) {
+              if (cancelled_) {
+                return errors::Cancelled(
+                    "PrefetchDatasetOp::Dataset::Iterator::GetNext");
+              }
+
+              if (!buffer_.empty()) {
+                // A new element is available. Forward the status from
+                // computing it, and (if we successfully got an element)
+                // the output values.
+                Status s = buffer_.front().status;
+                if (s.ok()) {
+                  *out_tensors = std::move(buffer_.front().value);
+                }
+                if (buffer_limit_) {
+                  buffer_limit_->RecordConsumed(waited ? 0 : buffer_.size(),
+                                                waited);
+                }
+                buffer_.pop_front();
+                *end_of_sequence = false;
+
+                // Refill the slot we just freed, and wake up threads from
+                // other calls to GetNext.
+                MaybeScheduleProducerLocked();
+                cond_var_.notify_all();
+                return s;
+              } else if (prefetch_finished_) {
+                *end_of_sequence = true;
+                return Status::OK();
+              }
+
+              // The buffer is empty. Unless the producer is running on
+              // another thread, claim its work (leaving any queued task
+              // stale) and produce the element ourselves rather than wait
+              // for a thread of the scheduler.
+              if (producer_state_ != ProducerState::kRunning) {
+                producer_state_ = ProducerState::kRunning;
+                ++producer_generation_;
+                break;
+              }
+              cond_var_.wait(l);
             }
-            buffer_.pop_front();
-            *end_of_sequence = false;
-
-            // Wake the prefetch thread, in case it has been waiting
-            // for space in the buffer.
-            // Also wake up threads from other calls to GetNext.
-            // TODO(mrry): Consider using different condition variables
-            // for GetNext and Prefetch.
-            cond_var_.notify_all();
-            return s;
-          } else if (prefetch_thread_finished_) {
-            *end_of_sequence = true;
-            return Status::OK();
           }
+          ProduceElement(ctx);
         }
       }
 
@@ -219,63 +254,80 @@ class PrefetchDatasetOp : public UnaryDatasetOpKernel {
         std::vector<Tensor> value;
       };
 
-      Status EnsurePrefetchThreadStarted(IteratorContext* ctx)
-          EXCLUSIVE_LOCKS_REQUIRED(mu_) {
-        if (!prefetch_thread_) {
-          prefetch_thread_.reset(
-              ctx->env()->StartThread({}, "prefetch_thread",
-                                      std::bind(&Iterator::PrefetchThread, this,
-                                                new IteratorContext(*ctx))));
+      // The state of the producer, which fills the buffer one element at a
+      // time.
+      enum class ProducerState {
+        // Nothing is scheduled, because the buffer is full or the input is
+        // exhausted.
+        kIdle,
+        // A task is queued on the scheduler.
+        kPending,
+        // A task of the scheduler or a GetNext call is producing an element.
+        kRunning,
+      };
+
+      // Queues a task to produce the next element, if there is room for it
+      // in the buffer and nothing is queued or running yet.
+      void MaybeScheduleProducerLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (producer_state_ != ProducerState::kIdle || cancelled_ ||
+            prefetch_finished_ || !ctx_ ||
+            buffer_.size() >= BufferLimitLocked()) {
+          return;
         }
-        return Status::OK();
+        producer_state_ = ProducerState::kPending;
+        const int64 generation = ++producer_generation_;
+        scheduler_client_->Schedule(
+            [this, generation]() { ProducerTask(generation); });
       }
 
-      // Prefetches elements of the input, storing results in an internal
-      // buffer.
-      //
-      // It owns the iterator context passed to it.
-      void PrefetchThread(IteratorContext* ctx) {
-        std::unique_ptr<IteratorContext> cleanup(ctx);
-        while (true) {
-          std::vector<Tensor> value;
-
-          // 1. Wait for a slot in the buffer.
-          {
-            mutex_lock l(mu_);
-            while (!cancelled_ && buffer_.size() == dataset()->buffer_size_) {
-              cond_var_.wait(l);
-            }
-
-            if (cancelled_) {
-              return;
-            }
-          }
-
-          // 2. Read the next element.
-          // Acquire the parent lock since we will be reading an element
-          // from the input iterator. Note that we do not wish to release
-          // this lock till we have added the fetched element to the
-          // `buffer_` else there will be local state that may be missed
-          // by SaveInternal.
-          mutex_lock parent_l(parent_mu_);
-          bool end_of_sequence;
-          BufferElement buffer_element;
-          buffer_element.status = input_impl_->GetNext(
-              ctx, &buffer_element.value, &end_of_sequence);
-          if (buffer_element.status.ok() && end_of_sequence) {
-            mutex_lock l(mu_);
-            prefetch_thread_finished_ = true;
-            cond_var_.notify_all();
+      // Runs on the scheduler. Produces an element unless a GetNext call
+      // has claimed the work of this task in the meantime.
+      void ProducerTask(int64 generation) {
+        IteratorContext* ctx;
+        {
+          mutex_lock l(mu_);
+          if (cancelled_ || producer_state_ != ProducerState::kPending ||
+              producer_generation_ != generation) {
             return;
           }
+          producer_state_ = ProducerState::kRunning;
+          ctx = ctx_.get();
+        }
+        ProduceElement(ctx);
+      }
 
-          // 3. Signal that the element has been produced.
-          {
-            mutex_lock l(mu_);
-            buffer_.push_back(std::move(buffer_element));
-            cond_var_.notify_all();
-          }
+      // Reads the next element of the input into the buffer, and schedules
+      // the production of the following one if there is room for it.
+      void ProduceElement(IteratorContext* ctx) {
+        // Acquire the parent lock since we will be reading an element
+        // from the input iterator. Note that we do not wish to release
+        // this lock till we have added the fetched element to the
+        // `buffer_` else there will be local state that may be missed
+        // by SaveInternal.
+        mutex_lock parent_l(parent_mu_);
+        bool end_of_sequence;
+        BufferElement buffer_element;
+        buffer_element.status = input_impl_->GetNext(
+            ctx, &buffer_element.value, &end_of_sequence);
+        mutex_lock l(mu_);
+        if (buffer_element.status.ok() && end_of_sequence) {
+          prefetch_finished_ = true;
+        } else {
+          buffer_.push_back(std::move(buffer_element));
+          if (buffer_limit_) buffer_limit_->RecordProduced();
         }
+        producer_state_ = ProducerState::kIdle;
+        MaybeScheduleProducerLocked();
+        cond_var_.notify_all();
+      }
+
+      // Returns the number of elements the producer may buffer. A
+      // `buffer_size` that is tuned starts at one element, which is also the
+      // value used when the iterator has no model to tune it.
+      size_t BufferLimitLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (buffer_limit_) return buffer_limit_->value();
+        if (dataset()->buffer_size_ == model::kAutoTune) return 1;
+        return dataset()->buffer_size_;
       }
 
       Status WriteStatus(IteratorStateWriter* writer, size_t index,
@@ -324,9 +376,19 @@ class PrefetchDatasetOp : public UnaryDatasetOpKernel {
       const std::unique_ptr<IteratorBase> input_impl_ GUARDED_BY(parent_mu_);
       condition_variable cond_var_;
       std::deque<BufferElement> buffer_ GUARDED_BY(mu_);
-      std::unique_ptr<Thread> prefetch_thread_ GUARDED_BY(mu_);
+      // Set when `buffer_size` is tuned by the model.
+      std::shared_ptr<model::Tunable> buffer_limit_ GUARDED_BY(mu_);
+      // A copy of the context of the first GetNext call, for the tasks of
+      // the producer.
+      std::unique_ptr<IteratorContext> ctx_ GUARDED_BY(mu_);
+      ProducerState producer_state_ GUARDED_BY(mu_) = ProducerState::kIdle;
+      // Incremented whenever a task is queued or its work is claimed, so that
+      // a task that is no longer current does nothing.
+      int64 producer_generation_ GUARDED_BY(mu_) = 0;
       bool cancelled_ GUARDED_BY(mu_) = false;
-      bool prefetch_thread_finished_ GUARDED_BY(mu_) = false;
+      bool prefetch_finished_ GUARDED_BY(mu_) = false;
+      // Runs the tasks of the producer. Set with `ctx_`.
+      std::unique_ptr<IteratorScheduler::Client> scheduler_client_;
     };
 
     const DatasetBase* const input_;
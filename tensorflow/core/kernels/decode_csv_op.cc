@@ -14,16 +14,84 @@ limitations under the License.
 ==============================================================================*/
 
 // See docs in ../ops/parsing_ops.cc.
+#include <string.h>
+#include <algorithm>
+#include <deque>
 #include <vector>
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+// Unquoted fields are scanned for the next special character 16 (SSE2) or 32
+// (AVX2) bytes at a time when the target supports it.
+#undef USE_SSE2_CSV_SCAN
+#undef USE_AVX2_CSV_SCAN
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define USE_SSE2_CSV_SCAN 1
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define USE_AVX2_CSV_SCAN 1
+#include <immintrin.h>
+#endif
+#endif
 
 namespace tensorflow {
 
+namespace {
+
+// Finds the first occurrence of any of the four characters c0, ..., c3 in
+// [begin, end). Returns end if there is none.
+const char* FindFirstOf4(const char* begin, const char* end, char c0, char c1,
+                         char c2, char c3) {
+  const char* p = begin;
+#ifdef USE_AVX2_CSV_SCAN
+  const __m256i v0 = _mm256_set1_epi8(c0);
+  const __m256i v1 = _mm256_set1_epi8(c1);
+  const __m256i v2 = _mm256_set1_epi8(c2);
+  const __m256i v3 = _mm256_set1_epi8(c3);
+  for (; end - p >= 32; p += 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const __m256i match = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, v0),
+                        _mm256_cmpeq_epi8(chunk, v1)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, v2),
+                        _mm256_cmpeq_epi8(chunk, v3)));
+    const uint32 mask = static_cast<uint32>(_mm256_movemask_epi8(match));
+    if (mask != 0) return p + __builtin_ctz(mask);
+  }
+#endif
+#ifdef USE_SSE2_CSV_SCAN
+  const __m128i w0 = _mm_set1_epi8(c0);
+  const __m128i w1 = _mm_set1_epi8(c1);
+  const __m128i w2 = _mm_set1_epi8(c2);
+  const __m128i w3 = _mm_set1_epi8(c3);
+  for (; end - p >= 16; p += 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i match =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, w0),
+                                  _mm_cmpeq_epi8(chunk, w1)),
+                     _mm_or_si128(_mm_cmpeq_epi8(chunk, w2),
+                                  _mm_cmpeq_epi8(chunk, w3)));
+    const int mask = _mm_movemask_epi8(match);
+    if (mask != 0) return p + __builtin_ctz(mask);
+  }
+#endif
+  for (; p < end; ++p) {
+    const char c = *p;
+    if (c == c0 || c == c1 || c == c2 || c == c3) return p;
+  }
+  return end;
+}
+
+}  // namespace
+
 class DecodeCSVOp : public OpKernel {
  public:
   explicit DecodeCSVOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
@@ -34,6 +102,19 @@ class DecodeCSVOp : public OpKernel {
                 errors::InvalidArgument("Out type too large"));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("field_delim", &delim));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_quote_delim", &use_quote_delim_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("select_cols", &select_cols_));
+    OP_REQUIRES(
+        ctx, out_type_.size() == select_cols_.size() || select_cols_.empty(),
+        errors::InvalidArgument("select_cols should match output size"));
+    select_all_cols_ = select_cols_.empty();
+    for (int i = 0; i < static_cast<int>(select_cols_.size()); ++i) {
+      OP_REQUIRES(ctx, select_cols_[i] >= 0,
+                  errors::InvalidArgument("select_cols should be non-negative "
+                                          "indices"));
+      OP_REQUIRES(ctx, i == 0 || select_cols_[i - 1] < select_cols_[i],
+                  errors::InvalidArgument("select_cols should be strictly "
+                                          "increasing indices"));
+    }
     OP_REQUIRES(ctx, delim.size() == 1,
                 errors::InvalidArgument("field_delim should be only 1 char"));
     delim_ = delim[0];
@@ -64,198 +145,242 @@ class DecodeCSVOp : public OpKernel {
       Tensor* out = nullptr;
       OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &out));
     }
+    if (records_size == 0) return;
 
-    for (int64 i = 0; i < records_size; ++i) {
-      const StringPiece record(records_t(i));
-      std::vector<string> fields;
-      ExtractFields(ctx, record, &fields);
-      OP_REQUIRES(ctx, fields.size() == out_type_.size(),
-                  errors::InvalidArgument("Expect ", out_type_.size(),
-                                          " fields but have ", fields.size(),
-                                          " in record ", i));
-
-      // Check each field in the record
-      for (int f = 0; f < static_cast<int>(out_type_.size()); ++f) {
-        const DataType& dtype = out_type_[f];
-        switch (dtype) {
-          case DT_INT32: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
-            } else {
-              int32 value;
-              OP_REQUIRES(ctx, strings::safe_strto32(fields[f], &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid int32: ", fields[f]));
-              output[f]->flat<int32>()(i) = value;
-            }
-            break;
-          }
-          case DT_INT64: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int64>()(i) = record_defaults[f].flat<int64>()(0);
-            } else {
-              int64 value;
-              OP_REQUIRES(ctx, strings::safe_strto64(fields[f], &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid int64: ", fields[f]));
-              output[f]->flat<int64>()(i) = value;
-            }
-            break;
-          }
-          case DT_FLOAT: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<float>()(i) = record_defaults[f].flat<float>()(0);
-            } else {
-              float value;
-              OP_REQUIRES(ctx, strings::safe_strtof(fields[f].c_str(), &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid float: ", fields[f]));
-              output[f]->flat<float>()(i) = value;
-            }
-            break;
-          }
-          case DT_DOUBLE: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<double>()(i) =
-                  record_defaults[f].flat<double>()(0);
-            } else {
-              double value;
-              OP_REQUIRES(ctx, strings::safe_strtod(fields[f].c_str(), &value),
-                          errors::InvalidArgument(
-                              "Field ", f, " in record ", i,
-                              " is not a valid double: ", fields[f]));
-              output[f]->flat<double>()(i) = value;
-            }
-            break;
-          }
-          case DT_STRING: {
-            // If this field is empty or NA value, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty() || fields[f] == na_value_) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<string>()(i) =
-                  record_defaults[f].flat<string>()(0);
-            } else {
-              output[f]->flat<string>()(i) = fields[f];
-            }
-            break;
+    // Records are independent, so they are parsed in parallel. When several
+    // records are malformed the error of the first one is reported, as a
+    // serial pass would.
+    mutex mu;
+    int64 error_record = records_size;
+    Status error;
+    auto parse_records = [&](int64 begin, int64 end) {
+      std::vector<StringPiece> fields;
+      std::deque<string> unescaped;
+      string buffer;
+      for (int64 i = begin; i < end; ++i) {
+        Status s = ExtractFields(records_t(i), &fields, &unescaped);
+        if (s.ok() && fields.size() != out_type_.size()) {
+          s = errors::InvalidArgument("Expect ", out_type_.size(),
+                                      " fields but have ", fields.size(),
+                                      " in record ", i);
+        }
+        for (int f = 0; s.ok() && f < static_cast<int>(out_type_.size());
+             ++f) {
+          s = ConvertField(record_defaults, f, i, fields[f], &buffer, &output);
+        }
+        if (!s.ok()) {
+          mutex_lock l(mu);
+          if (i < error_record) {
+            error_record = i;
+            error = s;
           }
-          default:
-            OP_REQUIRES(ctx, false,
-                        errors::InvalidArgument("csv: data type ", dtype,
-                                                " not supported in field ", f));
+          return;
         }
       }
+    };
+    int64 total_bytes = 0;
+    for (int64 i = 0; i < records_size; ++i) {
+      total_bytes += records_t(i).size();
     }
+    const int64 num_fields = out_type_.size();
+    const int64 cost_per_record = kCostPerByte * total_bytes / records_size +
+                                  kCostPerField * num_fields;
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, records_size,
+          cost_per_record, parse_records);
+    OP_REQUIRES_OK(ctx, error);
   }
 
  private:
+  static constexpr int64 kCostPerByte = 4;
+  static constexpr int64 kCostPerField = 100;
+
   std::vector<DataType> out_type_;
+  std::vector<int64> select_cols_;
+  bool select_all_cols_;
   char delim_;
   bool use_quote_delim_;
   string na_value_;
 
-  void ExtractFields(OpKernelContext* ctx, StringPiece input,
-                     std::vector<string>* result) {
-    int64 current_idx = 0;
-    if (!input.empty()) {
-      while (static_cast<size_t>(current_idx) < input.size()) {
-        if (input[current_idx] == '\n' || input[current_idx] == '\r') {
-          current_idx++;
-          continue;
+  // Stores field f of record i into output f, converting it to the output
+  // type. `buffer` is scratch space for the NUL-terminated copy that the
+  // floating point parsers need.
+  Status ConvertField(const OpInputList& record_defaults, int f, int64 i,
+                      StringPiece field, string* buffer,
+                      OpOutputList* output) const {
+    const DataType& dtype = out_type_[f];
+    // If this field is empty or NA value, check if default is given:
+    // If yes, use default value; Otherwise report error.
+    if (field.empty() || field == na_value_) {
+      if (dtype != DT_INT32 && dtype != DT_INT64 && dtype != DT_FLOAT &&
+          dtype != DT_DOUBLE && dtype != DT_STRING) {
+        return errors::InvalidArgument("csv: data type ", dtype,
+                                       " not supported in field ", f);
+      }
+      if (record_defaults[f].NumElements() != 1) {
+        return errors::InvalidArgument(
+            "Field ", f, " is required but missing in record ", i, "!");
+      }
+      switch (dtype) {
+        case DT_INT32:
+          (*output)[f]->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
+          break;
+        case DT_INT64:
+          (*output)[f]->flat<int64>()(i) = record_defaults[f].flat<int64>()(0);
+          break;
+        case DT_FLOAT:
+          (*output)[f]->flat<float>()(i) = record_defaults[f].flat<float>()(0);
+          break;
+        case DT_DOUBLE:
+          (*output)[f]->flat<double>()(i) =
+              record_defaults[f].flat<double>()(0);
+          break;
+        default:
+          (*output)[f]->flat<string>()(i) =
+              record_defaults[f].flat<string>()(0);
+          break;
+      }
+      return Status::OK();
+    }
+    switch (dtype) {
+      case DT_INT32: {
+        int32 value;
+        if (!strings::safe_strto32(field, &value)) {
+          return errors::InvalidArgument("Field ", f, " in record ", i,
+                                         " is not a valid int32: ", field);
         }
-
-        bool quoted = false;
-        if (use_quote_delim_ && input[current_idx] == '"') {
-          quoted = true;
-          current_idx++;
+        (*output)[f]->flat<int32>()(i) = value;
+        break;
+      }
+      case DT_INT64: {
+        int64 value;
+        if (!strings::safe_strto64(field, &value)) {
+          return errors::InvalidArgument("Field ", f, " in record ", i,
+                                         " is not a valid int64: ", field);
+        }
+        (*output)[f]->flat<int64>()(i) = value;
+        break;
+      }
+      case DT_FLOAT: {
+        float value;
+        buffer->assign(field.data(), field.size());
+        if (!strings::safe_strtof(buffer->c_str(), &value)) {
+          return errors::InvalidArgument("Field ", f, " in record ", i,
+                                         " is not a valid float: ", field);
+        }
+        (*output)[f]->flat<float>()(i) = value;
+        break;
+      }
+      case DT_DOUBLE: {
+        double value;
+        buffer->assign(field.data(), field.size());
+        if (!strings::safe_strtod(buffer->c_str(), &value)) {
+          return errors::InvalidArgument("Field ", f, " in record ", i,
+                                         " is not a valid double: ", field);
         }
+        (*output)[f]->flat<double>()(i) = value;
+        break;
+      }
+      case DT_STRING: {
+        (*output)[f]->flat<string>()(i).assign(field.data(), field.size());
+        break;
+      }
+      default:
+        return errors::InvalidArgument("csv: data type ", dtype,
+                                       " not supported in field ", f);
+    }
+    return Status::OK();
+  }
 
-        // This is the body of the field;
-        string field;
-        if (!quoted) {
-          while (static_cast<size_t>(current_idx) < input.size() &&
-                 input[current_idx] != delim_) {
-            OP_REQUIRES(ctx,
-                        (!use_quote_delim_ || input[current_idx] != '"') &&
-                            input[current_idx] != '\n' &&
-                            input[current_idx] != '\r',
-                        errors::InvalidArgument(
-                            "Unquoted fields cannot have quotes/CRLFs inside"));
-            field += input[current_idx];
-            current_idx++;
-          }
+  // Splits `input` into its selected fields. Fields point into `input`, except
+  // quoted fields with escaped quotes, which are unescaped into `unescaped`.
+  // Parsing stops after the last selected column, and columns that are not
+  // selected are only scanned for their end.
+  Status ExtractFields(StringPiece input, std::vector<StringPiece>* result,
+                       std::deque<string>* unescaped) const {
+    result->clear();
+    unescaped->clear();
+    if (input.empty()) return Status::OK();
+
+    const char* const begin = input.data();
+    const char* const end = begin + input.size();
+    // When quotes are not special the delimiter takes their place in the
+    // scanner, which is harmless.
+    const char quote = use_quote_delim_ ? '"' : delim_;
+    int64 column = 0;
+    size_t next_selected = 0;
+    const char* p = begin;
+    while (p < end) {
+      if (*p == '\n' || *p == '\r') {
+        ++p;
+        continue;
+      }
+      if (!select_all_cols_ && next_selected == select_cols_.size()) {
+        // All selected columns have been parsed.
+        return Status::OK();
+      }
+      const bool selected =
+          select_all_cols_ || select_cols_[next_selected] == column;
 
-          // Go to next field or the end
-          current_idx++;
-        } else if (use_quote_delim_) {
-          // Quoted field needs to be ended with '"' and delim or end
-          while (
-              (static_cast<size_t>(current_idx) < input.size() - 1) &&
-              (input[current_idx] != '"' || input[current_idx + 1] != delim_)) {
-            if (input[current_idx] != '"') {
-              field += input[current_idx];
-              current_idx++;
+      if (!use_quote_delim_ || *p != '"') {
+        const char* field_end = FindFirstOf4(p, end, delim_, quote, '\n', '\r');
+        if (field_end != end && *field_end != delim_) {
+          return errors::InvalidArgument(
+              "Unquoted fields cannot have quotes/CRLFs inside");
+        }
+        if (selected) result->emplace_back(p, field_end - p);
+        // Go to next field or the end
+        p = field_end + 1;
+      } else {
+        // Quoted field needs to be ended with '"' and delim or end
+        const char* const field_begin = ++p;
+        string* field = nullptr;
+        while (true) {
+          const char* q = static_cast<const char*>(memchr(p, '"', end - p));
+          if (q == nullptr) {
+            return errors::InvalidArgument(
+                "Quoted field has to end with quote followed by delim or "
+                "end");
+          }
+          if (q + 1 == end || q[1] == delim_) {
+            if (selected) {
+              if (field == nullptr) {
+                result->emplace_back(field_begin, q - field_begin);
+              } else {
+                field->append(p, q - p);
+                result->emplace_back(*field);
+              }
+            }
+            p = q + 2;
+            break;
+          }
+          if (q[1] != '"') {
+            return errors::InvalidArgument(
+                "Quote inside a string has to be escaped by another quote");
+          }
+          if (selected) {
+            if (field == nullptr) {
+              unescaped->emplace_back(field_begin, q - field_begin);
+              field = &unescaped->back();
             } else {
-              OP_REQUIRES(
-                  ctx, input[current_idx + 1] == '"',
-                  errors::InvalidArgument("Quote inside a string has to be "
-                                          "escaped by another quote"));
-              field += '"';
-              current_idx += 2;
+              field->append(p, q - p);
             }
+            field->push_back('"');
           }
-
-          OP_REQUIRES(
-              ctx,
-              (static_cast<size_t>(current_idx) < input.size() &&
-               input[current_idx] == '"' &&
-               (static_cast<size_t>(current_idx) == input.size() - 1 ||
-                input[current_idx + 1] == delim_)),
-              errors::InvalidArgument("Quoted field has to end with quote "
-                                      "followed by delim or end"));
-
-          current_idx += 2;
+          p = q + 2;
         }
-
-        result->push_back(field);
       }
+      if (selected) ++next_selected;
+      ++column;
+    }
 
-      // Check if the last field is missing
-      if (input[input.size() - 1] == delim_) result->push_back(string());
+    // Check if the last field is missing
+    if (end[-1] == delim_ &&
+        (select_all_cols_ || (next_selected < select_cols_.size() &&
+                              select_cols_[next_selected] == column))) {
+      result->emplace_back();
     }
+    return Status::OK();
   }
 };
 
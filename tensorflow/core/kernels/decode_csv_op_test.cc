@@ -0,0 +1,119 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Builds a graph that decodes `num_records` records of `num_cols` columns,
+// alternating float, int64 and string columns. When `num_selected` is less
+// than `num_cols` only that many spread out columns are decoded. String
+// fields are quoted when `quoted` is true. Returns the number of input bytes.
+int64 MakeDecodeCSVGraph(Graph* g, int num_records, int num_cols,
+                         int num_selected, bool quoted) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor records(DT_STRING, TensorShape({num_records}));
+  auto records_t = records.flat<string>();
+  int64 num_bytes = 0;
+  for (int i = 0; i < num_records; ++i) {
+    string& record = records_t(i);
+    for (int c = 0; c < num_cols; ++c) {
+      if (c > 0) record.push_back(',');
+      switch (c % 3) {
+        case 0:
+          strings::StrAppend(&record, rnd.RandFloat() * 1000);
+          break;
+        case 1:
+          strings::StrAppend(&record, rnd.Uniform64(1 << 30));
+          break;
+        default:
+          strings::StrAppend(&record, quoted ? "\"" : "", "token_",
+                             rnd.Uniform(10000), quoted ? "\"" : "");
+      }
+    }
+    num_bytes += record.size();
+  }
+
+  std::vector<int64> select_cols;
+  std::vector<NodeBuilder::NodeOut> defaults;
+  for (int s = 0; s < num_selected; ++s) {
+    const int c =
+        num_selected == num_cols ? s : s * num_cols / num_selected + s % 3;
+    if (num_selected < num_cols) select_cols.push_back(c);
+    Tensor default_value;
+    switch (c % 3) {
+      case 0:
+        default_value = test::AsTensor<float>({0.0f});
+        break;
+      case 1:
+        default_value = test::AsTensor<int64>({0});
+        break;
+      default:
+        default_value = test::AsTensor<string>({""});
+    }
+    defaults.emplace_back(test::graph::Constant(g, default_value));
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeCSV")
+                  .Input(test::graph::Constant(g, records))
+                  .Input(defaults)
+                  .Attr("select_cols", select_cols)
+                  .Finalize(g, &node));
+  return num_bytes;
+}
+
+void BM_DecodeCSV(int iters, int num_cols, int num_selected, bool quoted) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  const int64 num_bytes =
+      MakeDecodeCSVGraph(g, 10000, num_cols, num_selected, quoted);
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_bytes);
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+// All columns decoded; the records have `num_cols` columns.
+static void BM_DecodeCSV_AllColumns(int iters, int num_cols) {
+  BM_DecodeCSV(iters, num_cols, num_cols, false);
+}
+BENCHMARK(BM_DecodeCSV_AllColumns)->Arg(3)->Arg(12)->Arg(48);
+
+static void BM_DecodeCSV_AllColumnsQuoted(int iters, int num_cols) {
+  BM_DecodeCSV(iters, num_cols, num_cols, true);
+}
+BENCHMARK(BM_DecodeCSV_AllColumnsQuoted)->Arg(3)->Arg(12)->Arg(48);
+
+// `num_selected` out of 48 columns decoded through select_cols.
+static void BM_DecodeCSV_SelectedColumns(int iters, int num_selected) {
+  BM_DecodeCSV(iters, 48, num_selected, false);
+}
+BENCHMARK(BM_DecodeCSV_SelectedColumns)->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,12 +15,16 @@ limitations under the License.
 
 // See docs in ../ops/image_ops.cc
 
+#include <algorithm>
 #include <memory>
+#include <vector>
+
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/gif/gif_io.h"
 #include "tensorflow/core/lib/jpeg/jpeg_mem.h"
@@ -334,11 +338,231 @@ class DecodeImageOp : public OpKernel {
   jpeg::UncompressFlags flags_;
 };
 
+// Decodes a JPEG image straight to a bilinearly resized crop of it. libjpeg
+// scales the image down by 1/2, 1/4 or 1/8 in the DCT domain while decoding,
+// as far as the crop stays at least as large as the output, and only decodes
+// the rows and MCU columns that cover the crop. The decoded pixels are then
+// resized to the output with the same interpolation as ResizeBilinear. When
+// the crop is less than twice the size of the output, nothing is scaled down
+// during decoding, and the result is the same as that of ResizeBilinear on
+// the output of DecodeAndCropJpeg.
+class DecodeAndResizeJpegOp : public OpKernel {
+ public:
+  explicit DecodeAndResizeJpegOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("channels", &channels_));
+    OP_REQUIRES(context, channels_ == 0 || channels_ == 1 || channels_ == 3,
+                errors::InvalidArgument(
+                    "channels must be 0, 1, or 3 for JPEG, got ", channels_));
+    flags_.components = channels_;
+    OP_REQUIRES_OK(context, context->GetAttr("fancy_upscaling",
+                                             &flags_.fancy_upscaling));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("try_recover_truncated",
+                                    &flags_.try_recover_truncated_jpeg));
+    OP_REQUIRES_OK(context, context->GetAttr("acceptable_fraction",
+                                             &flags_.min_acceptable_fraction));
+
+    // Same default as DecodeJpeg.
+    flags_.dct_method = JDCT_IFAST;
+    string dct_method;
+    OP_REQUIRES_OK(context, context->GetAttr("dct_method", &dct_method));
+    OP_REQUIRES(
+        context,
+        (dct_method.empty() || dct_method == "INTEGER_FAST" ||
+         dct_method == "INTEGER_ACCURATE"),
+        errors::InvalidArgument("dct_method must be one of "
+                                "{'', 'INTEGER_FAST', 'INTEGER_ACCURATE'}"));
+    if (dct_method == "INTEGER_ACCURATE") {
+      flags_.dct_method = JDCT_ISLOW;
+    }
+    OP_REQUIRES_OK(context, context->GetAttr("align_corners", &align_corners_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& contents = context->input(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(contents.shape()),
+                errors::InvalidArgument("contents must be scalar, got shape ",
+                                        contents.shape().DebugString()));
+    const StringPiece input = contents.scalar<string>()();
+    OP_REQUIRES(context, ClassifyFileFormat(input) == kJpgFormat,
+                errors::InvalidArgument(
+                    "Expected JPEG, got ",
+                    FileFormatString(ClassifyFileFormat(input), input)));
+    OP_REQUIRES(context, input.size() <= std::numeric_limits<int>::max(),
+                errors::InvalidArgument("JPEG contents are too large for int: ",
+                                        input.size()));
+
+    const Tensor& crop_window = context->input(1);
+    OP_REQUIRES(context,
+                crop_window.dims() == 1 && (crop_window.dim_size(0) == 0 ||
+                                            crop_window.dim_size(0) == 4),
+                errors::InvalidArgument(
+                    "crop_window must have zero or four elements, got shape ",
+                    crop_window.shape().DebugString()));
+    const Tensor& size = context->input(2);
+    OP_REQUIRES(context, size.dims() == 1 && size.dim_size(0) == 2,
+                errors::InvalidArgument("size must have two elements, got ",
+                                        size.shape().DebugString()));
+    const int out_height = size.vec<int32>()(0);
+    const int out_width = size.vec<int32>()(1);
+    OP_REQUIRES(context, out_height > 0 && out_width > 0,
+                errors::InvalidArgument("output dimensions must be positive, "
+                                        "got ",
+                                        out_height, "x", out_width));
+
+    int image_width;
+    int image_height;
+    OP_REQUIRES(context,
+                jpeg::GetImageInfo(input.data(), input.size(), &image_width,
+                                   &image_height, nullptr),
+                errors::InvalidArgument("Invalid JPEG data, size ",
+                                        input.size()));
+    int crop_y = 0;
+    int crop_x = 0;
+    int crop_height = image_height;
+    int crop_width = image_width;
+    if (crop_window.NumElements() == 4) {
+      auto crop_window_vec = crop_window.vec<int32>();
+      crop_y = crop_window_vec(0);
+      crop_x = crop_window_vec(1);
+      crop_height = crop_window_vec(2);
+      crop_width = crop_window_vec(3);
+      OP_REQUIRES(
+          context,
+          crop_y >= 0 && crop_x >= 0 && crop_height > 0 && crop_width > 0 &&
+              crop_height <= image_height - crop_y &&
+              crop_width <= image_width - crop_x,
+          errors::InvalidArgument("Invalid crop window ", crop_y, ", ", crop_x,
+                                  ", ", crop_height, ", ", crop_width,
+                                  " for a ", image_height, "x", image_width,
+                                  " image"));
+    }
+
+    // The largest downscaling that keeps the crop at least as large as the
+    // output.
+    jpeg::UncompressFlags flags = flags_;
+    flags.ratio = 8;
+    while (flags.ratio > 1 &&
+           (crop_height < static_cast<int64>(out_height) * flags.ratio ||
+            crop_width < static_cast<int64>(out_width) * flags.ratio)) {
+      flags.ratio /= 2;
+    }
+    const int ratio = flags.ratio;
+
+    // The smallest window of the scaled image that covers the crop.
+    const int scaled_image_height = (image_height + ratio - 1) / ratio;
+    const int scaled_image_width = (image_width + ratio - 1) / ratio;
+    flags.crop_y = crop_y / ratio;
+    flags.crop_x = crop_x / ratio;
+    flags.crop_height =
+        std::min((crop_y + crop_height + ratio - 1) / ratio,
+                 scaled_image_height) -
+        flags.crop_y;
+    flags.crop_width = std::min((crop_x + crop_width + ratio - 1) / ratio,
+                                scaled_image_width) -
+                       flags.crop_x;
+    flags.crop = flags.crop_height < scaled_image_height ||
+                 flags.crop_width < scaled_image_width;
+
+    Tensor decoded;
+    OP_REQUIRES(
+        context,
+        jpeg::Uncompress(
+            input.data(), input.size(), flags, nullptr /* nwarn */,
+            [=, &decoded](int width, int height, int channels) -> uint8* {
+              Status status(context->allocate_temp(
+                  DT_UINT8, TensorShape({height, width, channels}),
+                  &decoded));
+              if (!status.ok()) {
+                VLOG(1) << status;
+                context->SetStatus(status);
+                return nullptr;
+              }
+              return decoded.flat<uint8>().data();
+            }),
+        errors::InvalidArgument("Invalid JPEG data, data size ",
+                                input.size()));
+
+    const int64 channels = decoded.dim_size(2);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({out_height, out_width, channels}),
+                       &output));
+
+    // Source coordinates are those of ResizeBilinear on the crop, mapped to
+    // the decoded window.
+    std::vector<CachedInterpolation> ys(out_height);
+    std::vector<CachedInterpolation> xs(out_width);
+    ComputeInterpolationWeights(
+        out_height, decoded.dim_size(0), crop_y - flags.crop_y * ratio,
+        CalculateResizeScale(crop_height, out_height, align_corners_), ratio,
+        ys.data());
+    ComputeInterpolationWeights(
+        out_width, decoded.dim_size(1), crop_x - flags.crop_x * ratio,
+        CalculateResizeScale(crop_width, out_width, align_corners_), ratio,
+        xs.data());
+
+    const uint8* image = decoded.flat<uint8>().data();
+    const int64 in_row_size = decoded.dim_size(1) * channels;
+    float* output_ptr = output->flat<float>().data();
+    for (int y = 0; y < out_height; ++y) {
+      const uint8* ys_lower = image + ys[y].lower * in_row_size;
+      const uint8* ys_upper = image + ys[y].upper * in_row_size;
+      const float ys_lerp = ys[y].lerp;
+      for (int x = 0; x < out_width; ++x) {
+        const int64 xs_lower = xs[x].lower * channels;
+        const int64 xs_upper = xs[x].upper * channels;
+        const float xs_lerp = xs[x].lerp;
+        for (int c = 0; c < channels; ++c) {
+          const float top_left = ys_lower[xs_lower + c];
+          const float top_right = ys_lower[xs_upper + c];
+          const float bottom_left = ys_upper[xs_lower + c];
+          const float bottom_right = ys_upper[xs_upper + c];
+          const float top = top_left + (top_right - top_left) * xs_lerp;
+          const float bottom =
+              bottom_left + (bottom_right - bottom_left) * xs_lerp;
+          *output_ptr++ = top + (bottom - top) * ys_lerp;
+        }
+      }
+    }
+  }
+
+ private:
+  struct CachedInterpolation {
+    int64 lower;
+    int64 upper;
+    float lerp;
+  };
+
+  // Computes the source rows (or columns) of each output row, for a crop
+  // that starts 'offset' pixels of the full size image into the decoded
+  // window, which is scaled down by 'ratio'.
+  static void ComputeInterpolationWeights(int64 out_size, int64 in_size,
+                                          int offset, float scale, int ratio,
+                                          CachedInterpolation* interpolation) {
+    for (int64 i = 0; i < out_size; ++i) {
+      const float in = (offset + i * scale) / ratio;
+      const int64 lower = std::min(static_cast<int64>(in), in_size - 1);
+      interpolation[i].lower = lower;
+      interpolation[i].upper = std::min(lower + 1, in_size - 1);
+      interpolation[i].lerp = in - lower;
+    }
+  }
+
+  int channels_;
+  bool align_corners_;
+  jpeg::UncompressFlags flags_;
+};
+
 REGISTER_KERNEL_BUILDER(Name("DecodeJpeg").Device(DEVICE_CPU), DecodeImageOp);
 REGISTER_KERNEL_BUILDER(Name("DecodePng").Device(DEVICE_CPU), DecodeImageOp);
 REGISTER_KERNEL_BUILDER(Name("DecodeGif").Device(DEVICE_CPU), DecodeImageOp);
 REGISTER_KERNEL_BUILDER(Name("DecodeAndCropJpeg").Device(DEVICE_CPU),
                         DecodeImageOp);
+REGISTER_KERNEL_BUILDER(Name("DecodeAndResizeJpeg").Device(DEVICE_CPU),
+                        DecodeAndResizeJpegOp);
 
 }  // namespace
 }  // namespace tensorflow
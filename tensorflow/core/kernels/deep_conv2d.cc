@@ -43,37 +43,108 @@ namespace tensorflow {
 // The transform matrices and input, filter and output tile sizes are all
 // specified by the DeepConv2DTransform implementation selected at the
 // start of the DeepConv2D call, based on convolution parameters.
+//
+// The input and output transforms are separable: 'A' and 'C' are kronecker
+// products 'M * M' of small 1-D matrices, so tiles are transformed by applying
+// 'M' along the tile rows and then along the tile columns, skipping the zero
+// coefficients of 'M'.
+
+// Returns the number of input tiles that are transformed and multiplied
+// together (i.e. the number of columns of each per-coordinate MatMul), chosen
+// so that the working set fits in a cache budget of 'cache_size' elements.
+static int64 GetNumTilesPerChunk(int64 cache_size, int64 tile_rows,
+                                 int64 tile_cols, int64 out_tile_rows,
+                                 int64 out_tile_cols, int64 in_depth,
+                                 int64 out_depth, int64 filter_shard_size,
+                                 int64 col_tiles) {
+  const int64 tile_spatial_size = tile_rows * tile_cols;
+  const int64 out_tile_spatial_size = out_tile_rows * out_tile_cols;
+
+  // Fixed costs.
+  const int64 tile_transform_matrix_size = tile_rows * tile_cols;
+  const int64 output_transform_matrix_size = out_tile_rows * tile_rows;
+  // Calculate cache reserve size.
+  const int64 filter_depth_size = in_depth * out_depth * filter_shard_size;
+  const bool small_filter = ((filter_depth_size * 100) / cache_size) <= 25;
+  const int64 cache_reserve_size = small_filter ? filter_depth_size : 1024;
+  // Calculate total fixed cost.
+  const int64 total_fixed_cost = tile_transform_matrix_size +
+                                 output_transform_matrix_size +
+                                 cache_reserve_size;
+
+  // Per-tile costs.
+  const int64 buffer1_per_tile_size =
+      tile_spatial_size * std::max(in_depth, out_depth * filter_shard_size);
+  const int64 buffer2_per_tile_size =
+      std::max(tile_spatial_size * in_depth,
+               out_tile_spatial_size * out_depth * filter_shard_size);
+  const int64 packed_tile_per_tile_size = in_depth;
+  const int64 gemm_out_per_tile_size = out_depth * filter_shard_size;
+  const int64 total_per_tile_cost =
+      buffer1_per_tile_size + buffer2_per_tile_size +
+      packed_tile_per_tile_size + gemm_out_per_tile_size;
+
+  const int64 num_tiles_cache =
+      std::max(4LL, (cache_size - total_fixed_cost) / total_per_tile_cost);
+  return std::min(num_tiles_cache, col_tiles);
+}
 
 // Approximate cost models for direct and deep convolutions.
 static int64 GetDeepConvCost(int input_tile_rows, int input_tile_cols,
                              int out_tile_rows, int out_tile_cols, int in_depth,
-                             int out_depth, int out_rows, int out_cols) {
-  // Input transform cost.
+                             int out_depth, int out_rows, int out_cols,
+                             int batch) {
+  // MatMuls with fewer columns than this are bound by streaming the packed
+  // filters rather than by arithmetic.
+  const int64 kMinGemmCols = 6;
+  // Filter transform and packing cost per transformed filter value: both are
+  // bound by memory traffic rather than by the few multiplies involved.
+  const int64 kFilterTransformCost = 40;
+
+  // Input transform cost (1-D transforms along tile rows, then tile columns).
   const int64 input_tile_spatial_size = input_tile_rows * input_tile_cols;
-  const int64 input_transform_cost =
-      input_tile_spatial_size * input_tile_spatial_size * in_depth;
-
-  // Element-wise products (each product is a MatMul across depth).
-  const int64 product_cost = input_tile_spatial_size * in_depth * out_depth;
+  const int64 input_transform_cost = input_tile_spatial_size *
+                                     (input_tile_rows + input_tile_cols) *
+                                     in_depth;
 
-  // Output transform cost.
-  const int64 output_tile_spatial_size = out_tile_rows * out_tile_cols;
+  // Output transform cost (1-D transforms along tile columns, then rows).
   const int64 output_transform_cost =
-      output_tile_spatial_size * input_tile_spatial_size * out_depth;
+      (input_tile_rows * out_tile_cols * input_tile_cols +
+       out_tile_rows * out_tile_cols * input_tile_rows) *
+      out_depth;
 
   // Calculate number of input tiles to process.
   const int64 row_tiles = (out_rows + out_tile_rows - 1) / out_tile_rows;
   const int64 col_tiles = (out_cols + out_tile_cols - 1) / out_tile_cols;
   const int64 num_tiles = row_tiles * col_tiles;
 
+  // Element-wise products: one MatMul across depth per tile coordinate, for
+  // each chunk of tiles processed together along a row of tiles.
+  const int64 chunk_tiles = GetNumTilesPerChunk(
+      (256LL << 10) / sizeof(float), input_tile_rows, input_tile_cols,
+      out_tile_rows, out_tile_cols, in_depth, out_depth, 1, col_tiles);
+  const int64 residual_tiles = col_tiles % chunk_tiles;
+  const int64 gemm_cols =
+      (col_tiles / chunk_tiles) * std::max(chunk_tiles, kMinGemmCols) +
+      (residual_tiles > 0 ? std::max(residual_tiles, kMinGemmCols) : 0);
+  const int64 product_cost =
+      row_tiles * gemm_cols * input_tile_spatial_size * in_depth * out_depth;
+
+  // Filter transform cost, paid once for all images.
+  const int64 filter_transform_cost =
+      kFilterTransformCost * input_tile_spatial_size * in_depth * out_depth;
+
   // Return total cost.
-  return num_tiles *
-         (input_transform_cost + product_cost + output_transform_cost);
+  return batch * (num_tiles * (input_transform_cost + output_transform_cost) +
+                  product_cost) +
+         filter_transform_cost;
 }
 
 static int64 GetDirectConvCost(int filter_rows, int filter_cols, int in_depth,
-                               int out_depth, int out_rows, int out_cols) {
-  return filter_rows * filter_cols * in_depth * out_depth * out_rows * out_cols;
+                               int out_depth, int out_rows, int out_cols,
+                               int batch) {
+  return static_cast<int64>(batch) * filter_rows * filter_cols * in_depth *
+         out_depth * out_rows * out_cols;
 }
 
 // Reads environment variable 'env_var_name'.
@@ -90,41 +161,67 @@ static bool ReadBoolFromEnvVar(const char* env_var_name, bool default_val) {
   return default_val;
 }
 
-// Returns true if convolution can be computed efficiently by DeepConv2D,
-// returns false otherwise.
+static int64 GetDeepConvCost(const DeepConv2DTransform<float>& t,
+                             int in_depth, int out_depth, int out_rows,
+                             int out_cols, int batch) {
+  return GetDeepConvCost(t.input_shape().rows, t.input_shape().cols,
+                         t.output_shape().rows, t.output_shape().cols,
+                         in_depth, out_depth, out_rows, out_cols, batch);
+}
+
+// Returns the algorithm with the lowest estimated cost for the convolution.
+// Larger Winograd tiles need fewer products per output, but cost more per
+// transformed value, need larger filter transforms, and form narrower MatMuls
+// for small spatial sizes, so the best tile depends on the batch size, depth
+// and spatial size of each layer.
 // TODO(andydavis) Add support for other filter sizes and strides.
 // TODO(andydavis) Add support for autotuning.
-bool CanUseDeepConv2D(int stride_rows, int stride_cols, int filter_rows,
-                      int filter_cols, int in_depth, int out_depth,
-                      int out_rows, int out_cols) {
+DeepConv2DAlgorithm SelectDeepConv2DAlgorithm(int stride_rows, int stride_cols,
+                                              int filter_rows, int filter_cols,
+                                              int in_depth, int out_depth,
+                                              int out_rows, int out_cols,
+                                              int batch) {
   // Check if convolution parameters are supported.
   // TODO(andydavis) Add support for multiple filter sizes and strides.
   if (stride_rows > 1 || stride_cols > 1 || filter_rows != 3 ||
       filter_cols != 3) {
-    return false;
+    return DeepConv2DAlgorithm::kDefault;
   }
 
   // Check if deep convolution is enabled by environment variable.
   // NOTE: IF this environment variable name changes, update conv_ops_test.py.
   if (!ReadBoolFromEnvVar("TF_USE_DEEP_CONV2D", false)) {
-    return false;
+    return DeepConv2DAlgorithm::kDefault;
   }
 
-  // Check if flop cost of deep convolution is less than direct convolution.
-  WinogradTransform<float> t;
-  const int64 deep_conv_cost = GetDeepConvCost(
-      t.input_shape().rows, t.input_shape().cols, t.output_shape().rows,
-      t.output_shape().cols, in_depth, out_depth, out_rows, out_cols);
-  const int64 direct_conv_cost = GetDirectConvCost(
-      filter_rows, filter_cols, in_depth, out_depth, out_rows, out_cols);
-
-  VLOG(2) << "CanUseDeepConv2D"
-          << " deep_conv_cost: " << deep_conv_cost
-          << " direct_conv_cost: " << direct_conv_cost << " deep_direct_ratio: "
-          << (static_cast<float>(deep_conv_cost) /
-              static_cast<float>(direct_conv_cost))
-          << " use_deep_conv: " << (deep_conv_cost < direct_conv_cost);
-  return deep_conv_cost < direct_conv_cost;
+  const int64 direct_conv_cost =
+      GetDirectConvCost(filter_rows, filter_cols, in_depth, out_depth,
+                        out_rows, out_cols, batch);
+  const int64 f2x2_cost =
+      GetDeepConvCost(WinogradTransform<float>(), in_depth, out_depth,
+                      out_rows, out_cols, batch);
+  const int64 f4x4_cost =
+      GetDeepConvCost(WinogradF4x4Transform<float>(), in_depth, out_depth,
+                      out_rows, out_cols, batch);
+
+  DeepConv2DAlgorithm algorithm = DeepConv2DAlgorithm::kDefault;
+  int64 cost = direct_conv_cost;
+  if (f2x2_cost < cost) {
+    algorithm = DeepConv2DAlgorithm::kWinogradF2x2;
+    cost = f2x2_cost;
+  }
+  if (f4x4_cost < cost) {
+    algorithm = DeepConv2DAlgorithm::kWinogradF4x4;
+    cost = f4x4_cost;
+  }
+
+  VLOG(2) << "SelectDeepConv2DAlgorithm"
+          << " direct_conv_cost: " << direct_conv_cost
+          << " f2x2_cost: " << f2x2_cost << " f4x4_cost: " << f4x4_cost
+          << " deep_direct_ratio: "
+          << (static_cast<float>(cost) / static_cast<float>(direct_conv_cost))
+          << " algorithm: " << static_cast<int>(algorithm);
+  return algorithm;
 }
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
@@ -487,20 +584,78 @@ struct TransformFilters {
   }
 };
 
+// Transforms filters of exactly the base filter size (a single filter shard)
+// with one MatMul: 'filter_in' is a [base_filter_spatial_size,
+// in_depth * out_depth] matrix, so no per-filter gather is needed.
+//
+// filter_in:
+//   [base_filter_rows, base_filter_cols, in_depth, out_depth]
+//
+// filter_out:
+//   [tile_rows, tile_cols, in_depth, out_depth]
+//
+// Each tile coordinate of 'filter_out' holds a column-major
+// [out_depth, in_depth] matrix, which PackFilters<T, Eigen::ColMajor> packs.
+template <typename T>
+struct TransformFiltersSingleShard {
+  typedef typename Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic,
+                                 Eigen::RowMajor>
+      MatrixType;
+  typedef Eigen::Map<MatrixType> MatrixMap;
+  typedef Eigen::Map<const MatrixType> ConstMatrixMap;
+
+  void operator()(OpKernelContext* ctx, const Conv2DArgs& args,
+                  const DeepConv2DTransform<T>* transform, const T* filter_in,
+                  T* filter_out) {
+    const int64 tile_spatial_size =
+        transform->input_shape().rows * transform->input_shape().cols;
+    const int64 base_filter_spatial_size =
+        transform->filter_shape().rows * transform->filter_shape().cols;
+    const int64 filter_size = args.in_depth * args.out_depth;
+
+    // Allocate buffer for filter transform matrix:
+    //   [tile_spatial_size, base_filter_spatial_size]
+    Tensor filter_transform_matrix;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(
+                 DataTypeToEnum<T>::value,
+                 TensorShape({tile_spatial_size, base_filter_spatial_size}),
+                 &filter_transform_matrix));
+    T* transform_matrix = filter_transform_matrix.template flat<T>().data();
+    transform->GetFilterTransformMatrix(
+        tile_spatial_size, base_filter_spatial_size, transform_matrix);
+
+    auto shard = [&transform_matrix, &tile_spatial_size,
+                  &base_filter_spatial_size, &filter_size, &filter_in,
+                  &filter_out](int64 start, int64 limit) {
+      ConstMatrixMap A(transform_matrix, tile_spatial_size,
+                       base_filter_spatial_size);
+      ConstMatrixMap B(filter_in, base_filter_spatial_size, filter_size);
+      MatrixMap C(filter_out, tile_spatial_size, filter_size);
+      C.middleCols(start, limit - start).noalias() =
+          A * B.middleCols(start, limit - start);
+    };
+    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, filter_size,
+          tile_spatial_size * base_filter_spatial_size, shard);
+  }
+};
+
 // Packs transformed filters stored in 'lhs_input' into 'lhs_block' in a
-// gemm-kernel friendly data layout.
+// gemm-kernel friendly data layout. 'lhs_input' is a [rows, depth] matrix
+// stored in 'StorageOrder'.
 //
 // Data layout for 'lhs_block':
 //   [out_depth, shard_rows, shard_cols, in_depth].
 
-template <typename T>
+template <typename T, int StorageOrder = Eigen::RowMajor>
 class GemmFilterPacker {
  public:
-  typedef Eigen::internal::const_blas_data_mapper<T, int64, Eigen::RowMajor>
+  typedef Eigen::internal::const_blas_data_mapper<T, int64, StorageOrder>
       LhsMapper;
   typedef Eigen::internal::gebp_traits<T, T> Traits;
   Eigen::internal::gemm_pack_lhs<T, int64, LhsMapper, Traits::mr,
-                                 Traits::LhsProgress, Eigen::RowMajor>
+                                 Traits::LhsProgress, StorageOrder>
       pack_lhs;
 
   GemmFilterPacker(const int64 rows, const int64 depth, const T* lhs_input,
@@ -508,7 +663,8 @@ class GemmFilterPacker {
       : rows_(rows),
         depth_(depth),
         lhs_block_(lhs_block),
-        lhs_mapper_(lhs_input, depth_) {}
+        lhs_mapper_(lhs_input,
+                    StorageOrder == Eigen::RowMajor ? depth_ : rows_) {}
 
   void Run() { pack_lhs(lhs_block_, lhs_mapper_, depth_, rows_); }
 
@@ -520,8 +676,9 @@ class GemmFilterPacker {
 };
 
 // Packs transformed filter stored in 'filter_transform_data' into
-// 'packed_filters' to be used by GemmState.
-template <typename T>
+// 'packed_filters' to be used by GemmState. The filters at each tile
+// coordinate are stored in 'StorageOrder' (see TransformFiltersSingleShard).
+template <typename T, int StorageOrder = Eigen::RowMajor>
 struct PackFilters {
   void operator()(OpKernelContext* ctx, const Conv2DArgs& args,
                   const int64 tile_spatial_size, const int64 filter_shards_row,
@@ -544,7 +701,7 @@ struct PackFilters {
                                     &(*packed_filters)[i]));
         T* packed_filter = (*packed_filters)[i].template flat<T>().data();
         // Pack filters.
-        GemmFilterPacker<T> packer(
+        GemmFilterPacker<T, StorageOrder> packer(
             num_filters, in_depth,
             filter_transform_data + i * filter_coord_stride, packed_filter);
         packer.Run();
@@ -651,7 +808,7 @@ struct CopyInputTile {
         if (in_c < 0 || in_c >= args.in_cols) continue;
 
         auto* in = input + (in_r * args.in_cols + in_c) * args.in_depth;
-        auto* tile = tile_buffer + coord_stride * (r * tile_rows + c);
+        auto* tile = tile_buffer + coord_stride * (r * tile_cols + c);
         // Copy vectorized portion of depth dimension.
         for (int64 d = 0; d < input_vectorized_size; d += kPacketSize) {
           auto v = Eigen::internal::ploadu<Packet>(in + d);
@@ -667,28 +824,74 @@ struct CopyInputTile {
   }
 };
 
-// Transforms 'num_tiles' tiles from 'input' by 'transform_matrix', storing the
-// final result in 'tile_transform'.
+// Computes 'out' = 'transform_matrix' * 'in', where 'transform_matrix' is a
+// 1-D transform matrix and the rows of 'in' and 'out' hold 'size' values at
+// strides 'in_stride' and 'out_stride'.
+// Zero coefficients (about half of those of the Winograd transforms) are
+// skipped. Columns are processed in blocks, which are accumulated in an L1
+// resident buffer before they are stored, so 'out' may alias 'in'.
+//
+// transform_matrix:
+//   [m_rows, m_cols]
+// in:
+//   [m_cols, size]
+// out:
+//   [m_rows, size]
+
+template <typename T>
+struct ApplyTransform {
+  typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> ArrayMap;
+  typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstArrayMap;
+
+  void operator()(const T* transform_matrix, const int64 m_rows,
+                  const int64 m_cols, const T* in, const int64 in_stride,
+                  const int64 size, T* out, const int64 out_stride) {
+    const int64 kMaxRows = 8;
+    const int64 kBlockSize = 256;
+    DCHECK_LE(m_rows, kMaxRows);
+    EIGEN_ALIGN_MAX T block[kMaxRows * kBlockSize];
+    for (int64 start = 0; start < size; start += kBlockSize) {
+      const int64 block_size = std::min(size - start, kBlockSize);
+      for (int64 i = 0; i < m_rows; ++i) {
+        ArrayMap out_block(block + i * kBlockSize, block_size);
+        bool initialized = false;
+        for (int64 k = 0; k < m_cols; ++k) {
+          const T coeff = transform_matrix[i * m_cols + k];
+          if (coeff == T(0)) continue;
+          ConstArrayMap in_block(in + k * in_stride + start, block_size);
+          if (initialized) {
+            out_block += coeff * in_block;
+          } else {
+            out_block = coeff * in_block;
+            initialized = true;
+          }
+        }
+        if (!initialized) out_block.setZero();
+      }
+      for (int64 i = 0; i < m_rows; ++i) {
+        memcpy(out + i * out_stride + start, block + i * kBlockSize,
+               block_size * sizeof(T));
+      }
+    }
+  }
+};
+
+// Transforms 'num_tiles' tiles from 'input' by the 1-D 'transform_matrix'
+// applied along tile rows and then tile columns, storing the final result in
+// 'tile_transform'.
 // Intermediate results are stored in 'tile_buffer'.
 //
 // input:
 //   [in_rows, in_cols, in_depth]
 // tile_buffer:
 //   [tile_rows, tile_cols, num_tiles, in_depth]
-// tile_transform_matrix:
-//   [tile_spatial_size, tile_spatial_size]
+// transform_matrix:
+//   [tile_rows, tile_rows]
 // tile_transform:
 //   [tile_rows, tile_cols, num_tiles, in_depth]
 
 template <typename T>
 struct TransformInputTiles {
-  typedef Eigen::Map<
-      Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>
-      MatrixMap;
-  typedef Eigen::Map<
-      const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>
-      ConstMatrixMap;
-
   void operator()(const Conv2DArgs& args,
                   const DeepConv2DTransform<T>* transform,
                   const int64 num_tiles, const int64 in_r_start,
@@ -711,20 +914,32 @@ struct TransformInputTiles {
                          tile_buffer + num_tiles_base);
     }
 
-    ConstMatrixMap A(transform_matrix, tile_spatial_size, tile_spatial_size);
-    ConstMatrixMap B(tile_buffer, tile_spatial_size, coord_stride);
-    MatrixMap C(tile_transform, tile_spatial_size, coord_stride);
+    // Transform along tile rows: each row of the result is a combination of
+    // [tile_cols, num_tiles, in_depth] slices of 'tile_buffer'.
+    const int64 row_stride = tile_cols * coord_stride;
+    ApplyTransform<T>()(transform_matrix, tile_rows, tile_rows, tile_buffer,
+                        row_stride, row_stride, tile_transform, row_stride);
 
-    C.noalias() = A * B;
+    // Transform along tile columns in place, one tile row at a time.
+    for (int64 r = 0; r < tile_rows; ++r) {
+      T* row = tile_transform + r * row_stride;
+      ApplyTransform<T>()(transform_matrix, tile_cols, tile_cols, row,
+                          coord_stride, coord_stride, row, coord_stride);
+    }
   }
 };
 
-// Transforms output tiles from buffer by 'out_transform_matrix', storing
-// final result in 'output' (intermediate results stored in 'out_buffer').
+// Transforms output tiles from buffer by the 1-D 'out_transform_matrix'
+// applied along tile columns and then tile rows, storing final result in
+// 'output' (intermediate results stored in 'out_buffer', which is overwritten,
+// and 'out_transform_buffer').
 //
 // out_buffer:
 //   [tile_rows, tile_cols, num_tiles, out_depth, shard_rows, shard_cols]
 //
+// out_transform_matrix:
+//   [out_tile_rows, tile_rows]
+//
 // output transform buffer:
 //  [out_tile_rows, out_tile_cols, num_tiles, out_depth, shard_rows, shard_cols]
 //
@@ -734,37 +949,35 @@ struct TransformInputTiles {
 
 template <typename T>
 struct TransformOutputTile {
-  typedef Eigen::Map<
-      Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>
-      MatrixMap;
-  typedef Eigen::Map<
-      const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>
-      ConstMatrixMap;
-
   void operator()(const Conv2DArgs& args,
                   const DeepConv2DTransform<T>* transform,
                   const int64 num_tiles, const int64 in_r, const int64 in_c,
                   const int64 filter_shards_row, const int64 filter_shards_col,
-                  const T* out_transform_matrix, const T* out_buffer,
+                  const T* out_transform_matrix, T* out_buffer,
                   T* out_transform_buffer, T* output) {
     const int64 tile_rows = transform->input_shape().rows;
     const int64 tile_cols = transform->input_shape().cols;
-    const int64 tile_spatial_size = tile_rows * tile_cols;
 
     const int64 out_buf_stride =
         num_tiles * args.out_depth * filter_shards_row * filter_shards_col;
 
     const int64 out_tile_rows = transform->output_shape().rows;
     const int64 out_tile_cols = transform->output_shape().cols;
-    const int64 out_tile_spatial_size = out_tile_rows * out_tile_cols;
-
-    // Compute output transform.
-    ConstMatrixMap A(out_transform_matrix, out_tile_spatial_size,
-                     tile_spatial_size);
-    ConstMatrixMap B(out_buffer, tile_spatial_size, out_buf_stride);
-    MatrixMap C(out_transform_buffer, out_tile_spatial_size, out_buf_stride);
 
-    C.noalias() = A * B;
+    // Compute output transform along tile columns in place, one tile row at a
+    // time. Each tile row of 'out_buffer' then starts with 'out_tile_cols'
+    // transformed rows.
+    const int64 row_stride = tile_cols * out_buf_stride;
+    for (int64 r = 0; r < tile_rows; ++r) {
+      T* row = out_buffer + r * row_stride;
+      ApplyTransform<T>()(out_transform_matrix, out_tile_cols, tile_cols, row,
+                          out_buf_stride, out_buf_stride, row, out_buf_stride);
+    }
+    // Compute output transform along tile rows.
+    const int64 out_row_size = out_tile_cols * out_buf_stride;
+    ApplyTransform<T>()(out_transform_matrix, out_tile_rows, tile_rows,
+                        out_buffer, row_stride, out_row_size,
+                        out_transform_buffer, out_row_size);
 
     const int64 tile_stride_rows = transform->output_shape().rows;
     const int64 tile_stride_cols = transform->output_shape().cols;
@@ -936,8 +1149,15 @@ template <typename T>
 struct DeepConv2D<CPUDevice, T> {
   void operator()(OpKernelContext* ctx, const Conv2DArgs& args, const T* input,
                   const T* filter, T* output) {
-    // TODO(andydavis) Add function to select transform based on conv params.
-    std::unique_ptr<DeepConv2DTransform<T>> transform(new WinogradTransform<T>);
+    std::unique_ptr<DeepConv2DTransform<T>> transform;
+    if (args.algorithm == DeepConv2DAlgorithm::kWinogradF4x4) {
+      // Filter sharding below assumes output tiles of 2x2 for filters larger
+      // than the base filter, which SelectDeepConv2DAlgorithm never chooses.
+      DCHECK(args.filter_rows == 3 && args.filter_cols == 3);
+      transform.reset(new WinogradF4x4Transform<T>);
+    } else {
+      transform.reset(new WinogradTransform<T>);
+    }
 
     const int64 in_depth = args.in_depth;
     const int64 out_depth = args.out_depth;
@@ -948,7 +1168,6 @@ struct DeepConv2D<CPUDevice, T> {
 
     const int64 out_tile_rows = transform->output_shape().rows;
     const int64 out_tile_cols = transform->output_shape().cols;
-    const int64 out_tile_spatial_size = out_tile_rows * out_tile_cols;
 
     const int64 base_filter_rows = transform->filter_shape().rows;
 
@@ -970,36 +1189,42 @@ struct DeepConv2D<CPUDevice, T> {
                  &filter_transform));
     T* filter_transform_data = filter_transform.template flat<T>().data();
 
-    // Transform filters.
-    TransformFilters<T>()(ctx, args, transform.get(), filter_shards_row,
-                          filter_shards_col, filter, filter_transform_data);
-
-    // Pack filters.
+    // Transform and pack filters.
     std::vector<Tensor> packed_filters(tile_spatial_size);
-    PackFilters<T>()(ctx, args, tile_spatial_size, filter_shards_row,
-                     filter_shards_col, filter_transform_data, &packed_filters);
+    if (filter_shards_row == 1 && filter_shards_col == 1 &&
+        args.filter_rows == base_filter_rows &&
+        args.filter_cols == transform->filter_shape().cols) {
+      TransformFiltersSingleShard<T>()(ctx, args, transform.get(), filter,
+                                       filter_transform_data);
+      PackFilters<T, Eigen::ColMajor>()(ctx, args, tile_spatial_size, 1, 1,
+                                        filter_transform_data,
+                                        &packed_filters);
+    } else {
+      TransformFilters<T>()(ctx, args, transform.get(), filter_shards_row,
+                            filter_shards_col, filter, filter_transform_data);
+      PackFilters<T>()(ctx, args, tile_spatial_size, filter_shards_row,
+                       filter_shards_col, filter_transform_data,
+                       &packed_filters);
+    }
 
-    // Allocate buffer for tile transform matrix.
+    // Allocate buffer for 1-D tile transform matrix.
     Tensor tile_transform_matrix_tensor;
-    OP_REQUIRES_OK(ctx, ctx->allocate_temp(
-                            DataTypeToEnum<T>::value,
-                            TensorShape({tile_spatial_size, tile_spatial_size}),
-                            &tile_transform_matrix_tensor));
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                           TensorShape({tile_rows, tile_cols}),
+                                           &tile_transform_matrix_tensor));
     T* tile_transform_matrix =
         tile_transform_matrix_tensor.template flat<T>().data();
-    transform->GetInputTransformMatrix(tile_spatial_size, tile_spatial_size,
-                                       tile_transform_matrix);
+    transform->GetInputTransformMatrix1D(tile_transform_matrix);
 
-    // Allocate buffer for output transform matrix.
+    // Allocate buffer for 1-D output transform matrix.
     Tensor output_transform_matrix_tensor;
-    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::value,
-                                           TensorShape({out_tile_spatial_size,
-                                                        tile_spatial_size}),
-                                           &output_transform_matrix_tensor));
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+                            DataTypeToEnum<T>::value,
+                            TensorShape({out_tile_rows, tile_rows}),
+                            &output_transform_matrix_tensor));
     T* output_transform_matrix =
         output_transform_matrix_tensor.template flat<T>().data();
-    transform->GetOutputTransformMatrix(
-        out_tile_spatial_size, tile_spatial_size, output_transform_matrix);
+    transform->GetOutputTransformMatrix1D(output_transform_matrix);
 
     auto shard = [&ctx, &args, &transform, &packed_filters, &in_depth,
                   out_depth, tile_rows, tile_cols, out_tile_rows, out_tile_cols,
@@ -1020,36 +1245,9 @@ struct DeepConv2D<CPUDevice, T> {
       // Cache budget (based on L2 cache size = 256KB).
       // TODO(andydavis) Read cache size from the system.
       const int64 cache_size = (256LL << 10) / sizeof(T);
-
-      // Fixed costs.
-      const int64 tile_transform_matrix_size =
-          tile_spatial_size * tile_spatial_size;
-      const int64 output_transform_matrix_size =
-          out_tile_spatial_size * tile_spatial_size;
-      // Calculate cache reserve size.
-      const int64 filter_depth_size = in_depth * out_depth * filter_shard_size;
-      const bool small_filter = ((filter_depth_size * 100) / cache_size) <= 25;
-      const int64 cache_reserve_size = small_filter ? filter_depth_size : 1024;
-      // Calculate total fixed cost.
-      const int64 total_fixed_cost = tile_transform_matrix_size +
-                                     output_transform_matrix_size +
-                                     cache_reserve_size;
-
-      // Per-tile costs.
-      const int64 buffer1_per_tile_size =
-          tile_spatial_size * std::max(in_depth, out_depth * filter_shard_size);
-      const int64 buffer2_per_tile_size =
-          std::max(tile_spatial_size * in_depth,
-                   out_tile_spatial_size * out_depth * filter_shard_size);
-      const int64 packed_tile_per_tile_size = in_depth;
-      const int64 gemm_out_per_tile_size = out_depth * filter_shard_size;
-      const int64 total_per_tile_cost =
-          buffer1_per_tile_size + buffer2_per_tile_size +
-          packed_tile_per_tile_size + gemm_out_per_tile_size;
-
-      const int64 num_tiles_cache =
-          std::max(4LL, (cache_size - total_fixed_cost) / total_per_tile_cost);
-      const int64 num_tiles = std::min(num_tiles_cache, col_tiles);
+      const int64 num_tiles = GetNumTilesPerChunk(
+          cache_size, tile_rows, tile_cols, out_tile_rows, out_tile_cols,
+          in_depth, out_depth, filter_shard_size, col_tiles);
 
       // Allocate temporary buffer 'buffer1', which is first used for copying
       // input tiles, then re-used to buffer gemm output. Calculate the
@@ -52,6 +52,16 @@ class DeepConv2DTransform {
   virtual void GetOutputTransformMatrix(const int64 rows, const int64 cols,
                                         T* transform_matrix) const = 0;
 
+  // The input and output transform matrices above are the kronecker products
+  // 'M * M' of the 1-D matrices 'M' returned below, which DeepConv2D applies
+  // separably along the tile rows and then the tile columns (tiles are
+  // square). Data layouts:
+  //   input:  [input_shape().rows, input_shape().rows]
+  //   output: [output_shape().rows, input_shape().rows]
+  virtual void GetInputTransformMatrix1D(T* transform_matrix) const = 0;
+
+  virtual void GetOutputTransformMatrix1D(T* transform_matrix) const = 0;
+
   struct Shape {
     Shape(int64 r, int64 c) : rows(r), cols(c) {}
     int64 rows;
@@ -63,6 +73,16 @@ class DeepConv2DTransform {
   virtual const Shape& output_shape() const = 0;
 };
 
+// Algorithms which can compute a 3x3, stride 1 Conv2D on the CPU.
+enum class DeepConv2DAlgorithm {
+  // Eigen SpatialConvolution (im2col followed by a tensor contraction).
+  kDefault,
+  // DeepConv2D with the Winograd F(2x2, 3x3) transform (4x4 input tiles).
+  kWinogradF2x2,
+  // DeepConv2D with the Winograd F(4x4, 3x3) transform (6x6 input tiles).
+  kWinogradF4x4,
+};
+
 // Conv2D arguments used by DeepConv2D implementation.
 struct Conv2DArgs {
   // Input layer dimensions
@@ -80,6 +100,9 @@ struct Conv2DArgs {
   int out_cols;
   int out_depth;
 
+  // Transform used to compute the convolution.
+  DeepConv2DAlgorithm algorithm;
+
   Conv2DArgs()
       : batch(0),
         in_rows(0),
@@ -91,15 +114,20 @@ struct Conv2DArgs {
         pad_cols(0),
         out_rows(0),
         out_cols(0),
-        out_depth(0) {}
+        out_depth(0),
+        algorithm(DeepConv2DAlgorithm::kWinogradF2x2) {}
 };
 
-// Returns true if convolution operation specified by function arguments
-// can use DeepConv2D implementation, and false otherwise.
-// May return false based on parameters, cost, or whether feature is disabled.
-bool CanUseDeepConv2D(int stride_rows, int stride_cols, int filter_rows,
-                      int filter_cols, int in_depth, int out_depth,
-                      int out_rows, int out_cols);
+// Returns the DeepConv2D algorithm with the lowest estimated cost for the
+// convolution of 'batch' images specified by function arguments, or kDefault
+// if the convolution should not use DeepConv2D.
+// May return kDefault based on parameters, cost, or whether feature is
+// disabled.
+DeepConv2DAlgorithm SelectDeepConv2DAlgorithm(int stride_rows, int stride_cols,
+                                              int filter_rows, int filter_cols,
+                                              int in_depth, int out_depth,
+                                              int out_rows, int out_cols,
+                                              int batch);
 
 namespace functor {
 
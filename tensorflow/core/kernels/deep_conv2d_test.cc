@@ -13,7 +13,17 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <stdlib.h>
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/deep_conv2d.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/winograd_transform.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -155,5 +165,218 @@ TEST(DeepConv2DTransformTest, WingradOutputTransformMatrix) {
   }
 }
 
+// Tests that the kronecker product of the 1-D transform matrices returned by
+// 't' with themselves equals the input and output transform matrices.
+static void TestSeparableTransformMatrices(
+    const DeepConv2DTransform<float>& t) {
+  const int tile_rows = t.input_shape().rows;
+  const int out_tile_rows = t.output_shape().rows;
+
+  std::vector<float> input_1d(tile_rows * tile_rows);
+  t.GetInputTransformMatrix1D(input_1d.data());
+  std::vector<float> input_kron(input_1d.size() * input_1d.size());
+  ComputeKroneckerProduct(tile_rows, tile_rows, input_1d.data(),
+                          input_kron.data());
+  std::vector<float> input_test(input_kron.size());
+  t.GetInputTransformMatrix(tile_rows * tile_rows, tile_rows * tile_rows,
+                            input_test.data());
+  for (int i = 0; i < input_kron.size(); ++i) {
+    EXPECT_FLOAT_EQ(input_kron[i], input_test[i]);
+  }
+
+  std::vector<float> output_1d(out_tile_rows * tile_rows);
+  t.GetOutputTransformMatrix1D(output_1d.data());
+  std::vector<float> output_kron(output_1d.size() * output_1d.size());
+  ComputeKroneckerProduct(out_tile_rows, tile_rows, output_1d.data(),
+                          output_kron.data());
+  std::vector<float> output_test(output_kron.size());
+  t.GetOutputTransformMatrix(out_tile_rows * out_tile_rows,
+                             tile_rows * tile_rows, output_test.data());
+  for (int i = 0; i < output_kron.size(); ++i) {
+    EXPECT_FLOAT_EQ(output_kron[i], output_test[i]);
+  }
+}
+
+TEST(DeepConv2DTransformTest, WinogradSeparableTransformMatrices) {
+  TestSeparableTransformMatrices(WinogradTransform<float>());
+}
+
+TEST(DeepConv2DTransformTest, WinogradF4x4SeparableTransformMatrices) {
+  TestSeparableTransformMatrices(WinogradF4x4Transform<float>());
+}
+
+TEST(DeepConv2DTransformTest, WinogradF4x4FilterTransformMatrix) {
+  // Test that the filter transform matrix returned is the kronecker product of
+  // the following matrix with itself:
+  //
+  //   [ 1/4   0     0    ]
+  //   [-1/6  -1/6  -1/6  ]
+  //   [-1/6   1/6  -1/6  ]
+  //   [ 1/24  1/12  1/6  ]
+  //   [ 1/24 -1/12  1/6  ]
+  //   [ 0     0     1    ]
+  //
+  const int rows = 6;
+  const int cols = 3;
+
+  float transform_matrix[] = {1.0f / 4,   0,           0,
+                              -1.0f / 6,  -1.0f / 6,   -1.0f / 6,
+                              -1.0f / 6,  1.0f / 6,    -1.0f / 6,
+                              1.0f / 24,  1.0f / 12,   1.0f / 6,
+                              1.0f / 24,  -1.0f / 12,  1.0f / 6,
+                              0,          0,           1};
+
+  const int kron_rows = rows * rows;
+  const int kron_cols = cols * cols;
+
+  float transform_matrix_kron[kron_rows * kron_cols];
+
+  ComputeKroneckerProduct(rows, cols, &transform_matrix[0],
+                          &transform_matrix_kron[0]);
+
+  float transform_matrix_test[kron_rows * kron_cols];
+  WinogradF4x4Transform<float> t;
+  t.GetFilterTransformMatrix(kron_rows, kron_cols, &transform_matrix_test[0]);
+
+  for (int i = 0; i < kron_rows * kron_cols; ++i) {
+    EXPECT_FLOAT_EQ(transform_matrix_kron[i], transform_matrix_test[i]);
+  }
+}
+
+TEST(DeepConv2DTransformTest, WinogradF4x4Convolution) {
+  // Test that the transforms compute a 6x6 by 3x3 convolution (correlation):
+  // y = C[(A d) .* (B g)].
+  WinogradF4x4Transform<float> t;
+  const int tile_size = 36;
+  const int filter_size = 9;
+  const int out_size = 16;
+
+  float input[tile_size];
+  for (int i = 0; i < tile_size; ++i) input[i] = (i * 7 % 11) - 5.0f;
+  float filter[filter_size];
+  for (int i = 0; i < filter_size; ++i) filter[i] = (i * 5 % 7) - 3.0f;
+
+  float input_transform[tile_size * tile_size];
+  t.GetInputTransformMatrix(tile_size, tile_size, input_transform);
+  float filter_transform[tile_size * filter_size];
+  t.GetFilterTransformMatrix(tile_size, filter_size, filter_transform);
+  float output_transform[out_size * tile_size];
+  t.GetOutputTransformMatrix(out_size, tile_size, output_transform);
+
+  float product[tile_size];
+  for (int i = 0; i < tile_size; ++i) {
+    float a = 0;
+    for (int j = 0; j < tile_size; ++j) {
+      a += input_transform[i * tile_size + j] * input[j];
+    }
+    float b = 0;
+    for (int j = 0; j < filter_size; ++j) {
+      b += filter_transform[i * filter_size + j] * filter[j];
+    }
+    product[i] = a * b;
+  }
+
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      float expected = 0;
+      for (int fr = 0; fr < 3; ++fr) {
+        for (int fc = 0; fc < 3; ++fc) {
+          expected += input[(r + fr) * 6 + c + fc] * filter[fr * 3 + fc];
+        }
+      }
+      float y = 0;
+      for (int j = 0; j < tile_size; ++j) {
+        y += output_transform[(r * 4 + c) * tile_size + j] * product[j];
+      }
+      EXPECT_NEAR(expected, y, 1e-3);
+    }
+  }
+}
+
+class DeepConv2DTest : public OpsTestBase {
+ protected:
+  // Runs a 3x3, stride 1 Conv2D for which DeepConv2D selects the F(4x4, 3x3)
+  // transform, and compares it against a direct convolution in double.
+  void TestWinogradF4x4(int batch, int in_rows, int in_cols, int in_depth,
+                        int out_depth, const string& padding) {
+    const int pad = padding == "SAME" ? 1 : 0;
+    const int out_rows = in_rows + 2 * pad - 2;
+    const int out_cols = in_cols + 2 * pad - 2;
+    setenv("TF_USE_DEEP_CONV2D", "1", 1);
+    ASSERT_EQ(DeepConv2DAlgorithm::kWinogradF4x4,
+              SelectDeepConv2DAlgorithm(1, 1, 3, 3, in_depth, out_depth,
+                                        out_rows, out_cols, batch));
+
+    TF_ASSERT_OK(NodeDefBuilder("conv_op", "Conv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("strides", {1, 1, 1, 1})
+                     .Attr("padding", padding)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    // Values in [-1, 1), so that the sums cancel.
+    Tensor input(DT_FLOAT, TensorShape({batch, in_rows, in_cols, in_depth}));
+    input.flat<float>().setRandom();
+    input.flat<float>() = input.flat<float>() * 2.0f - 1.0f;
+    Tensor filter(DT_FLOAT, TensorShape({3, 3, in_depth, out_depth}));
+    filter.flat<float>().setRandom();
+    filter.flat<float>() = filter.flat<float>() * 2.0f - 1.0f;
+    AddInputFromArray<float>(input.shape(), input.flat<float>());
+    AddInputFromArray<float>(filter.shape(), filter.flat<float>());
+    const Status status = RunOpKernel();
+    unsetenv("TF_USE_DEEP_CONV2D");
+    TF_ASSERT_OK(status);
+
+    const Tensor& output = *GetOutput(0);
+    ASSERT_EQ(TensorShape({batch, out_rows, out_cols, out_depth}),
+              output.shape());
+    auto in = input.tensor<float, 4>();
+    auto w = filter.tensor<float, 4>();
+    auto out = output.tensor<float, 4>();
+    for (int b = 0; b < batch; ++b) {
+      for (int r = 0; r < out_rows; ++r) {
+        for (int c = 0; c < out_cols; ++c) {
+          for (int d = 0; d < out_depth; ++d) {
+            double expected = 0;
+            double magnitude = 0;
+            for (int fr = 0; fr < 3; ++fr) {
+              const int ir = r + fr - pad;
+              if (ir < 0 || ir >= in_rows) continue;
+              for (int fc = 0; fc < 3; ++fc) {
+                const int ic = c + fc - pad;
+                if (ic < 0 || ic >= in_cols) continue;
+                for (int k = 0; k < in_depth; ++k) {
+                  const double p = static_cast<double>(in(b, ir, ic, k)) *
+                                   w(fr, fc, k, d);
+                  expected += p;
+                  magnitude += std::abs(p);
+                }
+              }
+            }
+            // The F(4x4, 3x3) transforms scale the terms by up to 5 and by
+            // fractions like 1/24, and the products are summed over the
+            // input depth in the transformed domain. In float, this loses up
+            // to ~1e-6 of sum(|x * w|), about 10x the rounding error of a
+            // direct convolution, rather than of the (cancelling) result.
+            ASSERT_NEAR(expected, out(b, r, c, d), 1e-5 * magnitude)
+                << "at " << b << ", " << r << ", " << c << ", " << d;
+          }
+        }
+      }
+    }
+  }
+};
+
+// The output rows and cols are not multiples of 4, so the last tiles are
+// partial, and with SAME padding the first and last tiles read the padding.
+TEST_F(DeepConv2DTest, WinogradF4x4MatchesDirectConvolutionSame) {
+  TestWinogradF4x4(2, 31, 31, 48, 64, "SAME");
+}
+
+TEST_F(DeepConv2DTest, WinogradF4x4MatchesDirectConvolutionValid) {
+  TestWinogradF4x4(2, 31, 31, 48, 64, "VALID");
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include "tensorflow/core/framework/numeric_op.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -362,6 +363,58 @@ static void ComputeBackpropInput(const DepthwiseArgs& args,
   }
 }
 
+// Computes rows [start, limit) of the depthwise conv2d backprop input of
+// 'out_backprop' by 'filter' for 'depth_multiplier' == 1, where row 'i' is
+// input row 'i % in_rows' of image 'i / in_rows'. Each input point is computed
+// by DepthwiseTapsDotOp directly from the output points which used it during
+// the forward pass, so (unlike CopyOutputBackpropRegion) nothing is copied.
+template <typename T>
+static void DepthwiseConvBackpropInputDirectRows(const DepthwiseArgs& args,
+                                                 const T* out_backprop,
+                                                 const T* filter,
+                                                 const int64 start,
+                                                 const int64 limit,
+                                                 T* in_backprop) {
+  const int64 depth = args.in_depth;
+  const int64 stride = args.stride;
+  const int64 output_image_size = args.out_rows * args.out_cols * depth;
+  const int64 input_row_size = args.in_cols * depth;
+  const int64 filter_spatial_size = args.filter_rows * args.filter_cols;
+  std::vector<const T*> out_bprops(filter_spatial_size);
+  std::vector<const T*> filters(filter_spatial_size);
+
+  for (int64 i = start; i < limit; ++i) {
+    const int64 b = i / args.in_rows;
+    const int64 in_r = i % args.in_rows;
+    const T* out_bprop_image = out_backprop + b * output_image_size;
+    T* in_bprop_row = in_backprop + i * input_row_size;
+
+    for (int64 in_c = 0; in_c < args.in_cols; ++in_c) {
+      // Gather the (output point, filter tap) pairs which used (in_r, in_c).
+      int num_taps = 0;
+      for (int64 f_r = 0; f_r < args.filter_rows; ++f_r) {
+        const int64 out_r_scaled = in_r + args.pad_rows - f_r;
+        if (out_r_scaled < 0 || out_r_scaled % stride != 0) continue;
+        const int64 out_r = out_r_scaled / stride;
+        if (out_r >= args.out_rows) continue;
+        for (int64 f_c = 0; f_c < args.filter_cols; ++f_c) {
+          const int64 out_c_scaled = in_c + args.pad_cols - f_c;
+          if (out_c_scaled < 0 || out_c_scaled % stride != 0) continue;
+          const int64 out_c = out_c_scaled / stride;
+          if (out_c >= args.out_cols) continue;
+          out_bprops[num_taps] =
+              out_bprop_image + (out_r * args.out_cols + out_c) * depth;
+          filters[num_taps] = filter + (f_r * args.filter_cols + f_c) * depth;
+          ++num_taps;
+        }
+      }
+      functor::DepthwiseTapsDotOp<T>()(depth, num_taps, out_bprops.data(),
+                                       filters.data(),
+                                       in_bprop_row + in_c * depth);
+    }
+  }
+}
+
 // Computes the depthwise conv2d backprop input of 'out_backprop' by
 // 'depthwise_filter' and stores the result in 'in_backprop'.
 template <typename T>
@@ -378,6 +431,23 @@ struct LaunchDepthwiseConvBackpropInputOp<CPUDevice, T> {
 
     static const int64 kPacketSize = (sizeof(Packet) / sizeof(T));
 
+    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+
+    if (args.depth_multiplier == 1) {
+      // Parallelize over the input rows of all images.
+      auto shard = [&args, &out_backprop, &depthwise_filter, &in_backprop](
+                       int64 start, int64 limit) {
+        DepthwiseConvBackpropInputDirectRows<T>(
+            args, out_backprop, depthwise_filter, start, limit, in_backprop);
+      };
+      const int64 shard_cost = args.in_cols * args.in_depth *
+                               args.filter_rows * args.filter_cols /
+                               (args.stride * args.stride);
+      Shard(worker_threads.num_threads, worker_threads.workers,
+            args.batch * args.in_rows, shard_cost, shard);
+      return;
+    }
+
     // Pad 'depthwise_filter' to vector register width (if needed).
     const bool pad_filter = (args.out_depth % kPacketSize) == 0 ? false : true;
     Tensor padded_filter;
@@ -447,7 +517,6 @@ struct LaunchDepthwiseConvBackpropInputOp<CPUDevice, T> {
     };
 
     const int64 shard_cost = args.in_rows * args.in_cols * args.out_depth;
-    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, args.batch,
           shard_cost, shard);
   }
@@ -717,6 +786,137 @@ static void ComputeBackpropFilter(const DepthwiseArgs& args,
   }
 }
 
+// Accumulates the filter backprop of output rows [start, limit) into
+// 'filter_backprop' ([filter_rows, filter_cols, depth]) for
+// 'depth_multiplier' == 1, where row 'i' is output row 'i % out_rows' of image
+// 'i / out_rows'. For each filter tap, the products of an 'out_backprop' row
+// and the input points the tap touched are accumulated in vector registers
+// along the row, and added to 'filter_backprop' once per tap and row.
+template <typename T>
+static void DepthwiseConvBackpropFilterDirectRows(const DepthwiseArgs& args,
+                                                  const T* out_backprop,
+                                                  const T* input,
+                                                  const int64 start,
+                                                  const int64 limit,
+                                                  T* filter_backprop) {
+  typedef typename Eigen::internal::packet_traits<T>::type Packet;
+  static const int64 kPacketSize = (sizeof(Packet) / sizeof(T));
+
+  const int64 depth = args.out_depth;
+  const int64 stride = args.stride;
+  const int64 input_image_size = args.in_rows * args.in_cols * depth;
+  const int64 output_row_size = args.out_cols * depth;
+  const int64 input_step = stride * depth;
+
+  const int64 block_size = 4 * kPacketSize;
+  const int64 blocked_size = (depth / block_size) * block_size;
+  const int64 vectorized_size = (depth / kPacketSize) * kPacketSize;
+
+  for (int64 i = start; i < limit; ++i) {
+    const int64 b = i / args.out_rows;
+    const int64 out_r = i % args.out_rows;
+    const T* input_image = input + b * input_image_size;
+    const T* out_bprop_row = out_backprop + i * output_row_size;
+
+    // Range of filter rows which fall inside the input.
+    const int64 in_r_start = out_r * stride - args.pad_rows;
+    const int64 f_r_start = std::max<int64>(0, -in_r_start);
+    const int64 f_r_end =
+        std::min<int64>(args.filter_rows, args.in_rows - in_r_start);
+
+    for (int64 f_r = f_r_start; f_r < f_r_end; ++f_r) {
+      const T* input_row =
+          input_image + (in_r_start + f_r) * args.in_cols * depth;
+      for (int64 f_c = 0; f_c < args.filter_cols; ++f_c) {
+        // Range of output cols [out_c_start, out_c_end) for which this tap
+        // falls inside the input.
+        const int64 in_c_offset = f_c - args.pad_cols;
+        const int64 out_c_start =
+            in_c_offset < 0 ? (-in_c_offset + stride - 1) / stride : 0;
+        const int64 in_c_last = args.in_cols - 1 - in_c_offset;
+        const int64 out_c_end =
+            in_c_last < 0 ? 0
+                          : std::min<int64>(args.out_cols,
+                                            in_c_last / stride + 1);
+        const int64 num_cols = out_c_end - out_c_start;
+        if (num_cols <= 0) continue;
+
+        const T* in =
+            input_row + (out_c_start * stride + in_c_offset) * depth;
+        const T* out_bprop = out_bprop_row + out_c_start * depth;
+        T* filter_bprop =
+            filter_backprop + (f_r * args.filter_cols + f_c) * depth;
+
+        for (int64 d = 0; d < blocked_size; d += block_size) {
+          auto vaccum0 = Eigen::internal::pset1<Packet>(static_cast<T>(0));
+          auto vaccum1 = vaccum0;
+          auto vaccum2 = vaccum0;
+          auto vaccum3 = vaccum0;
+          for (int64 c = 0; c < num_cols; ++c) {
+            const T* in_data = in + c * input_step + d;
+            const T* out_data = out_bprop + c * depth + d;
+            vaccum0 = Eigen::internal::pmadd<Packet>(
+                Eigen::internal::ploadu<Packet>(out_data),
+                Eigen::internal::ploadu<Packet>(in_data), vaccum0);
+            vaccum1 = Eigen::internal::pmadd<Packet>(
+                Eigen::internal::ploadu<Packet>(out_data + kPacketSize),
+                Eigen::internal::ploadu<Packet>(in_data + kPacketSize),
+                vaccum1);
+            vaccum2 = Eigen::internal::pmadd<Packet>(
+                Eigen::internal::ploadu<Packet>(out_data + 2 * kPacketSize),
+                Eigen::internal::ploadu<Packet>(in_data + 2 * kPacketSize),
+                vaccum2);
+            vaccum3 = Eigen::internal::pmadd<Packet>(
+                Eigen::internal::ploadu<Packet>(out_data + 3 * kPacketSize),
+                Eigen::internal::ploadu<Packet>(in_data + 3 * kPacketSize),
+                vaccum3);
+          }
+          T* f = filter_bprop + d;
+          Eigen::internal::pstoreu<T>(
+              f, Eigen::internal::padd<Packet>(
+                     Eigen::internal::ploadu<Packet>(f), vaccum0));
+          Eigen::internal::pstoreu<T>(
+              f + kPacketSize,
+              Eigen::internal::padd<Packet>(
+                  Eigen::internal::ploadu<Packet>(f + kPacketSize), vaccum1));
+          Eigen::internal::pstoreu<T>(
+              f + 2 * kPacketSize,
+              Eigen::internal::padd<Packet>(
+                  Eigen::internal::ploadu<Packet>(f + 2 * kPacketSize),
+                  vaccum2));
+          Eigen::internal::pstoreu<T>(
+              f + 3 * kPacketSize,
+              Eigen::internal::padd<Packet>(
+                  Eigen::internal::ploadu<Packet>(f + 3 * kPacketSize),
+                  vaccum3));
+        }
+
+        for (int64 d = blocked_size; d < vectorized_size; d += kPacketSize) {
+          auto vaccum = Eigen::internal::pset1<Packet>(static_cast<T>(0));
+          for (int64 c = 0; c < num_cols; ++c) {
+            vaccum = Eigen::internal::pmadd<Packet>(
+                Eigen::internal::ploadu<Packet>(out_bprop + c * depth + d),
+                Eigen::internal::ploadu<Packet>(in + c * input_step + d),
+                vaccum);
+          }
+          Eigen::internal::pstoreu<T>(
+              filter_bprop + d,
+              Eigen::internal::padd<Packet>(
+                  Eigen::internal::ploadu<Packet>(filter_bprop + d), vaccum));
+        }
+
+        for (int64 d = vectorized_size; d < depth; ++d) {
+          T accum = static_cast<T>(0);
+          for (int64 c = 0; c < num_cols; ++c) {
+            accum += out_bprop[c * depth + d] * in[c * input_step + d];
+          }
+          filter_bprop[d] += accum;
+        }
+      }
+    }
+  }
+}
+
 template <typename Device, typename T>
 struct LaunchDepthwiseConvBackpropFilterOp;
 
@@ -735,6 +935,53 @@ struct LaunchDepthwiseConvBackpropFilterOp<CPUDevice, T> {
     static const int64 kPacketSize = (sizeof(Packet) / sizeof(T));
 
     const int64 filter_spatial_size = args.filter_rows * args.filter_cols;
+    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+
+    if (args.depth_multiplier == 1) {
+      // Parallelize over the output rows of all images: each block of rows
+      // accumulates into its own buffer, and the buffers are summed at the
+      // end.
+      const int64 num_rows = args.batch * args.out_rows;
+      const int64 filter_size = filter_spatial_size * args.out_depth;
+      if (num_rows == 0) {
+        // Nothing contributes to the gradient, e.g. for an empty batch.
+        typename TTypes<T>::Flat(filter_backprop, filter_size).setZero();
+        return;
+      }
+      const int64 num_blocks = std::min<int64>(
+          num_rows, 4 * std::max(1, worker_threads.num_threads));
+      Tensor block_buffers;
+      OP_REQUIRES_OK(ctx, ctx->allocate_temp(
+                              DataTypeToEnum<T>::value,
+                              TensorShape({num_blocks, filter_size}),
+                              &block_buffers));
+      T* block_buffers_data = block_buffers.template flat<T>().data();
+
+      auto shard = [&args, &out_backprop, &input, num_rows, num_blocks,
+                    filter_size, block_buffers_data](int64 start, int64 limit) {
+        for (int64 j = start; j < limit; ++j) {
+          T* block_buffer = block_buffers_data + j * filter_size;
+          memset(block_buffer, 0, filter_size * sizeof(T));
+          DepthwiseConvBackpropFilterDirectRows<T>(
+              args, out_backprop, input, j * num_rows / num_blocks,
+              (j + 1) * num_rows / num_blocks, block_buffer);
+        }
+      };
+      const int64 shard_cost =
+          (num_rows / num_blocks) * args.out_cols * filter_size;
+      Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+            shard_cost, shard);
+
+      typename TTypes<T, 2>::ConstTensor buffers(block_buffers_data,
+                                                 num_blocks, filter_size);
+      typename TTypes<T>::Flat filter_backprop_flat(filter_backprop,
+                                                    filter_size);
+      const Eigen::array<int, 1> reduce_dims = {0};
+      filter_backprop_flat.device(ctx->eigen_device<CPUDevice>()) =
+          buffers.sum(reduce_dims);
+      return;
+    }
+
     const int64 padded_out_depth_size =
         ((args.out_depth + kPacketSize - 1) / kPacketSize) * kPacketSize;
 
@@ -792,7 +1039,6 @@ struct LaunchDepthwiseConvBackpropFilterOp<CPUDevice, T> {
       }
     };
     const int64 shard_cost = args.out_rows * args.out_cols * args.out_depth;
-    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, args.batch,
           shard_cost, shard);
 
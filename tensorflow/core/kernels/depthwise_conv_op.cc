@@ -18,6 +18,7 @@ limitations under the License.
 #include <algorithm>
 #include <cmath>
 #include <type_traits>
+#include <vector>
 
 #include "tensorflow/core/framework/numeric_op.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -138,16 +139,71 @@ struct DepthwiseConv2DKernel {
   }
 };
 
+// Computes rows [start, limit) of the depthwise conv2d of 'input' by 'filter'
+// for 'depth_multiplier' == 1, where row 'i' is output row 'i % out_rows' of
+// image 'i / out_rows'. Each output point is computed by DepthwiseTapsDotOp
+// directly from the input and the (unpadded) filter, skipping the filter taps
+// which fall into the padding, so no input patch is copied.
+template <typename T>
+static void DepthwiseConv2DDirectRows(const DepthwiseArgs& args,
+                                      const T* input, const T* filter,
+                                      const int64 start, const int64 limit,
+                                      T* output) {
+  const int64 depth = args.out_depth;
+  const int64 input_image_size = args.in_rows * args.in_cols * depth;
+  const int64 output_row_size = args.out_cols * depth;
+  const int64 filter_spatial_size = args.filter_rows * args.filter_cols;
+  std::vector<const T*> inputs(filter_spatial_size);
+  std::vector<const T*> filters(filter_spatial_size);
+
+  for (int64 i = start; i < limit; ++i) {
+    const int64 b = i / args.out_rows;
+    const int64 out_r = i % args.out_rows;
+    const T* input_image = input + b * input_image_size;
+    T* output_row = output + i * output_row_size;
+
+    // Range of filter rows which fall inside the input.
+    const int64 in_r_start = out_r * args.stride - args.pad_rows;
+    const int64 f_r_start = std::max<int64>(0, -in_r_start);
+    const int64 f_r_end =
+        std::min<int64>(args.filter_rows, args.in_rows - in_r_start);
+
+    for (int64 out_c = 0; out_c < args.out_cols; ++out_c) {
+      // Range of filter cols which fall inside the input.
+      const int64 in_c_start = out_c * args.stride - args.pad_cols;
+      const int64 f_c_start = std::max<int64>(0, -in_c_start);
+      const int64 f_c_end =
+          std::min<int64>(args.filter_cols, args.in_cols - in_c_start);
+
+      int num_taps = 0;
+      for (int64 f_r = f_r_start; f_r < f_r_end; ++f_r) {
+        const T* input_row =
+            input_image + (in_r_start + f_r) * args.in_cols * depth;
+        for (int64 f_c = f_c_start; f_c < f_c_end; ++f_c) {
+          inputs[num_taps] = input_row + (in_c_start + f_c) * depth;
+          filters[num_taps] = filter + (f_r * args.filter_cols + f_c) * depth;
+          ++num_taps;
+        }
+      }
+      functor::DepthwiseTapsDotOp<T>()(depth, num_taps, inputs.data(),
+                                       filters.data(),
+                                       output_row + out_c * depth);
+    }
+  }
+}
+
 // Computes the depthwise conv2d of 'input' by 'depthwise_filter' and stores
-// the result in 'output'. This implementation trades off copying small patches
-// of the input to achieve better data alignment, which enables vectorized
-// load/store and multiply-add operations (see comments at InputBufferCopyOp and
-// DepthwiseConv2DKernel for details).
+// the result in 'output'.
+//
+// For 'depth_multiplier' == 1 (e.g. all of MobileNet's depthwise layers),
+// output points are computed directly from the input by
+// DepthwiseConv2DDirectRows. Otherwise this implementation trades off copying
+// small patches of the input to achieve better data alignment, which enables
+// vectorized load/store and multiply-add operations (see comments at
+// InputBufferCopyOp and DepthwiseConv2DKernel for details).
 //
 // TODO(andydavis) Evaluate the performance of processing multiple input
 // patches in the inner loop.
-// TODO(andydavis) Consider a zero-copy implementation for the case when
-// 'in_depth' is a multiple of register width, and 'depth_multipler' is one.
 // TODO(andydavis) Evaluate the performance of alternative implementations.
 template <typename T>
 struct LaunchDepthwiseConvOp<CPUDevice, T> {
@@ -162,6 +218,21 @@ struct LaunchDepthwiseConvOp<CPUDevice, T> {
             "Depthwise convolution on CPU is only supported for NHWC format"));
     static const int64 kPacketSize = (sizeof(Packet) / sizeof(T));
 
+    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+
+    if (args.depth_multiplier == 1) {
+      auto shard = [&args, &input, &depthwise_filter, &output](int64 start,
+                                                                int64 limit) {
+        DepthwiseConv2DDirectRows<T>(args, input, depthwise_filter, start,
+                                     limit, output);
+      };
+      const int64 shard_cost = args.out_cols * args.out_depth *
+                               args.filter_rows * args.filter_cols;
+      Shard(worker_threads.num_threads, worker_threads.workers,
+            args.batch * args.out_rows, shard_cost, shard);
+      return;
+    }
+
     // Pad 'depthwise_filter' to vector register width (if needed).
     const bool pad_filter = (args.out_depth % kPacketSize) == 0 ? false : true;
     Tensor padded_filter;
@@ -234,7 +305,6 @@ struct LaunchDepthwiseConvOp<CPUDevice, T> {
     // flops/loads/stores required to compute one shard.
     const int64 shard_cost = kCostMultiplier * args.out_cols * args.out_depth;
 
-    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, total_shards,
           shard_cost, shard);
   }
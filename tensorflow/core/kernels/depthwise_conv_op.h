@@ -281,6 +281,74 @@ struct DepthwiseInputCopyOp {
   }
 };
 
+// Computes one output point of a depthwise convolution with
+// 'depth_multiplier' == 1 directly from the input points it depends on:
+//
+//   output[d] = sum_t (inputs[t][d] * filters[t][d]),  for d in [0, depth)
+//
+// where 'inputs' and 'filters' point to the 'num_taps' input points and filter
+// taps (each 'depth' elements long) which contribute to the output point.
+// Unlike DepthwiseInputCopyOp, inputs are read in place, so the kernel needs no
+// input buffer. Four vector accumulators are kept in registers so that the
+// multiply-adds of consecutive packets along 'depth' can overlap.
+template <typename T>
+struct DepthwiseTapsDotOp {
+  void operator()(const int64 depth, const int num_taps, const T* const* inputs,
+                  const T* const* filters, T* output) {
+    typedef typename Eigen::internal::packet_traits<T>::type Packet;
+    static const int64 kPacketSize = (sizeof(Packet) / sizeof(T));
+
+    const int64 block_size = 4 * kPacketSize;
+    const int64 blocked_size = (depth / block_size) * block_size;
+    const int64 vectorized_size = (depth / kPacketSize) * kPacketSize;
+
+    for (int64 d = 0; d < blocked_size; d += block_size) {
+      auto vaccum0 = Eigen::internal::pset1<Packet>(static_cast<T>(0));
+      auto vaccum1 = vaccum0;
+      auto vaccum2 = vaccum0;
+      auto vaccum3 = vaccum0;
+      for (int t = 0; t < num_taps; ++t) {
+        const T* in = inputs[t] + d;
+        const T* filter = filters[t] + d;
+        vaccum0 = Eigen::internal::pmadd<Packet>(
+            Eigen::internal::ploadu<Packet>(filter),
+            Eigen::internal::ploadu<Packet>(in), vaccum0);
+        vaccum1 = Eigen::internal::pmadd<Packet>(
+            Eigen::internal::ploadu<Packet>(filter + kPacketSize),
+            Eigen::internal::ploadu<Packet>(in + kPacketSize), vaccum1);
+        vaccum2 = Eigen::internal::pmadd<Packet>(
+            Eigen::internal::ploadu<Packet>(filter + 2 * kPacketSize),
+            Eigen::internal::ploadu<Packet>(in + 2 * kPacketSize), vaccum2);
+        vaccum3 = Eigen::internal::pmadd<Packet>(
+            Eigen::internal::ploadu<Packet>(filter + 3 * kPacketSize),
+            Eigen::internal::ploadu<Packet>(in + 3 * kPacketSize), vaccum3);
+      }
+      Eigen::internal::pstoreu<T>(output + d, vaccum0);
+      Eigen::internal::pstoreu<T>(output + d + kPacketSize, vaccum1);
+      Eigen::internal::pstoreu<T>(output + d + 2 * kPacketSize, vaccum2);
+      Eigen::internal::pstoreu<T>(output + d + 3 * kPacketSize, vaccum3);
+    }
+
+    for (int64 d = blocked_size; d < vectorized_size; d += kPacketSize) {
+      auto vaccum = Eigen::internal::pset1<Packet>(static_cast<T>(0));
+      for (int t = 0; t < num_taps; ++t) {
+        vaccum = Eigen::internal::pmadd<Packet>(
+            Eigen::internal::ploadu<Packet>(filters[t] + d),
+            Eigen::internal::ploadu<Packet>(inputs[t] + d), vaccum);
+      }
+      Eigen::internal::pstoreu<T>(output + d, vaccum);
+    }
+
+    for (int64 d = vectorized_size; d < depth; ++d) {
+      T accum = static_cast<T>(0);
+      for (int t = 0; t < num_taps; ++t) {
+        accum += filters[t][d] * inputs[t][d];
+      }
+      output[d] = accum;
+    }
+  }
+};
+
 }  // namespace functor
 }  // namespace tensorflow
 
@@ -15,6 +15,7 @@ limitations under the License.
 
 // See docs in ../ops/data_flow_ops.cc.
 
+#include <algorithm>
 #include <vector>
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -22,12 +23,21 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
 // Shared code that is not dependent on the type of T.  We do this to reduce
 // code size by not duplicating all this for all T (float, double, int32, etc.)
+//
+// The partitions are processed in blocks, in parallel, in two passes. The
+// first pass counts the elements of each partition in each block. Prefix
+// sums of those counts then give every block its own range of rows in each
+// output, so the second pass copies the blocks in parallel, and the outputs
+// keep the order of the input.
 class DynamicPartitionOp_Shared : public OpKernel {
  public:
   explicit DynamicPartitionOp_Shared(OpKernelConstruction* c) : OpKernel(c) {
@@ -39,9 +49,14 @@ class DynamicPartitionOp_Shared : public OpKernel {
     //   in the graph?
   }
 
+  // Validates the inputs and allocates the outputs. The partitions are split
+  // into blocks of *block_size elements, and on return
+  // (*block_offsets)[b * num_partitions_ + p] is the first row of output p
+  // that block b writes. A last row of offsets holds the output sizes.
   void ValidateAndAllocateOutputs(OpKernelContext* c, const Tensor** data,
                                   const Tensor** partitions,
-                                  OpOutputList* Tout) {
+                                  OpOutputList* Tout, int64* block_size,
+                                  std::vector<int64>* block_offsets) {
     OP_REQUIRES_OK(c, c->input("data", data));
     OP_REQUIRES_OK(c, c->input("partitions", partitions));
     OP_REQUIRES(
@@ -52,21 +67,62 @@ class DynamicPartitionOp_Shared : public OpKernel {
             "got data.shape = ", (*data)->shape().DebugString(),
             ", partitions.shape = ", (*partitions)->shape().DebugString()));
 
-    // Count how many occurrences of each partition id we have in partitions
-    gtl::InlinedVector<int, 32> partition_count(num_partitions_);
     auto e_partitions = (*partitions)->flat<int32>();
     const int64 N = e_partitions.dimension(0);
-    for (int64 i = 0; i < N; i++) {
-      const int32 p = internal::SubtleMustCopy(e_partitions(i));
-      OP_REQUIRES(c, FastBoundsCheck(p, num_partitions_),
-                  errors::InvalidArgument(
-                      "partitions", SliceDebugString((*partitions)->shape(), i),
-                      " = ", p, " is not in [0, ", num_partitions_, ")"));
-      partition_count[p]++;
+    const int64 slice_size = N == 0 ? 0 : (*data)->NumElements() / N;
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    // Blocks span at least as many elements as there are partitions, so that
+    // the offsets take no more memory than the partitions themselves.
+    const int64 min_block_size = std::max<int64>(
+        {kMinBlockElements / std::max<int64>(slice_size, 1),
+         static_cast<int64>(num_partitions_), 1});
+    const int64 num_blocks = std::max<int64>(
+        1, std::min<int64>(N / min_block_size,
+                           kBlocksPerThread * worker_threads->num_threads));
+    *block_size = std::max<int64>(1, (N + num_blocks - 1) / num_blocks);
+    const int64 num_partitions = std::max(num_partitions_, 0);
+    block_offsets->assign((num_blocks + 1) * num_partitions, 0);
+
+    // Count how many occurrences of each partition id we have in each block
+    // of partitions.
+    BlockErrors block_errors(N);
+    auto count_blocks = [&](int64 start_block, int64 limit_block) {
+      for (int64 b = start_block; b < limit_block; ++b) {
+        int64* counts = block_offsets->data() + b * num_partitions;
+        const int64 limit = std::min((b + 1) * *block_size, N);
+        for (int64 i = b * *block_size; i < limit; i++) {
+          const int32 p = internal::SubtleMustCopy(e_partitions(i));
+          if (!FastBoundsCheck(p, num_partitions_)) {
+            block_errors.Record(
+                i, errors::InvalidArgument(
+                       "partitions",
+                       SliceDebugString((*partitions)->shape(), i), " = ", p,
+                       " is not in [0, ", num_partitions_, ")"));
+            break;
+          }
+          counts[p]++;
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          *block_size, count_blocks);
+    OP_REQUIRES_OK(c, block_errors.status());
+
+    // Turn the counts into offsets within each output.
+    for (int64 p = 0; p < num_partitions; p++) {
+      int64 offset = 0;
+      for (int64 b = 0; b <= num_blocks; b++) {
+        int64* count = &(*block_offsets)[b * num_partitions + p];
+        const int64 block_count = *count;
+        *count = offset;
+        offset += block_count;
+      }
     }
 
     // Allocate output tensors of the right size
     OP_REQUIRES_OK(c, c->output_list("outputs", Tout));
+    const int64* partition_count =
+        block_offsets->data() + num_blocks * num_partitions;
     for (int p = 0; p < num_partitions_; p++) {
       TensorShape shape;
       shape.AddDim(partition_count[p]);
@@ -79,6 +135,37 @@ class DynamicPartitionOp_Shared : public OpKernel {
   }
 
  protected:
+  // Keeps the error of the lowest failing partition index, so that the
+  // reported error does not depend on the order in which blocks run.
+  class BlockErrors {
+   public:
+    explicit BlockErrors(int64 num_indices) : first_bad_index_(num_indices) {}
+
+    void Record(int64 index, const Status& s) {
+      mutex_lock l(mu_);
+      if (index < first_bad_index_) {
+        first_bad_index_ = index;
+        status_ = s;
+      }
+    }
+
+    Status status() {
+      mutex_lock l(mu_);
+      return status_;
+    }
+
+   private:
+    mutex mu_;
+    int64 first_bad_index_ GUARDED_BY(mu_);
+    Status status_ GUARDED_BY(mu_);
+  };
+
+  // Partitions are only split into blocks of at least this many data
+  // elements.
+  static constexpr int64 kMinBlockElements = 1 << 16;
+  // A few blocks per thread even out blocks with different costs.
+  static constexpr int64 kBlocksPerThread = 4;
+
   int num_partitions_;
 };
 
@@ -91,13 +178,19 @@ class DynamicPartitionOp : public DynamicPartitionOp_Shared {
     const Tensor* data;
     const Tensor* partitions;
     OpOutputList outputs;
-    ValidateAndAllocateOutputs(c, &data, &partitions, &outputs);
+    int64 block_size;
+    std::vector<int64> block_offsets;
+    ValidateAndAllocateOutputs(c, &data, &partitions, &outputs, &block_size,
+                               &block_offsets);
     if (!c->status().ok()) return;
     if (num_partitions_ == 0 || data->NumElements() == 0) return;
 
     auto e_partitions = partitions->flat<int32>();
     const int64 N = e_partitions.dimension(0);
-    gtl::InlinedVector<int, 32> output_index(num_partitions_);
+    const int64 num_blocks = block_offsets.size() / num_partitions_ - 1;
+    const int64 slice_size = data->NumElements() / N;
+    auto worker_threads = c->device()->tensorflow_cpu_worker_threads();
+    BlockErrors block_errors(N);
 
     if (partitions->dims() == data->dims()) {
       // Walk through data and copy the data to the appropriate output tensor
@@ -109,19 +202,37 @@ class DynamicPartitionOp : public DynamicPartitionOp_Shared {
       for (int p = 0; p < num_partitions_; p++) {
         out_vec.push_back(outputs[p]->vec<T>());
       }
-      for (int64 i = 0; i < N; i++) {
-        const int32 p = internal::SubtleMustCopy(e_partitions(i));
-        OP_REQUIRES(
-            c, FastBoundsCheck(p, num_partitions_),
-            errors::InvalidArgument("indices[", i, "] is out of range"));
-        auto oi = output_index[p];
-        OP_REQUIRES(c, FastBoundsCheck(oi, out_vec[p].size()),
-                    errors::InvalidArgument(
-                        "out_vec[", p, "] size: ", out_vec[p].size(),
-                        " is not LTE output_index[", p, "] : ", oi));
-        out_vec[p](oi) = data_flat(i);
-        output_index[p]++;
-      }
+      auto partition_blocks = [&](int64 start_block, int64 limit_block) {
+        for (int64 b = start_block; b < limit_block; ++b) {
+          gtl::InlinedVector<int64, 32> output_index(
+              block_offsets.begin() + b * num_partitions_,
+              block_offsets.begin() + (b + 1) * num_partitions_);
+          const int64* output_limit =
+              block_offsets.data() + (b + 1) * num_partitions_;
+          const int64 limit = std::min((b + 1) * block_size, N);
+          for (int64 i = b * block_size; i < limit; i++) {
+            const int32 p = internal::SubtleMustCopy(e_partitions(i));
+            if (!FastBoundsCheck(p, num_partitions_)) {
+              block_errors.Record(
+                  i, errors::InvalidArgument("indices[", i,
+                                             "] is out of range"));
+              break;
+            }
+            auto oi = output_index[p];
+            if (!FastBoundsCheck(oi, output_limit[p])) {
+              block_errors.Record(
+                  i, errors::InvalidArgument(
+                         "out_vec[", p, "] size: ", out_vec[p].size(),
+                         " is not LTE output_index[", p, "] : ", oi));
+              break;
+            }
+            out_vec[p](oi) = data_flat(i);
+            output_index[p]++;
+          }
+        }
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers,
+            num_blocks, block_size * sizeof(T), partition_blocks);
     } else {
       // If data has extra dimensions, use Eigen slices
       std::vector<Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>,
@@ -133,28 +244,46 @@ class DynamicPartitionOp : public DynamicPartitionOp_Shared {
       }
 
       // Walk through data and copy the data to the appropriate output tensor
-      const int64 slice_size = data->NumElements() / N;
       const auto data_flat = data->shaped<T, 2>({N, slice_size});
       Eigen::DSizes<Eigen::DenseIndex, 2> sizes(1, slice_size);
-      for (int64 i = 0; i < N; i++) {
-        // outputs[p][output_index[p]++] = data[i]
-        const int32 p = internal::SubtleMustCopy(e_partitions(i));
-        OP_REQUIRES(
-            c, FastBoundsCheck(p, num_partitions_),
-            errors::InvalidArgument("indices[", i,
-                                    "] has been asynchronously overwitten and "
-                                    "is no longer in range!"));
-        auto oi = output_index[p];
-        OP_REQUIRES(c, FastBoundsCheck(oi, out_flat[p].dimension(0)),
-                    errors::InvalidArgument("Size of output_index: ", oi,
-                                            " is no longer in range."));
-        Eigen::DSizes<Eigen::DenseIndex, 2> out_indices(oi, 0);
-        Eigen::DSizes<Eigen::DenseIndex, 2> data_indices(i, 0);
-        out_flat[p].slice(out_indices, sizes) =
-            data_flat.slice(data_indices, sizes);
-        output_index[p]++;
-      }
+      auto partition_blocks = [&](int64 start_block, int64 limit_block) {
+        for (int64 b = start_block; b < limit_block; ++b) {
+          gtl::InlinedVector<int64, 32> output_index(
+              block_offsets.begin() + b * num_partitions_,
+              block_offsets.begin() + (b + 1) * num_partitions_);
+          const int64* output_limit =
+              block_offsets.data() + (b + 1) * num_partitions_;
+          const int64 limit = std::min((b + 1) * block_size, N);
+          for (int64 i = b * block_size; i < limit; i++) {
+            // outputs[p][output_index[p]++] = data[i]
+            const int32 p = internal::SubtleMustCopy(e_partitions(i));
+            if (!FastBoundsCheck(p, num_partitions_)) {
+              block_errors.Record(
+                  i, errors::InvalidArgument(
+                         "indices[", i,
+                         "] has been asynchronously overwitten and "
+                         "is no longer in range!"));
+              break;
+            }
+            auto oi = output_index[p];
+            if (!FastBoundsCheck(oi, output_limit[p])) {
+              block_errors.Record(
+                  i, errors::InvalidArgument("Size of output_index: ", oi,
+                                             " is no longer in range."));
+              break;
+            }
+            Eigen::DSizes<Eigen::DenseIndex, 2> out_indices(oi, 0);
+            Eigen::DSizes<Eigen::DenseIndex, 2> data_indices(i, 0);
+            out_flat[p].slice(out_indices, sizes) =
+                data_flat.slice(data_indices, sizes);
+            output_index[p]++;
+          }
+        }
+      };
+      Shard(worker_threads->num_threads, worker_threads->workers,
+            num_blocks, block_size * slice_size * sizeof(T), partition_blocks);
     }
+    OP_REQUIRES_OK(c, block_errors.status());
   }
 };
 
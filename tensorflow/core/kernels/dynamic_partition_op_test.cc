@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -158,6 +159,49 @@ TEST_F(DynamicPartitionOpTest, Error_IndexOutOfRange) {
       << s;
 }
 
+TEST_F(DynamicPartitionOpTest, ManyBlocks) {
+  MakeOp();
+
+  // Large enough to be split into blocks; each output must keep the order of
+  // the input across block boundaries.
+  const int kSize = 1 << 20;
+  std::vector<float> data(kSize);
+  std::vector<int32> partitions(kSize);
+  std::vector<std::vector<float>> expected(4);
+  for (int i = 0; i < kSize; ++i) {
+    data[i] = i;
+    partitions[i] = (i * 7 + i / 1000) % 3 + (i % 11 == 0 ? 1 : 0);
+    expected[partitions[i]].push_back(data[i]);
+  }
+  AddInputFromArray<float>(TensorShape({kSize}), data);
+  AddInputFromArray<int32>(TensorShape({kSize}), partitions);
+  TF_ASSERT_OK(RunOpKernel());
+
+  for (int p = 0; p < 4; ++p) {
+    const int64 size = expected[p].size();
+    test::ExpectTensorEqual<float>(
+        test::AsTensor<float>(expected[p], TensorShape({size})),
+        *GetOutput(p));
+  }
+}
+
+TEST_F(DynamicPartitionOpTest, ManyBlocks_IndexOutOfRange) {
+  MakeOp();
+
+  const int kSize = 1 << 20;
+  std::vector<float> data(kSize);
+  std::vector<int32> partitions(kSize, 1);
+  // Only the first bad index is reported.
+  partitions[700000] = 5;
+  partitions[900000] = 99;
+  AddInputFromArray<float>(TensorShape({kSize}), data);
+  AddInputFromArray<int32>(TensorShape({kSize}), partitions);
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString())
+                  .contains("partitions[700000] = 5 is not in [0, 4)"))
+      << s;
+}
+
 Node* DynamicPartitionNode(Graph* g, Node* in0, Node* in1, int num_partitions) {
   Node* ret;
   TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DynamicPartition")
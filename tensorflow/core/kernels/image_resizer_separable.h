@@ -0,0 +1,201 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Helpers for CPU image resizers that interpolate separably: every source row
+// an output row needs is first resized horizontally into a float row, using
+// the resizer's precomputed per-column taps, and the output row is then a
+// weighted sum of those rows. Horizontally resized rows are cached, so
+// consecutive output rows that read the same source rows (e.g. when
+// upsampling) compute them only once, and the vertical pass runs over
+// contiguous floats with packet math.
+
+#ifndef TENSORFLOW_KERNELS_IMAGE_RESIZER_SEPARABLE_H_
+#define TENSORFLOW_KERNELS_IMAGE_RESIZER_SEPARABLE_H_
+
+#define EIGEN_USE_THREADS
+
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace separable_resize {
+
+// A packet holding one pixel of three or four float channels, so that the
+// horizontal passes can interpolate whole pixels. Targets without a packet of
+// four floats get a plain float, and kHavePixelPacket is false.
+typedef Eigen::internal::find_best_packet<float, 4>::type PixelPacket;
+static const bool kHavePixelPacket =
+    Eigen::internal::unpacket_traits<PixelPacket>::size == 4;
+
+// Returns the number of leading output pixels of a row that can be computed
+// with one PixelPacket each. With three channels a packet reads and writes
+// one value past the pixel, so this excludes the last output pixel and every
+// pixel x whose rightmost source pixel, at offset max_source_offset(x),
+// starts less than four values before the end of the source row. The offsets
+// must not decrease along the row.
+template <typename GetMaxSourceOffset>
+inline int64 NumPixelPackets(const int64 out_width, const int channels,
+                             const int64 in_row_size,
+                             const GetMaxSourceOffset& max_source_offset) {
+  if (!kHavePixelPacket || (channels != 3 && channels != 4)) return 0;
+  int64 num_pixels = channels == 3 ? out_width - 1 : out_width;
+  while (num_pixels > 0 &&
+         max_source_offset(num_pixels - 1) + 4 > in_row_size) {
+    --num_pixels;
+  }
+  return num_pixels;
+}
+
+// Holds the horizontally resized copies of the last kNumRows source rows.
+template <int kNumRows>
+class ResizedRowCache {
+ public:
+  explicit ResizedRowCache(int64 row_size)
+      : row_size_(row_size), buffer_(kNumRows * row_size) {
+    for (int i = 0; i < kNumRows; ++i) tags_[i] = -1;
+  }
+
+  // Points rows[i] at the buffer of source row tags[i]. Sets fresh[i] if that
+  // buffer does not hold the row yet and the caller has to fill it. Rows that
+  // none of 'tags' refer to are evicted.
+  void Get(const int64* tags, float** rows, bool* fresh) {
+    bool used[kNumRows] = {false};
+    for (int i = 0; i < kNumRows; ++i) {
+      rows[i] = nullptr;
+      fresh[i] = false;
+      for (int s = 0; s < kNumRows; ++s) {
+        if (tags_[s] == tags[i]) {
+          used[s] = true;
+          rows[i] = slot(s);
+          break;
+        }
+      }
+    }
+    for (int i = 0; i < kNumRows; ++i) {
+      if (rows[i] != nullptr) continue;
+      for (int j = 0; j < i; ++j) {
+        if (tags[j] == tags[i]) {
+          rows[i] = rows[j];
+          break;
+        }
+      }
+      if (rows[i] != nullptr) continue;
+      // There are at most kNumRows distinct tags, so a slot is free.
+      int s = 0;
+      while (used[s]) ++s;
+      used[s] = true;
+      tags_[s] = tags[i];
+      rows[i] = slot(s);
+      fresh[i] = true;
+    }
+  }
+
+ private:
+  float* slot(int s) { return buffer_.data() + s * row_size_; }
+
+  const int64 row_size_;
+  std::vector<float> buffer_;
+  int64 tags_[kNumRows];
+};
+
+// out[i] = top[i] + (bottom[i] - top[i]) * lerp.
+inline void VerticalLerp(const float* top, const float* bottom,
+                         const float lerp, const int64 size, float* out) {
+  typedef Eigen::internal::packet_traits<float>::type Packet;
+  static const int64 kPacketSize = sizeof(Packet) / sizeof(float);
+  const Packet lerp_packet = Eigen::internal::pset1<Packet>(lerp);
+  int64 i = 0;
+  for (; i + kPacketSize <= size; i += kPacketSize) {
+    const Packet t = Eigen::internal::ploadu<Packet>(top + i);
+    const Packet b = Eigen::internal::ploadu<Packet>(bottom + i);
+    const Packet delta = Eigen::internal::psub(b, t);
+    Eigen::internal::pstoreu<float>(
+        out + i,
+        Eigen::internal::padd(t, Eigen::internal::pmul(delta, lerp_packet)));
+  }
+  for (; i < size; ++i) {
+    out[i] = top[i] + (bottom[i] - top[i]) * lerp;
+  }
+}
+
+// out[i] = rows[0][i] * weights[0] + ... + rows[3][i] * weights[3], summed
+// left to right.
+inline void VerticalCubic(const float* const* rows, const float* weights,
+                          const int64 size, float* out) {
+  typedef Eigen::internal::packet_traits<float>::type Packet;
+  static const int64 kPacketSize = sizeof(Packet) / sizeof(float);
+  const Packet w0 = Eigen::internal::pset1<Packet>(weights[0]);
+  const Packet w1 = Eigen::internal::pset1<Packet>(weights[1]);
+  const Packet w2 = Eigen::internal::pset1<Packet>(weights[2]);
+  const Packet w3 = Eigen::internal::pset1<Packet>(weights[3]);
+  int64 i = 0;
+  for (; i + kPacketSize <= size; i += kPacketSize) {
+    const Packet r0 = Eigen::internal::ploadu<Packet>(rows[0] + i);
+    const Packet r1 = Eigen::internal::ploadu<Packet>(rows[1] + i);
+    const Packet r2 = Eigen::internal::ploadu<Packet>(rows[2] + i);
+    const Packet r3 = Eigen::internal::ploadu<Packet>(rows[3] + i);
+    Packet sum = Eigen::internal::pmul(r0, w0);
+    sum = Eigen::internal::padd(sum, Eigen::internal::pmul(r1, w1));
+    sum = Eigen::internal::padd(sum, Eigen::internal::pmul(r2, w2));
+    sum = Eigen::internal::padd(sum, Eigen::internal::pmul(r3, w3));
+    Eigen::internal::pstoreu<float>(out + i, sum);
+  }
+  for (; i < size; ++i) {
+    out[i] = rows[0][i] * weights[0] + rows[1][i] * weights[1] +
+             rows[2][i] * weights[2] + rows[3][i] * weights[3];
+  }
+}
+
+// Computes 'batch_size * out_height' output rows of 'out_row_size' floats
+// each, sharded over the rows. Output row y of every image reads the source
+// rows row_taps[y * kTaps + t] for t in [0, kTaps).
+//
+// horizontal(int64 row, float* out) resizes source row 'row', counted over
+// the whole batch, into 'out'. vertical(int64 y, float* const* rows,
+// float* out) combines the kTaps resized rows into output row 'y'.
+template <int kTaps, typename HorizontalFn, typename VerticalFn>
+void ResizeRows(const Eigen::ThreadPoolDevice& d, const int64 batch_size,
+                const int64 in_height, const int64 out_height,
+                const int64 out_row_size, const int64* row_taps,
+                const Eigen::TensorOpCost& cost_per_row,
+                const HorizontalFn& horizontal, const VerticalFn& vertical,
+                float* output) {
+  auto resize_rows = [&](int64 start, int64 limit) {
+    ResizedRowCache<kTaps> cache(out_row_size);
+    int64 tags[kTaps];
+    float* rows[kTaps];
+    bool fresh[kTaps];
+    for (int64 i = start; i < limit; ++i) {
+      const int64 b = i / out_height;
+      const int64 y = i - b * out_height;
+      for (int t = 0; t < kTaps; ++t) {
+        tags[t] = b * in_height + row_taps[y * kTaps + t];
+      }
+      cache.Get(tags, rows, fresh);
+      for (int t = 0; t < kTaps; ++t) {
+        if (fresh[t]) horizontal(tags[t], rows[t]);
+      }
+      vertical(y, rows, output + i * out_row_size);
+    }
+  };
+  d.parallelFor(batch_size * out_height, cost_per_row, resize_rows);
+}
+
+}  // namespace separable_resize
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_IMAGE_RESIZER_SEPARABLE_H_
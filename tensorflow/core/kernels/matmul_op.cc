@@ -22,6 +22,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
 #include "tensorflow/core/kernels/fill_functor.h"
 #include "tensorflow/core/util/matmul_autotune.h"
 #if GOOGLE_CUDA
@@ -515,6 +516,7 @@ struct MatMulFunctor<CPUDevice, T> {
       typename MatMulTypes<T>::in_type in0,
       typename MatMulTypes<T>::in_type in1,
       const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair) {
+    if (DispatchToCPUISA<T>::MatMul(d, out, in0, in1, dim_pair)) return;
     MatMul<CPUDevice>(d, out, in0, in1, dim_pair);
   }
 };
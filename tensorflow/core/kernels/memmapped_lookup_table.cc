@@ -0,0 +1,397 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/memmapped_lookup_table.h"
+
+#include <string.h>
+#include <vector>
+
+#include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/kernels/lookup_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+namespace lookup {
+
+namespace {
+
+uint64 AlignSection(uint64 offset) {
+  return (offset + kMemmappedHashTableAlignment - 1) &
+         ~(kMemmappedHashTableAlignment - 1);
+}
+
+bool IsSupportedKeyType(DataType dtype) {
+  return dtype == DT_INT64 || dtype == DT_STRING;
+}
+
+bool IsSupportedValueType(DataType dtype) {
+  return dtype == DT_INT32 || dtype == DT_INT64 || dtype == DT_FLOAT ||
+         dtype == DT_DOUBLE;
+}
+
+bool KeysEqual(int64 a, int64 b) { return a == b; }
+bool KeysEqual(const string& a, const string& b) { return a == b; }
+
+// Builds the bucket array of a table in memory and writes the file.
+template <class K, class V>
+class MemmappedHashTableWriter {
+ public:
+  MemmappedHashTableWriter(const K* keys, const V* values, int64 size)
+      : keys_(keys), values_(values), size_(size) {}
+
+  Status Write(Env* env, const string& filename) {
+    TF_RETURN_IF_ERROR(BuildBuckets());
+
+    MemmappedHashTableHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kMemmappedHashTableMagic;
+    header.version = kMemmappedHashTableVersion;
+    header.key_dtype = DataTypeToEnum<K>::v();
+    header.value_dtype = DataTypeToEnum<V>::v();
+    header.num_entries = entries_.size();
+    header.num_buckets = buckets_.size();
+    header.key_bytes_size = KeyBytesSize();
+    const MemmappedHashTableLayout layout = ComputeMemmappedHashTableLayout(
+        DataTypeToEnum<K>::v(), DataTypeToEnum<V>::v(), header.num_entries,
+        header.num_buckets, header.key_bytes_size);
+    header.file_size = layout.file_size;
+
+    const string tmp_filename = strings::StrCat(filename, ".tmp");
+    std::unique_ptr<WritableFile> file;
+    TF_RETURN_IF_ERROR(env->NewWritableFile(tmp_filename, &file));
+    uint64 offset = 0;
+    auto append = [&file, &offset](const void* data, uint64 size) {
+      offset += size;
+      return file->Append(
+          StringPiece(reinterpret_cast<const char*>(data), size));
+    };
+    auto pad_to = [&append, &offset](uint64 target) {
+      const string padding(target - offset, '\0');
+      return append(padding.data(), padding.size());
+    };
+
+    TF_RETURN_IF_ERROR(append(&header, sizeof(header)));
+    TF_RETURN_IF_ERROR(pad_to(layout.buckets_offset));
+    TF_RETURN_IF_ERROR(append(buckets_.data(), buckets_.size() *
+                                                   sizeof(buckets_[0])));
+    TF_RETURN_IF_ERROR(pad_to(layout.values_offset));
+    std::vector<V> values;
+    values.reserve(entries_.size());
+    for (int64 i : entries_) values.push_back(values_[i]);
+    TF_RETURN_IF_ERROR(append(values.data(), values.size() * sizeof(V)));
+    TF_RETURN_IF_ERROR(WriteKeys(layout, &append, &pad_to, keys_));
+    TF_RETURN_IF_ERROR(pad_to(layout.file_size));
+    TF_RETURN_IF_ERROR(file->Close());
+    return env->RenameFile(tmp_filename, filename);
+  }
+
+ private:
+  // Inserts every distinct key into buckets_, and records in entries_ the
+  // index of the first occurrence of each key in insertion order.
+  Status BuildBuckets() {
+    uint64 num_buckets = 4;
+    // Keep the load factor below 0.7 so that lookups of missing keys, which
+    // probe up to the next empty bucket, stay short.
+    while (num_buckets * 7 < static_cast<uint64>(size_) * 10) {
+      num_buckets <<= 1;
+    }
+    const uint64 mask = num_buckets - 1;
+    buckets_.assign(num_buckets, MemmappedHashTableBucket{0, 0});
+    for (int64 i = 0; i < size_; ++i) {
+      const uint64 tag = MemmappedHashTableTag(keys_[i]);
+      uint64 b = MemmappedHashTableHomeBucket(tag, mask);
+      while (true) {
+        MemmappedHashTableBucket& bucket = buckets_[b];
+        if (bucket.entry == 0) {
+          entries_.push_back(i);
+          bucket.tag = tag;
+          bucket.entry = entries_.size();
+          break;
+        }
+        if (bucket.tag == tag) {
+          const int64 previous = entries_[bucket.entry - 1];
+          if (KeysEqual(keys_[previous], keys_[i])) {
+            if (values_[previous] != values_[i]) {
+              return errors::InvalidArgument(
+                  "Key ", keys_[i], " is mapped to both ", values_[previous],
+                  " and ", values_[i], ".");
+            }
+            break;
+          }
+          // Distinct string keys with the same fingerprint. Lookups compare
+          // the key bytes as well, so just keep probing.
+        }
+        b = (b + 1) & mask;
+      }
+    }
+    return Status::OK();
+  }
+
+  uint64 KeyBytesSize() const { return KeyBytesSize(keys_); }
+  uint64 KeyBytesSize(const int64* keys) const { return 0; }
+  uint64 KeyBytesSize(const string* keys) const {
+    uint64 result = 0;
+    for (int64 i : entries_) result += keys[i].size();
+    return result;
+  }
+
+  template <typename AppendFn, typename PadFn>
+  Status WriteKeys(const MemmappedHashTableLayout& layout, AppendFn* append,
+                   PadFn* pad_to, const int64* keys) {
+    return Status::OK();
+  }
+
+  template <typename AppendFn, typename PadFn>
+  Status WriteKeys(const MemmappedHashTableLayout& layout, AppendFn* append,
+                   PadFn* pad_to, const string* keys) {
+    TF_RETURN_IF_ERROR((*pad_to)(layout.key_offsets_offset));
+    std::vector<uint64> offsets;
+    offsets.reserve(entries_.size() + 1);
+    uint64 offset = 0;
+    for (int64 i : entries_) {
+      offsets.push_back(offset);
+      offset += keys[i].size();
+    }
+    offsets.push_back(offset);
+    TF_RETURN_IF_ERROR(
+        (*append)(offsets.data(), offsets.size() * sizeof(offsets[0])));
+    TF_RETURN_IF_ERROR((*pad_to)(layout.key_bytes_offset));
+    for (int64 i : entries_) {
+      TF_RETURN_IF_ERROR((*append)(keys[i].data(), keys[i].size()));
+    }
+    return Status::OK();
+  }
+
+  const K* keys_;
+  const V* values_;
+  const int64 size_;
+  std::vector<MemmappedHashTableBucket> buckets_;
+  std::vector<int64> entries_;
+};
+
+// An InitializableLookupTable that only records the pairs it is initialized
+// with. Used to reuse the text file parsing of InitializeTableFromTextFile.
+template <class K, class V>
+class CollectingTable : public InitializableLookupTable {
+ public:
+  size_t size() const override { return keys_.size(); }
+  DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
+  DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
+
+  Status Write(Env* env, const string& filename) {
+    return MemmappedHashTableWriter<K, V>(keys_.data(), values_.data(),
+                                          keys_.size())
+        .Write(env, filename);
+  }
+
+ protected:
+  Status DoPrepare(size_t expected_num_elements) override {
+    keys_.reserve(expected_num_elements);
+    values_.reserve(expected_num_elements);
+    return Status::OK();
+  }
+
+  Status DoInsert(const Tensor& keys, const Tensor& values) override {
+    const auto key_values = keys.flat<K>();
+    const auto value_values = values.flat<V>();
+    for (int64 i = 0; i < key_values.size(); ++i) {
+      keys_.push_back(key_values(i));
+      values_.push_back(value_values(i));
+    }
+    return Status::OK();
+  }
+
+  Status DoFind(const Tensor& keys, Tensor* values,
+                const Tensor& default_value) override {
+    return errors::Unimplemented("CollectingTable does not support lookups.");
+  }
+
+ private:
+  std::vector<K> keys_;
+  std::vector<V> values_;
+};
+
+template <class K, class V>
+Status ConvertTextFile(const string& input_filename, int64 vocab_size,
+                       char delimiter, int32 key_index, int32 value_index,
+                       Env* env, const string& output_filename) {
+  CollectingTable<K, V>* table = new CollectingTable<K, V>;
+  core::ScopedUnref unref_table(table);
+  TF_RETURN_IF_ERROR(InitializeTableFromTextFile(
+      input_filename, vocab_size, delimiter, key_index, value_index, env,
+      table));
+  return table->Write(env, output_filename);
+}
+
+}  // namespace
+
+MemmappedHashTableLayout ComputeMemmappedHashTableLayout(
+    DataType key_dtype, DataType value_dtype, uint64 num_entries,
+    uint64 num_buckets, uint64 key_bytes_size) {
+  MemmappedHashTableLayout layout;
+  layout.buckets_offset = AlignSection(sizeof(MemmappedHashTableHeader));
+  layout.values_offset = AlignSection(
+      layout.buckets_offset + num_buckets * sizeof(MemmappedHashTableBucket));
+  layout.key_offsets_offset = AlignSection(
+      layout.values_offset + num_entries * DataTypeSize(value_dtype));
+  if (key_dtype == DT_STRING) {
+    layout.key_bytes_offset = AlignSection(layout.key_offsets_offset +
+                                           (num_entries + 1) * sizeof(uint64));
+    layout.file_size = AlignSection(layout.key_bytes_offset + key_bytes_size);
+  } else {
+    layout.key_bytes_offset = layout.key_offsets_offset;
+    layout.file_size = layout.key_offsets_offset;
+  }
+  return layout;
+}
+
+#define DISPATCH_VALUE_TYPE(K, value_dtype, CALL)                         \
+  switch (value_dtype) {                                                  \
+    case DT_INT32:                                                        \
+      return CALL(K, int32);                                              \
+    case DT_INT64:                                                        \
+      return CALL(K, int64);                                              \
+    case DT_FLOAT:                                                        \
+      return CALL(K, float);                                              \
+    case DT_DOUBLE:                                                       \
+      return CALL(K, double);                                             \
+    default:                                                              \
+      return errors::InvalidArgument("Unsupported value type ",           \
+                                     DataTypeString(value_dtype),         \
+                                     " for a memmapped hash table.");     \
+  }
+
+#define DISPATCH_KEY_AND_VALUE_TYPES(key_dtype, value_dtype, CALL)        \
+  switch (key_dtype) {                                                    \
+    case DT_INT64:                                                        \
+      DISPATCH_VALUE_TYPE(int64, value_dtype, CALL)                       \
+    case DT_STRING:                                                       \
+      DISPATCH_VALUE_TYPE(string, value_dtype, CALL)                      \
+    default:                                                              \
+      return errors::InvalidArgument("Unsupported key type ",             \
+                                     DataTypeString(key_dtype),           \
+                                     " for a memmapped hash table.");     \
+  }
+
+Status WriteMemmappedHashTable(Env* env, const string& filename,
+                               const Tensor& keys, const Tensor& values) {
+  if (!TensorShapeUtils::IsVector(keys.shape()) ||
+      keys.shape() != values.shape()) {
+    return errors::InvalidArgument(
+        "keys and values must be vectors of the same size, got shapes ",
+        keys.shape().DebugString(), " and ", values.shape().DebugString());
+  }
+#define WRITE_TABLE(K, V)                                                 \
+  MemmappedHashTableWriter<K, V>(keys.flat<K>().data(),                   \
+                                 values.flat<V>().data(), keys.NumElements()) \
+      .Write(env, filename)
+  DISPATCH_KEY_AND_VALUE_TYPES(keys.dtype(), values.dtype(), WRITE_TABLE)
+#undef WRITE_TABLE
+}
+
+Status ConvertTextFileToMemmappedHashTable(const string& input_filename,
+                                           int64 vocab_size, char delimiter,
+                                           int32 key_index, int32 value_index,
+                                           DataType key_dtype,
+                                           DataType value_dtype, Env* env,
+                                           const string& output_filename) {
+#define CONVERT_TEXT_FILE(K, V)                                             \
+  ConvertTextFile<K, V>(input_filename, vocab_size, delimiter, key_index, \
+                        value_index, env, output_filename)
+  DISPATCH_KEY_AND_VALUE_TYPES(key_dtype, value_dtype, CONVERT_TEXT_FILE)
+#undef CONVERT_TEXT_FILE
+}
+
+#undef DISPATCH_KEY_AND_VALUE_TYPES
+#undef DISPATCH_VALUE_TYPE
+
+Status MemmappedHashTableFile::Open(Env* env, const string& filename,
+                                    DataType key_dtype, DataType value_dtype) {
+  if (!IsSupportedKeyType(key_dtype) || !IsSupportedValueType(value_dtype)) {
+    return errors::InvalidArgument(
+        "Unsupported key and value types for a memmapped hash table: ",
+        DataTypeString(key_dtype), " and ", DataTypeString(value_dtype));
+  }
+  TF_RETURN_IF_ERROR(env->NewReadOnlyMemoryRegionFromFile(filename, &region_));
+  const uint64 length = region_->length();
+  const char* data = static_cast<const char*>(region_->data());
+  if (length < sizeof(MemmappedHashTableHeader)) {
+    return errors::DataLoss(filename, " is too short to be a memmapped hash ",
+                            "table: ", length, " bytes.");
+  }
+  const MemmappedHashTableHeader* header =
+      reinterpret_cast<const MemmappedHashTableHeader*>(data);
+  if (header->magic != kMemmappedHashTableMagic) {
+    return errors::DataLoss(
+        filename, " is not a memmapped hash table, or was written on a ",
+        "machine with a different byte order.");
+  }
+  if (header->version != kMemmappedHashTableVersion) {
+    return errors::DataLoss(filename, " has unsupported version ",
+                            header->version, ", expected ",
+                            kMemmappedHashTableVersion, ".");
+  }
+  if (header->key_dtype != key_dtype || header->value_dtype != value_dtype) {
+    return errors::InvalidArgument(
+        filename, " maps ", DataTypeString(DataType(header->key_dtype)),
+        " to ", DataTypeString(DataType(header->value_dtype)),
+        ", but the table expects ", DataTypeString(key_dtype), " to ",
+        DataTypeString(value_dtype), ".");
+  }
+  const uint64 num_buckets = header->num_buckets;
+  if (num_buckets == 0 || (num_buckets & (num_buckets - 1)) != 0 ||
+      header->num_entries >= num_buckets) {
+    return errors::DataLoss(filename, " has an invalid bucket count ",
+                            num_buckets, " for ", header->num_entries,
+                            " entries.");
+  }
+  // Check the size of each section against the file length by division, so
+  // that the products below cannot wrap around for a corrupt header.
+  uint64 available = length - sizeof(MemmappedHashTableHeader);
+  auto take = [&available](uint64 count, uint64 element_size) {
+    if (count > available / element_size) return false;
+    available -= count * element_size;
+    return true;
+  };
+  if (!take(num_buckets, sizeof(MemmappedHashTableBucket)) ||
+      !take(header->num_entries, DataTypeSize(value_dtype)) ||
+      (key_dtype == DT_STRING &&
+       (!take(header->num_entries + 1, sizeof(uint64)) ||
+        !take(header->key_bytes_size, 1)))) {
+    return errors::DataLoss(filename, " has sections that do not fit in its ",
+                            length, " bytes.");
+  }
+  const MemmappedHashTableLayout layout = ComputeMemmappedHashTableLayout(
+      key_dtype, value_dtype, header->num_entries, num_buckets,
+      header->key_bytes_size);
+  if (header->file_size != layout.file_size || length != layout.file_size) {
+    return errors::DataLoss(filename, " has size ", length, ", expected ",
+                            layout.file_size, ".");
+  }
+  header_ = header;
+  buckets_ =
+      reinterpret_cast<const MemmappedHashTableBucket*>(data +
+                                                        layout.buckets_offset);
+  values_ = data + layout.values_offset;
+  if (key_dtype == DT_STRING) {
+    key_offsets_ =
+        reinterpret_cast<const uint64*>(data + layout.key_offsets_offset);
+    key_bytes_ = data + layout.key_bytes_offset;
+  }
+  return Status::OK();
+}
+
+}  // namespace lookup
+}  // namespace tensorflow
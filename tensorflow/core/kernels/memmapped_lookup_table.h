@@ -0,0 +1,311 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_MEMMAPPED_LOOKUP_TABLE_H_
+#define TENSORFLOW_KERNELS_MEMMAPPED_LOOKUP_TABLE_H_
+
+#include <memory>
+
+#include "tensorflow/core/framework/lookup_interface.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace lookup {
+
+// An immutable hash table stored in a file that is looked up in place through
+// a read-only memory mapping. Opening a table costs O(1) regardless of its
+// size, pages are loaded lazily on first access, and processes that map the
+// same file share one copy in the page cache.
+//
+// File layout. All integers are stored in the byte order of the machine that
+// wrote the file (the magic number detects a mismatch), and every section
+// starts at a multiple of kMemmappedHashTableAlignment:
+//
+//   MemmappedHashTableHeader
+//   buckets:      num_buckets x MemmappedHashTableBucket, linear probing
+//   values:       num_entries x sizeof(value type)
+//   key offsets:  (num_entries + 1) x uint64, string keys only
+//   key bytes:    key_offsets[num_entries] bytes, string keys only
+//
+// Entry i has value values[i]. For string keys its key is
+// key_bytes[key_offsets[i], key_offsets[i + 1]); for int64 keys the key is
+// only stored in the bucket tag.
+
+constexpr uint64 kMemmappedHashTableMagic = 0x31305448544d4d54ULL;  // TMMTHT01
+constexpr uint32 kMemmappedHashTableVersion = 1;
+constexpr uint64 kMemmappedHashTableAlignment = 64;
+
+struct MemmappedHashTableHeader {
+  uint64 magic;
+  uint32 version;
+  int32 key_dtype;
+  int32 value_dtype;
+  uint32 reserved;
+  uint64 num_entries;
+  uint64 num_buckets;  // A power of 2 larger than num_entries.
+  uint64 key_bytes_size;
+  uint64 file_size;
+};
+
+struct MemmappedHashTableBucket {
+  // The key itself for int64 keys, Fingerprint64 of the key for string keys.
+  uint64 tag;
+  // 1 + the index of the entry stored in this bucket, 0 if the bucket is
+  // empty.
+  uint64 entry;
+};
+
+// Byte offsets of the sections of a table file.
+struct MemmappedHashTableLayout {
+  uint64 buckets_offset;
+  uint64 values_offset;
+  uint64 key_offsets_offset;
+  uint64 key_bytes_offset;
+  uint64 file_size;
+};
+
+// Computes the section offsets of a table file from its header fields. The
+// arithmetic is unchecked: the caller must know that every section fits in a
+// file, as MemmappedHashTableFile::Open() checks before calling it.
+MemmappedHashTableLayout ComputeMemmappedHashTableLayout(
+    DataType key_dtype, DataType value_dtype, uint64 num_entries,
+    uint64 num_buckets, uint64 key_bytes_size);
+
+inline uint64 MemmappedHashTableTag(int64 key) {
+  return static_cast<uint64>(key);
+}
+
+inline uint64 MemmappedHashTableTag(const string& key) {
+  return Fingerprint64(key);
+}
+
+// Maps a tag to its home bucket. Integer ids are often dense, so the bits are
+// mixed before masking.
+inline uint64 MemmappedHashTableHomeBucket(uint64 tag, uint64 bucket_mask) {
+  tag ^= tag >> 33;
+  tag *= 0xff51afd7ed558ccdULL;
+  tag ^= tag >> 33;
+  return tag & bucket_mask;
+}
+
+// Writes a table file that maps keys(i) to values(i). keys and values must be
+// vectors of the same size. A key may occur more than once only if it is
+// mapped to the same value every time. Supported key types are int64 and
+// string, supported value types are int32, int64, float and double.
+//
+// The file is written under a temporary name and renamed into place, so that
+// readers never observe a partially written table.
+Status WriteMemmappedHashTable(Env* env, const string& filename,
+                               const Tensor& keys, const Tensor& values);
+
+// Converts a text file vocabulary into a table file. The file is parsed exactly
+// like InitializeTableFromTextFile() does for a HashTable, so a table written
+// by this function returns the same values as a HashTable initialized from the
+// same file with the same arguments.
+Status ConvertTextFileToMemmappedHashTable(const string& input_filename,
+                                           int64 vocab_size, char delimiter,
+                                           int32 key_index, int32 value_index,
+                                           DataType key_dtype,
+                                           DataType value_dtype, Env* env,
+                                           const string& output_filename);
+
+// A validated, read-only mapping of a table file.
+//
+// Open() only checks the header, so it touches a single page. Lookups check
+// every offset they read against the section bounds, so a corrupted file can
+// produce wrong results but never an out of bounds access.
+class MemmappedHashTableFile {
+ public:
+  MemmappedHashTableFile() {}
+
+  // Maps `filename` and checks that it is a table file with the given key and
+  // value types.
+  Status Open(Env* env, const string& filename, DataType key_dtype,
+              DataType value_dtype);
+
+  int64 num_entries() const { return header_->num_entries; }
+  uint64 num_buckets() const { return header_->num_buckets; }
+  const MemmappedHashTableBucket* buckets() const { return buckets_; }
+
+  template <typename V>
+  const V* values() const {
+    return reinterpret_cast<const V*>(values_);
+  }
+
+  // Returns the index of the entry holding `key`, or -1 if there is none.
+  int64 FindEntry(int64 key) const {
+    const uint64 tag = MemmappedHashTableTag(key);
+    const uint64 mask = header_->num_buckets - 1;
+    for (uint64 b = MemmappedHashTableHomeBucket(tag, mask), probes = 0;
+         probes <= mask; b = (b + 1) & mask, ++probes) {
+      const MemmappedHashTableBucket& bucket = buckets_[b];
+      if (bucket.entry == 0 || bucket.entry > header_->num_entries) return -1;
+      if (bucket.tag == tag) return bucket.entry - 1;
+    }
+    return -1;
+  }
+
+  int64 FindEntry(const string& key) const {
+    const uint64 tag = MemmappedHashTableTag(key);
+    const uint64 mask = header_->num_buckets - 1;
+    for (uint64 b = MemmappedHashTableHomeBucket(tag, mask), probes = 0;
+         probes <= mask; b = (b + 1) & mask, ++probes) {
+      const MemmappedHashTableBucket& bucket = buckets_[b];
+      if (bucket.entry == 0 || bucket.entry > header_->num_entries) return -1;
+      if (bucket.tag == tag && StringKey(bucket.entry - 1) == key) {
+        return bucket.entry - 1;
+      }
+    }
+    return -1;
+  }
+
+  // Returns the key of entry `entry` of a table with string keys.
+  StringPiece StringKey(int64 entry) const {
+    const uint64 begin = key_offsets_[entry];
+    const uint64 end = key_offsets_[entry + 1];
+    if (begin > end || end > header_->key_bytes_size) return StringPiece();
+    return StringPiece(key_bytes_ + begin, end - begin);
+  }
+
+ private:
+  std::unique_ptr<ReadOnlyMemoryRegion> region_;
+  const MemmappedHashTableHeader* header_ = nullptr;
+  const MemmappedHashTableBucket* buckets_ = nullptr;
+  const char* values_ = nullptr;
+  const uint64* key_offsets_ = nullptr;
+  const char* key_bytes_ = nullptr;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MemmappedHashTableFile);
+};
+
+// Lookup table backed by a MemmappedHashTableFile. The table file name is
+// given by the scalar "filename" input of the op that creates the table.
+//
+// The table is read-only: Insert and ImportValues return Unimplemented. It
+// needs no initialization and is not saved in checkpoints, the file is the
+// source of truth.
+template <class K, class V>
+class MemmappedHashTable final : public LookupInterface {
+ public:
+  MemmappedHashTable(OpKernelContext* ctx, OpKernel* kernel) {
+    const Tensor* filename;
+    OP_REQUIRES_OK(ctx, ctx->input("filename", &filename));
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(filename->shape()),
+                errors::InvalidArgument("filename must be a scalar, got shape ",
+                                        filename->shape().DebugString()));
+    OP_REQUIRES_OK(ctx, file_.Open(ctx->env(), filename->scalar<string>()(),
+                                   key_dtype(), value_dtype()));
+  }
+
+  size_t size() const override { return file_.num_entries(); }
+
+  Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
+              const Tensor& default_value) override {
+    const V default_val = default_value.flat<V>()(0);
+    const auto key_values = key.flat<K>();
+    auto value_values = value->flat<V>();
+    const V* table_values = file_.template values<V>();
+
+    auto lookup = [this, &key_values, &value_values, table_values,
+                   default_val](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        const int64 entry = file_.FindEntry(key_values(i));
+        value_values(i) = entry < 0 ? default_val : table_values[entry];
+      }
+    };
+    // A lookup costs about one cache miss, or a page fault when the table is
+    // cold, so shard large batches across the worker threads.
+    const int64 num_keys = key_values.size();
+    if (num_keys < kMinShardedBatchSize) {
+      lookup(0, num_keys);
+    } else {
+      auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+      Shard(worker_threads->num_threads, worker_threads->workers, num_keys,
+            kCostPerLookup, lookup);
+    }
+    return Status::OK();
+  }
+
+  Status Insert(OpKernelContext* ctx, const Tensor& keys,
+                const Tensor& values) override {
+    return errors::Unimplemented("MemmappedHashTable is read-only.");
+  }
+
+  Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
+                      const Tensor& values) override {
+    return errors::Unimplemented("MemmappedHashTable is read-only.");
+  }
+
+  Status ExportValues(OpKernelContext* ctx) override {
+    const int64 size = file_.num_entries();
+    Tensor* keys;
+    Tensor* values;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("keys", TensorShape({size}), &keys));
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("values", TensorShape({size}), &values));
+    auto keys_data = keys->flat<K>();
+    auto values_data = values->flat<V>();
+    const MemmappedHashTableBucket* buckets = file_.buckets();
+    const V* table_values = file_.template values<V>();
+    for (uint64 b = 0; b < file_.num_buckets(); ++b) {
+      const uint64 entry = buckets[b].entry;
+      if (entry == 0 || entry > static_cast<uint64>(size)) continue;
+      ExportKey(buckets[b], &keys_data(entry - 1));
+      values_data(entry - 1) = table_values[entry - 1];
+    }
+    return Status::OK();
+  }
+
+  DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
+
+  DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
+
+  TensorShape key_shape() const override { return TensorShape(); }
+
+  TensorShape value_shape() const override { return TensorShape(); }
+
+  // The table contents live in the page cache, not in process memory.
+  int64 MemoryUsed() const override { return sizeof(MemmappedHashTable); }
+
+ private:
+  static constexpr int64 kMinShardedBatchSize = 4096;
+  static constexpr int64 kCostPerLookup = 200;
+
+  void ExportKey(const MemmappedHashTableBucket& bucket, int64* key) const {
+    *key = static_cast<int64>(bucket.tag);
+  }
+
+  void ExportKey(const MemmappedHashTableBucket& bucket, string* key) const {
+    *key = file_.StringKey(bucket.entry - 1).ToString();
+  }
+
+  MemmappedHashTableFile file_;
+};
+
+}  // namespace lookup
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_MEMMAPPED_LOOKUP_TABLE_H_
@@ -0,0 +1,280 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/memmapped_lookup_table.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/lookup_table_op.h"
+#include "tensorflow/core/kernels/lookup_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+string TablePath(const string& name) {
+  return io::JoinPath(testing::TmpDir(), name);
+}
+
+TEST(MemmappedHashTableTest, Int64Keys) {
+  const string path = TablePath("int64_keys");
+  Tensor keys = test::AsTensor<int64>({7, -3, 1000000007, 0, 7});
+  Tensor values = test::AsTensor<float>({1.5f, 2.5f, 3.5f, 4.5f, 1.5f});
+  TF_ASSERT_OK(WriteMemmappedHashTable(Env::Default(), path, keys, values));
+
+  MemmappedHashTableFile file;
+  TF_ASSERT_OK(file.Open(Env::Default(), path, DT_INT64, DT_FLOAT));
+  EXPECT_EQ(4, file.num_entries());
+  const float* table_values = file.values<float>();
+  EXPECT_EQ(1.5f, table_values[file.FindEntry(int64{7})]);
+  EXPECT_EQ(2.5f, table_values[file.FindEntry(int64{-3})]);
+  EXPECT_EQ(3.5f, table_values[file.FindEntry(int64{1000000007})]);
+  EXPECT_EQ(4.5f, table_values[file.FindEntry(int64{0})]);
+  EXPECT_EQ(-1, file.FindEntry(int64{8}));
+}
+
+TEST(MemmappedHashTableTest, StringKeys) {
+  const string path = TablePath("string_keys");
+  std::vector<string> key_list;
+  std::vector<int64> value_list;
+  for (int i = 0; i < 1000; ++i) {
+    key_list.push_back(strings::StrCat("token_", i));
+    value_list.push_back(i);
+  }
+  key_list.push_back("");
+  value_list.push_back(-7);
+  Tensor keys = test::AsTensor<string>(key_list);
+  Tensor values = test::AsTensor<int64>(value_list);
+  TF_ASSERT_OK(WriteMemmappedHashTable(Env::Default(), path, keys, values));
+
+  MemmappedHashTableFile file;
+  TF_ASSERT_OK(file.Open(Env::Default(), path, DT_STRING, DT_INT64));
+  EXPECT_EQ(1001, file.num_entries());
+  const int64* table_values = file.values<int64>();
+  for (int i = 0; i < 1000; ++i) {
+    const int64 entry = file.FindEntry(key_list[i]);
+    ASSERT_GE(entry, 0);
+    EXPECT_EQ(key_list[i], file.StringKey(entry));
+    EXPECT_EQ(i, table_values[entry]);
+  }
+  EXPECT_EQ(-7, table_values[file.FindEntry(string())]);
+  EXPECT_EQ(-1, file.FindEntry(string("token_1000")));
+  EXPECT_EQ(-1, file.FindEntry(string("token")));
+}
+
+TEST(MemmappedHashTableTest, ConflictingDuplicateKey) {
+  Tensor keys = test::AsTensor<int64>({1, 2, 1});
+  Tensor values = test::AsTensor<int64>({10, 20, 30});
+  Status s = WriteMemmappedHashTable(Env::Default(), TablePath("conflict"),
+                                     keys, values);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST(MemmappedHashTableTest, UnsupportedTypes) {
+  Tensor keys = test::AsTensor<int32>({1, 2});
+  Tensor values = test::AsTensor<int64>({10, 20});
+  Status s = WriteMemmappedHashTable(Env::Default(), TablePath("int32_keys"),
+                                     keys, values);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST(MemmappedHashTableTest, TypeMismatch) {
+  const string path = TablePath("type_mismatch");
+  Tensor keys = test::AsTensor<int64>({1, 2});
+  Tensor values = test::AsTensor<int64>({10, 20});
+  TF_ASSERT_OK(WriteMemmappedHashTable(Env::Default(), path, keys, values));
+  MemmappedHashTableFile file;
+  Status s = file.Open(Env::Default(), path, DT_STRING, DT_INT64);
+  EXPECT_TRUE(errors::IsInvalidArgument(s)) << s;
+}
+
+TEST(MemmappedHashTableTest, CorruptFile) {
+  const string path = TablePath("corrupt");
+  Tensor keys = test::AsTensor<int64>({1, 2});
+  Tensor values = test::AsTensor<int64>({10, 20});
+  TF_ASSERT_OK(WriteMemmappedHashTable(Env::Default(), path, keys, values));
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+
+  MemmappedHashTableFile file;
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path,
+                                 contents.substr(0, contents.size() - 1)));
+  EXPECT_TRUE(errors::IsDataLoss(
+      file.Open(Env::Default(), path, DT_INT64, DT_INT64)));
+
+  contents[0] = 'X';
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, contents));
+  EXPECT_TRUE(errors::IsDataLoss(
+      file.Open(Env::Default(), path, DT_INT64, DT_INT64)));
+}
+
+// Returns a copy of the header of the table file `contents`.
+MemmappedHashTableHeader ReadHeader(const string& contents) {
+  MemmappedHashTableHeader header;
+  memcpy(&header, contents.data(), sizeof(header));
+  return header;
+}
+
+void WriteHeader(const MemmappedHashTableHeader& header, string* contents) {
+  memcpy(&(*contents)[0], &header, sizeof(header));
+}
+
+TEST(MemmappedHashTableTest, CorruptHeaderOverflow) {
+  const string path = TablePath("corrupt_header_overflow");
+  Tensor keys = test::AsTensor<int64>({1, 2});
+  Tensor values = test::AsTensor<int64>({10, 20});
+  TF_ASSERT_OK(WriteMemmappedHashTable(Env::Default(), path, keys, values));
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  MemmappedHashTableHeader header = ReadHeader(contents);
+  ASSERT_EQ(4, header.num_buckets);
+
+  // 2^60 buckets of 16 bytes wrap around to 0 bytes, and 10 values then end
+  // the file at its actual size, so the computed layout matches the file.
+  header.num_buckets = uint64{1} << 60;
+  header.num_entries = 10;
+  ASSERT_EQ(header.file_size,
+            ComputeMemmappedHashTableLayout(DT_INT64, DT_INT64,
+                                            header.num_entries,
+                                            header.num_buckets, 0)
+                .file_size);
+  WriteHeader(header, &contents);
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, contents));
+  MemmappedHashTableFile file;
+  Status s = file.Open(Env::Default(), path, DT_INT64, DT_INT64);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+}
+
+TEST(MemmappedHashTableTest, CorruptHeaderKeyBytesOverflow) {
+  const string path = TablePath("corrupt_key_bytes_overflow");
+  Tensor keys = test::AsTensor<string>({"a", "b"});
+  Tensor values = test::AsTensor<int64>({10, 20});
+  TF_ASSERT_OK(WriteMemmappedHashTable(Env::Default(), path, keys, values));
+  string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), path, &contents));
+  MemmappedHashTableHeader header = ReadHeader(contents);
+  ASSERT_EQ(2, header.key_bytes_size);
+
+  // Key bytes of 2^64 - 62 bytes wrap around to end the file 64 bytes before
+  // the key bytes section would end, so drop those 64 bytes.
+  header.key_bytes_size -= kMemmappedHashTableAlignment;
+  header.file_size -= kMemmappedHashTableAlignment;
+  ASSERT_EQ(header.file_size,
+            ComputeMemmappedHashTableLayout(DT_STRING, DT_INT64,
+                                            header.num_entries,
+                                            header.num_buckets,
+                                            header.key_bytes_size)
+                .file_size);
+  WriteHeader(header, &contents);
+  contents.resize(header.file_size);
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), path, contents));
+  MemmappedHashTableFile file;
+  Status s = file.Open(Env::Default(), path, DT_STRING, DT_INT64);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+}
+
+TEST(MemmappedHashTableTest, ConvertTextFile) {
+  const string vocab = TablePath("vocab.txt");
+  const string path = TablePath("vocab.table");
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), vocab,
+                                 "brain\t11\nsalad\t22\nsurgery\t33\n"));
+  // Keys from the first column, values from the line number.
+  TF_ASSERT_OK(ConvertTextFileToMemmappedHashTable(
+      vocab, -1, '\t', 0, -1, DT_STRING, DT_INT64, Env::Default(), path));
+
+  MemmappedHashTableFile file;
+  TF_ASSERT_OK(file.Open(Env::Default(), path, DT_STRING, DT_INT64));
+  EXPECT_EQ(3, file.num_entries());
+  const int64* table_values = file.values<int64>();
+  EXPECT_EQ(0, table_values[file.FindEntry(string("brain"))]);
+  EXPECT_EQ(1, table_values[file.FindEntry(string("salad"))]);
+  EXPECT_EQ(2, table_values[file.FindEntry(string("surgery"))]);
+  EXPECT_EQ(-1, file.FindEntry(string("brain\t11")));
+}
+
+// Writes a vocabulary of `size` tokens, one per line, and the equivalent
+// table file. Returns the paths of both.
+std::pair<string, string> MakeVocabulary(int size) {
+  const string vocab = TablePath(strings::StrCat("bm_vocab_", size, ".txt"));
+  const string table = TablePath(strings::StrCat("bm_vocab_", size, ".table"));
+  string contents;
+  for (int i = 0; i < size; ++i) {
+    strings::StrAppend(&contents, "token_", i, "\n");
+  }
+  TF_CHECK_OK(WriteStringToFile(Env::Default(), vocab, contents));
+  TF_CHECK_OK(ConvertTextFileToMemmappedHashTable(
+      vocab, -1, '\t', -2, -1, DT_STRING, DT_INT64, Env::Default(), table));
+  return {vocab, table};
+}
+
+// Time to get a usable table for a vocabulary: parsing the text file into a
+// HashTable versus mapping the prebuilt file.
+static void BM_HashTableFromTextFile(int iters, int size) {
+  testing::StopTiming();
+  const string vocab = MakeVocabulary(size).first;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    HashTable<string, int64>* table =
+        new HashTable<string, int64>(nullptr, nullptr);
+    TF_CHECK_OK(InitializeTableFromTextFile(vocab, -1, '\t', -2, -1,
+                                            Env::Default(), table));
+    table->Unref();
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * size);
+}
+BENCHMARK(BM_HashTableFromTextFile)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+static void BM_MemmappedHashTableOpen(int iters, int size) {
+  testing::StopTiming();
+  const string table = MakeVocabulary(size).second;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    MemmappedHashTableFile file;
+    TF_CHECK_OK(file.Open(Env::Default(), table, DT_STRING, DT_INT64));
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * size);
+}
+BENCHMARK(BM_MemmappedHashTableOpen)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+static void BM_MemmappedHashTableFind(int iters, int size) {
+  testing::StopTiming();
+  const string table = MakeVocabulary(size).second;
+  MemmappedHashTableFile file;
+  TF_CHECK_OK(file.Open(Env::Default(), table, DT_STRING, DT_INT64));
+  // Half of the queries hit, half miss.
+  std::vector<string> queries;
+  for (int i = 0; i < 1024; ++i) {
+    queries.push_back(strings::StrCat("token_", (i * 104729) % (2 * size)));
+  }
+  const int64* values = file.values<int64>();
+  int64 sum = 0;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    const int64 entry = file.FindEntry(queries[i % queries.size()]);
+    sum += entry < 0 ? -1 : values[entry];
+  }
+  testing::StopTiming();
+  CHECK_NE(sum, kint64max);
+  testing::ItemsProcessed(iters);
+}
+BENCHMARK(BM_MemmappedHashTableFind)->Arg(1000)->Arg(1000000);
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
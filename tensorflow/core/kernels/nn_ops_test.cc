@@ -655,6 +655,27 @@ BM_ConvFloatDepthwiseFwd(32, 112, 112, 3, 8, 24, 3, 3, 2, SAME, conv7);
 BM_ConvFloatDepthwiseFwd(32, 112, 112, 3, 8, 24, 3, 3, 2, VALID, conv8);
 BM_ConvFloatDepthwiseFwd(1, 100, 100, 72, 1, 72, 3, 3, 1, SAME, conv9);
 BM_ConvFloatDepthwiseFwd(1, 100, 100, 72, 1, 72, 5, 5, 1, SAME, conv10);
+// MobileNet v2 depthwise layers, at training and single-image batch sizes.
+BM_ConvFloatDepthwiseFwd(32, 112, 112, 32, 1, 32, 3, 3, 1, SAME, mobilenet2_0);
+BM_ConvFloatDepthwiseFwd(32, 112, 112, 96, 1, 96, 3, 3, 2, SAME, mobilenet2_1);
+BM_ConvFloatDepthwiseFwd(32, 56, 56, 144, 1, 144, 3, 3, 1, SAME, mobilenet2_2);
+BM_ConvFloatDepthwiseFwd(32, 56, 56, 144, 1, 144, 3, 3, 2, SAME, mobilenet2_3);
+BM_ConvFloatDepthwiseFwd(32, 28, 28, 192, 1, 192, 3, 3, 1, SAME, mobilenet2_4);
+BM_ConvFloatDepthwiseFwd(32, 28, 28, 192, 1, 192, 3, 3, 2, SAME, mobilenet2_5);
+BM_ConvFloatDepthwiseFwd(32, 14, 14, 384, 1, 384, 3, 3, 1, SAME, mobilenet2_6);
+BM_ConvFloatDepthwiseFwd(32, 14, 14, 576, 1, 576, 3, 3, 1, SAME, mobilenet2_7);
+BM_ConvFloatDepthwiseFwd(32, 14, 14, 576, 1, 576, 3, 3, 2, SAME, mobilenet2_8);
+BM_ConvFloatDepthwiseFwd(32, 7, 7, 960, 1, 960, 3, 3, 1, SAME, mobilenet2_9);
+BM_ConvFloatDepthwiseFwd(1, 112, 112, 32, 1, 32, 3, 3, 1, SAME, mobilenet2b1_0);
+BM_ConvFloatDepthwiseFwd(1, 112, 112, 96, 1, 96, 3, 3, 2, SAME, mobilenet2b1_1);
+BM_ConvFloatDepthwiseFwd(1, 56, 56, 144, 1, 144, 3, 3, 1, SAME, mobilenet2b1_2);
+BM_ConvFloatDepthwiseFwd(1, 56, 56, 144, 1, 144, 3, 3, 2, SAME, mobilenet2b1_3);
+BM_ConvFloatDepthwiseFwd(1, 28, 28, 192, 1, 192, 3, 3, 1, SAME, mobilenet2b1_4);
+BM_ConvFloatDepthwiseFwd(1, 28, 28, 192, 1, 192, 3, 3, 2, SAME, mobilenet2b1_5);
+BM_ConvFloatDepthwiseFwd(1, 14, 14, 384, 1, 384, 3, 3, 1, SAME, mobilenet2b1_6);
+BM_ConvFloatDepthwiseFwd(1, 14, 14, 576, 1, 576, 3, 3, 1, SAME, mobilenet2b1_7);
+BM_ConvFloatDepthwiseFwd(1, 14, 14, 576, 1, 576, 3, 3, 2, SAME, mobilenet2b1_8);
+BM_ConvFloatDepthwiseFwd(1, 7, 7, 960, 1, 960, 3, 3, 1, SAME, mobilenet2b1_9);
 
 #define BM_ConvFloatDepthwiseBk(BS, R, C, ID, DM, OD, KR, KC, STR, PAD, LABEL) \
   static void BM_ConvFloatDepthwiseBkInCPU1_##LABEL(int iters) {               \
@@ -727,6 +748,18 @@ BM_ConvFloatDepthwiseBk(32, 112, 112, 8, 3, 24, 3, 3, 1, SAME, conv12);
 BM_ConvFloatDepthwiseBk(32, 112, 112, 12, 2, 24, 3, 3, 1, SAME, conv13);
 BM_ConvFloatDepthwiseBk(32, 112, 112, 24, 1, 24, 3, 3, 1, SAME, conv14);
 
+// MobileNet v2 depthwise layers.
+BM_ConvFloatDepthwiseBk(32, 112, 112, 32, 1, 32, 3, 3, 1, SAME, mobilenet2_0);
+BM_ConvFloatDepthwiseBk(32, 112, 112, 96, 1, 96, 3, 3, 2, SAME, mobilenet2_1);
+BM_ConvFloatDepthwiseBk(32, 56, 56, 144, 1, 144, 3, 3, 1, SAME, mobilenet2_2);
+BM_ConvFloatDepthwiseBk(32, 56, 56, 144, 1, 144, 3, 3, 2, SAME, mobilenet2_3);
+BM_ConvFloatDepthwiseBk(32, 28, 28, 192, 1, 192, 3, 3, 1, SAME, mobilenet2_4);
+BM_ConvFloatDepthwiseBk(32, 28, 28, 192, 1, 192, 3, 3, 2, SAME, mobilenet2_5);
+BM_ConvFloatDepthwiseBk(32, 14, 14, 384, 1, 384, 3, 3, 1, SAME, mobilenet2_6);
+BM_ConvFloatDepthwiseBk(32, 14, 14, 576, 1, 576, 3, 3, 1, SAME, mobilenet2_7);
+BM_ConvFloatDepthwiseBk(32, 14, 14, 576, 1, 576, 3, 3, 2, SAME, mobilenet2_8);
+BM_ConvFloatDepthwiseBk(32, 7, 7, 960, 1, 960, 3, 3, 1, SAME, mobilenet2_9);
+
 static void BM_LRNFloat(int iters, int depth, int cols, int rows,
                         int batch_size, int range, int num_threads,
                         const string& label) {
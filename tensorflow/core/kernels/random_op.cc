@@ -22,11 +22,14 @@ limitations under the License.
 #include <algorithm>
 #include <cmath>
 #include <memory>
+#include <type_traits>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/kernels/cpu_isa_dispatch.h"
+#include "tensorflow/core/kernels/random_op_cpu.h"
 #include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
@@ -68,6 +71,122 @@ struct FillPhiloxRandom {
   }
 };
 
+// Writes the next 'num_groups' outputs of 'gen' to 'out', using SIMD kernels
+// for the best instruction set of the CPU (see random_op_cpu.h), and
+// advances 'gen' past them. The results are the same as those of 'gen'.
+template <typename T>
+void GeneratePhiloxSamples(random::PhiloxRandom* gen, int64 num_groups,
+                           T* out) {
+  const uint32 counter[4] = {gen->counter()[0], gen->counter()[1],
+                             gen->counter()[2], gen->counter()[3]};
+  const uint32 key[2] = {gen->key()[0], gen->key()[1]};
+  if (!DispatchPhiloxToCPUISA(counter, key, num_groups, out)) {
+    typedef typename std::conditional<std::is_same<T, float>::value,
+                                      philox_cpu::UniformFloatOutput,
+                                      philox_cpu::BitsOutput>::type Output;
+    philox_cpu::PhiloxGenerate<Output>(counter, key, num_groups, out);
+  }
+  gen->Skip(num_groups);
+}
+
+// Hands out Philox outputs that were generated ahead of time.
+class PhiloxSampleBuffer {
+ public:
+  using ResultType = PhiloxRandom::ResultType;
+  using ResultElementType = PhiloxRandom::ResultElementType;
+  static const int kResultElementCount = PhiloxRandom::kResultElementCount;
+
+  explicit PhiloxSampleBuffer(const uint32* samples) : samples_(samples) {}
+
+  ResultType operator()() {
+    ResultType result;
+    for (int i = 0; i < kResultElementCount; ++i) {
+      result[i] = samples_[i];
+    }
+    samples_ += kResultElementCount;
+    return result;
+  }
+
+ private:
+  const uint32* samples_;
+};
+
+// The distributions whose groups are computed from Philox outputs that are
+// generated in batches. They must not have state, and must consume exactly
+// one Philox output per group. 'type' is the same distribution over a
+// PhiloxSampleBuffer, or void for the others.
+template <class Distribution>
+struct BatchedPhiloxDistribution {
+  typedef void type;
+};
+
+#define BATCHED_PHILOX_DISTRIBUTION(DISTRIBUTION, TYPE)                        \
+  template <>                                                                  \
+  struct BatchedPhiloxDistribution<DISTRIBUTION<PhiloxRandom, TYPE>> {         \
+    typedef DISTRIBUTION<PhiloxSampleBuffer, TYPE> type;                       \
+  };
+#define BATCHED_PHILOX_DISTRIBUTIONS(TYPE)                                     \
+  BATCHED_PHILOX_DISTRIBUTION(random::UniformDistribution, TYPE)               \
+  BATCHED_PHILOX_DISTRIBUTION(random::NormalDistribution, TYPE)
+TF_CALL_half(BATCHED_PHILOX_DISTRIBUTIONS);
+TF_CALL_bfloat16(BATCHED_PHILOX_DISTRIBUTIONS);
+TF_CALL_float(BATCHED_PHILOX_DISTRIBUTIONS);
+TF_CALL_double(BATCHED_PHILOX_DISTRIBUTIONS);
+#undef BATCHED_PHILOX_DISTRIBUTIONS
+#undef BATCHED_PHILOX_DISTRIBUTION
+
+// Fills 'num_groups' full groups from 'gen', and advances 'gen' past them.
+template <class Distribution,
+          class BatchedDistribution =
+              typename BatchedPhiloxDistribution<Distribution>::type>
+struct FillPhiloxRandomGroups {
+  typedef typename Distribution::ResultElementType T;
+  static void Run(random::PhiloxRandom* gen, T* data, int64 num_groups,
+                  const Distribution&) {
+    const int kGroupSize = Distribution::kResultElementCount;
+    // Small enough to stay in L1.
+    const int kBatchGroups = 256;
+    uint32 samples[kBatchGroups * PhiloxRandom::kResultElementCount];
+    BatchedDistribution dist;
+    while (num_groups > 0) {
+      const int64 batch_groups = std::min<int64>(num_groups, kBatchGroups);
+      GeneratePhiloxSamples(gen, batch_groups, samples);
+      PhiloxSampleBuffer buffer(samples);
+      for (int64 i = 0; i < batch_groups; ++i) {
+        auto group = dist(&buffer);
+        std::copy(&group[0], &group[0] + kGroupSize, data);
+        data += kGroupSize;
+      }
+      num_groups -= batch_groups;
+    }
+  }
+};
+
+template <class Distribution>
+struct FillPhiloxRandomGroups<Distribution, void> {
+  typedef typename Distribution::ResultElementType T;
+  static void Run(random::PhiloxRandom* gen, T* data, int64 num_groups,
+                  Distribution dist) {
+    const int kGroupSize = Distribution::kResultElementCount;
+    for (int64 i = 0; i < num_groups; ++i) {
+      auto samples = dist(gen);
+      std::copy(&samples[0], &samples[0] + kGroupSize, data);
+      data += kGroupSize;
+    }
+  }
+};
+
+// Uniform floats are converted along with the generation.
+template <>
+struct FillPhiloxRandomGroups<
+    random::UniformDistribution<PhiloxRandom, float>,
+    random::UniformDistribution<PhiloxSampleBuffer, float>> {
+  static void Run(random::PhiloxRandom* gen, float* data, int64 num_groups,
+                  const random::UniformDistribution<PhiloxRandom, float>&) {
+    GeneratePhiloxSamples(gen, num_groups, data);
+  }
+};
+
 // A class to fill a specified range of random groups
 template <class Distribution, bool VariableSamplesPerOutput>
 struct FillPhiloxRandomTask;
@@ -82,19 +201,17 @@ struct FillPhiloxRandomTask<Distribution, false> {
     const int kGroupSize = Distribution::kResultElementCount;
 
     gen.Skip(start_group);
-    int64 offset = start_group * kGroupSize;
 
     // First fill all the full-size groups
     int64 limit_group_full = std::min(limit_group, size / kGroupSize);
-    for (int64 index = start_group; index < limit_group_full; ++index) {
-      auto samples = dist(&gen);
-      std::copy(&samples[0], &samples[0] + kGroupSize, data + offset);
-      offset += kGroupSize;
-    }
+    FillPhiloxRandomGroups<Distribution>::Run(
+        &gen, data + start_group * kGroupSize, limit_group_full - start_group,
+        dist);
 
     // If there are any remaining elements that need to be filled, process them
     if (limit_group_full < limit_group) {
-      int64 remaining_size = size - limit_group_full * kGroupSize;
+      int64 offset = limit_group_full * kGroupSize;
+      int64 remaining_size = size - offset;
       auto samples = dist(&gen);
       std::copy(&samples[0], &samples[0] + remaining_size, data + offset);
     }
@@ -0,0 +1,309 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_RANDOM_OP_CPU_H_
+#define TENSORFLOW_CORE_KERNELS_RANDOM_OP_CPU_H_
+
+#include <string.h>
+
+#include "tensorflow/core/platform/types.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Generates many consecutive outputs of the Philox4x32-10 generator at once,
+// bit for bit the same as calling random::PhiloxRandom::operator() in a loop.
+// Each SIMD lane runs the ten rounds on a counter of its own, so that a packet
+// of N lanes yields N outputs, which are transposed back into the order of
+// the scalar generator before they are stored.
+//
+// The same code is compiled into cpu_isa_kernels_*.cc with the flags of
+// another instruction set (see cpu_isa_kernels_impl.h), so everything here
+// has internal linkage, and this header must not include philox_random.h or
+// random_distributions.h, whose inline functions would be compiled with those
+// flags too.
+
+namespace tensorflow {
+namespace functor {
+namespace {
+namespace philox_cpu {
+
+// The constants of random::PhiloxRandom.
+const uint32 kPhiloxW32A = 0x9E3779B9;
+const uint32 kPhiloxW32B = 0xBB67AE85;
+const uint32 kPhiloxM4x32A = 0xD2511F53;
+const uint32 kPhiloxM4x32B = 0xCD9E8D57;
+
+// Same as random::Uint32ToFloat.
+inline float Uint32ToFloat(uint32 x) {
+  const uint32 val = (static_cast<uint32>(127) << 23) | (x & 0x7fffffu);
+  float result;
+  memcpy(&result, &val, sizeof(val));
+  return result - 1.0f;
+}
+
+// Writes the output of the generator for 'counter' and 'key' to 'out', and
+// increments 'counter'.
+inline void PhiloxScalar(uint32* counter, const uint32* key, uint32* out) {
+  uint32 x0 = counter[0], x1 = counter[1], x2 = counter[2], x3 = counter[3];
+  uint32 k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; ++round) {
+    const uint64 p0 = static_cast<uint64>(kPhiloxM4x32A) * x0;
+    const uint64 p1 = static_cast<uint64>(kPhiloxM4x32B) * x2;
+    x0 = static_cast<uint32>(p1 >> 32) ^ x1 ^ k0;
+    x1 = static_cast<uint32>(p1);
+    x2 = static_cast<uint32>(p0 >> 32) ^ x3 ^ k1;
+    x3 = static_cast<uint32>(p0);
+    k0 += kPhiloxW32A;
+    k1 += kPhiloxW32B;
+  }
+  out[0] = x0;
+  out[1] = x1;
+  out[2] = x2;
+  out[3] = x3;
+  if (++counter[0] == 0 && ++counter[1] == 0 && ++counter[2] == 0) {
+    ++counter[3];
+  }
+}
+
+// Output of raw samples.
+struct BitsOutput {
+  typedef uint32 Scalar;
+  static void Run(uint32 x, uint32* out) { *out = x; }
+};
+
+// Output of the samples of random::UniformDistribution<PhiloxRandom, float>.
+struct UniformFloatOutput {
+  typedef float Scalar;
+  static void Run(uint32 x, float* out) { *out = Uint32ToFloat(x); }
+};
+
+#if defined(__SSE2__)
+#define TF_PHILOX_CPU_SIMD
+
+// A packet of 32-bit lanes, made of kPacketSize / 4 blocks of 128 bits.
+#if defined(__AVX512F__)
+typedef __m512i Packet;
+const int kPacketSize = 16;
+inline Packet Set1(uint32 x) { return _mm512_set1_epi32(x); }
+inline Packet Load(const uint32* p) { return _mm512_loadu_si512(p); }
+inline Packet Add(Packet a, Packet b) { return _mm512_add_epi32(a, b); }
+inline Packet Xor(Packet a, Packet b) { return _mm512_xor_si512(a, b); }
+// Multiplies the even lanes into 64-bit products.
+inline Packet MulEven(Packet a, Packet b) { return _mm512_mul_epu32(a, b); }
+inline Packet ShiftRight32(Packet a) { return _mm512_srli_epi64(a, 32); }
+inline Packet ShiftLeft32(Packet a) { return _mm512_slli_epi64(a, 32); }
+// Takes the even lanes of 'even' and the odd lanes of 'odd'.
+inline Packet Blend(Packet even, Packet odd) {
+  return _mm512_mask_blend_epi32(0xAAAA, even, odd);
+}
+inline Packet UnpackLo32(Packet a, Packet b) {
+  return _mm512_unpacklo_epi32(a, b);
+}
+inline Packet UnpackHi32(Packet a, Packet b) {
+  return _mm512_unpackhi_epi32(a, b);
+}
+inline Packet UnpackLo64(Packet a, Packet b) {
+  return _mm512_unpacklo_epi64(a, b);
+}
+inline Packet UnpackHi64(Packet a, Packet b) {
+  return _mm512_unpackhi_epi64(a, b);
+}
+inline void Store(Packet a, uint32* out) { _mm512_storeu_si512(out, a); }
+inline void Store(Packet a, float* out) {
+  const Packet bits =
+      _mm512_or_si512(_mm512_and_si512(a, Set1(0x7fffffu)), Set1(0x3f800000u));
+  _mm512_storeu_ps(out, _mm512_sub_ps(_mm512_castsi512_ps(bits),
+                                      _mm512_set1_ps(1.0f)));
+}
+#elif defined(__AVX2__)
+typedef __m256i Packet;
+const int kPacketSize = 8;
+inline Packet Set1(uint32 x) { return _mm256_set1_epi32(x); }
+inline Packet Load(const uint32* p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+inline Packet Add(Packet a, Packet b) { return _mm256_add_epi32(a, b); }
+inline Packet Xor(Packet a, Packet b) { return _mm256_xor_si256(a, b); }
+inline Packet MulEven(Packet a, Packet b) { return _mm256_mul_epu32(a, b); }
+inline Packet ShiftRight32(Packet a) { return _mm256_srli_epi64(a, 32); }
+inline Packet ShiftLeft32(Packet a) { return _mm256_slli_epi64(a, 32); }
+inline Packet Blend(Packet even, Packet odd) {
+  return _mm256_blend_epi32(even, odd, 0xAA);
+}
+inline Packet UnpackLo32(Packet a, Packet b) {
+  return _mm256_unpacklo_epi32(a, b);
+}
+inline Packet UnpackHi32(Packet a, Packet b) {
+  return _mm256_unpackhi_epi32(a, b);
+}
+inline Packet UnpackLo64(Packet a, Packet b) {
+  return _mm256_unpacklo_epi64(a, b);
+}
+inline Packet UnpackHi64(Packet a, Packet b) {
+  return _mm256_unpackhi_epi64(a, b);
+}
+inline void Store(Packet a, uint32* out) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), a);
+}
+inline void Store(Packet a, float* out) {
+  const Packet bits =
+      _mm256_or_si256(_mm256_and_si256(a, Set1(0x7fffffu)), Set1(0x3f800000u));
+  _mm256_storeu_ps(out, _mm256_sub_ps(_mm256_castsi256_ps(bits),
+                                      _mm256_set1_ps(1.0f)));
+}
+#else
+typedef __m128i Packet;
+const int kPacketSize = 4;
+inline Packet Set1(uint32 x) { return _mm_set1_epi32(x); }
+inline Packet Load(const uint32* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+inline Packet Add(Packet a, Packet b) { return _mm_add_epi32(a, b); }
+inline Packet Xor(Packet a, Packet b) { return _mm_xor_si128(a, b); }
+inline Packet MulEven(Packet a, Packet b) { return _mm_mul_epu32(a, b); }
+inline Packet ShiftRight32(Packet a) { return _mm_srli_epi64(a, 32); }
+inline Packet ShiftLeft32(Packet a) { return _mm_slli_epi64(a, 32); }
+inline Packet Blend(Packet even, Packet odd) {
+  // SSE2 has no 32-bit blend.
+  const Packet even_mask = _mm_set1_epi64x(0xffffffffu);
+  return _mm_or_si128(_mm_and_si128(even_mask, even),
+                      _mm_andnot_si128(even_mask, odd));
+}
+inline Packet UnpackLo32(Packet a, Packet b) {
+  return _mm_unpacklo_epi32(a, b);
+}
+inline Packet UnpackHi32(Packet a, Packet b) {
+  return _mm_unpackhi_epi32(a, b);
+}
+inline Packet UnpackLo64(Packet a, Packet b) {
+  return _mm_unpacklo_epi64(a, b);
+}
+inline Packet UnpackHi64(Packet a, Packet b) {
+  return _mm_unpackhi_epi64(a, b);
+}
+inline void Store(Packet a, uint32* out) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), a);
+}
+inline void Store(Packet a, float* out) {
+  const Packet bits =
+      _mm_or_si128(_mm_and_si128(a, Set1(0x7fffffu)), Set1(0x3f800000u));
+  _mm_storeu_ps(out, _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.0f)));
+}
+#endif
+
+// Computes the low and high halves of the 64-bit products of the lanes of 'x'
+// with the constant 'm'.
+inline void MultiplyHighLow(Packet m, Packet x, Packet* lo, Packet* hi) {
+  const Packet even = MulEven(x, m);
+  const Packet odd = MulEven(ShiftRight32(x), m);
+  *lo = Blend(even, ShiftLeft32(odd));
+  *hi = Blend(ShiftRight32(even), odd);
+}
+
+// Independent packets in flight, to hide the latency of the multiplications.
+const int kPackets = 4;
+// Outputs per call of PhiloxPackets.
+const int kPacketGroups = kPackets * kPacketSize;
+
+// Writes the outputs of the generator for the kPacketGroups counters starting
+// at 'counter', which must not carry out of counter[0].
+template <class Output>
+inline void PhiloxPackets(const uint32* counter, const uint32* key,
+                          typename Output::Scalar* out) {
+  // The transposition at the end turns the outputs of lane 4 * q + r into
+  // output r * kBlocks + q of the packet, where q is the 128-bit block.
+  const int kBlocks = kPacketSize / 4;
+  uint32 lane_offsets[kPacketSize];
+  for (int i = 0; i < kPacketSize; ++i) {
+    lane_offsets[i] = (i % 4) * kBlocks + i / 4;
+  }
+  const Packet offsets = Load(lane_offsets);
+
+  Packet x0[kPackets], x1[kPackets], x2[kPackets], x3[kPackets];
+  for (int p = 0; p < kPackets; ++p) {
+    x0[p] = Add(Set1(counter[0] + p * kPacketSize), offsets);
+    x1[p] = Set1(counter[1]);
+    x2[p] = Set1(counter[2]);
+    x3[p] = Set1(counter[3]);
+  }
+  const Packet ma = Set1(kPhiloxM4x32A);
+  const Packet mb = Set1(kPhiloxM4x32B);
+  uint32 k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; ++round) {
+    const Packet key0 = Set1(k0);
+    const Packet key1 = Set1(k1);
+    for (int p = 0; p < kPackets; ++p) {
+      Packet lo0, hi0, lo1, hi1;
+      MultiplyHighLow(ma, x0[p], &lo0, &hi0);
+      MultiplyHighLow(mb, x2[p], &lo1, &hi1);
+      x0[p] = Xor(Xor(hi1, x1[p]), key0);
+      x1[p] = lo1;
+      x2[p] = Xor(Xor(hi0, x3[p]), key1);
+      x3[p] = lo0;
+    }
+    k0 += kPhiloxW32A;
+    k1 += kPhiloxW32B;
+  }
+
+  // Transposes the 4x4 blocks of (x0, x1, x2, x3), so that each 128-bit
+  // block holds the four words of one output.
+  for (int p = 0; p < kPackets; ++p) {
+    const Packet t0 = UnpackLo32(x0[p], x1[p]);
+    const Packet t1 = UnpackLo32(x2[p], x3[p]);
+    const Packet t2 = UnpackHi32(x0[p], x1[p]);
+    const Packet t3 = UnpackHi32(x2[p], x3[p]);
+    typename Output::Scalar* packet_out = out + 4 * kPacketSize * p;
+    Store(UnpackLo64(t0, t1), packet_out);
+    Store(UnpackHi64(t0, t1), packet_out + kPacketSize);
+    Store(UnpackLo64(t2, t3), packet_out + 2 * kPacketSize);
+    Store(UnpackHi64(t2, t3), packet_out + 3 * kPacketSize);
+  }
+}
+#endif  // __SSE2__
+
+// Writes the next 'num_groups' outputs of the generator with 'counter' and
+// 'key' to 'out', four words per output, converted by 'Output'.
+template <class Output>
+inline void PhiloxGenerate(const uint32* counter, const uint32* key,
+                           int64 num_groups, typename Output::Scalar* out) {
+  uint32 c[4] = {counter[0], counter[1], counter[2], counter[3]};
+  while (num_groups > 0) {
+#ifdef TF_PHILOX_CPU_SIMD
+    // The scalar code takes care of the rare carries out of c[0].
+    if (num_groups >= kPacketGroups &&
+        c[0] <= ~static_cast<uint32>(0) - kPacketGroups) {
+      PhiloxPackets<Output>(c, key, out);
+      c[0] += kPacketGroups;
+      out += 4 * kPacketGroups;
+      num_groups -= kPacketGroups;
+      continue;
+    }
+#endif  // TF_PHILOX_CPU_SIMD
+    uint32 bits[4];
+    PhiloxScalar(c, key, bits);
+    for (int i = 0; i < 4; ++i) Output::Run(bits[i], out + i);
+    out += 4;
+    --num_groups;
+  }
+}
+
+}  // namespace philox_cpu
+}  // namespace
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_RANDOM_OP_CPU_H_
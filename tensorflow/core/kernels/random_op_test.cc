@@ -14,11 +14,14 @@ limitations under the License.
 ==============================================================================*/
 
 #include <random>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/random_op_cpu.h"
 #include "tensorflow/core/lib/math/math_util.h"
 #include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -58,6 +61,42 @@ Graph* TruncatedNormal(int64 n) {
   return g;
 }
 
+// Checks that the SIMD generator matches random::PhiloxRandom, including
+// around the carries out of the lowest word of the counter.
+TEST(PhiloxCPUTest, MatchesPhiloxRandom) {
+  using functor::philox_cpu::BitsOutput;
+  using functor::philox_cpu::PhiloxGenerate;
+  using functor::philox_cpu::UniformFloatOutput;
+  for (uint64 skip : {0ull, 5ull, 0xfffffffdull, 0xffffff9cull,
+                      0xfffffffffffffff0ull}) {
+    for (int64 num_groups : {0, 1, 7, 63, 64, 65, 1000}) {
+      random::PhiloxRandom gen(0x1234567890abull, 0xffffffffffffffffull);
+      gen.Skip(skip);
+      const uint32 counter[4] = {gen.counter()[0], gen.counter()[1],
+                                 gen.counter()[2], gen.counter()[3]};
+      const uint32 key[2] = {gen.key()[0], gen.key()[1]};
+      std::vector<uint32> bits(4 * num_groups);
+      std::vector<float> floats(4 * num_groups);
+      PhiloxGenerate<BitsOutput>(counter, key, num_groups, bits.data());
+      PhiloxGenerate<UniformFloatOutput>(counter, key, num_groups,
+                                         floats.data());
+
+      random::PhiloxRandom float_gen = gen;
+      random::UniformDistribution<random::PhiloxRandom, float> uniform;
+      for (int64 i = 0; i < num_groups; ++i) {
+        const auto expected_bits = gen();
+        const auto expected_floats = uniform(&float_gen);
+        for (int j = 0; j < 4; ++j) {
+          ASSERT_EQ(expected_bits[j], bits[4 * i + j])
+              << skip << " " << num_groups << " " << i;
+          ASSERT_EQ(expected_floats[j], floats[4 * i + j])
+              << skip << " " << num_groups << " " << i;
+        }
+      }
+    }
+  }
+}
+
 #define BM_RNG(DEVICE, RNG)                                   \
   void BM_##DEVICE##_##RNG(int iters, int arg) {              \
     testing::ItemsProcessed(static_cast<int64>(iters) * arg); \
@@ -117,6 +156,35 @@ void BM_PhiloxRandom(int iters) {
 }
 BENCHMARK(BM_PhiloxRandom);
 
+void BM_PhiloxRandomBatch(int iters) {
+  // Fill 2M random numbers
+  int count = 2 << 20;
+
+  testing::ItemsProcessed(static_cast<int64>(iters) * count);
+
+  random::PhiloxRandom gen(0x12345);
+  const uint32 key[2] = {gen.key()[0], gen.key()[1]};
+
+  // Generates in batches that stay in L1, as the random ops do.
+  const int kBatchGroups = 256;
+  std::vector<uint32> samples(4 * kBatchGroups);
+  uint32 val = 1;
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0; j < count; j += 4 * kBatchGroups) {
+      const uint32 counter[4] = {gen.counter()[0], gen.counter()[1],
+                                 gen.counter()[2], gen.counter()[3]};
+      functor::philox_cpu::PhiloxGenerate<functor::philox_cpu::BitsOutput>(
+          counter, key, kBatchGroups, samples.data());
+      gen.Skip(kBatchGroups);
+      val ^= samples[0] ^ samples[4 * kBatchGroups - 1];
+    }
+  }
+
+  // A anchor point to make sure the compiler does not cut corners
+  CHECK(val) << val;
+}
+BENCHMARK(BM_PhiloxRandomBatch);
+
 void BM_StdMTRandom(int iters) {
   // Fill 2M random numbers
   int count = 2 << 20;
@@ -15,6 +15,7 @@ limitations under the License.
 
 // See docs in ../ops/string_ops.cc.
 
+#include <algorithm>
 #include <string>
 
 #include "tensorflow/core/framework/kernel_def_builder.h"
@@ -25,7 +26,6 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
-#include "tensorflow/core/lib/strings/str_util.h"
 
 namespace tensorflow {
 
@@ -172,8 +172,19 @@ class ReduceJoinOp : public OpKernel {
         curr_strings[reduction_index] =
             input_flat(output_full_index + reduction_full_index);
       }
-      output_flat(output_index) =
-          str_util::Join(curr_strings, separator_.c_str());
+      // Join directly into the output element, sized once up front.
+      int64 joined_size =
+          separator_.size() * std::max<int64>(reduction_iter_size - 1, 0);
+      for (const StringPiece& piece : curr_strings) {
+        joined_size += piece.size();
+      }
+      string& joined = output_flat(output_index);
+      joined.clear();
+      joined.reserve(joined_size);
+      for (int64 i = 0; i < reduction_iter_size; ++i) {
+        if (i > 0) joined.append(separator_);
+        joined.append(curr_strings[i].data(), curr_strings[i].size());
+      }
     }
   }
 
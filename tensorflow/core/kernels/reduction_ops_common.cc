@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/reduction_ops_common.h"
 
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/util/env_var.h"
 
 namespace tensorflow {
 
@@ -152,4 +153,18 @@ Status ReductionHelper::Simplify(const Tensor& data, const Tensor& axis,
   return Status::OK();
 }
 
+namespace functor {
+
+bool UseKahanSummation() {
+  bool use_kahan_summation;
+  Status status = ReadBoolFromEnvVar("TF_REDUCTION_KAHAN_SUMMATION",
+                                     /*default_val=*/false,
+                                     &use_kahan_summation);
+  if (!status.ok()) {
+    LOG(WARNING) << status;
+  }
+  return use_kahan_summation;
+}
+
+}  // namespace functor
 }  // namespace tensorflow
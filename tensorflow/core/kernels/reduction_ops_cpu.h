@@ -0,0 +1,454 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_REDUCTION_OPS_CPU_H_
+#define TENSORFLOW_KERNELS_REDUCTION_OPS_CPU_H_
+
+// CPU kernels for float and double Sum, Mean, Max and Min reductions over a
+// single dimension of a tensor, seen as [outer, reduced, inner]. This covers
+// full reductions of 1-D tensors, row and column reductions of matrices, and
+// reductions over the middle dimension of 3-D tensors, for which Eigen's
+// reduce parallelizes poorly when the outer dimensions are small.
+//
+// Rows (inner == 1) are reduced with a SIMD tree reduction: leaves of
+// kLeafSize elements are reduced with independent packet accumulators and
+// combined pairwise. Columns (inner > 1) are reduced with a packet of
+// accumulators per column. Long reductions are split into blocks whose
+// partial results are combined at the end, so that few rows or columns can
+// still use all the threads. The blocks only depend on the shape of the
+// input, which makes the results independent of the number of threads.
+//
+// Setting the environment variable TF_REDUCTION_KAHAN_SUMMATION to true makes
+// sums and means use compensated (Kahan) summation, which keeps their error
+// independent of the number of elements at about 4x the arithmetic.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace functor {
+
+// Returns true if TF_REDUCTION_KAHAN_SUMMATION is set. Defined in
+// reduction_ops_common.cc.
+bool UseKahanSummation();
+
+namespace cpu_reduction {
+
+// Elements reduced with a flat loop before results are combined pairwise, as
+// in Eigen's full reductions.
+constexpr int64 kLeafSize = 1024;
+// Minimum number of elements per partial result of a split reduction, and
+// maximum number of partial results per output.
+constexpr int64 kMinBlockSize = 16 * 1024;
+constexpr int64 kMaxBlocks = 64;
+// Reductions are only split if they have fewer independent units of work
+// (rows, or tiles of columns) than this.
+constexpr int64 kMinUnitsWithoutSplit = 64;
+// Number of columns reduced together by a column reduction.
+constexpr int64 kColumnTile = 256;
+
+// Describes the reducers that these kernels support. 'BaseReducer' is the
+// stateless reducer that is applied to the elements; Mean divides its result
+// by the number of elements.
+template <typename Reducer>
+struct ReducerTraits {
+  static constexpr bool kSupported = false;
+};
+
+#define DEFINE_REDUCER_TRAITS(T)                                       \
+  template <>                                                          \
+  struct ReducerTraits<Eigen::internal::SumReducer<T>> {               \
+    static constexpr bool kSupported = true;                           \
+    static constexpr bool kIsSum = true;                               \
+    static constexpr bool kIsMean = false;                             \
+    typedef Eigen::internal::SumReducer<T> BaseReducer;                \
+  };                                                                   \
+  template <>                                                          \
+  struct ReducerTraits<Eigen::internal::MeanReducer<T>> {              \
+    static constexpr bool kSupported = true;                           \
+    static constexpr bool kIsSum = true;                               \
+    static constexpr bool kIsMean = true;                              \
+    typedef Eigen::internal::SumReducer<T> BaseReducer;                \
+  };                                                                   \
+  template <>                                                          \
+  struct ReducerTraits<Eigen::internal::MaxReducer<T>> {               \
+    static constexpr bool kSupported = true;                           \
+    static constexpr bool kIsSum = false;                              \
+    static constexpr bool kIsMean = false;                             \
+    typedef Eigen::internal::MaxReducer<T> BaseReducer;                \
+  };                                                                   \
+  template <>                                                          \
+  struct ReducerTraits<Eigen::internal::MinReducer<T>> {               \
+    static constexpr bool kSupported = true;                           \
+    static constexpr bool kIsSum = false;                              \
+    static constexpr bool kIsMean = false;                             \
+    typedef Eigen::internal::MinReducer<T> BaseReducer;                \
+  };
+DEFINE_REDUCER_TRAITS(float)
+DEFINE_REDUCER_TRAITS(double)
+#undef DEFINE_REDUCER_TRAITS
+
+// Adds 'x' to the compensated sum ('sum', 'compensation').
+template <typename T>
+inline void KahanAdd(T x, T* sum, T* compensation) {
+  const T y = x - *compensation;
+  const T t = *sum + y;
+  *compensation = (t - *sum) - y;
+  *sum = t;
+}
+
+template <typename Packet>
+inline void KahanAddPacket(const Packet& x, Packet* sum,
+                           Packet* compensation) {
+  using namespace Eigen::internal;  // NOLINT(build/namespaces)
+  const Packet y = psub(x, *compensation);
+  const Packet t = padd(*sum, y);
+  *compensation = psub(psub(t, *sum), y);
+  *sum = t;
+}
+
+// Adds the lanes of the compensated packet sum ('sum', 'compensation') to
+// the compensated sum ('total', 'total_compensation').
+template <typename T, typename Packet>
+inline void KahanAddLanes(const Packet& sum, const Packet& compensation,
+                          T* total, T* total_compensation) {
+  constexpr int kPacketSize = Eigen::internal::unpacket_traits<Packet>::size;
+  T sums[kPacketSize];
+  T compensations[kPacketSize];
+  Eigen::internal::pstoreu(sums, sum);
+  Eigen::internal::pstoreu(compensations, compensation);
+  for (int i = 0; i < kPacketSize; ++i) {
+    KahanAdd(sums[i], total, total_compensation);
+    KahanAdd(-compensations[i], total, total_compensation);
+  }
+}
+
+// Reduces the n contiguous elements at 'in' with a flat loop over 4
+// independent packet accumulators.
+template <typename T, typename Reducer>
+T ReduceLeaf(const T* in, int64 n, const Reducer& reducer) {
+  using namespace Eigen::internal;  // NOLINT(build/namespaces)
+  typedef typename packet_traits<T>::type Packet;
+  constexpr int64 kPacketSize = unpacket_traits<Packet>::size;
+  Packet accum0 = reducer.template initializePacket<Packet>();
+  Packet accum1 = accum0;
+  Packet accum2 = accum0;
+  Packet accum3 = accum0;
+  int64 i = 0;
+  for (; i + 4 * kPacketSize <= n; i += 4 * kPacketSize) {
+    reducer.reducePacket(ploadu<Packet>(in + i), &accum0);
+    reducer.reducePacket(ploadu<Packet>(in + i + kPacketSize), &accum1);
+    reducer.reducePacket(ploadu<Packet>(in + i + 2 * kPacketSize), &accum2);
+    reducer.reducePacket(ploadu<Packet>(in + i + 3 * kPacketSize), &accum3);
+  }
+  for (; i + kPacketSize <= n; i += kPacketSize) {
+    reducer.reducePacket(ploadu<Packet>(in + i), &accum0);
+  }
+  reducer.reducePacket(accum1, &accum0);
+  reducer.reducePacket(accum3, &accum2);
+  reducer.reducePacket(accum2, &accum0);
+  T accum = reducer.initialize();
+  for (; i < n; ++i) {
+    reducer.reduce(in[i], &accum);
+  }
+  return reducer.finalizeBoth(accum, accum0);
+}
+
+// Reduces the n contiguous elements at 'in' with a tree of leaves.
+template <typename T, typename Reducer>
+T ReduceTree(const T* in, int64 n, const Reducer& reducer) {
+  if (n <= kLeafSize) return ReduceLeaf(in, n, reducer);
+  const int64 half = (n / kLeafSize + 1) / 2 * kLeafSize;
+  T accum = ReduceTree(in, half, reducer);
+  reducer.reduce(ReduceTree(in + half, n - half, reducer), &accum);
+  return accum;
+}
+
+// Returns the compensated sum of the n contiguous elements at 'in'.
+template <typename T>
+T KahanSum(const T* in, int64 n) {
+  using namespace Eigen::internal;  // NOLINT(build/namespaces)
+  typedef typename packet_traits<T>::type Packet;
+  constexpr int64 kPacketSize = unpacket_traits<Packet>::size;
+  Packet sum0 = pset1<Packet>(T(0));
+  Packet sum1 = sum0;
+  Packet compensation0 = sum0;
+  Packet compensation1 = sum0;
+  int64 i = 0;
+  for (; i + 2 * kPacketSize <= n; i += 2 * kPacketSize) {
+    KahanAddPacket(ploadu<Packet>(in + i), &sum0, &compensation0);
+    KahanAddPacket(ploadu<Packet>(in + i + kPacketSize), &sum1,
+                   &compensation1);
+  }
+  T sum = T(0);
+  T compensation = T(0);
+  KahanAddLanes(sum0, compensation0, &sum, &compensation);
+  KahanAddLanes(sum1, compensation1, &sum, &compensation);
+  for (; i < n; ++i) {
+    KahanAdd(in[i], &sum, &compensation);
+  }
+  return sum - compensation;
+}
+
+template <typename T, typename Reducer>
+T ReduceContiguous(const T* in, int64 n, const Reducer& reducer, bool kahan) {
+  return kahan ? KahanSum(in, n) : ReduceTree(in, n, reducer);
+}
+
+// Sets out[0, width) to the reduction of the 'num_rows' rows of 'width'
+// elements at 'in', which are 'row_stride' elements apart. Each packet of
+// columns is accumulated in registers over all the rows.
+template <typename T, typename Reducer>
+void ReduceColumns(const T* in, int64 num_rows, int64 row_stride, int64 width,
+                   const Reducer& reducer, T* out) {
+  using namespace Eigen::internal;  // NOLINT(build/namespaces)
+  typedef typename packet_traits<T>::type Packet;
+  constexpr int64 kPacketSize = unpacket_traits<Packet>::size;
+  int64 j = 0;
+  for (; j + 4 * kPacketSize <= width; j += 4 * kPacketSize) {
+    Packet accum0 = reducer.template initializePacket<Packet>();
+    Packet accum1 = accum0;
+    Packet accum2 = accum0;
+    Packet accum3 = accum0;
+    const T* row = in + j;
+    for (int64 r = 0; r < num_rows; ++r, row += row_stride) {
+      reducer.reducePacket(ploadu<Packet>(row), &accum0);
+      reducer.reducePacket(ploadu<Packet>(row + kPacketSize), &accum1);
+      reducer.reducePacket(ploadu<Packet>(row + 2 * kPacketSize), &accum2);
+      reducer.reducePacket(ploadu<Packet>(row + 3 * kPacketSize), &accum3);
+    }
+    pstoreu(out + j, accum0);
+    pstoreu(out + j + kPacketSize, accum1);
+    pstoreu(out + j + 2 * kPacketSize, accum2);
+    pstoreu(out + j + 3 * kPacketSize, accum3);
+  }
+  for (; j + kPacketSize <= width; j += kPacketSize) {
+    Packet accum = reducer.template initializePacket<Packet>();
+    const T* row = in + j;
+    for (int64 r = 0; r < num_rows; ++r, row += row_stride) {
+      reducer.reducePacket(ploadu<Packet>(row), &accum);
+    }
+    pstoreu(out + j, accum);
+  }
+  for (; j < width; ++j) {
+    T accum = reducer.initialize();
+    const T* row = in + j;
+    for (int64 r = 0; r < num_rows; ++r, row += row_stride) {
+      reducer.reduce(*row, &accum);
+    }
+    out[j] = accum;
+  }
+}
+
+// Same as ReduceColumns for compensated sums.
+template <typename T>
+void KahanSumColumns(const T* in, int64 num_rows, int64 row_stride,
+                     int64 width, T* out) {
+  using namespace Eigen::internal;  // NOLINT(build/namespaces)
+  typedef typename packet_traits<T>::type Packet;
+  constexpr int64 kPacketSize = unpacket_traits<Packet>::size;
+  int64 j = 0;
+  for (; j + 2 * kPacketSize <= width; j += 2 * kPacketSize) {
+    Packet sum0 = pset1<Packet>(T(0));
+    Packet sum1 = sum0;
+    Packet compensation0 = sum0;
+    Packet compensation1 = sum0;
+    const T* row = in + j;
+    for (int64 r = 0; r < num_rows; ++r, row += row_stride) {
+      KahanAddPacket(ploadu<Packet>(row), &sum0, &compensation0);
+      KahanAddPacket(ploadu<Packet>(row + kPacketSize), &sum1,
+                     &compensation1);
+    }
+    pstoreu(out + j, psub(sum0, compensation0));
+    pstoreu(out + j + kPacketSize, psub(sum1, compensation1));
+  }
+  for (; j < width; ++j) {
+    T sum = T(0);
+    T compensation = T(0);
+    const T* row = in + j;
+    for (int64 r = 0; r < num_rows; ++r, row += row_stride) {
+      KahanAdd(*row, &sum, &compensation);
+    }
+    out[j] = sum - compensation;
+  }
+}
+
+// Number of partial results for each of 'num_units' independent reductions
+// of 'size' elements.
+inline int64 NumBlocks(int64 num_units, int64 size) {
+  if (num_units >= kMinUnitsWithoutSplit) return 1;
+  return std::max<int64>(1, std::min(kMaxBlocks, size / kMinBlockSize));
+}
+
+// Reduces the middle dimension of the [outer, reduced, inner] tensor 'in'
+// into the [outer, inner] tensor 'out'.
+template <typename T, typename Reducer>
+void ReduceMiddleDimension(OpKernelContext* ctx, const T* in, int64 outer,
+                           int64 reduced, int64 inner, const Reducer& reducer,
+                           bool kahan, bool mean, T* out) {
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *ctx->device()->tensorflow_cpu_worker_threads();
+  const int64 cost_per_element = kahan ? 4 : 1;
+  auto finalize = [reduced, mean](T value) {
+    return mean ? value / static_cast<T>(reduced) : value;
+  };
+
+  if (inner == 1) {
+    // Row reductions. Partial results are aligned on leaves.
+    const int64 num_blocks = NumBlocks(outer, reduced);
+    const int64 block_size =
+        num_blocks == 1
+            ? reduced
+            : (reduced / num_blocks + kLeafSize - 1) / kLeafSize * kLeafSize;
+    const int64 blocks_per_row = (reduced + block_size - 1) / block_size;
+    std::vector<T> partials(blocks_per_row > 1 ? outer * blocks_per_row : 0);
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          outer * blocks_per_row, block_size * cost_per_element,
+          [&](int64 start, int64 limit) {
+            for (int64 unit = start; unit < limit; ++unit) {
+              const int64 row = unit / blocks_per_row;
+              const int64 begin = unit % blocks_per_row * block_size;
+              const T result = ReduceContiguous(
+                  in + row * reduced + begin,
+                  std::min(block_size, reduced - begin), reducer, kahan);
+              if (blocks_per_row == 1) {
+                out[row] = finalize(result);
+              } else {
+                partials[unit] = result;
+              }
+            }
+          });
+    if (blocks_per_row > 1) {
+      for (int64 row = 0; row < outer; ++row) {
+        out[row] = finalize(ReduceContiguous(
+            partials.data() + row * blocks_per_row, blocks_per_row, reducer,
+            kahan));
+      }
+    }
+    return;
+  }
+
+  // Column reductions, one tile of columns at a time.
+  const int64 tiles_per_row = (inner + kColumnTile - 1) / kColumnTile;
+  const int64 num_blocks = NumBlocks(outer * tiles_per_row, reduced * inner);
+  const int64 block_rows = (reduced + num_blocks - 1) / num_blocks;
+  const int64 blocks_per_tile = (reduced + block_rows - 1) / block_rows;
+  // Partial results of block b of row o are at [(o * blocks + b) * inner].
+  std::vector<T> partials(blocks_per_tile > 1 ? outer * blocks_per_tile * inner
+                                              : 0);
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        outer * tiles_per_row * blocks_per_tile,
+        block_rows * std::min(inner, kColumnTile) * cost_per_element,
+        [&](int64 start, int64 limit) {
+          for (int64 unit = start; unit < limit; ++unit) {
+            const int64 block = unit % blocks_per_tile;
+            const int64 tile = unit / blocks_per_tile % tiles_per_row;
+            const int64 row = unit / blocks_per_tile / tiles_per_row;
+            const int64 row_begin = block * block_rows;
+            const int64 col_begin = tile * kColumnTile;
+            const int64 width = std::min(kColumnTile, inner - col_begin);
+            const T* block_in = in + (row * reduced + row_begin) * inner +
+                                col_begin;
+            const int64 num_rows = std::min(block_rows, reduced - row_begin);
+            T* block_out =
+                blocks_per_tile == 1
+                    ? out + row * inner + col_begin
+                    : partials.data() +
+                          (row * blocks_per_tile + block) * inner + col_begin;
+            if (kahan) {
+              KahanSumColumns(block_in, num_rows, inner, width, block_out);
+            } else {
+              ReduceColumns(block_in, num_rows, inner, width, reducer,
+                            block_out);
+            }
+            if (blocks_per_tile == 1 && mean) {
+              for (int64 j = 0; j < width; ++j) {
+                block_out[j] = finalize(block_out[j]);
+              }
+            }
+          }
+        });
+  if (blocks_per_tile > 1) {
+    for (int64 row = 0; row < outer; ++row) {
+      const T* row_partials = partials.data() + row * blocks_per_tile * inner;
+      T* row_out = out + row * inner;
+      if (kahan) {
+        KahanSumColumns(row_partials, blocks_per_tile, inner, inner, row_out);
+      } else {
+        ReduceColumns(row_partials, blocks_per_tile, inner, inner, reducer,
+                      row_out);
+      }
+      for (int64 j = 0; j < inner; ++j) {
+        row_out[j] = finalize(row_out[j]);
+      }
+    }
+  }
+}
+
+template <typename Reducer,
+          bool kSupported = ReducerTraits<Reducer>::kSupported>
+struct CpuReduce {
+  template <typename OUT_T, typename IN_T, typename ReductionAxes>
+  static bool Run(OpKernelContext* ctx, OUT_T out, IN_T in,
+                  const ReductionAxes& reduction_axes) {
+    return false;
+  }
+};
+
+template <typename Reducer>
+struct CpuReduce<Reducer, true> {
+  template <typename OUT_T, typename IN_T, typename ReductionAxes>
+  static bool Run(OpKernelContext* ctx, OUT_T out, IN_T in,
+                  const ReductionAxes& reduction_axes) {
+    if (Eigen::internal::array_size<ReductionAxes>::value != 1) return false;
+    typedef ReducerTraits<Reducer> Traits;
+    const int axis = reduction_axes[0];
+    int64 outer = 1;
+    int64 inner = 1;
+    for (int i = 0; i < in.rank(); ++i) {
+      if (i < axis) outer *= in.dimension(i);
+      if (i > axis) inner *= in.dimension(i);
+    }
+    static const bool use_kahan_summation = UseKahanSummation();
+    ReduceMiddleDimension(ctx, in.data(), outer, in.dimension(axis), inner,
+                          typename Traits::BaseReducer(),
+                          Traits::kIsSum && use_kahan_summation,
+                          Traits::kIsMean, out.data());
+    return true;
+  }
+};
+
+}  // namespace cpu_reduction
+
+// Computes out = in.reduce(reduction_axes, Reducer()) with the kernels above
+// and returns true, or returns false if they do not support the reduction.
+template <typename Reducer, typename OUT_T, typename IN_T,
+          typename ReductionAxes>
+bool ReduceOnCpu(OpKernelContext* ctx, OUT_T out, IN_T in,
+                 const ReductionAxes& reduction_axes) {
+  return cpu_reduction::CpuReduce<Reducer>::Run(ctx, out, in, reduction_axes);
+}
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_REDUCTION_OPS_CPU_H_
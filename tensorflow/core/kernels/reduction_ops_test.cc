@@ -13,13 +13,203 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <stdlib.h>
+
+#include <cmath>
+#include <vector>
+
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/reduction_ops_cpu.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
+namespace {
+
+TEST(UseKahanSummationTest, ReadsEnvironmentVariable) {
+  setenv("TF_REDUCTION_KAHAN_SUMMATION", "true", 1);
+  EXPECT_TRUE(functor::UseKahanSummation());
+  setenv("TF_REDUCTION_KAHAN_SUMMATION", "0", 1);
+  EXPECT_FALSE(functor::UseKahanSummation());
+  // A malformed value falls back to the default instead of aborting.
+  setenv("TF_REDUCTION_KAHAN_SUMMATION", "maybe", 1);
+  EXPECT_FALSE(functor::UseKahanSummation());
+  unsetenv("TF_REDUCTION_KAHAN_SUMMATION");
+  EXPECT_FALSE(functor::UseKahanSummation());
+}
+
+std::vector<float> RandomFloats(int64 n) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<float> values(n);
+  for (float& value : values) value = rnd.RandFloat();
+  return values;
+}
+
+TEST(KahanSummationTest, RowSumIsMoreAccurate) {
+  const int64 n = 1 << 22;
+  const std::vector<float> values = RandomFloats(n);
+  double expected = 0;
+  for (float value : values) expected += value;
+
+  const float kahan = functor::cpu_reduction::KahanSum(values.data(), n);
+  float naive = 0;
+  for (float value : values) naive += value;
+  const double kahan_error = std::abs(kahan - expected);
+  const double naive_error = std::abs(naive - expected);
+  EXPECT_LT(kahan_error, 1e-6 * expected);
+  EXPECT_LT(kahan_error * 10, naive_error);
+}
+
+TEST(KahanSummationTest, ColumnSumIsMoreAccurate) {
+  const int64 num_rows = 1 << 20;
+  const int64 num_cols = 19;
+  const std::vector<float> values = RandomFloats(num_rows * num_cols);
+  std::vector<double> expected(num_cols, 0);
+  for (int64 r = 0; r < num_rows; ++r) {
+    for (int64 c = 0; c < num_cols; ++c) {
+      expected[c] += values[r * num_cols + c];
+    }
+  }
+
+  std::vector<float> kahan(num_cols);
+  std::vector<float> naive(num_cols);
+  functor::cpu_reduction::KahanSumColumns(values.data(), num_rows, num_cols,
+                                          num_cols, kahan.data());
+  functor::cpu_reduction::ReduceColumns(values.data(), num_rows, num_cols,
+                                        num_cols,
+                                        Eigen::internal::SumReducer<float>(),
+                                        naive.data());
+  double kahan_error = 0;
+  double naive_error = 0;
+  for (int64 c = 0; c < num_cols; ++c) {
+    kahan_error = std::max(kahan_error, std::abs(kahan[c] - expected[c]));
+    naive_error = std::max(naive_error, std::abs(naive[c] - expected[c]));
+    EXPECT_LT(std::abs(kahan[c] - expected[c]), 1e-6 * expected[c]);
+  }
+  EXPECT_LT(kahan_error * 10, naive_error);
+}
+
+using functor::cpu_reduction::NumBlocks;
+using functor::cpu_reduction::kColumnTile;
+using functor::cpu_reduction::kLeafSize;
+
+class CpuReductionTest : public OpsTestBase {
+ protected:
+  // Runs Sum, Mean, Max and Min of a float tensor of 'shape' over 'axis',
+  // with values in [-1, 1) so that the sums cancel, and compares them with
+  // a reduction in double.
+  void TestReductions(const TensorShape& shape, int axis) {
+    int64 outer = 1;
+    int64 inner = 1;
+    for (int i = 0; i < shape.dims(); ++i) {
+      if (i < axis) outer *= shape.dim_size(i);
+      if (i > axis) inner *= shape.dim_size(i);
+    }
+    const int64 reduced = shape.dim_size(axis);
+    std::vector<float> values = RandomFloats(shape.num_elements());
+    for (float& value : values) value = 2 * value - 1;
+
+    for (const string op : {"Sum", "Mean", "Max", "Min"}) {
+      SCOPED_TRACE(op);
+      TF_ASSERT_OK(NodeDefBuilder("reduce", op)
+                       .Input(FakeInput(DT_FLOAT))
+                       .Input(FakeInput(DT_INT32))
+                       .Attr("keep_dims", false)
+                       .Finalize(node_def()));
+      TF_ASSERT_OK(InitOp());
+      inputs_.clear();
+      AddInputFromArray<float>(shape, values);
+      AddInputFromArray<int32>(TensorShape({}), {axis});
+      TF_ASSERT_OK(RunOpKernel());
+      const Tensor& output = *GetOutput(0);
+      ASSERT_EQ(outer * inner, output.NumElements());
+      const float* out = output.flat<float>().data();
+
+      for (int64 o = 0; o < outer; ++o) {
+        for (int64 i = 0; i < inner; ++i) {
+          const float* in = values.data() + o * reduced * inner + i;
+          const float actual = out[o * inner + i];
+          if (op == "Max" || op == "Min") {
+            float expected = in[0];
+            for (int64 r = 1; r < reduced; ++r) {
+              expected = op == "Max" ? std::max(expected, in[r * inner])
+                                     : std::min(expected, in[r * inner]);
+            }
+            ASSERT_EQ(expected, actual) << "at " << o << ", " << i;
+            continue;
+          }
+          double expected = 0;
+          double magnitude = 0;
+          for (int64 r = 0; r < reduced; ++r) {
+            expected += in[r * inner];
+            magnitude += std::abs(in[r * inner]);
+          }
+          if (op == "Mean") {
+            expected /= reduced;
+            magnitude /= reduced;
+          }
+          // Each element goes through at most 200 float additions in a row
+          // here: the rows of a block, or the elements of a leaf per
+          // accumulator, then the partial results. Each rounds by at most
+          // 2^-24 of the sum of the magnitudes, about 1.2e-5 in total.
+          ASSERT_NEAR(expected, actual, 2e-5 * magnitude)
+              << "at " << o << ", " << i;
+        }
+      }
+    }
+  }
+};
+
+TEST_F(CpuReductionTest, FullReductionIsSplitIntoBlocks) {
+  ASSERT_GT(NumBlocks(1, 1000003), 1);
+  TestReductions(TensorShape({1000003}), 0);
+}
+
+TEST_F(CpuReductionTest, FewRowsAreSplitIntoBlocks) {
+  ASSERT_GT(NumBlocks(3, 100003), 1);
+  TestReductions(TensorShape({3, 100003}), 1);
+}
+
+TEST_F(CpuReductionTest, ManyRowsAreReducedWithTrees) {
+  // Each row is a tree of several leaves and a partial one.
+  ASSERT_EQ(1, NumBlocks(70, 5003));
+  ASSERT_GT(5003, 4 * kLeafSize);
+  TestReductions(TensorShape({70, 5003}), 1);
+}
+
+TEST_F(CpuReductionTest, FewColumnTilesAreSplitIntoBlocks) {
+  // A full tile and a partial one, whose width is not a multiple of the
+  // packet size.
+  ASSERT_GT(NumBlocks(2, 5003 * 300), 1);
+  ASSERT_LT(300, 2 * kColumnTile);
+  TestReductions(TensorShape({5003, 300}), 0);
+}
+
+TEST_F(CpuReductionTest, ManyColumnTilesAreNotSplit) {
+  const int64 inner = 70 * kColumnTile + 13;
+  ASSERT_EQ(1, NumBlocks((inner + kColumnTile - 1) / kColumnTile, 50 * inner));
+  TestReductions(TensorShape({50, inner}), 0);
+}
+
+TEST_F(CpuReductionTest, MiddleDimensionIsSplitIntoBlocks) {
+  ASSERT_GT(NumBlocks(4, 20011 * 16), 1);
+  TestReductions(TensorShape({4, 20011, 16}), 1);
+}
+
+TEST_F(CpuReductionTest, MiddleDimensionOfManyRows) {
+  ASSERT_EQ(1, NumBlocks(70, 200 * 33));
+  TestReductions(TensorShape({70, 200, 33}), 1);
+}
+
+}  // namespace
 
 // Creates a Graph which "reduce"s a 3D float tensor of "num" elements
 // into a scalar.
@@ -184,4 +374,41 @@ static void BM_Bool2DToScalarGPU(int iters, int num_x, int num_y) {
 }
 BENCHMARK(BM_Bool2DToScalarGPU)->RangePair(2048, 8192, 2048, 8192);
 
+static void BM_Sum2DToScalarCPU(int iters, int num_x, int num_y) {
+  ReduceToScalar<float>(iters, "cpu", "Sum", num_x, num_y);
+}
+BENCHMARK(BM_Sum2DToScalarCPU)->RangePair(1, 8192, 1, 8192);
+
+static void BM_Sum2DRowReduceCPU(int iters, int num_x, int num_y) {
+  DoRowReduce(iters, "cpu", "Sum", num_x, num_y);
+}
+BENCHMARK(BM_Sum2DRowReduceCPU)->RangePair(1, 8192, 1, 8192);
+
+static void BM_Sum2DColumnReduceCPU(int iters, int num_x, int num_y) {
+  DoColReduce(iters, "cpu", "Sum", num_x, num_y);
+}
+BENCHMARK(BM_Sum2DColumnReduceCPU)
+    ->RangePair(1, 8192, 1, 8192)
+    ->ArgPair(1 << 20, 64);
+
+static void BM_Sum3DYReduceCPU(int iters, int num_x, int num_y) {
+  Do3DYReduce(iters, "cpu", "Sum", num_x, num_y);
+}
+BENCHMARK(BM_Sum3DYReduceCPU)->RangePair(64, 4096, 64, 4096);
+
+static void BM_Mean2DColumnReduceCPU(int iters, int num_x, int num_y) {
+  DoColReduce(iters, "cpu", "Mean", num_x, num_y);
+}
+BENCHMARK(BM_Mean2DColumnReduceCPU)->RangePair(2048, 8192, 2048, 8192);
+
+static void BM_Max2DToScalarCPU(int iters, int num_x, int num_y) {
+  ReduceToScalar<float>(iters, "cpu", "Max", num_x, num_y);
+}
+BENCHMARK(BM_Max2DToScalarCPU)->RangePair(2048, 8192, 2048, 8192);
+
+static void BM_Min2DRowReduceCPU(int iters, int num_x, int num_y) {
+  DoRowReduce(iters, "cpu", "Min", num_x, num_y);
+}
+BENCHMARK(BM_Min2DRowReduceCPU)->RangePair(2048, 8192, 2048, 8192);
+
 }  // end namespace tensorflow
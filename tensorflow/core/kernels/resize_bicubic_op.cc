@@ -19,6 +19,7 @@ limitations under the License.
 #include <math.h>
 #include <algorithm>
 #include <array>
+#include <vector>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -26,11 +27,15 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/image_resizer_separable.h"
 #include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
 
 namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
 namespace {
 
 static const int64 kTableSize = (1 << 10);
@@ -100,13 +105,6 @@ inline float Interpolate1D(const float weight_0, const float weight_1,
          static_cast<float>(value_3) * weight_3;
 }
 
-// Compute the 1D interpolation for a given X index using the y_weights
-static float Compute(float values_[4], const float xw_0, const float xw_1,
-                     const float xw_2, const float xw_3) {
-  return Interpolate1D(xw_0, xw_1, xw_2, xw_3, values_[0], values_[1],
-                       values_[2], values_[3]);
-}
-
 // In order to compute a single output value, we look at a 4x4 patch in the
 // source image. As we iterate increasing X across the image, the new 4x4 patch
 // often overlaps with the previous 4x4 patch we just looked at.
@@ -195,204 +193,133 @@ static void ComputeGradientXWeightsAndIndices(
   // gradient pass.
 }
 
+// Computes the leading pixels of a resized row with one packet per pixel and
+// returns how many it computed. Only float rows of three or four channels are
+// computed this way.
 template <typename T>
-static EIGEN_ALWAYS_INLINE float ComputeYInterpolation(
-    int which, int channel_num, const WeightsAndIndices& y_wai,
-    const T* y_ptr_0, const T* y_ptr_1, const T* y_ptr_2, const T* y_ptr_3,
-    const WeightsAndIndices& x_wai) {
-  int x_index;
-  switch (which) {
-    case 0:
-      x_index = x_wai.index_0;
-      break;
-    case 1:
-      x_index = x_wai.index_1;
-      break;
-    case 2:
-      x_index = x_wai.index_2;
-      break;
-    default:
-      x_index = x_wai.index_3;
-      break;
+inline int64 ResizeRowPackets(const T* input, const int64 in_row_width,
+                              const std::vector<WeightsAndIndices>& x_wais,
+                              const int num_channels, float* output) {
+  return 0;
+}
+
+template <>
+inline int64 ResizeRowPackets<float>(
+    const float* input, const int64 in_row_width,
+    const std::vector<WeightsAndIndices>& x_wais, const int num_channels,
+    float* output) {
+  typedef separable_resize::PixelPacket Packet;
+  const int64 num_pixels = separable_resize::NumPixelPackets(
+      x_wais.size(), num_channels, in_row_width,
+      [&x_wais](int64 x) { return x_wais[x].index_3; });
+  for (int64 x = 0; x < num_pixels; ++x) {
+    const WeightsAndIndices& x_wai = x_wais[x];
+    Packet sum = Eigen::internal::pmul(
+        Eigen::internal::ploadu<Packet>(input + x_wai.index_0),
+        Eigen::internal::pset1<Packet>(x_wai.weight_0));
+    sum = Eigen::internal::padd(
+        sum, Eigen::internal::pmul(
+                 Eigen::internal::ploadu<Packet>(input + x_wai.index_1),
+                 Eigen::internal::pset1<Packet>(x_wai.weight_1)));
+    sum = Eigen::internal::padd(
+        sum, Eigen::internal::pmul(
+                 Eigen::internal::ploadu<Packet>(input + x_wai.index_2),
+                 Eigen::internal::pset1<Packet>(x_wai.weight_2)));
+    sum = Eigen::internal::padd(
+        sum, Eigen::internal::pmul(
+                 Eigen::internal::ploadu<Packet>(input + x_wai.index_3),
+                 Eigen::internal::pset1<Packet>(x_wai.weight_3)));
+    Eigen::internal::pstoreu<float>(output + x * num_channels, sum);
+  }
+  return num_pixels;
+}
+
+// Resizes one source row horizontally with the precomputed column taps, whose
+// indices are already scaled by the number of channels.
+template <typename T>
+inline void ResizeRow(const T* input, const int64 in_row_width,
+                      const std::vector<WeightsAndIndices>& x_wais,
+                      const int num_channels, float* output) {
+  const int64 out_width = x_wais.size();
+  const int64 start =
+      ResizeRowPackets<T>(input, in_row_width, x_wais, num_channels, output);
+  output += start * num_channels;
+  if (num_channels == 3) {
+    // Manually unroll case of 3 channels.
+    for (int64 x = start; x < out_width; ++x) {
+      const WeightsAndIndices& x_wai = x_wais[x];
+      for (int c = 0; c < 3; ++c) {
+        output[c] = Interpolate1D<T>(
+            x_wai.weight_0, x_wai.weight_1, x_wai.weight_2, x_wai.weight_3,
+            input[x_wai.index_0 + c], input[x_wai.index_1 + c],
+            input[x_wai.index_2 + c], input[x_wai.index_3 + c]);
+      }
+      output += 3;
+    }
+  } else {
+    for (int64 x = start; x < out_width; ++x) {
+      const WeightsAndIndices& x_wai = x_wais[x];
+      for (int c = 0; c < num_channels; ++c) {
+        output[c] = Interpolate1D<T>(
+            x_wai.weight_0, x_wai.weight_1, x_wai.weight_2, x_wai.weight_3,
+            input[x_wai.index_0 + c], input[x_wai.index_1 + c],
+            input[x_wai.index_2 + c], input[x_wai.index_3 + c]);
+      }
+      output += num_channels;
+    }
   }
-  const int64 pt_index = x_index + channel_num;
-  return Interpolate1D<T>(y_wai.weight_0, y_wai.weight_1, y_wai.weight_2,
-                          y_wai.weight_3, y_ptr_0[pt_index], y_ptr_1[pt_index],
-                          y_ptr_2[pt_index], y_ptr_3[pt_index]);
 }
 
+// Interpolates separably: each source row an output row reads is resized
+// horizontally once, and the output row is the weighted sum of the four
+// resized rows.
 template <typename T>
 inline void interpolate_with_caching(
-    const typename TTypes<T, 4>::ConstTensor& input_data,
+    const CPUDevice& d, const typename TTypes<T, 4>::ConstTensor& input_data,
     const ImageResizerState& resizer_state,
     typename TTypes<float, 4>::Tensor output_data) {
   std::vector<WeightsAndIndices> x_wais(resizer_state.out_width);
   ComputeXWeightsAndIndices(resizer_state, &x_wais);
 
-  const auto num_channels = resizer_state.channels;
-  const int64 in_row_width = resizer_state.in_width * num_channels;
-  const int64 in_batch_width = resizer_state.in_height * in_row_width;
-
-  const T* input_b_ptr = input_data.data();
-  float* output_y_ptr = output_data.data();
-  std::vector<float> cached_value(num_channels == 3 ? 0 : 4 * num_channels, 0);
-
-  for (int64 b = 0; b < resizer_state.batch_size;
-       ++b, input_b_ptr += in_batch_width) {
-    for (int64 y = 0; y < resizer_state.out_height;
-         ++y, output_y_ptr += resizer_state.out_width * num_channels) {
-      WeightsAndIndices y_wai;
-      GetWeightsAndIndices(resizer_state.height_scale, y,
-                           resizer_state.in_height, &y_wai);
-      // Make pointers represent offsets of data in input_b_ptr.
-      const T* y_ptr_0 = input_b_ptr + y_wai.index_0 * in_row_width;
-      const T* y_ptr_1 = input_b_ptr + y_wai.index_1 * in_row_width;
-      const T* y_ptr_2 = input_b_ptr + y_wai.index_2 * in_row_width;
-      const T* y_ptr_3 = input_b_ptr + y_wai.index_3 * in_row_width;
-
-      if (num_channels == 3) {
-        // Manually unroll case of 3 channels.
-        float cached_value_0[4] = {0};
-        float cached_value_1[4] = {0};
-        float cached_value_2[4] = {0};
-        for (int64 x = 0; x < resizer_state.out_width; ++x) {
-          const WeightsAndIndices& x_wai = x_wais[x];
-          // Shift values in cached_value_* to fill first 'advance' values.
-          switch (x_wai.advance) {
-            case 3:
-              cached_value_0[0] = cached_value_0[1];
-              cached_value_0[1] = cached_value_0[2];
-              cached_value_0[2] = cached_value_0[3];
-              cached_value_1[0] = cached_value_1[1];
-              cached_value_1[1] = cached_value_1[2];
-              cached_value_1[2] = cached_value_1[3];
-              cached_value_2[0] = cached_value_2[1];
-              cached_value_2[1] = cached_value_2[2];
-              cached_value_2[2] = cached_value_2[3];
-              break;
-            case 2:
-              cached_value_0[0] = cached_value_0[2];
-              cached_value_0[1] = cached_value_0[3];
-              cached_value_1[0] = cached_value_1[2];
-              cached_value_1[1] = cached_value_1[3];
-              cached_value_2[0] = cached_value_2[2];
-              cached_value_2[1] = cached_value_2[3];
-              break;
-            case 1: {
-              cached_value_0[0] = cached_value_0[3];
-              cached_value_1[0] = cached_value_1[3];
-              cached_value_2[0] = cached_value_2[3];
-              break;
-            }
-          }
-
-          // Set the remaining '4-advance' values by computing.
-          switch (x_wai.advance) {
-            case 0:
-              cached_value_0[0] = ComputeYInterpolation(
-                  0, 0, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_1[0] = ComputeYInterpolation(
-                  0, 1, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_2[0] = ComputeYInterpolation(
-                  0, 2, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              TF_FALLTHROUGH_INTENDED;
-            case 1:
-              cached_value_0[1] = ComputeYInterpolation(
-                  1, 0, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_1[1] = ComputeYInterpolation(
-                  1, 1, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_2[1] = ComputeYInterpolation(
-                  1, 2, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              TF_FALLTHROUGH_INTENDED;
-            case 2:
-              cached_value_0[2] = ComputeYInterpolation(
-                  2, 0, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_1[2] = ComputeYInterpolation(
-                  2, 1, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_2[2] = ComputeYInterpolation(
-                  2, 2, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              TF_FALLTHROUGH_INTENDED;
-            case 3:
-              cached_value_0[3] = ComputeYInterpolation(
-                  3, 0, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_1[3] = ComputeYInterpolation(
-                  3, 1, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              cached_value_2[3] = ComputeYInterpolation(
-                  3, 2, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              break;
-          }
-          output_y_ptr[x * num_channels + 0] =
-              Compute(cached_value_0, x_wai.weight_0, x_wai.weight_1,
-                      x_wai.weight_2, x_wai.weight_3);
-          output_y_ptr[x * num_channels + 1] =
-              Compute(cached_value_1, x_wai.weight_0, x_wai.weight_1,
-                      x_wai.weight_2, x_wai.weight_3);
-          output_y_ptr[x * num_channels + 2] =
-              Compute(cached_value_2, x_wai.weight_0, x_wai.weight_1,
-                      x_wai.weight_2, x_wai.weight_3);
-        }
-      } else {
-        for (int64 x = 0; x < resizer_state.out_width; ++x) {
-          const WeightsAndIndices& x_wai = x_wais[x];
-          // Shift values in cached_value to fill first 'advance' values.
-          switch (x_wai.advance) {
-            case 3:
-              for (int64 c = 0; c < num_channels; ++c) {
-                cached_value[4 * c + 0] = cached_value[4 * c + 1];
-                cached_value[4 * c + 1] = cached_value[4 * c + 2];
-                cached_value[4 * c + 2] = cached_value[4 * c + 3];
-              }
-              break;
-            case 2:
-              for (int64 c = 0; c < num_channels; ++c) {
-                cached_value[4 * c + 0] = cached_value[4 * c + 2];
-                cached_value[4 * c + 1] = cached_value[4 * c + 3];
-              }
-              break;
-            case 1: {
-              for (int64 c = 0; c < num_channels; ++c) {
-                cached_value[4 * c + 0] = cached_value[4 * c + 3];
-              }
-              break;
-            }
-          }
-
-          // Set the remaining '4-advance' values by computing.
-          switch (x_wai.advance) {
-            case 0:
-              for (int64 c = 0; c < num_channels; ++c) {
-                cached_value[4 * c + 0] = ComputeYInterpolation(
-                    0, c, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              }
-              TF_FALLTHROUGH_INTENDED;
-            case 1:
-              for (int64 c = 0; c < num_channels; ++c) {
-                cached_value[4 * c + 1] = ComputeYInterpolation(
-                    1, c, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              }
-              TF_FALLTHROUGH_INTENDED;
-            case 2:
-              for (int64 c = 0; c < num_channels; ++c) {
-                cached_value[4 * c + 2] = ComputeYInterpolation(
-                    2, c, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              }
-              TF_FALLTHROUGH_INTENDED;
-            case 3:
-              for (int64 c = 0; c < num_channels; ++c) {
-                cached_value[4 * c + 3] = ComputeYInterpolation(
-                    3, c, y_wai, y_ptr_0, y_ptr_1, y_ptr_2, y_ptr_3, x_wai);
-              }
-              break;
-          }
-          for (int64 c = 0; c < num_channels; ++c) {
-            output_y_ptr[x * num_channels + c] =
-                Compute(&cached_value[4 * c], x_wai.weight_0, x_wai.weight_1,
-                        x_wai.weight_2, x_wai.weight_3);
-          }
-        }
-      }
-    }
+  const int64 out_height = resizer_state.out_height;
+  std::vector<float> y_weights(out_height * 4);
+  std::vector<int64> y_indices(out_height * 4);
+  for (int64 y = 0; y < out_height; ++y) {
+    WeightsAndIndices y_wai;
+    GetWeightsAndIndices(resizer_state.height_scale, y,
+                         resizer_state.in_height, &y_wai);
+    y_weights[y * 4 + 0] = y_wai.weight_0;
+    y_weights[y * 4 + 1] = y_wai.weight_1;
+    y_weights[y * 4 + 2] = y_wai.weight_2;
+    y_weights[y * 4 + 3] = y_wai.weight_3;
+    y_indices[y * 4 + 0] = y_wai.index_0;
+    y_indices[y * 4 + 1] = y_wai.index_1;
+    y_indices[y * 4 + 2] = y_wai.index_2;
+    y_indices[y * 4 + 3] = y_wai.index_3;
   }
+
+  const int num_channels = resizer_state.channels;
+  const int64 in_row_width = resizer_state.in_width * num_channels;
+  const int64 out_row_width = resizer_state.out_width * num_channels;
+  const T* input = input_data.data();
+
+  auto horizontal = [&](int64 row, float* out) {
+    ResizeRow<T>(input + row * in_row_width, in_row_width, x_wais,
+                 num_channels, out);
+  };
+  auto vertical = [&](int64 y, float* const* rows, float* out) {
+    separable_resize::VerticalCubic(rows, &y_weights[y * 4], out_row_width,
+                                    out);
+  };
+  // An output row resizes at most four source rows and sums them.
+  const Eigen::TensorOpCost cost(
+      /*bytes_loaded=*/16 * out_row_width * sizeof(T),
+      /*bytes_stored=*/out_row_width * sizeof(float),
+      /*compute_cycles=*/35 * out_row_width);
+  separable_resize::ResizeRows<4>(d, resizer_state.batch_size,
+                                  resizer_state.in_height, out_height,
+                                  out_row_width, y_indices.data(), cost,
+                                  horizontal, vertical, output_data.data());
 }
 
 template <typename T>
@@ -464,8 +391,6 @@ inline void ResizeBicubicGrad(typename TTypes<float, 4>::ConstTensor input_grad,
 
 }  // namespace
 
-typedef Eigen::ThreadPoolDevice CPUDevice;
-
 template <typename Device, typename T>
 class ResizeBicubicOp : public OpKernel {
  public:
@@ -480,10 +405,14 @@ class ResizeBicubicOp : public OpKernel {
 
     if (!context->status().ok()) return;
 
+    // Return if the output is empty.
+    if (st.output->NumElements() == 0) return;
+
     typename TTypes<T, 4>::ConstTensor input_data(input.tensor<T, 4>());
     TTypes<float, 4>::Tensor output_data = st.output->tensor<float, 4>();
 
-    interpolate_with_caching<T>(input_data, st, output_data);
+    interpolate_with_caching<T>(context->eigen_device<CPUDevice>(), input_data,
+                                st, output_data);
   }
 
  private:
@@ -19,12 +19,14 @@ limitations under the License.
 #include "tensorflow/core/kernels/resize_bilinear_op.h"
 
 #include <memory>
+#include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/image_resizer_separable.h"
 #include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
@@ -87,112 +89,117 @@ inline void compute_interpolation_weights(const int64 out_size,
   }
 }
 
-/**
- * Computes the bilinear interpolation from the appropriate 4 float points
- * and the linear interpolation weights.
- */
-inline float compute_lerp(const float top_left, const float top_right,
-                          const float bottom_left, const float bottom_right,
-                          const float x_lerp, const float y_lerp) {
-  const float top = top_left + (top_right - top_left) * x_lerp;
-  const float bottom = bottom_left + (bottom_right - bottom_left) * x_lerp;
-  return top + (bottom - top) * y_lerp;
+// Computes the leading pixels of a resized row with one packet per pixel and
+// returns how many it computed. Only float rows of three or four channels are
+// computed this way.
+template <typename T>
+inline int64 resize_row_packets(const T* input, const int64 in_row_size,
+                                const int64 out_width, const int channels,
+                                const CachedInterpolation* xs, float* output) {
+  return 0;
+}
+
+template <>
+inline int64 resize_row_packets<float>(const float* input,
+                                       const int64 in_row_size,
+                                       const int64 out_width,
+                                       const int channels,
+                                       const CachedInterpolation* xs,
+                                       float* output) {
+  typedef separable_resize::PixelPacket Packet;
+  const int64 num_pixels = separable_resize::NumPixelPackets(
+      out_width, channels, in_row_size,
+      [xs](int64 x) { return xs[x].upper; });
+  for (int64 x = 0; x < num_pixels; ++x) {
+    const Packet left = Eigen::internal::ploadu<Packet>(input + xs[x].lower);
+    const Packet right = Eigen::internal::ploadu<Packet>(input + xs[x].upper);
+    const Packet xs_lerp = Eigen::internal::pset1<Packet>(xs[x].lerp);
+    const Packet delta = Eigen::internal::psub(right, left);
+    Eigen::internal::pstoreu<float>(
+        output + x * channels,
+        Eigen::internal::padd(left, Eigen::internal::pmul(delta, xs_lerp)));
+  }
+  return num_pixels;
 }
 
+// Resizes one source row horizontally. Output value x * channels + c
+// interpolates between the input values at xs[x].lower + c and
+// xs[x].upper + c; the indices are already scaled by the number of channels.
 template <typename T>
-void resize_image(
-    typename TTypes<T, 4>::ConstTensor images, const int batch_size,
-    const int64 in_height, const int64 in_width, const int64 out_height,
-    const int64 out_width, const int channels,
-    const std::vector<CachedInterpolation>& xs,
-    const std::vector<CachedInterpolation>& ys,
-    typename TTypes<float, 4>::Tensor output) TF_ATTRIBUTE_NOINLINE;
+inline void resize_row(const T* input, const int64 in_row_size,
+                       const int64 out_width, const int channels,
+                       const CachedInterpolation* xs, float* output) {
+  const int64 start = resize_row_packets<T>(input, in_row_size, out_width,
+                                            channels, xs, output);
+  output += start * channels;
+  if (channels == 3) {
+    for (int64 x = start; x < out_width; ++x) {
+      const T* left = input + xs[x].lower;
+      const T* right = input + xs[x].upper;
+      const float xs_lerp = xs[x].lerp;
+      const float left0(left[0]);
+      const float right0(right[0]);
+      const float left1(left[1]);
+      const float right1(right[1]);
+      const float left2(left[2]);
+      const float right2(right[2]);
+      output[0] = left0 + (right0 - left0) * xs_lerp;
+      output[1] = left1 + (right1 - left1) * xs_lerp;
+      output[2] = left2 + (right2 - left2) * xs_lerp;
+      output += 3;
+    }
+  } else {
+    for (int64 x = start; x < out_width; ++x) {
+      const T* left = input + xs[x].lower;
+      const T* right = input + xs[x].upper;
+      const float xs_lerp = xs[x].lerp;
+      for (int c = 0; c < channels; ++c) {
+        const float l(left[c]);
+        const float r(right[c]);
+        output[c] = l + (r - l) * xs_lerp;
+      }
+      output += channels;
+    }
+  }
+}
+
+// Interpolates separably: each source row an output row reads is resized
+// horizontally once, and the output row blends the two resized rows. This
+// computes the same values, in the same order, as interpolating each output
+// pixel from its four neighbors.
 template <typename T>
-void resize_image(typename TTypes<T, 4>::ConstTensor images,
+void resize_image(const CPUDevice& d,
+                  typename TTypes<T, 4>::ConstTensor images,
                   const int batch_size, const int64 in_height,
                   const int64 in_width, const int64 out_height,
                   const int64 out_width, const int channels,
-                  const std::vector<CachedInterpolation>& xs_vec,
+                  const std::vector<CachedInterpolation>& xs,
                   const std::vector<CachedInterpolation>& ys,
                   typename TTypes<float, 4>::Tensor output) {
   const int64 in_row_size = in_width * channels;
-  const int64 in_batch_num_values = in_height * in_row_size;
   const int64 out_row_size = out_width * channels;
+  const T* input = images.data();
 
-  const T* input_b_ptr = images.data();
-  const CachedInterpolation* xs = xs_vec.data();
-
-  if (channels == 3) {
-    float* output_y_ptr = output.data();
-    for (int b = 0; b < batch_size; ++b) {
-      for (int64 y = 0; y < out_height; ++y) {
-        const T* ys_input_lower_ptr = input_b_ptr + ys[y].lower * in_row_size;
-        const T* ys_input_upper_ptr = input_b_ptr + ys[y].upper * in_row_size;
-        const float ys_lerp = ys[y].lerp;
-        for (int64 x = 0; x < out_width; ++x) {
-          const int64 xs_lower = xs[x].lower;
-          const int64 xs_upper = xs[x].upper;
-          const float xs_lerp = xs[x].lerp;
-
-          // Read channel 0.
-          const float top_left0(ys_input_lower_ptr[xs_lower + 0]);
-          const float top_right0(ys_input_lower_ptr[xs_upper + 0]);
-          const float bottom_left0(ys_input_upper_ptr[xs_lower + 0]);
-          const float bottom_right0(ys_input_upper_ptr[xs_upper + 0]);
-
-          // Read channel 1.
-          const float top_left1(ys_input_lower_ptr[xs_lower + 1]);
-          const float top_right1(ys_input_lower_ptr[xs_upper + 1]);
-          const float bottom_left1(ys_input_upper_ptr[xs_lower + 1]);
-          const float bottom_right1(ys_input_upper_ptr[xs_upper + 1]);
-
-          // Read channel 2.
-          const float top_left2(ys_input_lower_ptr[xs_lower + 2]);
-          const float top_right2(ys_input_lower_ptr[xs_upper + 2]);
-          const float bottom_left2(ys_input_upper_ptr[xs_lower + 2]);
-          const float bottom_right2(ys_input_upper_ptr[xs_upper + 2]);
-
-          // Compute output.
-          output_y_ptr[x * channels + 0] =
-              compute_lerp(top_left0, top_right0, bottom_left0, bottom_right0,
-                           xs_lerp, ys_lerp);
-          output_y_ptr[x * channels + 1] =
-              compute_lerp(top_left1, top_right1, bottom_left1, bottom_right1,
-                           xs_lerp, ys_lerp);
-          output_y_ptr[x * channels + 2] =
-              compute_lerp(top_left2, top_right2, bottom_left2, bottom_right2,
-                           xs_lerp, ys_lerp);
-        }
-        output_y_ptr += out_row_size;
-      }
-      input_b_ptr += in_batch_num_values;
-    }
-  } else {
-    float* output_y_ptr = output.data();
-    for (int b = 0; b < batch_size; ++b) {
-      for (int64 y = 0; y < out_height; ++y) {
-        const T* ys_input_lower_ptr = input_b_ptr + ys[y].lower * in_row_size;
-        const T* ys_input_upper_ptr = input_b_ptr + ys[y].upper * in_row_size;
-        const float ys_lerp = ys[y].lerp;
-        for (int64 x = 0; x < out_width; ++x) {
-          auto xs_lower = xs[x].lower;
-          auto xs_upper = xs[x].upper;
-          auto xs_lerp = xs[x].lerp;
-          for (int c = 0; c < channels; ++c) {
-            const float top_left(ys_input_lower_ptr[xs_lower + c]);
-            const float top_right(ys_input_lower_ptr[xs_upper + c]);
-            const float bottom_left(ys_input_upper_ptr[xs_lower + c]);
-            const float bottom_right(ys_input_upper_ptr[xs_upper + c]);
-            output_y_ptr[x * channels + c] =
-                compute_lerp(top_left, top_right, bottom_left, bottom_right,
-                             xs_lerp, ys_lerp);
-          }
-        }
-        output_y_ptr += out_row_size;
-      }
-      input_b_ptr += in_batch_num_values;
-    }
+  std::vector<int64> row_taps(out_height * 2);
+  for (int64 y = 0; y < out_height; ++y) {
+    row_taps[y * 2] = ys[y].lower;
+    row_taps[y * 2 + 1] = ys[y].upper;
   }
+  auto horizontal = [&](int64 row, float* out) {
+    resize_row<T>(input + row * in_row_size, in_row_size, out_width, channels,
+                  xs.data(), out);
+  };
+  auto vertical = [&](int64 y, float* const* rows, float* out) {
+    separable_resize::VerticalLerp(rows[0], rows[1], ys[y].lerp, out_row_size,
+                                   out);
+  };
+  // An output row resizes at most two source rows and blends them.
+  const Eigen::TensorOpCost cost(/*bytes_loaded=*/4 * out_row_size * sizeof(T),
+                                 /*bytes_stored=*/out_row_size * sizeof(float),
+                                 /*compute_cycles=*/9 * out_row_size);
+  separable_resize::ResizeRows<2>(d, batch_size, in_height, out_height,
+                                  out_row_size, row_taps.data(), cost,
+                                  horizontal, vertical, output.data());
 }
 
 }  // namespace
@@ -214,7 +221,7 @@ struct ResizeBilinear<CPUDevice, T> {
 
     // Handle no-op resizes efficiently.
     if (out_height == in_height && out_width == in_width) {
-      output = images.template cast<float>();
+      output.device(d) = images.template cast<float>();
       return;
     }
 
@@ -232,7 +239,7 @@ struct ResizeBilinear<CPUDevice, T> {
       xs[i].upper *= channels;
     }
 
-    resize_image<T>(images, batch_size, in_height, in_width, out_height,
+    resize_image<T>(d, images, batch_size, in_height, in_width, out_height,
                     out_width, channels, xs, ys, output);
   }
 };
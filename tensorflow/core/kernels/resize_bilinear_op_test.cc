@@ -453,6 +453,42 @@ TEST_F(ResizeBilinearOpTest, Test5_3c) { TestResize(1, 298, 297, 3, 299, 299); }
 TEST_F(ResizeBilinearOpTest, Test6_1c) { TestResize(1, 304, 303, 1, 299, 299); }
 TEST_F(ResizeBilinearOpTest, Test6_3c) { TestResize(1, 304, 303, 3, 299, 299); }
 
+class ResizeBilinearOpUint8Test : public ResizeBilinearOpTest {
+ protected:
+  ResizeBilinearOpUint8Test() {
+    TF_EXPECT_OK(NodeDefBuilder("resize_bilinear_op", "ResizeBilinear")
+                     .Input(FakeInput(DT_UINT8))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("align_corners", false)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+// uint8 images are interpolated without a cast to float first, and must match
+// the resized float image with the same values.
+TEST_F(ResizeBilinearOpUint8Test, TestMatchesFloat) {
+  for (int channels : {1, 3, 4}) {
+    const TensorShape shape({2, 37, 53, channels});
+    std::vector<uint8> values(shape.num_elements());
+    std::vector<float> float_values(shape.num_elements());
+    for (int64 i = 0; i < values.size(); ++i) {
+      values[i] = (i * 37 + 11) % 256;
+      float_values[i] = values[i];
+    }
+    const Tensor float_input = test::AsTensor<float>(float_values, shape);
+    inputs_.clear();
+    AddInputFromArray<uint8>(shape, values);
+    AddInputFromArray<int32>(TensorShape({2}), {71, 29});
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(DT_FLOAT, TensorShape({2, 71, 29, channels}));
+    ResizeBilinearBaseline(float_input.tensor<float, 4>(),
+                           expected.tensor<float, 4>());
+    test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+  }
+}
+
 TEST_F(ResizeBilinearOpTest, TestInvalidOutputSize) {
   AddInputFromArray<float>(TensorShape({1, 2, 2, 1}), {1, 2, 3, 4});
   AddInputFromArray<int32>(TensorShape({2}), {0, 0});
@@ -54,4 +54,49 @@ BM_ResizeDev(gpu, ResizeNearestNeighbor, 10, 499, 499);
 BM_ResizeDev(cpu, ResizeBilinear, 10, 499, 499);
 BM_ResizeDev(gpu, ResizeBilinear, 10, 499, 499);
 
+// Resizes a batch of 3-channel images of type T to out_height x out_width, as
+// done when preprocessing images for a model.
+template <typename T>
+static Graph* BM_ResizeImage(const char* algorithm, int batches, int height,
+                             int width, int out_height, int out_width) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in(DataTypeToEnum<T>::value,
+            TensorShape({batches, height, width, 3}));
+  in.flat<T>().setRandom();
+
+  Tensor out_size(DT_INT32, TensorShape({2}));
+  auto out_size_flat = out_size.flat<int32>();
+  out_size_flat(0) = out_height;
+  out_size_flat(1) = out_width;
+
+  Node* ret;
+  Status s = NodeBuilder(g->NewName("n"), algorithm)
+                 .Input(test::graph::Constant(g, in))
+                 .Input(test::graph::Constant(g, out_size))
+                 .Finalize(g, &ret);
+  assert(s.ok());
+  return g;
+}
+
+#define BM_ResizeImageDev(ALGORITHM, T, B, H, W, OH, OW)                      \
+  static void BM_Resize_##ALGORITHM##_##T##_##B##_##H##x##W##_##OH##x##OW(    \
+      int iters) {                                                            \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B * OH * OW * 3);     \
+    test::Benchmark("cpu", BM_ResizeImage<T>(#ALGORITHM, B, H, W, OH, OW))    \
+        .Run(iters);                                                          \
+  }                                                                           \
+  BENCHMARK(BM_Resize_##ALGORITHM##_##T##_##B##_##H##x##W##_##OH##x##OW)
+
+#define BM_ResizeImageSizes(ALGORITHM, T)                                     \
+  BM_ResizeImageDev(ALGORITHM, T, 32, 375, 500, 224, 224);                    \
+  BM_ResizeImageDev(ALGORITHM, T, 32, 768, 1024, 224, 224);                   \
+  BM_ResizeImageDev(ALGORITHM, T, 32, 224, 224, 299, 299);                    \
+  BM_ResizeImageDev(ALGORITHM, T, 32, 64, 64, 256, 256)
+
+BM_ResizeImageSizes(ResizeBilinear, uint8);
+BM_ResizeImageSizes(ResizeBilinear, float);
+BM_ResizeImageSizes(ResizeBicubic, uint8);
+BM_ResizeImageSizes(ResizeBicubic, float);
+
 }  // namespace tensorflow
+
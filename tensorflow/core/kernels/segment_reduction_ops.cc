@@ -23,6 +23,7 @@ limitations under the License.
 #include "third_party/eigen3/Eigen/Core"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/kernels/segment_reduction_ops.h"
+#include <algorithm>
 #include <vector>
 #include "tensorflow/core/framework/numeric_op.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -33,7 +34,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #if GOOGLE_CUDA
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
@@ -362,6 +365,13 @@ TF_CALL_GPU_NUMBER_TYPES(REGISTER_GPU_SORTED_KERNELS_ALL);
 namespace functor {
 
 // The ReductionFunctor implementation for CPU.
+//
+// Small inputs are reduced with a single pass over the rows. Larger inputs are
+// first bucketed by segment id with a counting sort, then the output segments
+// are sharded across the worker threads and each segment is reduced from its
+// own rows. Every output row is written by exactly one thread and combines its
+// input rows in their original order, so the result is bitwise identical to
+// the serial pass and does not depend on the number of threads.
 template <typename T, typename Index, typename InitialValueF,
           typename ReductionF>
 struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
@@ -370,15 +380,39 @@ struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
                   typename TTypes<Index>::ConstFlat segment_ids,
                   const Index data_size, const T* data,
                   typename TTypes<T, 2>::Tensor output) {
-    output.setConstant(InitialValueF()());
     if (data_size == 0) {
+      output.setConstant(InitialValueF()());
       return;
     }
     const int64 N = segment_ids.dimension(0);
+    const int64 inner_dim = data_size / N;
     ReductionF reduction;
-    auto data_flat = typename TTypes<T, 2>::ConstTensor(data, N, data_size / N);
+    auto data_flat = typename TTypes<T, 2>::ConstTensor(data, N, inner_dim);
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    if (worker_threads->num_threads <= 1 ||
+        data_size < kMinParallelDataSize) {
+      output.setConstant(InitialValueF()());
+      for (int64 i = 0; i < N; ++i) {
+        Index j = internal::SubtleMustCopy(segment_ids(i));
+        if (j < 0) {
+          continue;
+        }
+        OP_REQUIRES(ctx, FastBoundsCheck(j, num_segments),
+                    errors::InvalidArgument(
+                        "segment_ids", SliceDebugString(segment_ids_shape, i),
+                        " = ", j, " is out of range [0, ", num_segments, ")"));
+        reduction(data_flat.template chip<0>(i), output.template chip<0>(j));
+      }
+      return;
+    }
+
+    // Rows of segment j are rows[segment_begin[j]], ...,
+    // rows[segment_begin[j + 1] - 1], in increasing order.
+    std::vector<Index> row_segment(N);
+    std::vector<int64> segment_begin(num_segments + 1, 0);
     for (int64 i = 0; i < N; ++i) {
       Index j = internal::SubtleMustCopy(segment_ids(i));
+      row_segment[i] = j;
       if (j < 0) {
         continue;
       }
@@ -386,9 +420,39 @@ struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
                   errors::InvalidArgument(
                       "segment_ids", SliceDebugString(segment_ids_shape, i),
                       " = ", j, " is out of range [0, ", num_segments, ")"));
-      reduction(data_flat.template chip<0>(i), output.template chip<0>(j));
+      ++segment_begin[j + 1];
+    }
+    for (int64 j = 0; j < num_segments; ++j) {
+      segment_begin[j + 1] += segment_begin[j];
     }
+    std::vector<int64> rows(segment_begin[num_segments]);
+    {
+      std::vector<int64> next(segment_begin.begin(), segment_begin.end() - 1);
+      for (int64 i = 0; i < N; ++i) {
+        if (row_segment[i] >= 0) rows[next[row_segment[i]]++] = i;
+      }
+    }
+
+    auto reduce_segments = [&](int64 begin, int64 end) {
+      const T initial_value = InitialValueF()();
+      for (int64 j = begin; j < end; ++j) {
+        auto out = output.template chip<0>(j);
+        out.setConstant(initial_value);
+        for (int64 k = segment_begin[j]; k < segment_begin[j + 1]; ++k) {
+          reduction(data_flat.template chip<0>(rows[k]), out);
+        }
+      }
+    };
+    const int64 rows_per_segment = 1 + N / std::max<int64>(num_segments, 1);
+    const int64 cost_per_segment = rows_per_segment * inner_dim;
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          cost_per_segment, reduce_segments);
   }
+
+ private:
+  // Below this many input elements the counting sort costs more than the
+  // parallel reduction saves.
+  static constexpr int64 kMinParallelDataSize = 32768;
 };
 
 template <typename T>
@@ -689,12 +753,14 @@ class SparseSegmentReductionOpBase : public OpKernel {
                 errors::InvalidArgument("segment ids must be >= 0"));
     auto output_flat = output->flat_outer_dims<T>();
 
-    int64 start = 0, end = 1;
-    // Index from which the output is not initialized.
-    OutputRow uninitialized_index = 0;
-    OutputRow out_index = internal::SubtleMustCopy(segment_vec(start));
-
-    while (true) {
+    // Find the segment boundaries. Segment k covers the indices
+    // [segment_start[k], segment_start[k + 1]) and is reduced into output row
+    // segment_row[k].
+    std::vector<int64> segment_start;
+    std::vector<OutputRow> segment_row;
+    OutputRow out_index = internal::SubtleMustCopy(segment_vec(0));
+    segment_start.push_back(0);
+    for (int64 end = 1; end <= num_indices; ++end) {
       // We initialize next_index to 0 to avoid "warning: 'next_index' may be
       // used uninitialized in this function" in the Mac build (since the
       // compiler isn't smart enough to realize the code is safe).
@@ -702,7 +768,6 @@ class SparseSegmentReductionOpBase : public OpKernel {
       if (end < num_indices) {
         next_index = internal::SubtleMustCopy(segment_vec(end));
         if (out_index == next_index) {
-          ++end;
           continue;
         }
         // We have a new segment here.  Verify that the segment ids are growing.
@@ -715,46 +780,62 @@ class SparseSegmentReductionOpBase : public OpKernel {
           errors::InvalidArgument(
               "Segment id ", out_index, " out of range [0, ", output_rows,
               "), possibly because 'segment_ids' input is not sorted."));
-
-      // If there is a gap between two indices, we need to set that gap to the
-      // default value.
-      if (out_index > uninitialized_index) {
-        Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-            out_index - uninitialized_index, num_col);
-        Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-            gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-        gap_slice.setConstant(default_value_);
-      }
-
-      auto out = output_flat.template chip<0>(out_index);
-      const int bad_offset =
-          Reduce(input_flat, indices_vec, start, end - start, out);
-      OP_REQUIRES(context, bad_offset < 0,
-                  errors::InvalidArgument(
-                      "Bad: indices[", start + bad_offset,
-                      "] == ", indices_vec(start + bad_offset),
-                      " out of range [0, ", input_flat.dimension(0), ")"));
-
-      start = end;
-      ++end;
-      uninitialized_index = out_index + 1;
+      segment_start.push_back(end);
+      segment_row.push_back(out_index);
       out_index = next_index;
-      if (end > num_indices) break;
     }
+    const int64 num_segments = segment_row.size();
+
+    // Segments write disjoint output rows, so they are sharded across the
+    // worker threads. Each segment is reduced by one thread exactly as in a
+    // serial pass, which keeps the result independent of the sharding. A shard
+    // also fills the gap of unused output rows that precedes each of its
+    // segments.
+    mutex mu;
+    int64 first_bad_index = num_indices;
+    auto reduce_segments = [&](int64 begin, int64 end) {
+      for (int64 k = begin; k < end; ++k) {
+        const int64 start = segment_start[k];
+        const int64 num = segment_start[k + 1] - start;
+        const OutputRow gap_begin = k == 0 ? 0 : segment_row[k - 1] + 1;
+        SetToDefault(&output_flat, gap_begin, segment_row[k]);
+        auto out = output_flat.template chip<0>(segment_row[k]);
+        const int64 bad_offset =
+            Reduce(input_flat, indices_vec, start, num, out);
+        if (bad_offset >= 0) {
+          mutex_lock l(mu);
+          first_bad_index = std::min(first_bad_index, start + bad_offset);
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const int64 cost_per_segment = (1 + num_indices / num_segments) * num_col;
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          cost_per_segment, reduce_segments);
+    OP_REQUIRES(context, first_bad_index == num_indices,
+                errors::InvalidArgument(
+                    "Bad: indices[", first_bad_index,
+                    "] == ", indices_vec(first_bad_index),
+                    " out of range [0, ", input_flat.dimension(0), ")"));
 
     // Fill the gap at the end with the default value.
-    if (uninitialized_index < output_rows) {
-      Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-          output_rows - uninitialized_index, num_col);
-      Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-          gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-      gap_slice.setConstant(default_value_);
-    }
+    SetToDefault(&output_flat, segment_row.back() + 1, output_rows);
   }
 
  private:
   typedef int32 Index;
 
+  // Sets output rows [begin, end) to the default value.
+  void SetToDefault(typename TTypes<T>::Matrix* output_flat, int64 begin,
+                    int64 end) const {
+    if (begin >= end) return;
+    Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
+        end - begin, output_flat->dimension(1));
+    Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
+        gap_slice(&(*output_flat)(begin, 0), gap_slice_shape);
+    gap_slice.setConstant(default_value_);
+  }
+
   int64 Reduce(const typename TTypes<T>::ConstMatrix& input_flat,
                const typename TTypes<Index>::ConstVec& indices_vec, int64 start,
                int64 num,
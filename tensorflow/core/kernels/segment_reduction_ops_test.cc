@@ -113,6 +113,100 @@ BM_Reduce_Arg(64, 32, 2);
 BM_Reduce_Arg(4096, 32, 2);
 BM_Reduce_Arg(4096, 128, 2);
 
+// Reduces a num_rows x num_cols matrix into num_rows / segment_size segments
+// whose ids are scattered over the rows.
+static void BM_UnsortedSegmentReduction(int iters, const string& reduction,
+                                        int num_rows, int num_cols,
+                                        int segment_size) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  const int num_segments = num_rows / segment_size;
+  Tensor input(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  input.flat<float>().setRandom();
+  Tensor segment_ids(DT_INT32, TensorShape({num_rows}));
+  test::FillFn<int32>(&segment_ids, [num_segments](int i) -> int32 {
+    return (i * 7919) % num_segments;
+  });
+  Tensor num_segments_t(DT_INT32, TensorShape({}));
+  num_segments_t.scalar<int32>()() = num_segments;
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), reduction)
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, segment_ids))
+                  .Input(test::graph::Constant(g, num_segments_t))
+                  .Finalize(g, &node));
+
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_rows * num_cols *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_UnsortedReduce(O, R, C, S)                \
+  static void BM_##O##_##R##_##C##_##S(int iters) {  \
+    BM_UnsortedSegmentReduction(iters, #O, R, C, S); \
+  }                                                  \
+  BENCHMARK(BM_##O##_##R##_##C##_##S);
+
+#define BM_UnsortedReduce_Arg(R, C, S)            \
+  BM_UnsortedReduce(UnsortedSegmentSum, R, C, S); \
+  BM_UnsortedReduce(UnsortedSegmentMax, R, C, S);
+
+BM_UnsortedReduce_Arg(4096, 32, 4);
+BM_UnsortedReduce_Arg(4096, 128, 4);
+BM_UnsortedReduce_Arg(65536, 128, 16);
+BM_UnsortedReduce_Arg(16384, 1024, 64);
+
+// Gathers num_indices random rows of a num_rows x num_cols matrix and reduces
+// them into sorted segments of segment_size consecutive indices.
+static void BM_SparseSegmentReduction(int iters, const string& reduction,
+                                      int num_indices, int num_cols,
+                                      int segment_size) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+  const int num_rows = 10000;
+  Tensor input(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  input.flat<float>().setRandom();
+  Tensor indices(DT_INT32, TensorShape({num_indices}));
+  test::FillFn<int32>(&indices, [num_rows](int i) -> int32 {
+    return (i * 7919) % num_rows;
+  });
+  Tensor segment_ids(DT_INT32, TensorShape({num_indices}));
+  test::FillFn<int32>(&segment_ids, [segment_size](int i) -> int32 {
+    return i / segment_size;
+  });
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), reduction)
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, indices))
+                  .Input(test::graph::Constant(g, segment_ids))
+                  .Finalize(g, &node));
+
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_indices * num_cols *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+#define BM_SparseReduce(O, N, C, S)                 \
+  static void BM_##O##_##N##_##C##_##S(int iters) { \
+    BM_SparseSegmentReduction(iters, #O, N, C, S);  \
+  }                                                 \
+  BENCHMARK(BM_##O##_##N##_##C##_##S);
+
+#define BM_SparseReduce_Arg(N, C, S)          \
+  BM_SparseReduce(SparseSegmentSum, N, C, S); \
+  BM_SparseReduce(SparseSegmentMean, N, C, S);
+
+BM_SparseReduce_Arg(4096, 32, 1);
+BM_SparseReduce_Arg(4096, 128, 8);
+BM_SparseReduce_Arg(65536, 128, 8);
+BM_SparseReduce_Arg(65536, 128, 1024);
+
 static void SparseSegmentMeanGradHelper(int iters, float uniqueness, int size) {
   testing::StopTiming();
   Graph* g = new Graph(OpRegistry::Global());
@@ -167,79 +167,55 @@ void SparseSlice<T>::Initialize(
   DCHECK_LE(num_cols + col_offset, mat_cols);
 
   int num_blocks = (num_cols + block_size - 1) / block_size;
-  int mat_size = num_rows * num_cols;
 
   index3_offset.reserve(num_blocks);
-  data3.reserve(mat_size);
-  index3.reserve(mat_size / 3);
-
   index_offset.reserve(num_blocks);
   data.reserve(num_blocks * num_rows * 2);
   index.reserve(num_blocks * num_rows * 2);
+  // data3 and index3 are not reserved for the whole slice: that would make
+  // every slice a large allocation whose pages are faulted in one by one,
+  // although most of it stays unused for sparse inputs.
 
   Index3 idx3;
   Index idx;
-  int data3_size = 0;
   static const T zero(0);
+  // Column offsets of the nonzero elements of one row of a block.
+  uint8 nonzero_cols[256];
   for (int i = 0; i < num_blocks; ++i) {
     int num_block_cols = std::min(block_size, num_cols - block_size * i);
     for (int row = 0; row < num_rows; ++row) {
       idx3.m = static_cast<uint8>(row);
       // Safety note: The following code has a race, since it checks whether
-      // *curr is nonzero and then reads it again on use.  However, the result
-      // of the race is only that some of the "nonzeros" in the resulting sparse
-      // representation may actually be zero, which is harmless.
+      // an element is nonzero and then reads it again on use.  However, the
+      // result of the race is only that some of the "nonzeros" in the resulting
+      // sparse representation may actually be zero, which is harmless.
       const auto* start =
           Transpose ? &mat(col_offset, row) : &mat(row, col_offset);
-      const auto* curr = start;
       const int stride = Transpose ? mat.dimension(1) : 1;
-      const auto* end = start + stride * num_block_cols;
-      uint8 k = 0;
-#define NEXT_ELEM \
-  curr += stride; \
-  ++k;
-      while (true) {
-        while (curr < end && (*curr == zero)) {
-          NEXT_ELEM;
-        }
-        if (curr >= end) break;
-        idx3.k1 = k;
-        data3.push_back(*curr);
-        NEXT_ELEM;
-
-        while (curr < end && (*curr == zero)) {
-          NEXT_ELEM;
-        }
-        if (curr >= end) break;
-        idx3.k2 = k;
-        data3.push_back(*curr);
-        NEXT_ELEM;
-
-        while (curr < end && (*curr == zero)) {
-          NEXT_ELEM;
-        }
-        if (curr >= end) break;
-        idx3.k3 = k;
-        data3.push_back(*curr);
-        NEXT_ELEM;
+      // Compacts the column offsets of the nonzeros without branching on the
+      // values, since for the sparsities this op is used for, the branches in
+      // an element by element scan are mispredicted most of the time.
+      int num_nonzeros = 0;
+      for (int k = 0; k < num_block_cols; ++k) {
+        nonzero_cols[num_nonzeros] = static_cast<uint8>(k);
+        num_nonzeros += (start[k * stride] != zero);
+      }
+      int j = 0;
+      for (; j + 3 <= num_nonzeros; j += 3) {
+        idx3.k1 = nonzero_cols[j];
+        idx3.k2 = nonzero_cols[j + 1];
+        idx3.k3 = nonzero_cols[j + 2];
+        data3.push_back(start[idx3.k1 * stride]);
+        data3.push_back(start[idx3.k2 * stride]);
+        data3.push_back(start[idx3.k3 * stride]);
         index3.push_back(idx3);
-#undef NEXT_ELEM
       }
-      int num_inserted_mod = data3.size() % 3;
-      // Move some elements to index and data if needed.
-      data3_size = data3.size() - num_inserted_mod;
+      // Move the remaining elements to index and data.
       idx.m = idx3.m;
-      switch (num_inserted_mod) {
-        case 2:
-          idx.k = idx3.k2;
-          data.push_back(data3[data3_size + 1]);
-          index.push_back(idx);
-          TF_FALLTHROUGH_INTENDED;
-        case 1:
-          idx.k = idx3.k1;
-          data.push_back(data3[data3_size]);
-          index.push_back(idx);
-          data3.resize(data3_size);
+      for (int r = num_nonzeros - 1; r >= j; --r) {
+        idx.k = nonzero_cols[r];
+        data.push_back(start[idx.k * stride]);
+        index.push_back(idx);
       }
     }
     col_offset += block_size;
@@ -583,11 +559,10 @@ ALWAYS_INLINE void MulAdd3Way128(const Packet a1, const Packet a2,
                                  const Packet a3, const float** inp1,
                                  const float** inp2, const float** inp3,
                                  float** out) {
-  if (kNumOperands == 8) {
-    FourMulAdd3Way(a1, a2, a3, inp1, inp2, inp3, out);
-    FourMulAdd3Way(a1, a2, a3, inp1, inp2, inp3, out);
-    FourMulAdd3Way(a1, a2, a3, inp1, inp2, inp3, out);
-    FourMulAdd3Way(a1, a2, a3, inp1, inp2, inp3, out);
+  if (kNumOperands >= 8) {
+    for (int i = 0; i < 128 / (4 * kNumOperands); ++i) {
+      FourMulAdd3Way(a1, a2, a3, inp1, inp2, inp3, out);
+    }
   } else {
     DCHECK_LE(4 * kNumOperands, 128);
     for (int i = 0; i < 128 / (4 * kNumOperands); ++i) {
@@ -1313,8 +1288,12 @@ inline void SparseMatMul<TL, TR>::ComputeBlockSizes(
   // Heuristics for calculating block sizes
   // Assume two hyperthreads per core.
   const int est_num_cores = std::max(1, (num_threads + 1) / 2);
-  // Use block of rhs with at most 128K floats per core.
-  const int mem = est_num_cores * 128 * 1024;
+  // Use block of rhs with at most half of the L2 cache per core, but at least
+  // 512KB per core, which was tuned on CPUs with smaller L2 caches. The budget
+  // is in bytes, so that blocks of bfloat16 have twice as many elements.
+  const int64 mem_per_core =
+      std::max<int64>(512 * 1024, Eigen::l2CacheSize() / 2);
+  const int mem = est_num_cores * mem_per_core / sizeof(TR);
   *KR = std::min(static_cast<int>(right.dimension(0)), mem / 256);
   *NR = right.dimension(1);
   if (*KR * *NR > mem) {
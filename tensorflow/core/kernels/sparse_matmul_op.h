@@ -445,20 +445,42 @@ EIGEN_STRONG_INLINE Packet8f pbroadcast_fourth<Packet8f>(const Packet8f& a) {
 #endif
 
 #ifdef EIGEN_VECTORIZE_AVX512
+// For a Packet of 32 bfloat16 values (512-bits), interleave the lower and the
+// upper 16 values, so that 32-bit word i holds value i in its lower half and
+// value i + 16 in its upper half. pexpand_bf16_l and pexpand_bf16_u then only
+// need a shift and a mask, instead of a cross lane shuffle each.
+template <>
+EIGEN_STRONG_INLINE Packet16f
+pinterleave4x64<Packet16f>(const Packet16f& from) {
+#ifdef __AVX512BW__
+  const __m512i idx = _mm512_set_epi16(
+      31, 15, 30, 14, 29, 13, 28, 12, 27, 11, 26, 10, 25, 9, 24, 8, 23, 7, 22,
+      6, 21, 5, 20, 4, 19, 3, 18, 2, 17, 1, 16, 0);
+  return _mm512_castsi512_ps(
+      _mm512_permutexvar_epi16(idx, _mm512_castps_si512(from)));
+#else
+  const __m512i tmp = _mm512_castps_si512(from);
+  const __m512i low = _mm512_cvtepu16_epi32(_mm512_castsi512_si256(tmp));
+  const __m512i high =
+      _mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(tmp, 1));
+  return _mm512_castsi512_ps(
+      _mm512_or_si512(low, _mm512_slli_epi32(high, 16)));
+#endif
+}
 
+// Return the float representation of the lower 16 bfloat16 values of a Packet
+// interleaved by pinterleave4x64.
 template <typename Packet>
 EIGEN_DEVICE_FUNC inline Packet16f pexpand_bf16_l(const Packet16f& from) {
-  return _mm512_castsi512_ps(_mm512_slli_epi32(
-      _mm512_cvtepu16_epi32(_mm512_castsi512_si256(_mm512_castps_si512(from))),
-      16));
+  return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_castps_si512(from), 16));
 }
 
+// Return the float representation of the upper 16 bfloat16 values of a Packet
+// interleaved by pinterleave4x64.
 template <typename Packet>
 EIGEN_DEVICE_FUNC inline Packet16f pexpand_bf16_u(const Packet16f& from) {
-  Packet16i tmp = _mm512_castps_si512(from);
-  Packet16i tmp2 = _mm512_alignr_epi32(tmp, tmp, 8);
-  return _mm512_castsi512_ps(_mm512_slli_epi32(
-      _mm512_cvtepu16_epi32(_mm512_castsi512_si256(tmp2)), 16));
+  return _mm512_castsi512_ps(_mm512_and_si512(
+      _mm512_castps_si512(from), _mm512_set1_epi32(0xffff0000)));
 }
 
 #endif
@@ -208,6 +208,45 @@ BM_SPARSE_BFLOAT16_FLOAT(2048, 2048, 2048, 99, 0, false, false);
 BM_SPARSE_FLOAT_BFLOAT16(2048, 2048, 2048, 85, 0, false, false);
 BM_SPARSE_FLOAT_BFLOAT16(2048, 2048, 2048, 99, 0, false, false);
 
+// Dense MatMul on the same inputs, as a baseline for the sparse benchmarks.
+static Graph* DenseMatMul(int m, int n, int d, float sparsity) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor left(DT_FLOAT, TensorShape({m, d}));
+  left.flat<float>().setRandom();
+  Sparsify<float>(&left, sparsity);
+  Tensor right(DT_FLOAT, TensorShape({d, n}));
+  right.flat<float>().setRandom();
+  test::graph::Matmul(g, test::graph::Constant(g, left),
+                      test::graph::Constant(g, right), false, false);
+  return g;
+}
+
+#define BM_DENSE(M, K, N, S)                                                   \
+  static void BM_Dense##_##M##_##K##_##N##_##S(int iters) {                    \
+    testing::StopTiming();                                                     \
+    testing::ItemsProcessed(static_cast<int64>(iters) * M * K * N * 2);        \
+    auto label = strings::Printf("sp_a: %0.2f", S / 100.0);                    \
+    testing::SetLabel(label);                                                  \
+    testing::UseRealTime();                                                    \
+    auto g = DenseMatMul(M, N, K, S / 100.0);                                  \
+    testing::StartTiming();                                                    \
+    test::Benchmark("cpu", g).Run(iters);                                      \
+  }                                                                            \
+  BENCHMARK(BM_Dense##_##M##_##K##_##N##_##S);
+
+// Sparse vs. dense at the sparsity levels typical of ReLU activations.
+#define BM_SPARSE_VS_DENSE(M, K, N, S)                                         \
+  BM_DENSE(M, K, N, S);                                                        \
+  BM_SPARSE_FLOAT(M, K, N, S, 0, false, false);                                \
+  BM_SPARSE_BFLOAT16_FLOAT(M, K, N, S, 0, false, false);
+
+BM_SPARSE_VS_DENSE(1024, 2048, 256, 60);
+BM_SPARSE_VS_DENSE(1024, 2048, 256, 75);
+BM_SPARSE_VS_DENSE(1024, 2048, 256, 90);
+BM_SPARSE_VS_DENSE(1024, 2048, 64, 60);
+BM_SPARSE_VS_DENSE(1024, 2048, 64, 75);
+BM_SPARSE_VS_DENSE(1024, 2048, 64, 90);
+
 static Graph* MultiSparseMatMul(int m, int n, int d, float sparsity_1,
                                 float sparsity_2, int copies) {
   Graph* g = new Graph(OpRegistry::Global());
@@ -361,6 +400,19 @@ TEST_F(SparseMatmulOpTest, InterleavePacketTest) {
     for (int i = PacketSize / 2; i < 3 * PacketSize / 4; ++i)
       ref[i] = data1[i - PacketSize / 4];
     for (int i = 3 * PacketSize / 4; i < PacketSize; ++i) ref[i] = data1[i];
+  } else if (PacketSize == 16) {  // AVX512
+    // The 32 bfloat16 values of the Packet are interleaved. The result may not
+    // be a valid float, so compare the bits.
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(data1);
+    uint16_t* out = reinterpret_cast<uint16_t*>(ref);
+    for (int i = 0; i < PacketSize; ++i) {
+      out[2 * i] = in[i];
+      out[2 * i + 1] = in[i + PacketSize];
+    }
+    internal::pstoreu(data2, internal::pinterleave4x64<Packet>(
+                                 internal::ploadu<Packet>(data1)));
+    ASSERT_EQ(0, memcmp(ref, data2, PacketSize * sizeof(float)));
+    return;
   } else {
     // No interleaving done for smaller packets
     for (int i = 0; i < PacketSize; ++i) ref[i] = data1[i];
@@ -372,6 +424,13 @@ TEST_F(SparseMatmulOpTest, InterleavePacketTest) {
 }
 
 TEST_F(SparseMatmulOpTest, Bfloat16ExpandTest) {
+  if (PacketSize == 16) {  // AVX512
+    // pexpand_bf16_l and pexpand_bf16_u expect the input to be interleaved by
+    // pinterleave4x64.
+    internal::pstoreu(data3_bfloat16,
+                      internal::pinterleave4x64<Packet>(
+                          internal::ploadu<Packet>(data3_bfloat16)));
+  }
   if (PacketSize == 8) {  // AVX
     for (int i = 0; i < PacketSize / 2; ++i) {
       ref[i] = data3[i];
@@ -19,16 +19,225 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_tensor_dense_matmul_op.h"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/fill_functor.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 typedef Eigen::GpuDevice GPUDevice;
 
+namespace functor {
+
+namespace {
+Status KOutOfBoundsError(int64 k, std::size_t i, int rhs_index_a,
+                         std::size_t lhs_right) {
+  return errors::InvalidArgument("k (", k, ") from index[", i, ",", rhs_index_a,
+                                 "] out of bounds (>=", lhs_right, ")");
+}
+
+Status MOutOfBoundsError(int64 m, std::size_t i, int lhs_index_a,
+                         int64 out_dim0) {
+  return errors::InvalidArgument("m (", m, ") from index[", i, ",", lhs_index_a,
+                                 "] out of bounds (>=", out_dim0, ")");
+}
+}  // namespace
+
+// The sparsity structure of op(A) in compressed sparse row (CSR) form. The
+// entries of each row keep their order in a_indices, so that the products
+// of a row are summed in the same order as by the COO formulation.
+template <typename Tindices>
+struct SparseTensorDenseMatMulCsr {
+  // Entries of row m are [row_ptr[m], row_ptr[m + 1]).
+  std::vector<int64> row_ptr;
+  // Column of op(A) of each entry.
+  std::vector<Tindices> cols;
+  // Index in a_values of each entry. Empty if a_indices is already ordered
+  // by the rows of op(A), which is the common case without adjoint_a.
+  std::vector<int64> perm;
+
+  // Converts the COO indices of A to the CSR structure of op(A), and checks
+  // that all indices are in bounds.
+  Status Init(typename TTypes<Tindices>::ConstMatrix a_indices,
+              int lhs_index_a, int rhs_index_a, int64 num_rows,
+              std::size_t num_cols) {
+    const std::size_t nnz = a_indices.dimension(0);
+    row_ptr.assign(num_rows + 1, 0);
+    bool row_ordered = true;
+    Tindices prev_m = 0;
+    for (std::size_t i = 0; i < nnz; ++i) {
+      const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+      const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+      if (!FastBoundsCheck(k, num_cols)) {
+        return KOutOfBoundsError(k, i, rhs_index_a, num_cols);
+      }
+      if (!FastBoundsCheck(m, num_rows)) {
+        return MOutOfBoundsError(m, i, lhs_index_a, num_rows);
+      }
+      ++row_ptr[m + 1];
+      row_ordered &= m >= prev_m;
+      prev_m = m;
+    }
+    for (int64 m = 0; m < num_rows; ++m) {
+      row_ptr[m + 1] += row_ptr[m];
+    }
+
+    // The indices are read again below, and must be checked again in case
+    // they were modified concurrently.
+    cols.resize(nnz);
+    perm.clear();
+    if (row_ordered) {
+      for (std::size_t i = 0; i < nnz; ++i) {
+        const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+        if (!FastBoundsCheck(k, num_cols)) {
+          return KOutOfBoundsError(k, i, rhs_index_a, num_cols);
+        }
+        cols[i] = k;
+      }
+      return Status::OK();
+    }
+    perm.resize(nnz);
+    std::vector<int64> next(row_ptr.begin(), row_ptr.end() - 1);
+    for (std::size_t i = 0; i < nnz; ++i) {
+      const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+      const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+      if (!FastBoundsCheck(k, num_cols)) {
+        return KOutOfBoundsError(k, i, rhs_index_a, num_cols);
+      }
+      if (!FastBoundsCheck(m, num_rows) || next[m] == row_ptr[m + 1]) {
+        return MOutOfBoundsError(m, i, lhs_index_a, num_rows);
+      }
+      const int64 p = next[m]++;
+      cols[p] = k;
+      perm[p] = i;
+    }
+    return Status::OK();
+  }
+};
+
+// Reuses the CSR structure of a sparse operand across calls while its
+// indices do not change, e.g. when they come from a constant or from a
+// variable holding a fixed sparsity pattern. The structure is cached once
+// the same indices tensor is seen in two consecutive calls, so that fed
+// operands, which get a new buffer every step, never pay for the copy of
+// the indices used to validate the cache.
+template <typename Tindices>
+class SparseTensorDenseMatMulCsrCache {
+ public:
+  typedef SparseTensorDenseMatMulCsr<Tindices> Csr;
+
+  // Sets '*csr' to the CSR structure of the matrix 'a_indices'. If it is
+  // neither cached nor worth caching yet, it is only built if
+  // 'build_uncached', and '*csr' is set to null otherwise.
+  Status Get(const Tensor& a_indices, int lhs_index_a, int rhs_index_a,
+             int64 num_rows, std::size_t num_cols, bool build_uncached,
+             std::shared_ptr<const Csr>* csr) {
+    const typename TTypes<Tindices>::ConstMatrix a_indices_t =
+        a_indices.matrix<Tindices>();
+    const Tindices* data = a_indices_t.data();
+    const std::size_t size = a_indices_t.size();
+    std::shared_ptr<const Entry> entry;
+    bool cacheable;
+    {
+      mutex_lock l(mu_);
+      entry = entry_;
+      // 'last_indices_' holds a reference to its buffer, so a buffer at the
+      // same address is the same one, and not a new allocation of a later
+      // step. Both may still be different slices of one larger buffer.
+      cacheable = last_indices_.SharesBufferWith(a_indices) &&
+                  last_indices_.shape() == a_indices.shape() &&
+                  last_indices_.tensor_data().data() ==
+                      a_indices.tensor_data().data();
+      last_indices_ = a_indices;
+    }
+    if (entry != nullptr && entry->num_rows == num_rows &&
+        entry->num_cols == num_cols && entry->indices.size() == size &&
+        std::memcmp(entry->indices.data(), data, size * sizeof(Tindices)) ==
+            0) {
+      *csr = std::shared_ptr<const Csr>(entry, &entry->csr);
+      return Status::OK();
+    }
+
+    if (!cacheable) {
+      csr->reset();
+      if (build_uncached) {
+        std::shared_ptr<Csr> new_csr = std::make_shared<Csr>();
+        TF_RETURN_IF_ERROR(new_csr->Init(a_indices_t, lhs_index_a,
+                                         rhs_index_a, num_rows, num_cols));
+        *csr = std::move(new_csr);
+      }
+      return Status::OK();
+    }
+    // Builds from a private copy, so that the cached structure matches the
+    // indices it is validated against.
+    std::shared_ptr<Entry> new_entry = std::make_shared<Entry>();
+    new_entry->indices.assign(data, data + size);
+    new_entry->num_rows = num_rows;
+    new_entry->num_cols = num_cols;
+    TF_RETURN_IF_ERROR(new_entry->csr.Init(
+        typename TTypes<Tindices>::ConstMatrix(new_entry->indices.data(),
+                                               a_indices_t.dimensions()),
+        lhs_index_a, rhs_index_a, num_rows, num_cols));
+    *csr = std::shared_ptr<const Csr>(new_entry, &new_entry->csr);
+    mutex_lock l(mu_);
+    entry_ = std::move(new_entry);
+    return Status::OK();
+  }
+
+ private:
+  struct Entry {
+    // Copy of the indices that 'csr' was built from.
+    std::vector<Tindices> indices;
+    int64 num_rows;
+    std::size_t num_cols;
+    Csr csr;
+  };
+
+  mutex mu_;
+  std::shared_ptr<const Entry> entry_ GUARDED_BY(mu_);
+  // The indices of the previous call. This keeps one extra buffer of fed
+  // indices alive until the next call.
+  Tensor last_indices_ GUARDED_BY(mu_);
+};
+
+}  // namespace functor
+
+namespace {
+
+// The CPU functor multiplies by a CSR form of A, which it can reuse across
+// calls; the GPU one works on the COO indices directly.
+template <typename T, typename Tindices, bool ADJ_A, bool ADJ_B>
+Status LaunchSparseTensorDenseMatMul(
+    const CPUDevice& d, typename TTypes<T>::Matrix out,
+    const Tensor& a_indices, typename TTypes<T>::ConstVec a_values,
+    typename TTypes<T>::ConstMatrix b,
+    functor::SparseTensorDenseMatMulCsrCache<Tindices>* cache) {
+  return functor::SparseTensorDenseMatMulFunctor<
+      CPUDevice, T, Tindices, ADJ_A, ADJ_B>::Compute(d, out, a_indices,
+                                                     a_values, b, cache);
+}
+
+template <typename T, typename Tindices, bool ADJ_A, bool ADJ_B>
+Status LaunchSparseTensorDenseMatMul(
+    const GPUDevice& d, typename TTypes<T>::Matrix out,
+    const Tensor& a_indices, typename TTypes<T>::ConstVec a_values,
+    typename TTypes<T>::ConstMatrix b,
+    functor::SparseTensorDenseMatMulCsrCache<Tindices>* /*cache*/) {
+  return functor::SparseTensorDenseMatMulFunctor<
+      GPUDevice, T, Tindices, ADJ_A, ADJ_B>::Compute(
+      d, out, a_indices.matrix<Tindices>(), a_values, b);
+}
+
+}  // namespace
+
 template <typename Device, typename T, typename Tindices>
 class SparseTensorDenseMatMulOp : public OpKernel {
  public:
@@ -132,14 +341,13 @@ class SparseTensorDenseMatMulOp : public OpKernel {
       return;
     }
 
-#define MAYBE_ADJOINT(ADJ_A, ADJ_B)                                        \
-  if (adjoint_a_ == ADJ_A && adjoint_b_ == ADJ_B) {                        \
-    Status functor_status = functor::SparseTensorDenseMatMulFunctor<       \
-        Device, T, Tindices, ADJ_A,                                        \
-        ADJ_B>::Compute(ctx->eigen_device<Device>(), out->matrix<T>(),     \
-                        a_indices->matrix<Tindices>(), a_values->vec<T>(), \
-                        b->matrix<T>());                                   \
-    OP_REQUIRES_OK(ctx, functor_status);                                   \
+#define MAYBE_ADJOINT(ADJ_A, ADJ_B)                                           \
+  if (adjoint_a_ == ADJ_A && adjoint_b_ == ADJ_B) {                           \
+    Status functor_status =                                                   \
+        LaunchSparseTensorDenseMatMul<T, Tindices, ADJ_A, ADJ_B>(             \
+            ctx->eigen_device<Device>(), out->matrix<T>(), *a_indices,        \
+            a_values->vec<T>(), b->matrix<T>(), &csr_cache_);                 \
+    OP_REQUIRES_OK(ctx, functor_status);                                      \
   }
 
     MAYBE_ADJOINT(false, false);
@@ -153,6 +361,7 @@ class SparseTensorDenseMatMulOp : public OpKernel {
  private:
   bool adjoint_a_;
   bool adjoint_b_;
+  functor::SparseTensorDenseMatMulCsrCache<Tindices> csr_cache_;
 };
 
 #define REGISTER_CPU(TypeT, TypeIndex)           \
@@ -225,90 +434,209 @@ REGISTER_KERNELS_GPU(float);
 
 namespace functor {
 
-namespace {
-Status KOutOfBoundsError(int64 k, std::size_t i, int rhs_index_a,
-                         std::size_t lhs_right) {
-  return errors::InvalidArgument("k (", k, ") from index[", i, ",", rhs_index_a,
-                                 "] out of bounds (>=", lhs_right, ")");
-}
-
-Status MOutOfBoundsError(int64 m, std::size_t i, int lhs_index_a,
-                         int64 out_dim0) {
-  return errors::InvalidArgument("m (", m, ") from index[", i, ",", lhs_index_a,
-                                 "] out of bounds (>=", out_dim0, ")");
-}
-}  // namespace
-
 template <typename T, typename Tindices, bool ADJ_A, bool ADJ_B>
 struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
-  // Vectorize certain operations above this size.
-  static const std::size_t kNumVectorize = 32;
-
   static Status Compute(const CPUDevice& d, typename TTypes<T>::Matrix out,
                         typename TTypes<Tindices>::ConstMatrix a_indices,
                         typename TTypes<T>::ConstVec a_values,
                         typename TTypes<T>::ConstMatrix b) {
-    const std::size_t nnz = a_values.size();
-    const std::size_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+    return Compute(d, out, a_indices, a_values, b, nullptr, nullptr);
+  }
+
+  // Same as above, reusing the CSR structure of A from 'cache'.
+  static Status Compute(const CPUDevice& d, typename TTypes<T>::Matrix out,
+                        const Tensor& a_indices,
+                        typename TTypes<T>::ConstVec a_values,
+                        typename TTypes<T>::ConstMatrix b,
+                        SparseTensorDenseMatMulCsrCache<Tindices>* cache) {
+    return Compute(d, out, a_indices.matrix<Tindices>(), a_values, b,
+                   &a_indices, cache);
+  }
+
+ private:
+  // Reuses the CSR structure of A from 'cache' if not null, in which case
+  // 'a_indices_tensor' is the tensor that holds 'a_indices'.
+  static Status Compute(const CPUDevice& d, typename TTypes<T>::Matrix out,
+                        typename TTypes<Tindices>::ConstMatrix a_indices,
+                        typename TTypes<T>::ConstVec a_values,
+                        typename TTypes<T>::ConstMatrix b,
+                        const Tensor* a_indices_tensor,
+                        SparseTensorDenseMatMulCsrCache<Tindices>* cache) {
+    typedef SparseTensorDenseMatMulCsr<Tindices> Csr;
+    // Output rows narrower than this are accumulated with scalar code.
+    const int64 kNumVectorize = 16;
+    // Width in bytes of the column blocks of B and of the output, so that
+    // the output block of a row stays in L1 while the rows of B selected by
+    // its entries are streamed through.
+    const int64 kColumnBlockBytes = 8192;
+    // Minimum number of multiply-adds worth running on another thread.
+    const int64 kMinShardCost = 32 * 1024;
+
+    const int64 num_rows = out.dimension(0);
+    const int64 n = out.dimension(1);
     const std::size_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
     const int lhs_index_a = ADJ_A ? 1 : 0;
     const int rhs_index_a = ADJ_A ? 0 : 1;
 
-    out.setZero();
+    // Converting A to CSR costs about as much as multiplying it by a few
+    // columns of B, so narrow products only use the CSR form when it is
+    // reused across calls.
+    const bool build_csr = n >= kNumVectorize;
+    std::shared_ptr<const Csr> csr;
+    if (cache != nullptr) {
+      TF_RETURN_IF_ERROR(cache->Get(*a_indices_tensor, lhs_index_a,
+                                    rhs_index_a, num_rows, lhs_right,
+                                    build_csr, &csr));
+    } else if (build_csr) {
+      std::shared_ptr<Csr> new_csr = std::make_shared<Csr>();
+      TF_RETURN_IF_ERROR(new_csr->Init(a_indices, lhs_index_a, rhs_index_a,
+                                       num_rows, lhs_right));
+      csr = std::move(new_csr);
+    }
+    if (csr == nullptr) {
+      return ComputeCoo(out, a_indices, a_values, b);
+    }
 
-    // TODO(ebrevdo): After many failed experiments, can't find a multi-threaded
-    // approach that achieves the performance of the single threaded
-    // one.  Perhaps Eigen threadpool implementation is just too slow?
+    // The values of op(A) in CSR order.
+    const std::size_t nnz = a_values.size();
+    const bool conjugate_a = ADJ_A && Eigen::NumTraits<T>::IsComplex;
+    std::vector<T> csr_values;
+    const T* values = a_values.data();
+    if (!csr->perm.empty() || conjugate_a) {
+      csr_values.resize(nnz);
+      for (std::size_t p = 0; p < nnz; ++p) {
+        const T value = a_values(csr->perm.empty() ? p : csr->perm[p]);
+        csr_values[p] = conjugate_a ? MaybeConj(value) : value;
+      }
+      values = csr_values.data();
+    }
 
-    if (rhs_right < kNumVectorize) {
-      // Disable vectorization if the RHS of output is too small
-      auto maybe_adjoint_b = MaybeAdjoint<decltype(b), ADJ_B>(b);
+    // Rows of op(B) must be contiguous, so take a conjugate transposed copy
+    // of B if ADJ_B.
+    Eigen::Tensor<T, 2, Eigen::RowMajor> adjoint_b;
+    const T* b_data = b.data();
+    if (ADJ_B) {
+      Eigen::array<int, 2> shuffle{{1, 0}};
+      adjoint_b = b.shuffle(shuffle).conjugate();
+      b_data = adjoint_b.data();
+    }
 
-      for (std::size_t i = 0; i < nnz; ++i) {
-        const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
-        const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
-        if (!FastBoundsCheck(k, lhs_right)) {
-          return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
+    const int64 col_block =
+        std::max(kNumVectorize, kColumnBlockBytes / int64{sizeof(T)});
+    const int64* row_ptr = csr->row_ptr.data();
+    const Tindices* cols = csr->cols.data();
+    T* out_data = out.data();
+    auto compute_rows = [&](int64 row_start, int64 row_limit) {
+      if (n == 1) {
+        // Matrix-vector product.
+        for (int64 m = row_start; m < row_limit; ++m) {
+          T sum(0);
+          for (int64 p = row_ptr[m]; p < row_ptr[m + 1]; ++p) {
+            sum += values[p] * b_data[cols[p]];
+          }
+          out_data[m] = sum;
         }
-        if (!FastBoundsCheck(m, out.dimension(0))) {
-          return MOutOfBoundsError(m, i, lhs_index_a, out.dimension(0));
+        return;
+      }
+      typedef Eigen::Array<T, Eigen::Dynamic, 1> Array;
+      for (int64 n_start = 0; n_start < n; n_start += col_block) {
+        const int64 n_size = std::min(col_block, n - n_start);
+        for (int64 m = row_start; m < row_limit; ++m) {
+          T* out_row = out_data + m * n + n_start;
+          const int64 p_limit = row_ptr[m + 1];
+          if (n_size < kNumVectorize) {
+            // Accumulates in registers rather than in the output.
+            T sums[kNumVectorize] = {};
+            for (int64 p = row_ptr[m]; p < p_limit; ++p) {
+              const T* b_row = b_data + cols[p] * n + n_start;
+              const T value = values[p];
+              for (int64 j = 0; j < n_size; ++j) {
+                sums[j] += value * b_row[j];
+              }
+            }
+            std::copy(sums, sums + n_size, out_row);
+          } else {
+            Eigen::Map<Array> out_block(out_row, n_size);
+            out_block.setZero();
+            for (int64 p = row_ptr[m]; p < p_limit; ++p) {
+              out_block += values[p] * Eigen::Map<const Array>(
+                                           b_data + cols[p] * n + n_start,
+                                           n_size);
+            }
+          }
         }
-        const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
-        for (std::size_t n = 0; n < rhs_right; ++n) {
-          const T b_value = maybe_adjoint_b(k, n);
-          out(m, n) += a_value * b_value;
+      }
+    };
+
+    // Splits the rows into shards with about the same number of multiply-adds
+    // rather than the same number of rows, since the entries of real sparse
+    // operands are often concentrated in a few rows. Each row also costs the
+    // write of its output.
+    const int64 total_cost = row_ptr[num_rows] + num_rows;
+    const int64 num_shards = std::min(
+        num_rows,
+        std::min<int64>(4 * d.numThreads(), total_cost * n / kMinShardCost));
+    if (num_shards <= 1) {
+      compute_rows(0, num_rows);
+      return Status::OK();
+    }
+    std::vector<int64> shard_rows(num_shards + 1, num_rows);
+    shard_rows[0] = 0;
+    for (int64 s = 1; s < num_shards; ++s) {
+      // First row m with row_ptr[m] + m >= total_cost * s / num_shards.
+      const int64 target = total_cost * s / num_shards;
+      int64 lo = shard_rows[s - 1];
+      int64 hi = num_rows;
+      while (lo < hi) {
+        const int64 mid = lo + (hi - lo) / 2;
+        if (row_ptr[mid] + mid < target) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
         }
       }
-    } else {
-      // Vectorization via Eigen.
-      const int b_chip_index = ADJ_B ? 1 : 0;
-
-#define LOOP_NNZ(b_passed)                                                  \
-  for (std::size_t i = 0; i < nnz; ++i) {                                   \
-    const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a)); \
-    const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a)); \
-    const T a_value = (ADJ_A) ? MaybeConj(a_values(i)) : a_values(i);       \
-    if (!FastBoundsCheck(k, lhs_right)) {                                   \
-      return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);               \
-    }                                                                       \
-    if (!FastBoundsCheck(m, out.dimension(0))) {                            \
-      return MOutOfBoundsError(m, i, lhs_index_a, out.dimension(0));        \
-    }                                                                       \
-    out.template chip<0>(m) +=                                              \
-        b_passed.template chip<b_chip_index>(k) * a_value;                  \
+      shard_rows[s] = lo;
+    }
+    const double shard_cost = static_cast<double>(total_cost) * n / num_shards;
+    const Eigen::TensorOpCost cost(shard_cost * sizeof(T),
+                                   static_cast<double>(num_rows) * n /
+                                       num_shards * sizeof(T),
+                                   2 * shard_cost);
+    d.parallelFor(num_shards, cost, [&](int64 first, int64 last) {
+      for (int64 s = first; s < last; ++s) {
+        compute_rows(shard_rows[s], shard_rows[s + 1]);
+      }
+    });
+    return Status::OK();
   }
 
-      if (ADJ_B) {
-        // Perform transpose and conjugation on B once, since we chip out B's
-        // columns in the nnz loop.
-        Eigen::array<int, 2> shuffle(1, 0);  // preserve dimension order
-        Eigen::Tensor<T, 2, Eigen::ColMajor> col_major_conj_b =
-            b.swap_layout().shuffle(shuffle).conjugate();
-        LOOP_NNZ(col_major_conj_b);
-      } else {
-        LOOP_NNZ(b);
+  // Multiplies by the COO form of A, one entry at a time.
+  static Status ComputeCoo(typename TTypes<T>::Matrix out,
+                           typename TTypes<Tindices>::ConstMatrix a_indices,
+                           typename TTypes<T>::ConstVec a_values,
+                           typename TTypes<T>::ConstMatrix b) {
+    const std::size_t nnz = a_values.size();
+    const std::size_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+    const std::size_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
+    const int lhs_index_a = ADJ_A ? 1 : 0;
+    const int rhs_index_a = ADJ_A ? 0 : 1;
+    auto maybe_adjoint_b = MaybeAdjoint<decltype(b), ADJ_B>(b);
+
+    out.setZero();
+    for (std::size_t i = 0; i < nnz; ++i) {
+      const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+      const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+      if (!FastBoundsCheck(k, lhs_right)) {
+        return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
+      }
+      if (!FastBoundsCheck(m, out.dimension(0))) {
+        return MOutOfBoundsError(m, i, lhs_index_a, out.dimension(0));
+      }
+      const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
+      for (std::size_t n = 0; n < rhs_right; ++n) {
+        const T b_value = maybe_adjoint_b(k, n);
+        out(m, n) += a_value * b_value;
       }
-#undef LOOP_NNZ
     }
     return Status::OK();
   }
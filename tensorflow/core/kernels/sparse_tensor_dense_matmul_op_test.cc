@@ -117,4 +117,17 @@ BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, false, true);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, false);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, true);
 
+// Densities from 0.01% to 10% of a 4096 x 4096 operand.
+BM_SparseTensorDenseMatmul(1677, 4096, 4096, 128, false, false);
+BM_SparseTensorDenseMatmul(16777, 4096, 4096, 128, false, false);
+BM_SparseTensorDenseMatmul(167772, 4096, 4096, 128, false, false);
+BM_SparseTensorDenseMatmul(1677721, 4096, 4096, 128, false, false);
+BM_SparseTensorDenseMatmul(167772, 4096, 4096, 128, true, false);
+BM_SparseTensorDenseMatmul(167772, 4096, 4096, 16, false, false);
+
+// Batches of a wide linear model with about 10 and 100 features per example.
+BM_SparseTensorDenseMatmul(81920, 8192, 1048576, 16, false, false);
+BM_SparseTensorDenseMatmul(819200, 8192, 1048576, 16, false, false);
+BM_SparseTensorDenseMatmul(81920, 8192, 1048576, 64, false, false);
+
 }  // end namespace tensorflow
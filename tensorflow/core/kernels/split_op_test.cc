@@ -99,5 +99,11 @@ BM_SPLIT_2D(1, 512, 1024, 256);
 BM_SPLIT_2D(1, 20, 100000, 5);
 BM_SPLIT_2D(1, 2, 3, 524288);
 BM_SPLIT_2D(1, 100, 4096, 512);
+// Many narrow outputs per row.
+BM_SPLIT_2D(1, 256, 1024, 1);
+BM_SPLIT_2D(1, 256, 1024, 4);
+// Few huge outputs.
+BM_SPLIT_2D(1, 2, 16, 4194304);
+BM_SPLIT_2D(1, 4, 16, 2097152);
 
 }  // namespace tensorflow
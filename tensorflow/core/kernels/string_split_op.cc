@@ -15,32 +15,45 @@ limitations under the License.
 
 // See docs in ../ops/string_ops.cc.
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "tensorflow/core/framework/kernel_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/kernels/string_view_builder.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
-#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
 
 namespace tensorflow {
 
 namespace {
 
-std::vector<string> Split(const string& str, const string& delimiter,
-                          const bool skipEmpty) {
-  if (!delimiter.empty()) {
-    if (skipEmpty) {
-      return str_util::Split(str, delimiter, str_util::SkipEmpty());
+// Appends the tokens of `str` to `tokens` as views into `str` and returns
+// their number. A non-empty delimiter is a set of delimiter characters, like
+// for str_util::Split(); an empty delimiter splits `str` into characters.
+int64 SplitToViews(StringPiece str, StringPiece delimiter, bool skip_empty,
+                   StringViewBuilder* tokens) {
+  const int64 initial_size = tokens->size();
+  if (delimiter.empty()) {
+    for (size_t i = 0; i < str.size(); ++i) {
+      tokens->AddView(str.substr(i, 1));
     }
-    return str_util::Split(str, delimiter);
+    return str.size();
   }
-  std::vector<string> char_vector(str.size());
-  for (size_t i = 0; i < str.size(); ++i) {
-    char_vector[i] = str[i];
+  if (str.empty()) return 0;
+  size_t token_start = 0;
+  for (size_t i = 0; i <= str.size(); ++i) {
+    if (i == str.size() || delimiter.find(str[i]) != StringPiece::npos) {
+      if (!skip_empty || i > token_start) {
+        tokens->AddView(StringPiece(str.data() + token_start, i - token_start));
+      }
+      token_start = i + 1;
+    }
   }
-  return char_vector;
+  return tokens->size() - initial_size;
 }
 
 }  // namespace
@@ -75,8 +88,9 @@ class StringSplitOp : public OpKernel {
                                 delimiter_tensor->shape().DebugString()));
     const auto delimiter_vec = delimiter_tensor->flat<string>();
     const string& delimiter = delimiter_vec(0);
-    // Empty delimiter means split the input character by character.
-    std::vector<string> tokens;
+    // Empty delimiter means split the input character by character. The
+    // tokens are views into the input until they are copied into the output.
+    StringViewBuilder tokens;
     // Guess that we'll be unpacking a handful of tokens per example.
     static constexpr int kReserveSize = 4;
     tokens.reserve(batch_size * kReserveSize);
@@ -85,12 +99,11 @@ class StringSplitOp : public OpKernel {
     int64 max_num_entries = 0;
     std::vector<int64> num_indices(batch_size);
     for (int64 i = 0; i < batch_size; ++i) {
-      std::vector<string> parts = Split(input_vec(i), delimiter, skip_empty_);
-      int64 n_entries = parts.size();
+      const int64 n_entries =
+          SplitToViews(input_vec(i), delimiter, skip_empty_, &tokens);
       num_indices[i] = n_entries;
       output_size += n_entries;
       max_num_entries = std::max(max_num_entries, n_entries);
-      tokens.insert(tokens.end(), parts.begin(), parts.end());
     }
 
     Tensor* sp_indices_t;
@@ -103,7 +116,6 @@ class StringSplitOp : public OpKernel {
     OP_REQUIRES_OK(ctx, ctx->allocate_output(2, TensorShape({2}), &sp_shape_t));
 
     auto sp_indices = sp_indices_t->matrix<int64>();
-    auto sp_tokens = sp_tokens_t->vec<string>();
     auto sp_shape = sp_shape_t->vec<int64>();
     sp_shape(0) = batch_size;
     sp_shape(1) = max_num_entries;
@@ -112,10 +124,10 @@ class StringSplitOp : public OpKernel {
       for (size_t j = 0; j < num_indices[i]; ++j) {
         sp_indices(c, 0) = i;
         sp_indices(c, 1) = j;
-        sp_tokens(c) = tokens[c];
         ++c;
       }
     }
+    tokens.Materialize(sp_tokens_t->flat<string>());
   }
 
  private:
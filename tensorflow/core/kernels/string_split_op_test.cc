@@ -0,0 +1,157 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class StringSplitOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(bool skip_empty) {
+    TF_ASSERT_OK(NodeDefBuilder("string_split_op", "StringSplit")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("skip_empty", skip_empty)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    // Lets a test run the op more than once.
+    inputs_.clear();
+  }
+
+  // Splits `input` and checks the tokens and their indices in the output.
+  void ExpectSplit(const std::vector<string>& input, const string& delimiter,
+                   bool skip_empty, const std::vector<int64>& indices,
+                   const std::vector<string>& tokens,
+                   const std::vector<int64>& shape) {
+    MakeOp(skip_empty);
+    AddInputFromArray<string>(TensorShape({static_cast<int64>(input.size())}),
+                              input);
+    AddInputFromArray<string>(TensorShape({}), {delimiter});
+    TF_ASSERT_OK(RunOpKernel());
+
+    const int64 num_tokens = tokens.size();
+    test::ExpectTensorEqual<int64>(
+        test::AsTensor<int64>(indices, TensorShape({num_tokens, 2})),
+        *GetOutput(0));
+    test::ExpectTensorEqual<string>(
+        test::AsTensor<string>(tokens, TensorShape({num_tokens})),
+        *GetOutput(1));
+    test::ExpectTensorEqual<int64>(test::AsTensor<int64>(shape),
+                                   *GetOutput(2));
+  }
+};
+
+TEST_F(StringSplitOpTest, EmptyInput) {
+  ExpectSplit({}, " ", true, {}, {}, {0, 0});
+}
+
+TEST_F(StringSplitOpTest, EmptyElements) {
+  // An empty element has no tokens, even if empty tokens are kept.
+  ExpectSplit({"", "a b", ""}, " ", true, {1, 0, 1, 1}, {"a", "b"}, {3, 2});
+  ExpectSplit({"", "a b", ""}, " ", false, {1, 0, 1, 1}, {"a", "b"}, {3, 2});
+}
+
+TEST_F(StringSplitOpTest, EmptyDelimiter) {
+  // Splits into characters; spaces are characters like any other.
+  ExpectSplit({"ab c", "", "d"}, "", true,
+              {0, 0, 0, 1, 0, 2, 0, 3, 2, 0}, {"a", "b", " ", "c", "d"},
+              {3, 4});
+}
+
+TEST_F(StringSplitOpTest, SkipEmpty) {
+  ExpectSplit({" a  b ", "c"}, " ", true, {0, 0, 0, 1, 1, 0},
+              {"a", "b", "c"}, {2, 2});
+}
+
+TEST_F(StringSplitOpTest, KeepEmpty) {
+  ExpectSplit({" a  b ", "c"}, " ", false,
+              {0, 0, 0, 1, 0, 2, 0, 3, 0, 4, 1, 0}, {"", "a", "", "b", "", "c"},
+              {2, 5});
+}
+
+TEST_F(StringSplitOpTest, MultiCharacterDelimiter) {
+  // Every character of the delimiter is a delimiter on its own.
+  ExpectSplit({"a<b>c<>d"}, "<>", true, {0, 0, 0, 1, 0, 2, 0, 3},
+              {"a", "b", "c", "d"}, {1, 4});
+  ExpectSplit({"a<b>c<>d"}, "<>", false, {0, 0, 0, 1, 0, 2, 0, 3, 0, 4},
+              {"a", "b", "c", "", "d"}, {1, 5});
+}
+
+TEST_F(StringSplitOpTest, TokensOutliveInput) {
+  // The tokens are views into the input until the output is materialized,
+  // so they must be copies once the op has run.
+  MakeOp(true);
+  AddInputFromArray<string>(TensorShape({2}), {"hello world", "foo"});
+  AddInputFromArray<string>(TensorShape({}), {" "});
+  TF_ASSERT_OK(RunOpKernel());
+  mutable_input(0).tensor->flat<string>().setConstant("overwritten");
+  test::ExpectTensorEqual<string>(
+      test::AsTensor<string>({"hello", "world", "foo"}, TensorShape({3})),
+      *GetOutput(1));
+}
+
+}  // namespace
+
+// Splits a batch of 1000 sentences of `num_tokens` words each.
+static Graph* SetupStringSplitGraph(int num_tokens, int64* num_bytes) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_STRING, TensorShape({1000}));
+  auto input_flat = input.flat<string>();
+  *num_bytes = 0;
+  for (int i = 0; i < 1000; ++i) {
+    string& sentence = input_flat(i);
+    for (int j = 0; j < num_tokens; ++j) {
+      // Token lengths between 2 and 17 characters.
+      strings::StrAppend(&sentence, j > 0 ? " " : "",
+                         string(2 + (i * 7 + j * 13) % 16, 'a' + j % 26));
+    }
+    *num_bytes += sentence.size();
+  }
+  Tensor delimiter(DT_STRING, TensorShape({}));
+  delimiter.scalar<string>()() = " ";
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "StringSplit")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, delimiter))
+                  .Finalize(g, &node));
+  return g;
+}
+
+static void BM_StringSplit(int iters, int num_tokens) {
+  testing::StopTiming();
+  int64 num_bytes;
+  Graph* g = SetupStringSplitGraph(num_tokens, &num_bytes);
+  testing::BytesProcessed(static_cast<int64>(iters) * num_bytes);
+  testing::ItemsProcessed(static_cast<int64>(iters) * 1000 * num_tokens);
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+BENCHMARK(BM_StringSplit)->Arg(1)->Arg(10)->Arg(100);
+
+}  // namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_STRING_TO_HASH_BUCKET_OP_H_
 #define TENSORFLOW_CORE_KERNELS_STRING_TO_HASH_BUCKET_OP_H_
 
+#include <algorithm>
 #include <string>
 
 #include "tensorflow/core/framework/op_kernel.h"
@@ -23,9 +24,45 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+// Sets output(i) to hash(input(i)) % num_buckets for every element, sharding
+// the elements across the worker threads of the device.
+template <typename HashFn>
+void HashStringsToBuckets(OpKernelContext* context,
+                          TTypes<string>::ConstFlat input, int64 num_buckets,
+                          HashFn hash, TTypes<int64>::Flat output) {
+  const int64 num_strings = input.size();
+  if (num_strings == 0) return;
+  auto hash_range = [&input, &output, &hash, num_buckets](int64 begin,
+                                                          int64 end) {
+    for (int64 i = begin; i < end; ++i) {
+      const uint64 input_hash = hash(input(i));
+      const uint64 bucket_id = input_hash % num_buckets;
+      // The number of buckets is always in the positive range of int64 so is
+      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
+      // safe.
+      output(i) = static_cast<int64>(bucket_id);
+    }
+  };
+  // Sample the string lengths for the cost estimate rather than reading every
+  // element twice.
+  const int64 kNumSamples = 16;
+  const int64 stride = std::max<int64>(num_strings / kNumSamples, 1);
+  int64 sampled_bytes = 0;
+  int64 num_sampled = 0;
+  for (int64 i = 0; i < num_strings; i += stride, ++num_sampled) {
+    sampled_bytes += input(i).size();
+  }
+  // About one cycle per byte plus the call and the modulo.
+  const int64 cost_per_string = sampled_bytes / num_sampled + 50;
+  auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_strings,
+        cost_per_string, hash_range);
+}
+
 template <uint64 hash(const string&)>
 class StringToHashBucketOp : public OpKernel {
  public:
@@ -42,17 +79,9 @@ class StringToHashBucketOp : public OpKernel {
     OP_REQUIRES_OK(context,
                    context->allocate_output("output", input_tensor->shape(),
                                             &output_tensor));
-    auto output_flat = output_tensor->flat<int64>();
-
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    HashStringsToBuckets(context, input_flat, num_buckets_,
+                         [](const string& s) { return hash(s); },
+                         output_tensor->flat<int64>());
   }
 
  private:
@@ -84,17 +113,9 @@ class StringToKeyedHashBucketOp : public OpKernel {
     OP_REQUIRES_OK(context,
                    context->allocate_output("output", input_tensor->shape(),
                                             &output_tensor));
-    auto output_flat = output_tensor->flat<int64>();
-
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(key_, input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    HashStringsToBuckets(context, input_flat, num_buckets_,
+                         [this](const string& s) { return hash(key_, s); },
+                         output_tensor->flat<int64>());
   }
 
  private:
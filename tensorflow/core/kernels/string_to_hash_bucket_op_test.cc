@@ -0,0 +1,101 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+
+// Token length distributions.
+enum TokenLengths {
+  // Single words, roughly following the word lengths of running English text:
+  // mostly 2 to 8 characters.
+  kWords = 0,
+  // Word n-grams and short queries, 10 to 30 characters.
+  kNgrams = 1,
+  // Identifiers and URLs, 20 to 120 characters.
+  kUrls = 2,
+};
+
+static int SampleTokenLength(TokenLengths lengths, random::SimplePhilox* rnd) {
+  switch (lengths) {
+    case kWords: {
+      static const int kWordLengths[] = {1, 2, 2, 3, 3, 3, 4, 4, 4, 4,
+                                         5, 5, 5, 6, 6, 7, 7, 8, 9, 11};
+      return kWordLengths[rnd->Uniform(20)];
+    }
+    case kNgrams:
+      return 10 + rnd->Uniform(21);
+    default:
+      return 20 + rnd->Uniform(101);
+  }
+}
+
+static Graph* SetupHashBucketGraph(const string& op, TokenLengths lengths,
+                                   int64* num_bytes) {
+  const int kNumTokens = 100000;
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor input(DT_STRING, TensorShape({kNumTokens}));
+  auto input_flat = input.flat<string>();
+  *num_bytes = 0;
+  for (int i = 0; i < kNumTokens; ++i) {
+    const int length = SampleTokenLength(lengths, &rnd);
+    string& token = input_flat(i);
+    token.resize(length);
+    for (int j = 0; j < length; ++j) {
+      token[j] = 'a' + rnd.Uniform(26);
+    }
+    *num_bytes += length;
+  }
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), op)
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("num_buckets", 1000003)
+                  .Finalize(g, &node));
+  return g;
+}
+
+static void BM_HashBucket(int iters, const string& op, int lengths) {
+  testing::StopTiming();
+  int64 num_bytes;
+  Graph* g = SetupHashBucketGraph(op, static_cast<TokenLengths>(lengths),
+                                  &num_bytes);
+  testing::BytesProcessed(static_cast<int64>(iters) * num_bytes);
+  testing::ItemsProcessed(static_cast<int64>(iters) * 100000);
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g).Run(iters);
+}
+
+static void BM_StringToHashBucketFast(int iters, int lengths) {
+  BM_HashBucket(iters, "StringToHashBucketFast", lengths);
+}
+
+static void BM_StringToHashBucket(int iters, int lengths) {
+  BM_HashBucket(iters, "StringToHashBucket", lengths);
+}
+
+BENCHMARK(BM_StringToHashBucketFast)->Arg(kWords)->Arg(kNgrams)->Arg(kUrls);
+BENCHMARK(BM_StringToHashBucket)->Arg(kWords)->Arg(kNgrams)->Arg(kUrls);
+
+}  // namespace tensorflow
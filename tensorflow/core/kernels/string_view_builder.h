@@ -0,0 +1,73 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_STRING_VIEW_BUILDER_H_
+#define TENSORFLOW_KERNELS_STRING_VIEW_BUILDER_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Accumulates the elements of a string output as StringPieces and only
+// materializes them as strings once the output tensor is allocated.
+//
+// Each element views bytes owned by someone else, typically a substring of an
+// input tensor element, so a kernel can compute its output before it knows the
+// output size without building a temporary string per element. Materialize()
+// then copies every element exactly once into the output tensor.
+//
+// Sample use case:
+//
+// StringViewBuilder tokens;
+// for (...) tokens.AddView(StringPiece(input(i)).substr(begin, size));
+// Tensor* output;
+// OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({tokens.size()}),
+//                                          &output));
+// tokens.Materialize(output->flat<string>());
+class StringViewBuilder {
+ public:
+  StringViewBuilder() {}
+
+  void reserve(int64 n) { views_.reserve(n); }
+
+  // Appends an element that views `s`. The bytes of `s` must stay valid until
+  // the builder is materialized.
+  void AddView(StringPiece s) { views_.push_back(s); }
+
+  int64 size() const { return views_.size(); }
+
+  // Copies the elements into `output`, which must hold size() strings.
+  void Materialize(TTypes<string>::Flat output) const {
+    CHECK_EQ(output.size(), size());
+    for (int64 i = 0; i < size(); ++i) {
+      output(i).assign(views_[i].data(), views_[i].size());
+    }
+  }
+
+ private:
+  std::vector<StringPiece> views_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StringViewBuilder);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_STRING_VIEW_BUILDER_H_
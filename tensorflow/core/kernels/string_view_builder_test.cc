@@ -0,0 +1,64 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/string_view_builder.h"
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(StringViewBuilderTest, Views) {
+  const string input = "hello world";
+  StringViewBuilder builder;
+  builder.AddView(StringPiece(input).substr(0, 5));
+  builder.AddView(StringPiece());
+  builder.AddView(StringPiece(input).substr(6));
+
+  EXPECT_EQ(3, builder.size());
+
+  Tensor output(DT_STRING, TensorShape({3}));
+  builder.Materialize(output.flat<string>());
+  test::ExpectTensorEqual<string>(
+      test::AsTensor<string>({"hello", "", "world"}, TensorShape({3})),
+      output);
+}
+
+TEST(StringViewBuilderTest, MaterializeCopiesElements) {
+  std::vector<string> inputs;
+  for (int i = 0; i < 10000; ++i) {
+    inputs.push_back(strings::StrCat("value_", i));
+  }
+  StringViewBuilder builder;
+  builder.reserve(inputs.size());
+  for (const string& input : inputs) {
+    builder.AddView(input);
+  }
+
+  Tensor output(DT_STRING, TensorShape({builder.size()}));
+  builder.Materialize(output.flat<string>());
+  // The output owns its bytes once materialized.
+  inputs.clear();
+  auto output_flat = output.flat<string>();
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_EQ(strings::StrCat("value_", i), output_flat(i));
+  }
+}
+
+}  // namespace
+}  // namespace tensorflow
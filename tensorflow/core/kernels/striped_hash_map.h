@@ -0,0 +1,247 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_STRIPED_HASH_MAP_H_
+#define TENSORFLOW_KERNELS_STRIPED_HASH_MAP_H_
+
+#include <vector>
+
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace lookup {
+
+// A hash map that is safe for concurrent use and that scales with the number
+// of concurrent readers.
+//
+// The key space is partitioned into kNumStripes stripes, each an independent
+// open-addressed gtl::FlatMap guarded by its own reader/writer mutex. Readers
+// of different stripes never touch the same cache line, readers of the same
+// stripe only share the stripe's lock in shared mode, and a writer blocks only
+// the stripe it is writing to. Because every stripe grows on its own, a resize
+// rehashes 1/kNumStripes of the entries while the rest of the table stays
+// available, instead of stopping all lookups for a full rehash.
+//
+// The batch methods group the keys by stripe first so that each stripe's lock
+// is acquired at most once per call, which keeps the locking cost independent
+// of the batch size.
+//
+// Sample use case:
+//
+// StripedHashMap<int64, int64> map;
+// map.InsertBatch(n, [&](int64 i) { return keys[i]; },
+//                 [&](int64 i) { return values[i]; });
+// map.FindBatch(n, [&](int64 i) { return keys[i]; },
+//               [&](int64 i, const int64& v) { out[i] = v; },
+//               [&](int64 i) { out[i] = default_value; });
+template <class K, class V>
+class StripedHashMap {
+ public:
+  static constexpr int kLogNumStripes = 6;
+  static constexpr int kNumStripes = 1 << kLogNumStripes;
+
+  StripedHashMap() : stripes_(kNumStripes) {}
+
+  size_t size() const {
+    size_t result = 0;
+    for (const Stripe& stripe : stripes_) {
+      tf_shared_lock l(stripe.mu);
+      result += stripe.map.size();
+    }
+    return result;
+  }
+
+  // Looks up the keys key(0), ..., key(n - 1). Calls found(i, value) for every
+  // key that is present and missing(i) for every key that is not. Callbacks
+  // for the same stripe run while that stripe is read-locked, so they must not
+  // call back into the map.
+  template <typename KeyFn, typename FoundFn, typename MissingFn>
+  void FindBatch(int64 n, KeyFn key, FoundFn found, MissingFn missing) const {
+    if (n == 1) {
+      const Stripe& stripe = stripes_[StripeIndex(key(0))];
+      tf_shared_lock l(stripe.mu);
+      FindLocked(stripe, 0, key, found, missing);
+      return;
+    }
+    std::vector<int64> order;
+    std::vector<int64> stripe_begin;
+    GroupByStripe(n, key, &order, &stripe_begin);
+    for (int s = 0; s < kNumStripes; ++s) {
+      if (stripe_begin[s] == stripe_begin[s + 1]) continue;
+      const Stripe& stripe = stripes_[s];
+      tf_shared_lock l(stripe.mu);
+      for (int64 j = stripe_begin[s]; j < stripe_begin[s + 1]; ++j) {
+        FindLocked(stripe, order[j], key, found, missing);
+      }
+    }
+  }
+
+  // Inserts or updates the pairs (key(i), value(i)) for i in [0, n). When a
+  // key occurs several times in the batch the last occurrence wins.
+  template <typename KeyFn, typename ValueFn>
+  void InsertBatch(int64 n, KeyFn key, ValueFn value) {
+    std::vector<int64> order;
+    std::vector<int64> stripe_begin;
+    GroupByStripe(n, key, &order, &stripe_begin);
+    for (int s = 0; s < kNumStripes; ++s) {
+      if (stripe_begin[s] == stripe_begin[s + 1]) continue;
+      Stripe& stripe = stripes_[s];
+      mutex_lock l(stripe.mu);
+      for (int64 j = stripe_begin[s]; j < stripe_begin[s + 1]; ++j) {
+        stripe.map[key(order[j])] = value(order[j]);
+      }
+    }
+  }
+
+  // Atomically replaces the contents of the map with the pairs
+  // (key(i), value(i)) for i in [0, n).
+  template <typename KeyFn, typename ValueFn>
+  void Assign(int64 n, KeyFn key, ValueFn value) {
+    std::vector<int64> order;
+    std::vector<int64> stripe_begin;
+    GroupByStripe(n, key, &order, &stripe_begin);
+    LockAll();
+    for (int s = 0; s < kNumStripes; ++s) {
+      Stripe& stripe = stripes_[s];
+      stripe.map.clear();
+      for (int64 j = stripe_begin[s]; j < stripe_begin[s + 1]; ++j) {
+        stripe.map[key(order[j])] = value(order[j]);
+      }
+    }
+    UnlockAll();
+  }
+
+  // Calls begin(size) and then fn(key, value) for every entry, on a
+  // consistent snapshot of the map. Writers are blocked for the duration of
+  // the call; readers are not.
+  template <typename BeginFn, typename Fn>
+  void ForEach(BeginFn begin, Fn fn) const {
+    LockAllShared();
+    size_t total = 0;
+    for (const Stripe& stripe : stripes_) total += stripe.map.size();
+    begin(total);
+    for (const Stripe& stripe : stripes_) {
+      for (auto it = stripe.map.begin(); it != stripe.map.end(); ++it) {
+        fn(it->first, it->second);
+      }
+    }
+    UnlockAllShared();
+  }
+
+  // Returns the number of buckets allocated over all stripes.
+  size_t bucket_count() const {
+    size_t result = 0;
+    for (const Stripe& stripe : stripes_) {
+      tf_shared_lock l(stripe.mu);
+      result += stripe.map.bucket_count();
+    }
+    return result;
+  }
+
+ private:
+  // gtl::FlatMap takes its bucket index and marker from the raw key hash, and
+  // std::hash is the identity for integral keys, which would make runs of
+  // consecutive ids collide. Mix the bits first.
+  struct MixedHash {
+    size_t operator()(const K& k) const {
+      uint64 h = static_cast<uint64>(hash<K>()(k));
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return static_cast<size_t>(h);
+    }
+  };
+
+  // Pads each stripe to its own cache lines so that locking one stripe does
+  // not invalidate the lock word of its neighbours.
+  struct Stripe {
+    mutable mutex mu;
+    gtl::FlatMap<K, V, MixedHash> map GUARDED_BY(mu);
+    char padding[64];
+  };
+
+  // The stripe is chosen from the high bits of the mixed hash, which the
+  // FlatMap inside the stripe only uses once it holds billions of entries.
+  static int StripeIndex(const K& k) {
+    const uint64 h = static_cast<uint64>(MixedHash()(k));
+    return static_cast<int>(h >> (64 - kLogNumStripes));
+  }
+
+  // Stable counting sort of the batch indices by stripe. On return the
+  // indices of the keys belonging to stripe s are
+  // (*order)[(*stripe_begin)[s]], ..., (*order)[(*stripe_begin)[s + 1] - 1].
+  template <typename KeyFn>
+  static void GroupByStripe(int64 n, KeyFn key, std::vector<int64>* order,
+                            std::vector<int64>* stripe_begin) {
+    std::vector<int> stripe_of(n);
+    stripe_begin->assign(kNumStripes + 1, 0);
+    for (int64 i = 0; i < n; ++i) {
+      stripe_of[i] = StripeIndex(key(i));
+      ++(*stripe_begin)[stripe_of[i] + 1];
+    }
+    for (int s = 0; s < kNumStripes; ++s) {
+      (*stripe_begin)[s + 1] += (*stripe_begin)[s];
+    }
+    std::vector<int64> next(stripe_begin->begin(), stripe_begin->end() - 1);
+    order->resize(n);
+    for (int64 i = 0; i < n; ++i) {
+      (*order)[next[stripe_of[i]]++] = i;
+    }
+  }
+
+  template <typename KeyFn, typename FoundFn, typename MissingFn>
+  static void FindLocked(const Stripe& stripe, int64 i, KeyFn key,
+                         FoundFn found, MissingFn missing)
+      SHARED_LOCKS_REQUIRED(stripe.mu) {
+    auto it = stripe.map.find(key(i));
+    if (it != stripe.map.end()) {
+      found(i, it->second);
+    } else {
+      missing(i);
+    }
+  }
+
+  // Whole-table operations always acquire the stripe locks in index order,
+  // and single-stripe operations never hold more than one, so they cannot
+  // deadlock with each other.
+  void LockAll() NO_THREAD_SAFETY_ANALYSIS {
+    for (Stripe& stripe : stripes_) stripe.mu.lock();
+  }
+  void UnlockAll() NO_THREAD_SAFETY_ANALYSIS {
+    for (Stripe& stripe : stripes_) stripe.mu.unlock();
+  }
+  void LockAllShared() const NO_THREAD_SAFETY_ANALYSIS {
+    for (const Stripe& stripe : stripes_) stripe.mu.lock_shared();
+  }
+  void UnlockAllShared() const NO_THREAD_SAFETY_ANALYSIS {
+    for (const Stripe& stripe : stripes_) stripe.mu.unlock_shared();
+  }
+
+  std::vector<Stripe> stripes_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StripedHashMap);
+};
+
+}  // namespace lookup
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_STRIPED_HASH_MAP_H_
@@ -0,0 +1,225 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/striped_hash_map.h"
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace lookup {
+namespace {
+
+// Looks up keys[i] for all i and returns the values, -1 for missing keys.
+std::vector<int64> FindAll(const StripedHashMap<int64, int64>& map,
+                           const std::vector<int64>& keys) {
+  std::vector<int64> values(keys.size());
+  map.FindBatch(keys.size(), [&keys](int64 i) { return keys[i]; },
+                [&values](int64 i, const int64& v) { values[i] = v; },
+                [&values](int64 i) { values[i] = -1; });
+  return values;
+}
+
+TEST(StripedHashMapTest, InsertAndFind) {
+  StripedHashMap<int64, int64> map;
+  std::vector<int64> keys;
+  for (int64 i = 0; i < 1000; ++i) keys.push_back(i * 7919);
+  map.InsertBatch(keys.size(), [&keys](int64 i) { return keys[i]; },
+                  [](int64 i) { return i; });
+  EXPECT_EQ(1000, map.size());
+
+  keys.push_back(-5);
+  std::vector<int64> values = FindAll(map, keys);
+  for (int64 i = 0; i < 1000; ++i) EXPECT_EQ(i, values[i]);
+  EXPECT_EQ(-1, values[1000]);
+}
+
+TEST(StripedHashMapTest, SingleKeyFind) {
+  StripedHashMap<string, float> map;
+  std::vector<string> keys = {"a", "b"};
+  map.InsertBatch(2, [&keys](int64 i) { return keys[i]; },
+                  [](int64 i) { return 1.5f * i; });
+  float found = 0;
+  bool missing = false;
+  map.FindBatch(1, [](int64 i) { return string("b"); },
+                [&found](int64 i, const float& v) { found = v; },
+                [&missing](int64 i) { missing = true; });
+  EXPECT_EQ(1.5f, found);
+  EXPECT_FALSE(missing);
+  map.FindBatch(1, [](int64 i) { return string("c"); },
+                [&found](int64 i, const float& v) { found = v; },
+                [&missing](int64 i) { missing = true; });
+  EXPECT_TRUE(missing);
+}
+
+TEST(StripedHashMapTest, LastDuplicateWins) {
+  StripedHashMap<int64, int64> map;
+  std::vector<int64> keys = {3, 4, 3, 3};
+  map.InsertBatch(keys.size(), [&keys](int64 i) { return keys[i]; },
+                  [](int64 i) { return i; });
+  EXPECT_EQ(2, map.size());
+  EXPECT_EQ(std::vector<int64>({3, 1}), FindAll(map, {3, 4}));
+}
+
+TEST(StripedHashMapTest, AssignReplacesContents) {
+  StripedHashMap<int64, int64> map;
+  std::vector<int64> keys = {1, 2, 3};
+  map.InsertBatch(keys.size(), [&keys](int64 i) { return keys[i]; },
+                  [](int64 i) { return i; });
+  std::vector<int64> new_keys = {3, 10};
+  map.Assign(new_keys.size(), [&new_keys](int64 i) { return new_keys[i]; },
+             [](int64 i) { return 100 + i; });
+  EXPECT_EQ(2, map.size());
+  EXPECT_EQ(std::vector<int64>({-1, -1, 100, 101}),
+            FindAll(map, {1, 2, 3, 10}));
+}
+
+TEST(StripedHashMapTest, ForEachVisitsAllEntries) {
+  StripedHashMap<int64, int64> map;
+  map.InsertBatch(500, [](int64 i) { return i; },
+                  [](int64 i) { return 2 * i; });
+  size_t reported = 0;
+  std::unordered_map<int64, int64> seen;
+  map.ForEach([&reported](size_t size) { reported = size; },
+              [&seen](const int64& k, const int64& v) { seen[k] = v; });
+  EXPECT_EQ(500, reported);
+  ASSERT_EQ(500, seen.size());
+  for (int64 i = 0; i < 500; ++i) EXPECT_EQ(2 * i, seen[i]);
+}
+
+TEST(StripedHashMapTest, ConcurrentReadersAndWriters) {
+  StripedHashMap<int64, int64> map;
+  const int kThreads = 8;
+  const int64 kKeysPerThread = 2000;
+  thread::ThreadPool pool(Env::Default(), "test", kThreads);
+  BlockingCounter counter(kThreads);
+  for (int t = 0; t < kThreads; ++t) {
+    pool.Schedule([&map, &counter, t, kKeysPerThread] {
+      const int64 base = t * kKeysPerThread;
+      for (int64 i = 0; i < kKeysPerThread; i += 100) {
+        map.InsertBatch(100, [base, i](int64 j) { return base + i + j; },
+                        [base, i](int64 j) { return -(base + i + j); });
+        // Everything this thread has written so far must be visible.
+        std::vector<int64> keys(i + 100);
+        for (int64 j = 0; j < i + 100; ++j) keys[j] = base + j;
+        std::vector<int64> values = FindAll(map, keys);
+        for (int64 j = 0; j < i + 100; ++j) {
+          EXPECT_EQ(-(base + j), values[j]);
+        }
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  EXPECT_EQ(kThreads * kKeysPerThread, map.size());
+}
+
+// Read-heavy benchmark: num_threads threads issue batches of 128 lookups, and
+// one batch in 20 is an insert. Compares against a single mutex-guarded
+// std::unordered_map, which is what MutableHashTableOfScalars used to wrap.
+constexpr int64 kBenchmarkKeys = 1 << 20;
+constexpr int kBatchSize = 128;
+constexpr int kBatchesPerThread = 200;
+
+class MutexMap {
+ public:
+  template <typename KeyFn, typename FoundFn, typename MissingFn>
+  void FindBatch(int64 n, KeyFn key, FoundFn found, MissingFn missing) const {
+    mutex_lock l(mu_);
+    for (int64 i = 0; i < n; ++i) {
+      auto it = map_.find(key(i));
+      if (it != map_.end()) {
+        found(i, it->second);
+      } else {
+        missing(i);
+      }
+    }
+  }
+
+  template <typename KeyFn, typename ValueFn>
+  void InsertBatch(int64 n, KeyFn key, ValueFn value) {
+    mutex_lock l(mu_);
+    for (int64 i = 0; i < n; ++i) map_[key(i)] = value(i);
+  }
+
+ private:
+  mutable mutex mu_;
+  std::unordered_map<int64, int64> map_ GUARDED_BY(mu_);
+};
+
+template <typename Map>
+void ReadHeavyBenchmark(int iters, int num_threads) {
+  testing::StopTiming();
+  Map map;
+  map.InsertBatch(kBenchmarkKeys, [](int64 i) { return i; },
+                  [](int64 i) { return i; });
+  thread::ThreadPool pool(Env::Default(), "bench", num_threads);
+  std::atomic<int64> checksum(0);
+  testing::StartTiming();
+  for (int it = 0; it < iters; ++it) {
+    BlockingCounter counter(num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+      pool.Schedule([&map, &counter, &checksum, t, it] {
+        random::PhiloxRandom philox(t, it);
+        random::SimplePhilox rnd(&philox);
+        int64 keys[kBatchSize];
+        int64 sum = 0;
+        for (int b = 0; b < kBatchesPerThread; ++b) {
+          for (int i = 0; i < kBatchSize; ++i) {
+            keys[i] = rnd.Uniform64(2 * kBenchmarkKeys);
+          }
+          if (b % 20 == 0) {
+            map.InsertBatch(kBatchSize, [&keys](int64 i) { return keys[i]; },
+                            [](int64 i) { return i; });
+          } else {
+            map.FindBatch(kBatchSize, [&keys](int64 i) { return keys[i]; },
+                          [&sum](int64 i, const int64& v) { sum += v; },
+                          [&sum](int64 i) { --sum; });
+          }
+        }
+        checksum += sum;
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  testing::StopTiming();
+  CHECK_NE(checksum.load(), kint64max);
+  testing::ItemsProcessed(static_cast<int64>(iters) * num_threads *
+                          kBatchesPerThread * kBatchSize);
+}
+
+static void BM_StripedHashMapReadHeavy(int iters, int num_threads) {
+  ReadHeavyBenchmark<StripedHashMap<int64, int64>>(iters, num_threads);
+}
+BENCHMARK(BM_StripedHashMapReadHeavy)->Arg(1)->Arg(4)->Arg(8)->Arg(32);
+
+static void BM_MutexHashMapReadHeavy(int iters, int num_threads) {
+  ReadHeavyBenchmark<MutexMap>(iters, num_threads);
+}
+BENCHMARK(BM_MutexHashMapReadHeavy)->Arg(1)->Arg(4)->Arg(8)->Arg(32);
+
+}  // namespace
+}  // namespace lookup
+}  // namespace tensorflow
@@ -28,7 +28,6 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
-#include "tensorflow/core/lib/gtl/top_n.h"
 #include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
@@ -97,6 +96,137 @@ class TopK : public OpKernel {
   bool sorted_;
 };
 
+namespace {
+
+// Orders indices into `data` by decreasing value, and by increasing index
+// among equal values. This is the order of TopK's output, and it makes the
+// selected set unique even when there are ties.
+template <typename T>
+struct StableGreater {
+  explicit StableGreater(const T* data) : data(data) {}
+  bool operator()(const int32 a, const int32 b) const {
+    if (data[b] < data[a]) {
+      return true;
+    } else if (data[b] > data[a]) {
+      return false;
+    } else {
+      return a < b;
+    }
+  }
+  const T* data;
+};
+
+// Selects the first k of the n indices idx[0], ..., idx[n - 1] in
+// StableGreater order and moves them to idx[0], ..., idx[k - 1], sorted if
+// `sorted`. Linear in n, so it is the method of choice when k is a sizable
+// fraction of n.
+template <typename T>
+void SelectTopKOfIndices(const T* data, int32* idx, int64 n, int k,
+                         bool sorted) {
+  const StableGreater<T> greater(data);
+  if (k < n) std::nth_element(idx, idx + k - 1, idx + n, greater);
+  if (sorted) std::sort(idx, idx + k, greater);
+}
+
+// Selects the k largest elements of data[begin], ..., data[end - 1] with a
+// bounded heap, and writes their indices to out[0], ..., out[k - 1], sorted
+// if `sorted`. O(n log k) in the worst case, but once the heap has settled
+// most elements fall below its minimum, and whole blocks of them are skipped
+// with a vectorizable comparison against that threshold.
+template <typename T>
+void SelectTopKWithHeap(const T* data, int32 begin, int32 end, int k,
+                        bool sorted, int32* out) {
+  const StableGreater<T> greater(data);
+  // A max-heap under StableGreater keeps the worst selected index on top.
+  int32* heap_end = out + k;
+  std::iota(out, heap_end, begin);
+  std::make_heap(out, heap_end, greater);
+  T threshold = data[out[0]];
+  // Later indices lose ties, so an element can only enter the heap if it is
+  // strictly greater than the current worst one.
+  static constexpr int32 kBlockSize = 16;
+  int32 c = begin + k;
+  for (; c + kBlockSize <= end; c += kBlockSize) {
+    const T* block = data + c;
+    bool any_greater = false;
+    for (int32 j = 0; j < kBlockSize; ++j) {
+      any_greater |= block[j] > threshold;
+    }
+    if (!any_greater) continue;
+    for (int32 j = 0; j < kBlockSize; ++j) {
+      if (block[j] > threshold) {
+        std::pop_heap(out, heap_end, greater);
+        out[k - 1] = c + j;
+        std::push_heap(out, heap_end, greater);
+        threshold = data[out[0]];
+      }
+    }
+  }
+  for (; c < end; ++c) {
+    if (data[c] > threshold) {
+      std::pop_heap(out, heap_end, greater);
+      out[k - 1] = c;
+      std::push_heap(out, heap_end, greater);
+      threshold = data[out[0]];
+    }
+  }
+  if (sorted) std::sort_heap(out, heap_end, greater);
+}
+
+// Sorts all n indices of a row, for k == n.
+template <typename T>
+void SortAllIndices(const T* data, int32 n, int32* out) {
+  const auto comp = [data](const int32 a, const int32 b) {
+    return data[b] < data[a];
+  };
+  int32* begin = out;
+  int32* end = out + n;
+  // Set the initial array of indices 0 ... k - 1.
+  std::iota(begin, end, 0);
+  // We want an in-place sort, but we can cheat because we're sorting
+  // indices that started out sorted.  First, do a std::sort, which
+  // is notably faster than std::stable_sort.
+  std::sort(begin, end, comp);
+  // Then, for runs of adjacent elements that were equal, sort the
+  // indices in those runs in increasing order.
+  for (int32* run_begin = begin; run_begin != end;) {
+    int32* run_end = run_begin + 1;
+    if (run_end == end) break;
+    if (data[*run_begin] == data[*run_end]) {
+      while (++run_end != end) {
+        if (data[*run_begin] != data[*run_end]) break;
+      }
+      std::sort(run_begin, run_end);
+    }
+    run_begin = run_end;
+  }
+}
+
+// When k is at least 1/kMinHeapRatio of the columns, partial selection over
+// all indices beats the heap.
+constexpr int64 kMinHeapRatio = 16;
+
+// Rows are only split into blocks of at least this many columns.
+constexpr int64 kMinColsPerBlock = 1 << 15;
+
+// Selects the top k of data[begin], ..., data[end - 1] into out[0], ...,
+// out[k - 1], choosing the method from k and the range size.
+template <typename T>
+void SelectTopKInRange(const T* data, int32 begin, int32 end, int k,
+                       bool sorted, int32* out) {
+  const int64 n = end - begin;
+  if (k * kMinHeapRatio < n) {
+    SelectTopKWithHeap(data, begin, end, k, sorted, out);
+  } else {
+    std::vector<int32> idx(n);
+    std::iota(idx.begin(), idx.end(), begin);
+    SelectTopKOfIndices(data, idx.data(), n, k, sorted);
+    std::copy(idx.begin(), idx.begin() + k, out);
+  }
+}
+
+}  // namespace
+
 namespace functor {
 
 template <typename T>
@@ -134,69 +264,61 @@ struct TopKFunctor<CPUDevice, T> {
       return Status::OK();
     }
 
-    auto SortIndices = [&, context](int start_batch, int limit_batch) {
-      for (int32 b = start_batch; b < limit_batch; ++b) {
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // Guesstimate of cost; 4*N*log(K) where N == num_cols.
+    // If K == N, assume the cost is N*log(K + 1).
+    const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<int32>() +
+                            Eigen::TensorOpCost::AddCost<T>();
+    const double base_cost =
+        cmp_cost *
+        static_cast<double>(num_cols *
+                            Eigen::numext::log2(static_cast<float>(k + 1)));
+    const double sort_cost = (k == num_cols) ? base_cost : 4 * base_cost;
+    const double copy_cost = 2 * k * Eigen::TensorOpCost::AddCost<T>();
+    const double total_cost = sort_cost + copy_cost;
+
+    // A few long rows cannot keep the threads busy when they are sharded by
+    // row, so each row is split into blocks instead. Every block selects its
+    // own top k, and the final top k is selected from the union of those
+    // candidates, which always contains it.
+    const int64 num_blocks =
+        std::min<int64>(worker_threads.num_threads,
+                        num_cols / std::max<int64>(kMinColsPerBlock,
+                                                   k * kMinHeapRatio));
+    if (num_rows < worker_threads.num_threads && num_blocks > 1) {
+      const int64 block_cols = (num_cols + num_blocks - 1) / num_blocks;
+      std::vector<int32> candidates(num_blocks * k);
+      for (int64 b = 0; b < num_rows; ++b) {
         const T* input_data = &input(b, 0);
-        const auto stable_comp = [input_data](const int32 a, const int32 b) {
-          if (input_data[b] < input_data[a]) {
-            return true;
-          } else if (input_data[b] > input_data[a]) {
-            return false;
-          } else {
-            return a < b;
+        auto select_in_blocks = [&](int64 start_block, int64 limit_block) {
+          for (int64 i = start_block; i < limit_block; ++i) {
+            const int32 begin = i * block_cols;
+            const int32 end = std::min(num_cols, (i + 1) * block_cols);
+            SelectTopKInRange(input_data, begin, end, k, /*sorted=*/false,
+                              &candidates[i * k]);
           }
         };
-        const auto comp = [input_data](const int32 a, const int32 b) {
-          return input_data[b] < input_data[a];
-        };
-        // TODO(ebrevdo): For large k < num_cols, instead of using
-        // TopN, it may be faster to create a temporary vector of
-        // values 0..num_cols - 1 and then use std::partial_sort_copy
-        // of this into indices. Choosing the appropriate minimum k or
-        // ratio of k/num_cols will require some experimentation.
+        Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+              static_cast<int64>(total_cost / num_blocks), select_in_blocks);
+        SelectTopKOfIndices(input_data, candidates.data(), candidates.size(),
+                            k, sorted);
+        std::copy(candidates.begin(), candidates.begin() + k, &indices(b, 0));
+        std::transform(
+            &indices(b, 0), &indices(b, k), &values(b, 0),
+            [input_data](const int32 loc) { return input_data[loc]; });
+      }
+      return Status::OK();
+    }
+
+    auto SortIndices = [&, context](int start_batch, int limit_batch) {
+      for (int32 b = start_batch; b < limit_batch; ++b) {
+        const T* input_data = &input(b, 0);
         if (k == num_cols) {
-          auto* begin = &indices(b, 0);
-          auto* end = &indices(b, k);
-          // Set the initial array of indices 0 ... k - 1.
-          std::iota(begin, end, 0);
-          // We want an in-place sort, but we can cheat because we're sorting
-          // indices that started out sorted.  First, do a std::sort, which
-          // is notably faster than std::stable_sort.
-          std::sort(begin, end, comp);
-          // Then, for runs of adjacent elements that were equal, sort the
-          // indices in those runs in increasing order.
-          for (auto* run_begin = begin; run_begin != end;) {
-            auto* run_end = run_begin + 1;
-            if (run_end == end) break;
-            if (input_data[*run_begin] == input_data[*run_end]) {
-              while (++run_end != end) {
-                if (input_data[*run_begin] != input_data[*run_end]) break;
-              }
-              std::sort(run_begin, run_end);
-            }
-            run_begin = run_end;
-          }
+          SortAllIndices(input_data, k, &indices(b, 0));
         } else {
-          // Use the TopN heap object to sort.
-          gtl::TopN<int32, decltype(stable_comp)> filter(k, stable_comp);
-          filter.reserve(num_cols);
-          for (int32 c = 0; c < num_cols; ++c) {
-            filter.push(c);
-          }
-
-          int32 i = 0;
-          if (sorted) {
-            std::unique_ptr<std::vector<int32>> top_k(filter.Extract());
-            for (auto top_k_it = top_k->begin(); top_k_it != top_k->end();
-                 ++top_k_it, ++i) {
-              indices(b, i) = *top_k_it;
-            }
-          } else {
-            for (auto top_k_it = filter.unsorted_begin();
-                 top_k_it != filter.unsorted_end(); ++top_k_it, ++i) {
-              indices(b, i) = *top_k_it;
-            }
-          }
+          SelectTopKInRange(input_data, 0, num_cols, k, sorted,
+                            &indices(b, 0));
         }
         // Now that the indices are sorted, copy the values over in
         // sorted order.
@@ -205,21 +327,9 @@ struct TopKFunctor<CPUDevice, T> {
       }  // for (int32 b = ...
     };
 
-    // Guesstimate of cost; 4*N*log(K) where N == num_cols.
-    // If K == N, assume the cost is N*log(K + 1).
-    const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<int32>() +
-                            Eigen::TensorOpCost::AddCost<T>();
-    const double base_cost =
-        cmp_cost *
-        static_cast<double>(num_cols *
-                            Eigen::numext::log2(static_cast<float>(k + 1)));
-    const double sort_cost = (k == num_cols) ? base_cost : 4 * base_cost;
-    const double copy_cost = 2 * k * Eigen::TensorOpCost::AddCost<T>();
-    const double total_cost = sort_cost + copy_cost;
     const int64 final_cost = (total_cost >= static_cast<double>(kint64max))
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
@@ -0,0 +1,158 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class TopKOpTest : public OpsTestBase {
+ protected:
+  // Runs TopKV2 on `input` with `num_threads` worker threads, whatever the
+  // number of CPUs, and checks its outputs against a full stable sort.
+  void RunAndCheck(const Tensor& input, int k, bool sorted, int num_threads) {
+    thread::ThreadPool pool(Env::Default(), "topk_test", num_threads);
+    DeviceBase::CpuWorkerThreads worker_threads;
+    worker_threads.num_threads = num_threads;
+    worker_threads.workers = &pool;
+    device_->set_tensorflow_cpu_worker_threads(&worker_threads);
+
+    inputs_.clear();
+    TF_ASSERT_OK(NodeDefBuilder("topk", "TopKV2")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("sorted", sorted)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    const auto input_matrix = input.matrix<float>();
+    const int64 num_rows = input_matrix.dimension(0);
+    const int64 num_cols = input_matrix.dimension(1);
+    AddInputFromArray<float>(
+        input.shape(),
+        gtl::ArraySlice<float>(input_matrix.data(), input.NumElements()));
+    AddInputFromArray<int32>(TensorShape({}), {k});
+    TF_ASSERT_OK(RunOpKernel());
+    const auto values = GetOutput(0)->matrix<float>();
+    const auto indices = GetOutput(1)->matrix<int32>();
+
+    for (int64 r = 0; r < num_rows; ++r) {
+      const float* row = &input_matrix(r, 0);
+      // Larger values first, and lower indices first among equal values.
+      std::vector<int32> expected(num_cols);
+      std::iota(expected.begin(), expected.end(), 0);
+      std::stable_sort(
+          expected.begin(), expected.end(),
+          [row](int32 a, int32 b) { return row[a] > row[b]; });
+      expected.resize(k);
+      std::vector<int32> actual(&indices(r, 0), &indices(r, 0) + k);
+      if (!sorted) {
+        // Any order, but ties must still be broken by index.
+        std::sort(actual.begin(), actual.end(), [row](int32 a, int32 b) {
+          return row[a] > row[b] || (row[a] == row[b] && a < b);
+        });
+      }
+      ASSERT_EQ(expected, actual) << "row " << r << ", k " << k;
+      for (int i = 0; i < k; ++i) {
+        ASSERT_EQ(row[indices(r, i)], values(r, i));
+      }
+    }
+  }
+};
+
+// Fewer rows than threads, with at least 65536 columns: each row is split
+// into blocks that select their candidates in parallel.
+TEST_F(TopKOpTest, SplitRowsMatchReference) {
+  const int num_rows = 3;
+  const int num_cols = 200003;
+  Tensor input(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  auto input_matrix = input.matrix<float>();
+  random::PhiloxRandom philox(17, 42);
+  random::SimplePhilox rnd(&philox);
+  for (int c = 0; c < num_cols; ++c) {
+    // Few distinct values, so that ties span the blocks.
+    input_matrix(0, c) = rnd.Uniform(1000);
+    // Distinct values.
+    input_matrix(1, c) = rnd.RandFloat();
+    // All equal.
+    input_matrix(2, c) = 1.0f;
+  }
+  for (bool sorted : {true, false}) {
+    for (int k : {2, 5, 100, 5000, 12000}) {
+      RunAndCheck(input, k, sorted, /*num_threads=*/8);
+    }
+  }
+}
+
+}  // namespace
+
+static Graph* TopK(int num_rows, int num_cols, int k, bool sorted) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  input.flat<float>().setRandom();
+  Tensor k_tensor(DT_INT32, TensorShape({}));
+  k_tensor.scalar<int32>()() = k;
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "TopKV2")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, k_tensor))
+                  .Attr("sorted", sorted)
+                  .Finalize(g, &node));
+  return g;
+}
+
+// Many short rows, small k: rows are sharded across threads.
+#define BM_TopKManyRows(ROWS, COLS, K)                                       \
+  static void BM_TopK_##ROWS##_##COLS##_##K(int iters) {                     \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * ROWS * COLS);        \
+    test::Benchmark("cpu", TopK(ROWS, COLS, K, true)).Run(iters);            \
+  }                                                                          \
+  BENCHMARK(BM_TopK_##ROWS##_##COLS##_##K);
+
+BM_TopKManyRows(1024, 128, 5);
+BM_TopKManyRows(1024, 1000, 10);
+BM_TopKManyRows(256, 10000, 100);
+BM_TopKManyRows(256, 10000, 5000);
+
+// A single huge row with a large k: each row is split across threads.
+#define BM_TopKOneRow(COLS, K, SORTED)                                       \
+  static void BM_TopKOneRow_##COLS##_##K##_##SORTED(int iters) {             \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * COLS);               \
+    test::Benchmark("cpu", TopK(1, COLS, K, SORTED)).Run(iters);             \
+  }                                                                          \
+  BENCHMARK(BM_TopKOneRow_##COLS##_##K##_##SORTED);
+
+BM_TopKOneRow(1000000, 1000, true);
+BM_TopKOneRow(1000000, 100000, true);
+BM_TopKOneRow(10000000, 1000, true);
+BM_TopKOneRow(10000000, 1000, false);
+BM_TopKOneRow(10000000, 100000, false);
+
+}  // namespace tensorflow
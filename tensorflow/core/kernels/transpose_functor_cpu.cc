@@ -15,6 +15,7 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <complex>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
@@ -26,6 +27,19 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 
+// The 8x8 tiles of the tiled transpose are transposed in registers: with AVX
+// for 4-byte types and with SSE2 for 2-byte types.
+#undef USE_SSE2_TRANSPOSE
+#undef USE_AVX_TRANSPOSE
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define USE_SSE2_TRANSPOSE 1
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define USE_AVX_TRANSPOSE 1
+#include <immintrin.h>
+#endif
+#endif
+
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
 namespace tensorflow {
@@ -65,12 +79,236 @@ void TransposeSimple(const CPUDevice& device, const Tensor& in,
   device.parallelFor(in.NumElements(), cost, std::move(transpose_fn));
 }
 
+// Transposes the 8x8 tile at src, with rows src_stride elements apart, into
+// the tile at dst, with rows dst_stride elements apart.
+template <typename T>
+inline void Transpose8x8(const T* src, int64 src_stride, T* dst,
+                         int64 dst_stride) {
+  for (int r = 0; r < 8; ++r) {
+    for (int c = 0; c < 8; ++c) {
+      dst[c * dst_stride + r] = src[r * src_stride + c];
+    }
+  }
+}
+
+#ifdef USE_AVX_TRANSPOSE
+template <>
+inline void Transpose8x8<uint32>(const uint32* src, int64 src_stride,
+                                 uint32* dst, int64 dst_stride) {
+  const float* s = reinterpret_cast<const float*>(src);
+  float* d = reinterpret_cast<float*>(dst);
+  const __m256 r0 = _mm256_loadu_ps(s + 0 * src_stride);
+  const __m256 r1 = _mm256_loadu_ps(s + 1 * src_stride);
+  const __m256 r2 = _mm256_loadu_ps(s + 2 * src_stride);
+  const __m256 r3 = _mm256_loadu_ps(s + 3 * src_stride);
+  const __m256 r4 = _mm256_loadu_ps(s + 4 * src_stride);
+  const __m256 r5 = _mm256_loadu_ps(s + 5 * src_stride);
+  const __m256 r6 = _mm256_loadu_ps(s + 6 * src_stride);
+  const __m256 r7 = _mm256_loadu_ps(s + 7 * src_stride);
+  // Interleave pairs of rows, then pairs of pairs; each 128-bit lane then
+  // holds four elements of a column.
+  const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  const __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  const __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  const __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  const __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+  const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  // Join the lanes of rows 0-3 and 4-7.
+  _mm256_storeu_ps(d + 0 * dst_stride, _mm256_permute2f128_ps(u0, u4, 0x20));
+  _mm256_storeu_ps(d + 1 * dst_stride, _mm256_permute2f128_ps(u1, u5, 0x20));
+  _mm256_storeu_ps(d + 2 * dst_stride, _mm256_permute2f128_ps(u2, u6, 0x20));
+  _mm256_storeu_ps(d + 3 * dst_stride, _mm256_permute2f128_ps(u3, u7, 0x20));
+  _mm256_storeu_ps(d + 4 * dst_stride, _mm256_permute2f128_ps(u0, u4, 0x31));
+  _mm256_storeu_ps(d + 5 * dst_stride, _mm256_permute2f128_ps(u1, u5, 0x31));
+  _mm256_storeu_ps(d + 6 * dst_stride, _mm256_permute2f128_ps(u2, u6, 0x31));
+  _mm256_storeu_ps(d + 7 * dst_stride, _mm256_permute2f128_ps(u3, u7, 0x31));
+}
+#endif  // USE_AVX_TRANSPOSE
+
+#ifdef USE_SSE2_TRANSPOSE
+template <>
+inline void Transpose8x8<uint16>(const uint16* src, int64 src_stride,
+                                 uint16* dst, int64 dst_stride) {
+  __m128i r[8];
+  for (int i = 0; i < 8; ++i) {
+    r[i] = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(src + i * src_stride));
+  }
+  // Interleave 16-, 32- and then 64-bit elements of ever further apart rows.
+  const __m128i t0 = _mm_unpacklo_epi16(r[0], r[1]);
+  const __m128i t1 = _mm_unpackhi_epi16(r[0], r[1]);
+  const __m128i t2 = _mm_unpacklo_epi16(r[2], r[3]);
+  const __m128i t3 = _mm_unpackhi_epi16(r[2], r[3]);
+  const __m128i t4 = _mm_unpacklo_epi16(r[4], r[5]);
+  const __m128i t5 = _mm_unpackhi_epi16(r[4], r[5]);
+  const __m128i t6 = _mm_unpacklo_epi16(r[6], r[7]);
+  const __m128i t7 = _mm_unpackhi_epi16(r[6], r[7]);
+  const __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+  const __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+  const __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+  const __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+  const __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+  const __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+  const __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+  const __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+  const __m128i c[8] = {
+      _mm_unpacklo_epi64(u0, u4), _mm_unpackhi_epi64(u0, u4),
+      _mm_unpacklo_epi64(u1, u5), _mm_unpackhi_epi64(u1, u5),
+      _mm_unpacklo_epi64(u2, u6), _mm_unpackhi_epi64(u2, u6),
+      _mm_unpacklo_epi64(u3, u7), _mm_unpackhi_epi64(u3, u7)};
+  for (int i = 0; i < 8; ++i) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * dst_stride), c[i]);
+  }
+}
+#endif  // USE_SSE2_TRANSPOSE
+
+// Transposes the rows x cols matrix at src into the cols x rows matrix at
+// dst, 8x8 tiles at a time. The tiles are visited down the columns of src,
+// which fills whole rows of dst before moving on.
+template <typename T>
+void TransposeBlock(const T* src, int64 src_stride, T* dst, int64 dst_stride,
+                    int64 rows, int64 cols) {
+  const int64 tiled_rows = rows - rows % 8;
+  const int64 tiled_cols = cols - cols % 8;
+  for (int64 c = 0; c < tiled_cols; c += 8) {
+    for (int64 r = 0; r < tiled_rows; r += 8) {
+      Transpose8x8(src + r * src_stride + c, src_stride,
+                   dst + c * dst_stride + r, dst_stride);
+    }
+  }
+  for (int64 c = tiled_cols; c < cols; ++c) {
+    for (int64 r = 0; r < tiled_rows; ++r) {
+      dst[c * dst_stride + r] = src[r * src_stride + c];
+    }
+  }
+  for (int64 r = tiled_rows; r < rows; ++r) {
+    for (int64 c = 0; c < cols; ++c) {
+      dst[c * dst_stride + r] = src[r * src_stride + c];
+    }
+  }
+}
+
+// Transposes that move the innermost dimension are a batch of strided 2-D
+// transposes: the input dimension that becomes innermost in the output
+// (the rows) against the innermost input dimension (the columns). Each of
+// them is done in kTiledBlockSize x kTiledBlockSize blocks that stay in L1,
+// and the threads share strips of kTiledBlockSize rows. Returns false,
+// without touching out, if the permutation does not move the innermost
+// dimension or the matrices are too narrow to tile.
+constexpr int64 kTiledBlockSize = 64;
+
+template <typename T>
+bool TransposeTiled(const CPUDevice& device, const Tensor& in,
+                    const gtl::ArraySlice<int32> perm, Tensor* out) {
+  internal::TransposePermsVec out_position;
+  internal::TransposeDimsVec new_dims;
+  internal::ReduceTransposeDimensions(in.shape(), perm, &out_position,
+                                      &new_dims);
+  // ReduceTransposeDimensions returns the output position of each of the
+  // reduced input dimensions; invert that into a permutation.
+  const int ndims = out_position.size();
+  internal::TransposePermsVec new_perm(ndims);
+  for (int i = 0; i < ndims; ++i) new_perm[out_position[i]] = i;
+  if (ndims < 2 || new_perm[ndims - 1] == ndims - 1) return false;
+  const int row_dim = new_perm[ndims - 1];
+  const int64 rows = new_dims[row_dim];
+  const int64 cols = new_dims[ndims - 1];
+  if (rows < 8 || cols < 8) return false;
+
+  internal::TransposeDimsVec in_strides(ndims);
+  internal::TransposeDimsVec out_strides(ndims);
+  in_strides[ndims - 1] = 1;
+  out_strides[ndims - 1] = 1;
+  for (int i = ndims - 2; i >= 0; --i) {
+    in_strides[i] = in_strides[i + 1] * new_dims[i + 1];
+    out_strides[i] = out_strides[i + 1] * new_dims[new_perm[i + 1]];
+  }
+  // The remaining output dimensions enumerate the matrices, in output order.
+  int64 dst_stride = 0;
+  internal::TransposeDimsVec batch_dims;
+  internal::TransposeDimsVec batch_in_strides;
+  internal::TransposeDimsVec batch_out_strides;
+  for (int i = 0; i < ndims - 1; ++i) {
+    if (new_perm[i] == ndims - 1) {
+      dst_stride = out_strides[i];
+    } else {
+      batch_dims.push_back(new_dims[new_perm[i]]);
+      batch_in_strides.push_back(in_strides[new_perm[i]]);
+      batch_out_strides.push_back(out_strides[i]);
+    }
+  }
+  const int64 src_stride = in_strides[row_dim];
+  const int64 num_matrices = in.NumElements() / (rows * cols);
+  const int64 num_strips = (rows + kTiledBlockSize - 1) / kTiledBlockSize;
+
+  const T* p = reinterpret_cast<const T*>(in.tensor_data().data());
+  T* q = reinterpret_cast<T*>(const_cast<char*>((out->tensor_data().data())));
+  auto transpose_fn = [&](int64 begin, int64 end) {
+    for (int64 strip = begin; strip < end; ++strip) {
+      int64 t = strip / num_strips;
+      int64 in_offset = 0;
+      int64 out_offset = 0;
+      for (int i = batch_dims.size() - 1; i >= 0; --i) {
+        const int64 idx = t % batch_dims[i];
+        t /= batch_dims[i];
+        in_offset += idx * batch_in_strides[i];
+        out_offset += idx * batch_out_strides[i];
+      }
+      const int64 r = (strip % num_strips) * kTiledBlockSize;
+      const int64 block_rows = std::min(kTiledBlockSize, rows - r);
+      for (int64 c = 0; c < cols; c += kTiledBlockSize) {
+        TransposeBlock(p + in_offset + r * src_stride + c, src_stride,
+                       q + out_offset + c * dst_stride + r, dst_stride,
+                       block_rows, std::min(kTiledBlockSize, cols - c));
+      }
+    }
+  };
+  const int64 strip_size = kTiledBlockSize * cols;
+  Eigen::TensorOpCost cost(/*bytes_loaded=*/sizeof(T) * strip_size,
+                           /*bytes_stored=*/sizeof(T) * strip_size,
+                           /*compute_cycles=*/strip_size);
+  device.parallelFor(num_matrices * num_strips, cost, std::move(transpose_fn));
+  return true;
+}
+
+// Every 2- and 4-byte type is transposed as uint16 or uint32.
+template <typename T>
+bool MaybeTransposeTiled(const CPUDevice& device, const Tensor& in,
+                         const gtl::ArraySlice<int32> perm, Tensor* out) {
+  return false;
+}
+
+template <>
+bool MaybeTransposeTiled<uint16>(const CPUDevice& device, const Tensor& in,
+                                 const gtl::ArraySlice<int32> perm,
+                                 Tensor* out) {
+  return TransposeTiled<uint16>(device, in, perm, out);
+}
+
+template <>
+bool MaybeTransposeTiled<uint32>(const CPUDevice& device, const Tensor& in,
+                                 const gtl::ArraySlice<int32> perm,
+                                 Tensor* out) {
+  return TransposeTiled<uint32>(device, in, perm, out);
+}
+
 }  // namespace
 
 template <typename T, bool conjugate>
 struct Transpose<CPUDevice, T, conjugate> {
   static void run(const CPUDevice& d, const Tensor& in,
                   const gtl::ArraySlice<int32> perm, Tensor* out) {
+    if (!conjugate && MaybeTransposeTiled<T>(d, in, perm, out)) return;
     switch (in.dims()) {
       case 2:
         internal::TransposeUsingEigen<CPUDevice, T, 2>(d, in, perm, conjugate,
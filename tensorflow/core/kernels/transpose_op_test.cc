@@ -0,0 +1,187 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/transpose_functor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Transposes one element at a time.
+template <typename T>
+Tensor ReferenceTranspose(const Tensor& in, const std::vector<int32>& perm) {
+  TensorShape out_shape;
+  for (const int32 d : perm) out_shape.AddDim(in.dim_size(d));
+  Tensor out(in.dtype(), out_shape);
+  const int ndims = in.dims();
+  std::vector<int64> in_strides(ndims, 1);
+  for (int i = ndims - 2; i >= 0; --i) {
+    in_strides[i] = in_strides[i + 1] * in.dim_size(i + 1);
+  }
+  auto in_flat = in.flat<T>();
+  auto out_flat = out.flat<T>();
+  for (int64 o = 0; o < out.NumElements(); ++o) {
+    int64 t = o;
+    int64 i = 0;
+    for (int d = ndims - 1; d >= 0; --d) {
+      i += (t % out_shape.dim_size(d)) * in_strides[perm[d]];
+      t /= out_shape.dim_size(d);
+    }
+    out_flat(o) = in_flat(i);
+  }
+  return out;
+}
+
+template <typename T>
+void TestTranspose(const TensorShape& shape, const std::vector<int32>& perm) {
+  Tensor in(DataTypeToEnum<T>::value, shape);
+  auto in_flat = in.flat<T>();
+  for (int64 i = 0; i < in.NumElements(); ++i) {
+    in_flat(i) = static_cast<T>(i % 2039);
+  }
+  const Tensor expected = ReferenceTranspose<T>(in, perm);
+  Tensor out(in.dtype(), expected.shape());
+
+  Eigen::ThreadPool pool(4);
+  Eigen::ThreadPoolDevice device(&pool, 4);
+  TF_ASSERT_OK(DoTranspose(device, in, perm, &out));
+  test::ExpectTensorEqual<T>(expected, out);
+}
+
+TEST(TransposeTest, Tiled2D) {
+  TestTranspose<float>(TensorShape({8, 8}), {1, 0});
+  TestTranspose<float>(TensorShape({64, 64}), {1, 0});
+  TestTranspose<float>(TensorShape({131, 77}), {1, 0});
+  TestTranspose<Eigen::half>(TensorShape({131, 77}), {1, 0});
+  TestTranspose<int32>(TensorShape({1000, 9}), {1, 0});
+}
+
+TEST(TransposeTest, Tiled3D) {
+  TestTranspose<float>(TensorShape({3, 67, 70}), {0, 2, 1});
+  TestTranspose<float>(TensorShape({17, 19, 23}), {2, 1, 0});
+  TestTranspose<float>(TensorShape({17, 19, 23}), {1, 2, 0});
+  TestTranspose<float>(TensorShape({17, 19, 23}), {2, 0, 1});
+  TestTranspose<Eigen::half>(TensorShape({17, 19, 23}), {2, 0, 1});
+}
+
+TEST(TransposeTest, Tiled4D) {
+  // NHWC <-> NCHW.
+  TestTranspose<float>(TensorShape({2, 13, 11, 40}), {0, 3, 1, 2});
+  TestTranspose<float>(TensorShape({2, 40, 13, 11}), {0, 2, 3, 1});
+  TestTranspose<Eigen::half>(TensorShape({2, 13, 11, 40}), {0, 3, 1, 2});
+  TestTranspose<Eigen::half>(TensorShape({2, 40, 13, 11}), {0, 2, 3, 1});
+  TestTranspose<float>(TensorShape({9, 10, 11, 12}), {3, 1, 0, 2});
+}
+
+TEST(TransposeTest, Untiled) {
+  // The innermost dimension stays in place, or a tiled dimension is too
+  // short; these keep using Eigen.
+  TestTranspose<float>(TensorShape({5, 6, 7}), {1, 0, 2});
+  TestTranspose<float>(TensorShape({2, 3, 100}), {0, 2, 1});
+  TestTranspose<int8>(TensorShape({31, 33}), {1, 0});
+  TestTranspose<double>(TensorShape({31, 33}), {1, 0});
+}
+
+template <typename T>
+static Graph* Transpose(const TensorShape& shape,
+                        const std::vector<int32>& perm) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in(DataTypeToEnum<T>::value, shape);
+  in.flat<T>().setRandom();
+  Tensor perm_tensor(DT_INT32, TensorShape({static_cast<int64>(perm.size())}));
+  std::copy(perm.begin(), perm.end(), perm_tensor.flat<int32>().data());
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Transpose")
+                  .Input(test::graph::Constant(g, in))
+                  .Input(test::graph::Constant(g, perm_tensor))
+                  .Finalize(g, &node));
+  return g;
+}
+
+// Permutations by kind, benchmarked over several sizes.
+enum TransposeKind {
+  kMatrix = 0,       // {1, 0} on [size, size].
+  kBatchMatrix = 1,  // {0, 2, 1} on [32, size, size].
+  kNHWCToNCHW = 2,   // {0, 3, 1, 2} on [32, size, size, 64].
+  kNCHWToNHWC = 3,   // {0, 2, 3, 1} on [32, 64, size, size].
+};
+
+template <typename T>
+static void BM_Transpose(int iters, int kind, int size) {
+  TensorShape shape;
+  std::vector<int32> perm;
+  switch (kind) {
+    case kMatrix:
+      shape = TensorShape({size, size});
+      perm = {1, 0};
+      break;
+    case kBatchMatrix:
+      shape = TensorShape({32, size, size});
+      perm = {0, 2, 1};
+      break;
+    case kNHWCToNCHW:
+      shape = TensorShape({32, size, size, 64});
+      perm = {0, 3, 1, 2};
+      break;
+    default:
+      shape = TensorShape({32, 64, size, size});
+      perm = {0, 2, 3, 1};
+  }
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * shape.num_elements() *
+                          sizeof(T));
+  test::Benchmark("cpu", Transpose<T>(shape, perm)).Run(iters);
+}
+
+static void BM_TransposeFloat(int iters, int kind, int size) {
+  BM_Transpose<float>(iters, kind, size);
+}
+
+static void BM_TransposeHalf(int iters, int kind, int size) {
+  BM_Transpose<Eigen::half>(iters, kind, size);
+}
+
+BENCHMARK(BM_TransposeFloat)
+    ->ArgPair(kMatrix, 256)
+    ->ArgPair(kMatrix, 1024)
+    ->ArgPair(kMatrix, 4096)
+    ->ArgPair(kBatchMatrix, 64)
+    ->ArgPair(kBatchMatrix, 512)
+    ->ArgPair(kNHWCToNCHW, 14)
+    ->ArgPair(kNHWCToNCHW, 56)
+    ->ArgPair(kNCHWToNHWC, 14)
+    ->ArgPair(kNCHWToNHWC, 56);
+
+BENCHMARK(BM_TransposeHalf)
+    ->ArgPair(kMatrix, 1024)
+    ->ArgPair(kMatrix, 4096)
+    ->ArgPair(kBatchMatrix, 512)
+    ->ArgPair(kNHWCToNCHW, 56)
+    ->ArgPair(kNCHWToNHWC, 56);
+
+}  // namespace
+}  // namespace tensorflow
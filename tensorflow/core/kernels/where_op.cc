@@ -23,8 +23,11 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/where_op.h"
 
+#include <string.h>
+#include <algorithm>
 #include <memory>
 #include <numeric>
+#include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -35,7 +38,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #if GOOGLE_CUDA
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
@@ -62,7 +67,49 @@ int64 CountAccumulator(const T* begin, const T* end) {
 
 template <>
 int64 CountAccumulator<bool>(const bool* begin, const bool* end) {
-  return std::accumulate(begin, end, 0LL);
+  static_assert(sizeof(bool) == 1, "bool must be a byte");
+  // Adds eight bools at a time into the byte lanes of a word, and folds the
+  // lanes into the count before any of them can overflow.
+  const char* p = reinterpret_cast<const char*>(begin);
+  const char* const limit = reinterpret_cast<const char*>(end);
+  int64 count = 0;
+  while (limit - p >= 8) {
+    const int64 num_words = std::min<int64>((limit - p) / 8, 255);
+    uint64 lanes = 0;
+    for (int64 i = 0; i < num_words; ++i, p += 8) {
+      uint64 word;
+      memcpy(&word, p, sizeof(word));
+      lanes += word;
+    }
+    lanes = (lanes & 0x00FF00FF00FF00FFULL) +
+            ((lanes >> 8) & 0x00FF00FF00FF00FFULL);
+    count += (lanes * 0x0001000100010001ULL) >> 48;
+  }
+  for (; p < limit; ++p) count += *p;
+  return count;
+}
+
+// Where scans its input in runs of kScanBlock elements and skips the runs
+// without any true value.
+constexpr int kScanBlock = 16;
+
+template <typename T>
+bool AnyNonZero(const T* begin) {
+  // Written without early exits so that it vectorizes.
+  bool any = false;
+  for (int i = 0; i < kScanBlock; ++i) {
+    any |= begin[i] != T(0);
+  }
+  return any;
+}
+
+template <>
+bool AnyNonZero<bool>(const bool* begin) {
+  uint64 words[kScanBlock / sizeof(uint64)];
+  memcpy(words, begin, sizeof(words));
+  uint64 any = 0;
+  for (const uint64 word : words) any |= word;
+  return any != 0;
 }
 
 }  // namespace
@@ -77,6 +124,11 @@ struct NumTrue<CPUDevice, T, int64> {
   }
 };
 
+// Unlike the GPU functor, the CPU functor writes the input in blocks of
+// `block_size` elements, in parallel. The true values of block i are written
+// to output rows block_offsets[i], ..., block_offsets[i + 1] - 1, so
+// block_offsets must hold the exclusive prefix sums of the per-block counts,
+// followed by their total.
 template <int DIMS, typename T, typename TIndex>
 struct Where<CPUDevice, DIMS, T, TIndex> {
   EIGEN_ALWAYS_INLINE static void WriteIndexRowMajor(
@@ -89,9 +141,39 @@ struct Where<CPUDevice, DIMS, T, TIndex> {
     }
   }
 
+  // Writes the indices of the true values among input elements [begin, end)
+  // to output rows *found_true onwards, advancing *found_true past each one.
+  // Rows at or past output_limit are counted but not written.
+  EIGEN_ALWAYS_INLINE static void ComputeRange(
+      const T* input, const Eigen::DSizes<TIndex, DIMS>& strides, TIndex begin,
+      TIndex end, typename TTypes<int64>::Matrix output, TIndex output_limit,
+      TIndex* found_true) {
+    TIndex n = begin;
+    for (; n + kScanBlock <= end; n += kScanBlock) {
+      if (!AnyNonZero(input + n)) continue;
+      for (TIndex m = n; m < n + kScanBlock; ++m) {
+        if (input[m] != T(0)) {
+          if (*found_true < output_limit) {
+            WriteIndexRowMajor(output, strides, *found_true, m);
+          }
+          ++*found_true;
+        }
+      }
+    }
+    for (; n < end; ++n) {
+      if (input[n] != T(0)) {
+        if (*found_true < output_limit) {
+          WriteIndexRowMajor(output, strides, *found_true, n);
+        }
+        ++*found_true;
+      }
+    }
+  }
+
   EIGEN_ALWAYS_INLINE static Status Compute(
       OpKernelContext* ctx, const CPUDevice& d,
-      typename TTypes<T, DIMS>::ConstTensor input,
+      typename TTypes<T, DIMS>::ConstTensor input, TIndex block_size,
+      const std::vector<TIndex>& block_offsets,
       typename TTypes<int64>::Matrix output, TIndex* found_true) {
     Eigen::DSizes<Eigen::DenseIndex, DIMS> dims = input.dimensions();
     Eigen::DSizes<TIndex, DIMS> strides;
@@ -105,14 +187,38 @@ struct Where<CPUDevice, DIMS, T, TIndex> {
       strides[i] = strides[i + 1] * dims[i + 1];
     }
 
-    Eigen::DenseIndex output_size = output.dimension(0);
-    for (Eigen::DenseIndex n = 0; n < input.size(); ++n) {
-      if (input.data()[n] != T(0)) {
-        if (FastBoundsCheck(*found_true, output_size)) {
-          WriteIndexRowMajor(output, strides, *found_true, n);
-        }
-        ++*found_true;
+    const TIndex num_blocks = block_offsets.size() - 1;
+    const TIndex output_size = output.dimension(0);
+    const TIndex input_size = input.size();
+    std::vector<TIndex> block_found(num_blocks);
+    auto write_blocks = [&](int64 start_block, int64 limit_block) {
+      for (int64 i = start_block; i < limit_block; ++i) {
+        TIndex found = block_offsets[i];
+        const TIndex output_limit = std::min(block_offsets[i + 1], output_size);
+        ComputeRange(input.data(), strides,
+                     std::min(i * block_size, input_size),
+                     std::min((i + 1) * block_size, input_size), output,
+                     output_limit, &found);
+        block_found[i] = found - block_offsets[i];
+      }
+    };
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          block_size * (2 + DIMS), write_blocks);
+
+    *found_true = 0;
+    for (TIndex i = 0; i < num_blocks; ++i) {
+      const TIndex expected = block_offsets[i + 1] - block_offsets[i];
+      if (block_found[i] != expected) {
+        // The total may still match, but some output rows were not written.
+        return errors::InvalidArgument(
+            "WhereOp: Race condition between counting the number of true "
+            "elements and writing them.  When counting, saw ",
+            expected, " elements in block ", i,
+            "; but when writing their indices, saw ", block_found[i],
+            " elements.");
       }
+      *found_true += block_found[i];
     }
     return Status::OK();
   }
@@ -136,30 +242,54 @@ class WhereCPUOp : public OpKernel {
 
     const int input_dims = input.dims();
 
-    Tensor num_true;
-    OP_REQUIRES_OK(
-        context, context->allocate_temp(DT_INT64, TensorShape({}), &num_true));
-    auto num_true_t = num_true.scalar<int64>();
-
-    Status s = functor::NumTrue<CPUDevice, T, int64>::Compute(
-        context, context->eigen_device<CPUDevice>(), input.flat<T>(),
-        num_true_t);
-    OP_REQUIRES_OK(context, s);
-    TensorShape output_shape({num_true_t(), input_dims});
+    // The input is split into blocks that are counted in parallel. The
+    // prefix sums of the counts then tell each block where to write its
+    // indices, so the blocks are written in parallel as well.
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const int64 input_size = input.NumElements();
+    const int64 num_blocks = std::max<int64>(
+        1, std::min<int64>(input_size / kMinBlockSize,
+                           kBlocksPerThread * worker_threads->num_threads));
+    const int64 block_size =
+        std::max<int64>(1, (input_size + num_blocks - 1) / num_blocks);
+    std::vector<int64> block_offsets(num_blocks + 1);
+
+    const auto input_flat = input.flat<T>();
+    mutex mu;
+    Status count_status;
+    auto count_blocks = [&](int64 start_block, int64 limit_block) {
+      for (int64 i = start_block; i < limit_block; ++i) {
+        const int64 begin = std::min(i * block_size, input_size);
+        const int64 end = std::min((i + 1) * block_size, input_size);
+        Status s = functor::NumTrue<CPUDevice, T, int64>::Compute(
+            context, context->eigen_device<CPUDevice>(),
+            typename TTypes<T>::ConstFlat(input_flat.data() + begin,
+                                          end - begin),
+            TTypes<int64>::Scalar(&block_offsets[i + 1]));
+        if (!s.ok()) {
+          mutex_lock l(mu);
+          count_status.Update(s);
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          block_size, count_blocks);
+    OP_REQUIRES_OK(context, count_status);
+    std::partial_sum(block_offsets.begin(), block_offsets.end(),
+                     block_offsets.begin());
+    const int64 num_true = block_offsets.back();
+
+    TensorShape output_shape({num_true, input_dims});
     Tensor* output = nullptr;
     OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
 
-    // TODO(ebrevdo): Replace single-threaded copy with a
-    // multithreaded block copy by getting block counts above instead
-    // of a global NumTrue, then having each block filled in in
-    // separate threads below.
     int64 found_true = 0;
 
 #define HANDLE_DIM(NDIM)                                                      \
   case NDIM: {                                                                \
     Status s = functor::Where<CPUDevice, NDIM, T, int64>::Compute(            \
         context, context->eigen_device<CPUDevice>(), input.tensor<T, NDIM>(), \
-        output->matrix<int64>(), &found_true);                                \
+        block_size, block_offsets, output->matrix<int64>(), &found_true);     \
     OP_REQUIRES_OK(context, s);                                               \
   } break;
 
@@ -178,15 +308,20 @@ class WhereCPUOp : public OpKernel {
 #undef HANDLE_DIM
 
     OP_REQUIRES(
-        context, found_true == num_true_t(),
+        context, found_true == num_true,
         errors::InvalidArgument(
             "WhereOp: Race condition between counting the number of true "
             "elements and writing them.  When counting, saw ",
-            num_true_t(), " elements; but when writing their indices, saw ",
+            num_true, " elements; but when writing their indices, saw ",
             found_true, " elements."));
   }
 
  private:
+  // Inputs are only split into blocks of at least this many elements.
+  static constexpr int64 kMinBlockSize = 1 << 16;
+  // A few blocks per thread even out blocks with different densities.
+  static constexpr int64 kBlocksPerThread = 4;
+
   TF_DISALLOW_COPY_AND_ASSIGN(WhereCPUOp);
 };
 
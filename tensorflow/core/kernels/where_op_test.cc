@@ -0,0 +1,56 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+
+// A boolean mask of `num_elements` elements, `percent_true` percent of them
+// true.
+static Graph* Where(int64 num_elements, int percent_true) {
+  Graph* g = new Graph(OpRegistry::Global());
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor mask(DT_BOOL, TensorShape({num_elements / 1000, 1000}));
+  auto mask_flat = mask.flat<bool>();
+  for (int64 i = 0; i < num_elements; ++i) {
+    mask_flat(i) = rnd.Uniform(100) < percent_true;
+  }
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Where")
+                  .Input(test::graph::Constant(g, mask))
+                  .Finalize(g, &node));
+  return g;
+}
+
+#define BM_WhereDev(NUM, DEVICE)                                             \
+  static void BM_Where_##NUM##_##DEVICE(int iters, int percent_true) {       \
+    testing::UseRealTime();                                                  \
+    testing::ItemsProcessed(static_cast<int64>(iters) * NUM);                \
+    test::Benchmark(#DEVICE, Where(NUM, percent_true)).Run(iters);           \
+  }                                                                          \
+  BENCHMARK(BM_Where_##NUM##_##DEVICE)->Arg(0)->Arg(1)->Arg(50)->Arg(99);
+
+BM_WhereDev(1000000, cpu);
+BM_WhereDev(10000000, cpu);
+BM_WhereDev(100000000, cpu);
+
+}  // namespace tensorflow
@@ -20,7 +20,8 @@ limitations under the License.
 
 namespace tensorflow {
 
-// Winograd DeepConv2DTransform implementation for 3x3 filters.
+// Winograd DeepConv2DTransform implementation for 3x3 filters, computing 2x2
+// output tiles from 4x4 input tiles: F(2x2, 3x3).
 // Details:
 // *) Arithmetic complexity of computations: Shmuel Winograd
 // *) Fast Algorithms for Convolutional Neural Networks: Lavin, Gray
@@ -42,6 +43,10 @@ class WinogradTransform : public DeepConv2DTransform<T> {
   virtual void GetOutputTransformMatrix(const int64 rows, const int64 cols,
                                         T* transform_matrix) const;
 
+  virtual void GetInputTransformMatrix1D(T* transform_matrix) const;
+
+  virtual void GetOutputTransformMatrix1D(T* transform_matrix) const;
+
   virtual const Shape& filter_shape() const { return filter_shape_; }
   virtual const Shape& input_shape() const { return input_shape_; }
   virtual const Shape& output_shape() const { return output_shape_; }
@@ -372,6 +377,138 @@ void WinogradTransform<T>::GetOutputTransformMatrix(const int64 rows,
   transform_matrix[3 * cols + 15] = T(1.0);
 };
 
+template <typename T>
+void WinogradTransform<T>::GetInputTransformMatrix1D(
+    T* transform_matrix) const {
+  static const float kMatrix[] = {1, 0,  -1, 0, 0, 1, 1, 0,
+                                  0, -1, 1,  0, 0, 1, 0, -1};
+  for (int i = 0; i < 16; ++i) transform_matrix[i] = T(kMatrix[i]);
+}
+
+template <typename T>
+void WinogradTransform<T>::GetOutputTransformMatrix1D(
+    T* transform_matrix) const {
+  static const float kMatrix[] = {1, 1, 1, 0, 0, 1, -1, -1};
+  for (int i = 0; i < 8; ++i) transform_matrix[i] = T(kMatrix[i]);
+}
+
+// Writes the kronecker product 'M * M' of the [m_rows, m_cols] matrix 'M' to
+// 'transform_matrix', which has layout [m_rows * m_rows, m_cols * m_cols].
+template <typename T>
+void ComputeWinogradKroneckerProduct(const int64 m_rows, const int64 m_cols,
+                                     const T* m, T* transform_matrix) {
+  const int64 cols = m_cols * m_cols;
+  for (int64 i = 0; i < m_rows; ++i) {
+    for (int64 k = 0; k < m_rows; ++k) {
+      T* row = transform_matrix + (i * m_rows + k) * cols;
+      for (int64 j = 0; j < m_cols; ++j) {
+        for (int64 l = 0; l < m_cols; ++l) {
+          row[j * m_cols + l] = T(m[i * m_cols + j] * m[k * m_cols + l]);
+        }
+      }
+    }
+  }
+}
+
+// Winograd DeepConv2DTransform implementation for 3x3 filters, computing 4x4
+// output tiles from 6x6 input tiles: F(4x4, 3x3).
+//
+// It needs 36 products per 16 outputs where F(2x2, 3x3) needs 16 per 4, so it
+// wins for deep convolutions where the products dominate, at the cost of
+// larger transforms and slightly larger rounding errors (the transform
+// matrices below have entries up to 8, where F(2x2, 3x3) only has 1s).
+// Details: Fast Algorithms for Convolutional Neural Networks: Lavin, Gray
+template <typename T>
+class WinogradF4x4Transform : public DeepConv2DTransform<T> {
+ public:
+  typedef typename DeepConv2DTransform<T>::Shape Shape;
+
+  WinogradF4x4Transform()
+      : filter_shape_(3, 3), input_shape_(6, 6), output_shape_(4, 4) {}
+
+  // The filter transform matrix is the kronecker product 'M * M' of the
+  // following matrix 'M':
+  //
+  //   [ 1/4     0     0   ]
+  //   [-1/6  -1/6  -1/6   ]
+  //   [-1/6   1/6  -1/6   ]
+  //   [ 1/24  1/12  1/6   ]
+  //   [ 1/24 -1/12  1/6   ]
+  //   [ 0      0     1    ]
+  //
+  // The data layout of 'transform_matrix':
+  //   [input_tile_spatial_size, filter_spatial_size]
+  virtual void GetFilterTransformMatrix(const int64 rows, const int64 cols,
+                                        T* transform_matrix) const {
+    CHECK_EQ(rows, 36);
+    CHECK_EQ(cols, 9);
+    const T m[] = {T(1.0 / 4),  T(0),         T(0),         //
+                   T(-1.0 / 6), T(-1.0 / 6),  T(-1.0 / 6),  //
+                   T(-1.0 / 6), T(1.0 / 6),   T(-1.0 / 6),  //
+                   T(1.0 / 24), T(1.0 / 12),  T(1.0 / 6),   //
+                   T(1.0 / 24), T(-1.0 / 12), T(1.0 / 6),   //
+                   T(0),        T(0),         T(1)};
+    ComputeWinogradKroneckerProduct(6, 3, m, transform_matrix);
+  }
+
+  // The input transform matrix is the kronecker product 'M * M' of the matrix
+  // 'M' returned by GetInputTransformMatrix1D.
+  //
+  // Data layout of 'transform_matrix':
+  //   [tile_spatial_size, tile_spatial_size]
+  virtual void GetInputTransformMatrix(const int64 rows, const int64 cols,
+                                       T* transform_matrix) const {
+    CHECK_EQ(rows, 36);
+    CHECK_EQ(cols, 36);
+    T m[36];
+    GetInputTransformMatrix1D(m);
+    ComputeWinogradKroneckerProduct(6, 6, m, transform_matrix);
+  }
+
+  // The output transform matrix is the kronecker product 'M * M' of the
+  // matrix 'M' returned by GetOutputTransformMatrix1D.
+  //
+  // Data layout of 'transform_matrix':
+  //   [out_tile_spatial_size, tile_spatial_size]
+  virtual void GetOutputTransformMatrix(const int64 rows, const int64 cols,
+                                        T* transform_matrix) const {
+    CHECK_EQ(rows, 16);
+    CHECK_EQ(cols, 36);
+    T m[24];
+    GetOutputTransformMatrix1D(m);
+    ComputeWinogradKroneckerProduct(4, 6, m, transform_matrix);
+  }
+
+  // Data layout of 'transform_matrix': [tile_rows, tile_rows]
+  virtual void GetInputTransformMatrix1D(T* transform_matrix) const {
+    static const float kMatrix[] = {4, 0,  -5, 0,  1, 0,  //
+                                    0, -4, -4, 1,  1, 0,  //
+                                    0, 4,  -4, -1, 1, 0,  //
+                                    0, -2, -1, 2,  1, 0,  //
+                                    0, 2,  -1, -2, 1, 0,  //
+                                    0, 4,  0,  -5, 0, 1};
+    for (int i = 0; i < 36; ++i) transform_matrix[i] = T(kMatrix[i]);
+  }
+
+  // Data layout of 'transform_matrix': [out_tile_rows, tile_rows]
+  virtual void GetOutputTransformMatrix1D(T* transform_matrix) const {
+    static const float kMatrix[] = {1, 1, 1,  1, 1,  0,  //
+                                    0, 1, -1, 2, -2, 0,  //
+                                    0, 1, 1,  4, 4,  0,  //
+                                    0, 1, -1, 8, -8, 1};
+    for (int i = 0; i < 24; ++i) transform_matrix[i] = T(kMatrix[i]);
+  }
+
+  virtual const Shape& filter_shape() const { return filter_shape_; }
+  virtual const Shape& input_shape() const { return input_shape_; }
+  virtual const Shape& output_shape() const { return output_shape_; }
+
+ private:
+  const Shape filter_shape_;
+  const Shape input_shape_;
+  const Shape output_shape_;
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_CORE_KERNELS_WINOGRAD_TRANSFORM_H_
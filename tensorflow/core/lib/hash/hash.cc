@@ -76,6 +76,19 @@ uint32 Hash32(const char* data, size_t n, uint32 seed) {
   return h;
 }
 
+// Returns the little-endian value of the 1 to 7 bytes at data.
+static inline uint64 LittleEndianTail64(const char* data, size_t n) {
+  if (n >= 4) {
+    // Two overlapping 4-byte loads cover all bytes.
+    const uint64 lo = core::DecodeFixed32(data);
+    const uint64 hi = core::DecodeFixed32(data + n - 4);
+    return lo | (hi << (8 * (n - 4)));
+  }
+  // Bytes 0, n / 2 and n - 1 cover all bytes.
+  return ByteAs64(data[0]) | (ByteAs64(data[n / 2]) << (8 * (n / 2))) |
+         (ByteAs64(data[n - 1]) << (8 * (n - 1)));
+}
+
 uint64 Hash64(const char* data, size_t n, uint64 seed) {
   const uint64 m = 0xc6a4a7935bd1e995;
   const int r = 47;
@@ -95,28 +108,11 @@ uint64 Hash64(const char* data, size_t n, uint64 seed) {
     h *= m;
   }
 
-  switch (n) {
-    case 7:
-      h ^= ByteAs64(data[6]) << 48;
-      TF_FALLTHROUGH_INTENDED;
-    case 6:
-      h ^= ByteAs64(data[5]) << 40;
-      TF_FALLTHROUGH_INTENDED;
-    case 5:
-      h ^= ByteAs64(data[4]) << 32;
-      TF_FALLTHROUGH_INTENDED;
-    case 4:
-      h ^= ByteAs64(data[3]) << 24;
-      TF_FALLTHROUGH_INTENDED;
-    case 3:
-      h ^= ByteAs64(data[2]) << 16;
-      TF_FALLTHROUGH_INTENDED;
-    case 2:
-      h ^= ByteAs64(data[1]) << 8;
-      TF_FALLTHROUGH_INTENDED;
-    case 1:
-      h ^= ByteAs64(data[0]);
-      h *= m;
+  // The remaining bytes are mixed in as one little-endian word. Assembling it
+  // from a few overlapping loads avoids a hard to predict branch on n.
+  if (n > 0) {
+    h ^= LittleEndianTail64(data, n);
+    h *= m;
   }
 
   h ^= h >> r;
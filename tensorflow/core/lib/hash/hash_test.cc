@@ -33,6 +33,10 @@ TEST(Hash, SignedUnsignedIssue) {
       0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x18, 0x28, 0x00, 0x00, 0x00,
       0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
   };
+  // Prefixes of d6 cover every Hash64 tail length of 5 to 7 bytes, with and
+  // without a preceding 8-byte word.
+  const unsigned char d6[15] = {0x80, 0x8d, 0x9a, 0xa7, 0xb4, 0xc1, 0xce, 0xdb,
+                                0xe8, 0xf5, 0x83, 0x90, 0x9d, 0xaa, 0xb7};
 
   struct Case {
     uint32 hash32;
@@ -49,6 +53,13 @@ TEST(Hash, SignedUnsignedIssue) {
            {0x3ba37e0eu, 0x02167564e4d06430ull, d3, sizeof(d3), 0xbc9f1d34},
            {0x16174eb3u, 0x8f7ed82ffc21071full, d4, sizeof(d4), 0xbc9f1d34},
            {0x98b1926cu, 0xce196580c97aff1eull, d5, sizeof(d5), 0x12345678},
+           {0xb5152703u, 0x422e1851305b07cbull, d6, 5, 0xbc9f1d34},
+           {0x4a13591du, 0x6d434ba5efbd045bull, d6, 6, 0xbc9f1d34},
+           {0xd92d3d36u, 0xd4a26420deb0b5bcull, d6, 7, 0xbc9f1d34},
+           {0xeef9502bu, 0x41e9e09c563f23a0ull, d6, 8, 0xbc9f1d34},
+           {0xc305ba8bu, 0xfe4fb6cf0bc714adull, d6, 9, 0xbc9f1d34},
+           {0x469a62e9u, 0x491f5da96b67a294ull, d6, 13, 0xbc9f1d34},
+           {0xfbeed396u, 0xf9f50ed2d7a8a434ull, d6, 15, 0xbc9f1d34},
        }) {
     EXPECT_EQ(c.hash32,
               Hash32(reinterpret_cast<const char*>(c.data), c.size, c.seed));
@@ -81,4 +92,16 @@ static void BM_Hash32(int iters, int len) {
 }
 BENCHMARK(BM_Hash32)->Range(1, 1024);
 
+// Hashes keys of varying length, 1 to max_len bytes.
+static void BM_Hash64(int iters, int max_len) {
+  std::string input(max_len, 'x');
+  uint64 h = 0;
+  for (int i = 0; i < iters; i++) {
+    h += Hash64(input.data(), 1 + (i * 7) % max_len, 1);
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * (max_len + 1) / 2);
+  VLOG(1) << h;
+}
+BENCHMARK(BM_Hash64)->Range(1, 1024);
+
 }  // namespace tensorflow
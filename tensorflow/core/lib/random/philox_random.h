@@ -183,6 +183,10 @@ class PhiloxRandom {
     return counter;
   }
 
+  // The counter of the next output, and the key.
+  PHILOX_DEVICE_INLINE const ResultType& counter() const { return counter_; }
+  PHILOX_DEVICE_INLINE const Key& key() const { return key_; }
+
  private:
   // We use the same constants as recommended by the original paper.
   static const uint32 kPhiloxW32A = 0x9E3779B9;
@@ -545,6 +545,30 @@ REGISTER_OP("Betainc")
       return Status::OK();
     });
 
+// Evaluates a DAG of elementwise ops on 'inputs' in a single pass. Value i is
+// input i for i < N, and the result of instruction i - N otherwise. Instruction
+// i applies the cwise op named ops[i] ("Add", "Sigmoid", ...) to the values
+// operands[2 * i] and, for binary ops, operands[2 * i + 1]. All values are
+// broadcast to the shape of 'output', which is the last value. Created by the
+// grappler remapper; do not invoke directly.
+REGISTER_OP("_FusedElementwise")
+    .Input("inputs: N * T")
+    .Output("output: T")
+    .Attr("T: {float, double}")
+    .Attr("N: int >= 1")
+    .Attr("ops: list(string) >= 1")
+    .Attr("operands: list(int)")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle output = c->input(0);
+      for (int i = 1; i < c->num_inputs(); ++i) {
+        TF_RETURN_IF_ERROR(
+            shape_inference::BroadcastBinaryOpOutputShapeFnHelper(
+                c, output, c->input(i), &output));
+      }
+      c->set_output(0, output);
+      return Status::OK();
+    });
+
 // --------------------------------------------------------------------------
 
 // Declares cwise binary comparison operations signature: 't, 't -> bool,
@@ -454,6 +454,25 @@ REGISTER_OP("FusedPadConv2D")
       return CommonFusedConvCalculations(c, false /* has_resize */);
     });
 
+// Conv2D followed by the ops in 'fused_ops', which take their extra inputs from
+// 'args' in order: an optional "BiasAdd" (bias), an optional "FusedBatchNorm"
+// in inference mode (scale, offset, mean, variance), and an optional "Relu" or
+// "Relu6". Created by the grappler remapper; do not invoke directly.
+REGISTER_OP("_FusedConv2D")
+    .Input("input: T")
+    .Input("filter: T")
+    .Input("args: num_args * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("num_args: int >= 0")
+    .Attr("strides: list(int)")
+    .Attr(GetPaddingAttrString())
+    .Attr(GetConvnetDataFormatAttrString())
+    .Attr("dilations: list(int) = [1, 1, 1, 1]")
+    .Attr("fused_ops: list(string) = []")
+    .Attr("epsilon: float = 0.0001")
+    .SetShapeFn(shape_inference::Conv2DShape);
+
 // --------------------------------------------------------------------------
 
 REGISTER_OP("DepthwiseConv2dNative")
@@ -17,9 +17,15 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import time
+
+import numpy as np
+
+from tensorflow.python.client import session
 from tensorflow.python.data.ops import dataset_ops
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import errors
+from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
 from tensorflow.python.platform import test
 
@@ -54,6 +60,101 @@ class PrefetchDatasetTest(test.TestCase):
       with self.test_session() as sess:
         sess.run(init_op, feed_dict={buffer_size: -5})
 
+  def testDeepPrefetchChain(self):
+    # Every stage schedules its producer on the shared threads of the global
+    # iterator scheduler, which may be fewer than there are stages.
+    dataset = dataset_ops.Dataset.range(100)
+    for _ in range(20):
+      dataset = dataset.map(lambda x: x + 1).prefetch(1)
+    iterator = dataset.make_one_shot_iterator()
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      for i in range(100):
+        self.assertEqual(i + 20, sess.run(get_next))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
+  def testPrefetchInsideFlatMap(self):
+    dataset = dataset_ops.Dataset.range(10).flat_map(
+        lambda x: dataset_ops.Dataset.range(x).prefetch(2)).prefetch(2)
+    iterator = dataset.make_one_shot_iterator()
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      for i in range(10):
+        for j in range(i):
+          self.assertEqual(j, sess.run(get_next))
+      with self.assertRaises(errors.OutOfRangeError):
+        sess.run(get_next)
+
+  def testDestroyIteratorWhileProducing(self):
+    dataset = dataset_ops.Dataset.range(1000)
+    for _ in range(5):
+      dataset = dataset.prefetch(10)
+    iterator = dataset.make_initializable_iterator()
+    get_next = iterator.get_next()
+
+    with self.test_session() as sess:
+      for _ in range(10):
+        sess.run(iterator.initializer)
+        self.assertEqual(0, sess.run(get_next))
+
+
+def _num_threads():
+  """Returns the number of threads of this process, or None if unknown."""
+  try:
+    with open("/proc/self/status") as f:
+      for line in f:
+        if line.startswith("Threads:"):
+          return int(line.split()[1])
+  except IOError:
+    pass
+  return None
+
+
+class PrefetchDatasetBenchmark(test.Benchmark):
+
+  def benchmarkPrefetchPipeline(self):
+    num_stages = 10
+    with ops.Graph().as_default():
+      dataset = dataset_ops.Dataset.from_tensors(0).repeat(None)
+      for _ in range(num_stages):
+        dataset = dataset.map(lambda x: x + 1).prefetch(1)
+      iterator = dataset.make_one_shot_iterator()
+      next_element = iterator.get_next()
+
+      # Starts the shared threads of the iterator scheduler, so that only the
+      # threads started for the stages are counted.
+      warm_up = dataset_ops.Dataset.range(1).prefetch(1)
+      warm_up_element = warm_up.make_one_shot_iterator().get_next()
+
+      with session.Session() as sess:
+        sess.run(warm_up_element)
+        threads_before = _num_threads()
+        for _ in range(5):
+          sess.run(next_element.op)
+        deltas = []
+        for _ in range(100):
+          start = time.time()
+          for _ in range(100):
+            sess.run(next_element.op)
+          end = time.time()
+          deltas.append(end - start)
+        threads_after = _num_threads()
+
+        median_wall_time = np.median(deltas) / 100
+        extras = {"elements_per_second": 1 / median_wall_time}
+        if threads_before is not None and threads_after is not None:
+          extras["threads_started"] = threads_after - threads_before
+        print("Prefetch pipeline of %d stages: median wall time: %f, %s" %
+              (num_stages, median_wall_time, extras))
+        self.report_benchmark(
+            iters=10000,
+            wall_time=median_wall_time,
+            extras=extras,
+            name="benchmark_prefetch_pipeline_%d_stages" % num_stages)
+
 
 if __name__ == "__main__":
   test.main()
@@ -551,6 +551,8 @@ class Dataset(object):
     Args:
       buffer_size: A `tf.int64` scalar `tf.Tensor`, representing the
         maximum number elements that will be buffered when prefetching.
+        If `tf.contrib.data.AUTOTUNE` is used, the buffer size is tuned at
+        runtime.
 
     Returns:
       Dataset: A `Dataset`.
@@ -829,7 +831,9 @@ class Dataset(object):
        `self.output_types`) to another nested structure of tensors.
       num_parallel_calls: (Optional.) A `tf.int32` scalar `tf.Tensor`,
         representing the number elements to process in parallel. If not
-        specified, elements will be processed sequentially.
+        specified, elements will be processed sequentially. If
+        `tf.contrib.data.AUTOTUNE` is used, the number of parallel calls is
+        tuned at runtime.
 
     Returns:
       Dataset: A `Dataset`.
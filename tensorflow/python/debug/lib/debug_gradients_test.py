@@ -41,7 +41,8 @@ class IdentifyGradientTest(test_util.TensorFlowTestCase):
   def setUp(self):
     rewriter_config = rewriter_config_pb2.RewriterConfig(
         disable_model_pruning=True,
-        dependency_optimization=rewriter_config_pb2.RewriterConfig.OFF)
+        dependency_optimization=rewriter_config_pb2.RewriterConfig.OFF,
+        remapping=rewriter_config_pb2.RewriterConfig.OFF)
     graph_options = config_pb2.GraphOptions(rewrite_options=rewriter_config)
     config = config_pb2.ConfigProto(graph_options=graph_options)
     self.sess = session.Session(config=config)
@@ -39,7 +39,8 @@ class SessionDebugFileTest(session_debug_testlib.SessionDebugTestBase):
   def _no_rewrite_session_config(self):
     rewriter_config = rewriter_config_pb2.RewriterConfig(
         disable_model_pruning=True,
-        arithmetic_optimization=rewriter_config_pb2.RewriterConfig.OFF)
+        arithmetic_optimization=rewriter_config_pb2.RewriterConfig.OFF,
+        remapping=rewriter_config_pb2.RewriterConfig.OFF)
     graph_options = config_pb2.GraphOptions(rewrite_options=rewriter_config)
     return config_pb2.ConfigProto(graph_options=graph_options)
 
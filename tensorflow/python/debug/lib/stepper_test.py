@@ -57,7 +57,8 @@ class StepperTest(test_util.TensorFlowTestCase):
     rewriter_config = rewriter_config_pb2.RewriterConfig(
         disable_model_pruning=True,
         arithmetic_optimization=rewriter_config_pb2.RewriterConfig.OFF,
-        constant_folding=rewriter_config_pb2.RewriterConfig.OFF)
+        constant_folding=rewriter_config_pb2.RewriterConfig.OFF,
+        remapping=rewriter_config_pb2.RewriterConfig.OFF)
     graph_options = config_pb2.GraphOptions(rewrite_options=rewriter_config)
     config = config_pb2.ConfigProto(graph_options=graph_options)
     self.sess = session.Session(config=config)
@@ -592,7 +593,8 @@ class StepperAssignAddTest(test_util.TensorFlowTestCase):
     rewriter_config = rewriter_config_pb2.RewriterConfig(
         disable_model_pruning=True,
         arithmetic_optimization=rewriter_config_pb2.RewriterConfig.OFF,
-        constant_folding=rewriter_config_pb2.RewriterConfig.OFF)
+        constant_folding=rewriter_config_pb2.RewriterConfig.OFF,
+        remapping=rewriter_config_pb2.RewriterConfig.OFF)
     graph_options = config_pb2.GraphOptions(rewrite_options=rewriter_config)
     config = config_pb2.ConfigProto(graph_options=graph_options)
     self.sess = session.Session(config=config)
@@ -725,7 +727,8 @@ class StepperBackwardRunTest(test_util.TensorFlowTestCase):
     rewriter_config = rewriter_config_pb2.RewriterConfig(
         disable_model_pruning=True,
         arithmetic_optimization=rewriter_config_pb2.RewriterConfig.OFF,
-        constant_folding=rewriter_config_pb2.RewriterConfig.OFF)
+        constant_folding=rewriter_config_pb2.RewriterConfig.OFF,
+        remapping=rewriter_config_pb2.RewriterConfig.OFF)
     graph_options = config_pb2.GraphOptions(rewrite_options=rewriter_config)
     config = config_pb2.ConfigProto(graph_options=graph_options)
     self.sess = session.Session(config=config)
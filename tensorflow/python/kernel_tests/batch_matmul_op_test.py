@@ -118,6 +118,9 @@ class BatchMatmulOpTest(test.TestCase):
     compareNonEmpty(self, [7, 2, 3], [7, 3, 1])
     compareNonEmpty(self, [7, 2, 3], [7, 3, 5])
     compareNonEmpty(self, [10, 64, 75], [10, 75, 30])
+    compareNonEmpty(self, [4, 16, 16], [4, 16, 16])
+    compareNonEmpty(self, [4, 64, 64], [4, 64, 64])
+    compareNonEmpty(self, [6, 17, 40], [6, 40, 32])
     compareNonEmpty(self, [5, 7, 2, 3], [5, 7, 3, 5])
 
   def _testEmpty(self, dtype, adjoint_a, adjoint_b, use_static_shape):
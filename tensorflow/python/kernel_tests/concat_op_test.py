@@ -522,6 +522,45 @@ class ConcatOpTest(test.TestCase):
           cur_offset += params[p[i]].shape[concat_dim]
           self.assertAllEqual(result[index], params[p[i]])
 
+  def _testConcatOnCpu(self, inputs, axis):
+    with self.test_session(use_gpu=False):
+      p = [array_ops.placeholder(x.dtype, shape=x.shape) for x in inputs]
+      result = array_ops.concat(p, axis).eval(feed_dict=dict(zip(p, inputs)))
+    self.assertAllEqual(np.concatenate(inputs, axis), result)
+
+  def testConcatSmallPieces(self):
+    # Pieces of at most 128 bytes per row on average are copied row by row.
+    # Zero and odd widths cover the tails of the small copies, and pieces of
+    # more than 64 bytes per row the calls to memcpy.
+    for dtype in [np.int8, np.float32, np.float64]:
+      inputs = [
+          np.random.randint(0, 100, (64, i % 23)).astype(dtype)
+          for i in range(300)
+      ]
+      self._testConcatOnCpu(inputs, 1)
+    inputs = [np.random.rand(1, 4).astype(np.float32) for _ in range(5)]
+    self._testConcatOnCpu(inputs, 0)
+
+  def testConcatStreaming(self):
+    # Outputs of at least 16MB in pieces of at least 4KB per row on average
+    # are written with non-temporal stores. The odd widths leave most pieces
+    # unaligned.
+    inputs = [
+        np.random.rand(4, 1048577).astype(np.float32),
+        np.random.rand(4, 1048573).astype(np.float32)
+    ]
+    self._testConcatOnCpu(inputs, 1)
+    inputs = [np.random.rand(3, 1048577).astype(np.float32) for _ in range(2)]
+    self._testConcatOnCpu(inputs, 0)
+
+  def testConcatDefaultCopy(self):
+    for dtype in [np.int8, np.float32]:
+      inputs = [
+          np.random.randint(0, 100, (100, 1000 + i)).astype(dtype)
+          for i in range(3)
+      ]
+      self._testConcatOnCpu(inputs, 1)
+
   def testConcatEmpty(self):
     with self.test_session(use_gpu=True):
       t1 = []
@@ -1752,7 +1752,7 @@ class SeparableConv2DTest(test.TestCase):
 class DeepConv2DTest(test.TestCase):
 
   def _CompareFwdConv2D(self, tensor_in_sizes, filter_in_sizes, conv_strides,
-                        padding):
+                        padding, tol=1e-5):
     """Verifies that DeepConv2D and Conv2D produce the same values.
 
     Args:
@@ -1762,6 +1762,7 @@ class DeepConv2DTest(test.TestCase):
         [kernel_rows, kernel_cols, input_depth, output_depth].
       conv_strides: [row_stride, col_stride] for the convolution;
       padding: Padding type.
+      tol: Relative and absolute tolerance of the comparison.
     """
     x1 = np.random.rand(*tensor_in_sizes).astype(np.float32)
     x2 = np.random.rand(*filter_in_sizes).astype(np.float32)
@@ -1779,15 +1780,22 @@ class DeepConv2DTest(test.TestCase):
       os.environ["TF_USE_DEEP_CONV2D"] = "1"
       values_test = sess.run([conv])
 
-      self.assertAllClose(values_expect, values_test, rtol=1e-5, atol=1e-5)
+      self.assertAllClose(values_expect, values_test, rtol=tol, atol=tol)
 
   def _RunTestCases(self, conv_strides, padding):
     input_sizes = [[5, 5, 5, 1248], [3, 17, 17, 192], [2, 35, 35, 288],
                    [2, 6, 8, 517], [2, 7, 4, 81], [3, 11, 3, 77]]
     filter_sizes = [[3, 3, 1248, 128], [3, 3, 192, 192], [3, 3, 288, 384],
                     [3, 3, 517, 64], [3, 3, 81, 77], [3, 3, 77, 181]]
-    for input_shape, filter_shape in zip(input_sizes, filter_sizes):
-      self._CompareFwdConv2D(input_shape, filter_shape, conv_strides, padding)
+    # [2, 35, 35, 288] selects the F(4x4, 3x3) transform, which loses up to
+    # ~1e-6 of the sum of the (here all positive) terms in float, against
+    # ~1e-7 for F(2x2, 3x3). The direct convolution it is compared with
+    # rounds as well, so the case gets twice the tolerance of the others.
+    tols = [1e-5, 1e-5, 2e-5, 1e-5, 1e-5, 1e-5]
+    for input_shape, filter_shape, tol in zip(input_sizes, filter_sizes,
+                                              tols):
+      self._CompareFwdConv2D(input_shape, filter_shape, conv_strides, padding,
+                             tol)
 
   def testConv2D3x3FilterStride1x1Valid(self):
     self._RunTestCases([1, 1], "VALID")
@@ -229,6 +229,58 @@ class DecodeCSVOpTest(test.TestCase):
     self._test(
         args, expected_err_re="Quoted field has to end with quote followed.*")
 
+  def testSelectCols(self):
+    args = {
+        "records": [",,", "4,5,6", '"a",b,"c"', "7,8,9,10"],
+        "record_defaults": [["x"], ["y"]],
+        "select_cols": [0, 2],
+    }
+
+    expected_out = [[b"x", b"4", b"a", b"7"], [b"y", b"6", b"c", b"9"]]
+
+    self._test(args, expected_out)
+
+  def testSelectColsSkipsUnusedFields(self):
+    # The second column is not a valid int and the fourth is malformed, but
+    # neither is selected.
+    args = {
+        "records": ['1,abc,2,"x', '3,def,4,"y'],
+        "record_defaults": [[0], [0]],
+        "select_cols": [0, 2],
+    }
+
+    expected_out = [[1, 3], [2, 4]]
+
+    self._test(args, expected_out)
+
+  def testSelectColsMissingField(self):
+    args = {
+        "records": ["1,2,3", "4"],
+        "record_defaults": [[0], [0]],
+        "select_cols": [0, 2],
+    }
+
+    self._test(args, expected_err_re="Expect 2 fields but have 1 in record 1")
+
+  def testSelectColsNotSorted(self):
+    with self.assertRaisesRegexp(ValueError, "not strictly increasing"):
+      parsing_ops.decode_csv(
+          records=["1,2"], record_defaults=[[0], [0]], select_cols=[1, 0])
+
+  def testSelectColsWrongLength(self):
+    with self.assertRaisesRegexp(ValueError, "do not match"):
+      parsing_ops.decode_csv(
+          records=["1,2"], record_defaults=[[0], [0]], select_cols=[1])
+
+  def testManyRecordsFirstErrorReported(self):
+    records = ["%d,%d" % (i, i) for i in range(10000)]
+    records[5000] = "5000,x"
+    records[7000] = "7000,y"
+    args = {"records": records, "record_defaults": [[0], [0]]}
+
+    self._test(
+        args, expected_err_re="Field 1 in record 5000 is not a valid int32: x")
+
 
 if __name__ == "__main__":
   test.main()
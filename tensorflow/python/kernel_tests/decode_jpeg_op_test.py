@@ -23,6 +23,7 @@ import time
 
 from six.moves import xrange  # pylint: disable=redefined-builtin
 from tensorflow.python.client import session
+from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import control_flow_ops
@@ -186,6 +187,68 @@ class DecodeJpegBenchmark(test.Benchmark):
           iters=num_iters,
           wall_time=duration_decode_after_crop)
 
+  def _evalDecodeAndResizeJpeg(self, image_name, fused, num_iters, size,
+                               tile=None):
+    """Evaluate decoding and resizing of the given image to `size`.
+
+    Args:
+      image_name: a string of image file name (without suffix).
+      fused: If true, use DecodeAndResizeJpeg instead of separate decode and
+          resize ops.
+      num_iters: number of iterations for evaluation.
+      size: the [height, width] of the resized image.
+      tile: if not None, tile the image to composite a larger fake image.
+
+    Returns:
+      The duration of the run in seconds.
+    """
+    ops.reset_default_graph()
+
+    image_file_path = os.path.join(prefix_path, image_name)
+    single_image = image_ops.decode_jpeg(
+        io_ops.read_file(image_file_path), channels=3, name='single_image')
+    if tile is not None:
+      single_image = array_ops.tile(single_image, tile)
+    image_content = variable_scope.get_variable(
+        'image_%s' % image_name,
+        initializer=image_ops.encode_jpeg(single_image))
+
+    with session.Session() as sess:
+      sess.run(variables.global_variables_initializer())
+      if fused:
+        image = image_ops.decode_and_resize_jpeg(
+            image_content, array_ops.zeros([0], dtypes.int32), size,
+            channels=3)
+      else:
+        image = image_ops.decode_jpeg(image_content, channels=3)
+        image = image_ops.resize_bilinear(
+            array_ops.expand_dims(image, 0), size)[0]
+
+      for _ in xrange(3):
+        # Skip warm up time.
+        sess.run(image)
+
+      start_time = time.time()
+      for _ in xrange(num_iters):
+        sess.run(image)
+    return time.time() - start_time
+
+  def benchmarkDecodeAndResizeJpeg(self):
+    """Evaluate decoding and resizing of ImageNet sized images to 224x224."""
+    num_iters = 100
+    size = [224, 224]
+    # medium.jpg is 500x375, about the average size of ImageNet images.
+    for tile in [[1, 1, 1], [2, 2, 1], [4, 4, 1]]:
+      for fused in [False, True]:
+        duration = self._evalDecodeAndResizeJpeg('medium.jpg', fused,
+                                                 num_iters, size, tile)
+        self.report_benchmark(
+            name='decode_%s_resize_jpeg_tile%d' %
+            ('and' if fused else 'then', tile[0]),
+            iters=num_iters,
+            wall_time=duration,
+            extras={'images_per_second': num_iters / duration})
+
 
 if __name__ == '__main__':
   test.main()
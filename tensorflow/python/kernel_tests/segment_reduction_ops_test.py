@@ -443,6 +443,42 @@ class UnsortedSegmentTest(SegmentReductionHelper):
         self.assertAllClose(np_ans, tf_ans)
         self.assertShapeEqual(np_ans, s)
 
+  def testLargeValues(self):
+    # More than 32768 elements, so that the CPU kernels bucket the rows by
+    # segment and reduce the segments in parallel.
+    num_rows, inner_dim, num_segments = 20000, 4, 1000
+    rng = np.random.RandomState(0)
+    np_x = rng.uniform(0.5, 1.5, (num_rows, inner_dim)).astype(np.float32)
+    unsorted_ids = rng.randint(-1, num_segments, num_rows)
+    # Rows with negative ids are dropped, and every 7th segment is left empty.
+    unsorted_ids[unsorted_ids % 7 == 0] = -1
+    all_dropped_ids = np.full(num_rows, -1)
+    ops_list = [(np.add, math_ops.unsorted_segment_sum, 0),
+                (np.multiply, math_ops.unsorted_segment_prod, 1),
+                (np.minimum, math_ops.unsorted_segment_min,
+                 np.finfo(np.float32).max),
+                (np.maximum, math_ops.unsorted_segment_max,
+                 np.finfo(np.float32).min)]
+    with self.test_session(use_gpu=False):
+      for segment_ids in unsorted_ids, all_dropped_ids:
+        kept = segment_ids >= 0
+        for np_op, tf_op, initial_value in ops_list:
+          np_ans = np.full((num_segments, inner_dim), initial_value,
+                           dtype=np.float32)
+          np_op.at(np_ans, segment_ids[kept], np_x[kept])
+          tf_ans = tf_op(np_x, segment_ids, num_segments).eval()
+          self.assertAllClose(np_ans, tf_ans)
+
+  def testLargeBadIndices(self):
+    segment_ids = np.zeros(20000, dtype=np.int32)
+    segment_ids[12345] = 1000
+    with self.test_session(use_gpu=False):
+      s = math_ops.unsorted_segment_sum(
+          np.ones((20000, 4), dtype=np.float32), segment_ids, 10)
+      with self.assertRaisesOpError(
+          r"segment_ids\[12345\] = 1000 is out of range \[0, 10\)"):
+        s.eval()
+
 
 class SparseSegmentReductionHelper(SegmentReductionHelper):
 
@@ -561,6 +597,60 @@ class SparseSegmentReductionOpTest(SparseSegmentReductionHelper):
         tf_ans = s.eval()
         self.assertAllClose(np.zeros([5, 4]), tf_ans)
 
+  def testLargeValues(self):
+    # Enough segments to be reduced in parallel, with gaps of empty segments
+    # before, between and after them.
+    num_rows, inner_dim, num_indices, num_segments = 5000, 8, 20000, 3500
+    rng = np.random.RandomState(0)
+    np_x = rng.uniform(-1, 1, (num_rows, inner_dim)).astype(np.float32)
+    indices = rng.randint(0, num_rows, num_indices).astype(np.int32)
+    segment_ids = np.sort(rng.randint(10, 3000, num_indices)).astype(np.int32)
+    segment_ids[segment_ids % 5 == 0] += 1
+    counts = np.bincount(segment_ids, minlength=num_segments)
+    sums = np.zeros((num_segments, inner_dim), dtype=np.float64)
+    np.add.at(sums, segment_ids, np_x[indices])
+    divisors = np.maximum(counts, 1)[:, np.newaxis]
+    ops_list = [(sums, math_ops.sparse_segment_sum),
+                (sums / divisors, math_ops.sparse_segment_mean),
+                (sums / np.sqrt(divisors), math_ops.sparse_segment_sqrt_n)]
+    with self.test_session(use_gpu=False):
+      for np_ans, tf_op in ops_list:
+        tf_ans = tf_op(
+            data=np_x,
+            indices=indices,
+            segment_ids=segment_ids,
+            num_segments=num_segments).eval()
+        self.assertAllClose(np_ans, tf_ans, rtol=1e-5, atol=1e-5)
+      # Without num_segments, the output ends at the last segment.
+      tf_ans = math_ops.sparse_segment_sum(
+          data=np_x, indices=indices, segment_ids=segment_ids).eval()
+      self.assertAllClose(
+          sums[:segment_ids[-1] + 1], tf_ans, rtol=1e-5, atol=1e-5)
+
+  def testLargeErrors(self):
+    num_indices = 20000
+    np_x = np.ones((100, 4), dtype=np.float32)
+    segment_ids = np.arange(num_indices, dtype=np.int32) // 3
+    with self.test_session(use_gpu=False):
+      # The first of several bad indices is reported.
+      indices = np.zeros(num_indices, dtype=np.int32)
+      indices[15000] = 1000
+      indices[17000] = 2000
+      s = math_ops.sparse_segment_sum(
+          data=np_x, indices=indices, segment_ids=segment_ids)
+      with self.assertRaisesOpError(r"indices\[15000\] == 1000 out of range"):
+        s.eval()
+      # Unsorted segment ids are rejected.
+      unsorted_ids = np.copy(segment_ids)
+      unsorted_ids[12000], unsorted_ids[12003] = (unsorted_ids[12003],
+                                                  unsorted_ids[12000])
+      s = math_ops.sparse_segment_sum(
+          data=np_x,
+          indices=np.zeros(num_indices, dtype=np.int32),
+          segment_ids=unsorted_ids)
+      with self.assertRaisesOpError("segment ids are not increasing"):
+        s.eval()
+
   def testSegmentIdsGreaterThanZero(self):
     tf_x, np_x = self._input([10, 4], dtype=dtypes_lib.float32)
     ops_list = [(np.add, None, math_ops.sparse_segment_sum), (
@@ -243,6 +243,62 @@ class SparseTensorDenseMatMulTest(test.TestCase):
             y = y.transpose() if adjoint_b else y
             self._testMatmul(x, y, adjoint_a, adjoint_b)
 
+  # The CPU kernel caches a compressed form of the sparse operand while its
+  # indices do not change between runs.
+  def testRepeatedRunsWithUnsortedIndices(self):
+    np.random.seed(127)  # Repeatable results
+    x = np.random.rand(50, 40).astype(np.float32)
+    x[x < 0.7] = 0
+    x_indices = np.vstack(np.where(x)).astype(np.int64).T
+    order = np.random.permutation(len(x_indices))
+    x_indices = x_indices[order]
+    x_values = x[np.where(x)][order]
+
+    with self.test_session(use_gpu=False) as sess:
+      values = array_ops.placeholder(dtypes.float32, shape=[len(x_values)])
+      for adjoint_a in [False, True]:
+        sp_x = sparse_tensor.SparseTensor(
+            constant_op.constant(x_indices), values, x.shape)
+        b = np.random.randn(x.shape[0] if adjoint_a else x.shape[1],
+                            32).astype(np.float32)
+        result = sparse_ops.sparse_tensor_dense_matmul(
+            sp_x, b, adjoint_a=adjoint_a)
+        for scale in [1.0, -2.0, 0.5]:
+          dense_x = np.zeros_like(x)
+          dense_x[tuple(x_indices.T)] = scale * x_values
+          np_ans = np.matmul(dense_x.T if adjoint_a else dense_x, b)
+          self.assertAllClose(
+              np_ans,
+              sess.run(result, {values: scale * x_values}),
+              rtol=1e-4,
+              atol=1e-4)
+
+  # Fed indices of the same shape may get the buffer of the previous run,
+  # which must not be taken for unchanged indices.
+  def testRepeatedRunsWithFedIndices(self):
+    np.random.seed(127)  # Repeatable results
+    nnz = 300
+    with self.test_session(use_gpu=False) as sess:
+      indices = array_ops.placeholder(dtypes.int64, shape=[nnz, 2])
+      values = array_ops.placeholder(dtypes.float32, shape=[nnz])
+      for adjoint_a in [False, True]:
+        sp_x = sparse_tensor.SparseTensor(indices, values, [50, 40])
+        b = np.random.randn(50 if adjoint_a else 40, 32).astype(np.float32)
+        result = sparse_ops.sparse_tensor_dense_matmul(
+            sp_x, b, adjoint_a=adjoint_a)
+        for _ in range(5):
+          flat = np.random.permutation(50 * 40)[:nnz]
+          x_indices = np.vstack(np.unravel_index(flat, [50, 40])).T
+          x_values = np.random.rand(nnz).astype(np.float32)
+          dense_x = np.zeros([50, 40], dtype=np.float32)
+          dense_x[tuple(x_indices.T)] = x_values
+          np_ans = np.matmul(dense_x.T if adjoint_a else dense_x, b)
+          self.assertAllClose(
+              np_ans,
+              sess.run(result, {indices: x_indices, values: x_values}),
+              rtol=1e-4,
+              atol=1e-4)
+
 
 def _sparse_tensor_dense_vs_dense_matmul_benchmark_dense(x, y, adjoint_a,
                                                          adjoint_b):
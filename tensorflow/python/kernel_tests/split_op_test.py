@@ -259,6 +259,39 @@ class SplitOpTest(test.TestCase):
       self._compare(self._makeData((6, 7, 18), dtype), 0, 3)
       self._compare(self._makeData((6, 7, 9), dtype), 0, 3)
 
+  def _compareOnCpu(self, x, dim, num):
+    with self.test_session(use_gpu=False) as sess:
+      p = array_ops.placeholder(x.dtype, shape=x.shape)
+      out = sess.run(
+          array_ops.split(value=p, num_or_size_splits=num, axis=dim),
+          feed_dict={p: x})
+    for expected, actual in zip(np.split(x, num, dim), out):
+      self.assertAllEqual(expected, actual)
+
+  def testSplitSmallPieces(self):
+    # Pieces of at most 128 bytes per row on average are copied row by row.
+    # Odd widths cover the tails of the small copies, and pieces of more than
+    # 64 bytes per row the calls to memcpy.
+    for dtype in [np.int8, np.float32, np.float64]:
+      for width in [1, 3, 9, 17]:
+        x = np.random.randint(0, 100, (64, 300 * width)).astype(dtype)
+        self._compareOnCpu(x, 1, 300)
+    self._compareOnCpu(np.random.rand(6, 7).astype(np.float32), 0, 3)
+
+  def testSplitStreaming(self):
+    # Inputs of at least 16MB split into pieces of at least 4KB per row on
+    # average are read into the outputs with non-temporal stores. The odd
+    # widths leave most pieces unaligned.
+    x = np.random.rand(4, 2 * 1048579).astype(np.float32)
+    self._compareOnCpu(x, 1, 2)
+    x = np.random.rand(6, 1048577).astype(np.float32)
+    self._compareOnCpu(x, 0, 3)
+
+  def testSplitDefaultCopy(self):
+    for dtype in [np.int8, np.float32]:
+      x = np.random.randint(0, 100, (100, 3 * 1001)).astype(dtype)
+      self._compareOnCpu(x, 1, 3)
+
   def _RunAndVerify(self, dtype, large_num_splits=False):
     # Random dims of rank 5
     shape = np.random.randint(0, 5, size=5)
@@ -2793,6 +2793,78 @@ class JpegTest(test_util.TensorFlowTestCase):
             lambda e: "Invalid JPEG data or crop window" in str(e)):
           sess.run(result)
 
+  def testDecodeAndResizeJpeg(self):
+    with self.test_session() as sess:
+      base = "tensorflow/core/lib/jpeg/testdata"
+      jpeg0 = io_ops.read_file(os.path.join(base, "jpeg_merge_test1.jpg"))
+
+      h, w, _ = 256, 128, 3
+      # Crops less than twice as large as the output are not scaled down while
+      # decoding.
+      for crop_window, size in [([0, 0, h, w], [200, 100]),
+                                ([6, 5, 15, 10], [10, 7]),
+                                ([h - 6, w - 5, 6, 5], [6, 5]),
+                                ([3, 9, 100, 50], [60, 99])]:
+        for align_corners in [False, True]:
+          # Explicit stages: decode + crop + resize.
+          image1 = image_ops.decode_and_crop_jpeg(jpeg0, crop_window)
+          image1 = image_ops.resize_bilinear(
+              array_ops.expand_dims(image1, 0),
+              size,
+              align_corners=align_corners)[0]
+
+          # Fused decode+crop+resize.
+          image2 = image_ops.decode_and_resize_jpeg(
+              jpeg0, crop_window, size, align_corners=align_corners)
+          self.assertAllEqual(image1.get_shape().as_list(),
+                              image2.get_shape().as_list())
+          image1, image2 = sess.run([image1, image2])
+          self.assertAllClose(image1, image2)
+
+      # An empty crop window stands for the whole image.
+      image1 = image_ops.decode_and_resize_jpeg(jpeg0, [0, 0, h, w], [200, 99])
+      image2 = image_ops.decode_and_resize_jpeg(
+          jpeg0, array_ops.zeros([0], dtypes.int32), [200, 99])
+      image1, image2 = sess.run([image1, image2])
+      self.assertAllEqual(image1, image2)
+
+      # At 1/8 of the size, the image is scaled down while decoding.
+      image1 = image_ops.decode_jpeg(jpeg0, ratio=8)
+      image2 = image_ops.decode_and_resize_jpeg(jpeg0, [0, 0, h, w],
+                                                [h // 8, w // 8])
+      image1, image2 = sess.run([image1, image2])
+      self.assertAllEqual(image1, image2)
+
+      # Same for a crop, up to the rounding to whole pixels of the window.
+      image1 = image_ops.decode_and_resize_jpeg(jpeg0, [48, 32, 128, 64],
+                                                [32, 16])
+      image2 = image_ops.resize_area(
+          array_ops.expand_dims(
+              image_ops.decode_and_crop_jpeg(jpeg0, [48, 32, 128, 64]), 0),
+          [32, 16])[0]
+      image1, image2 = sess.run([image1, image2])
+      self.assertLess(self.averageError(image1, image2), 3)
+
+  def testDecodeAndResizeJpegWithInvalidArguments(self):
+    with self.test_session() as sess:
+      base = "tensorflow/core/lib/jpeg/testdata"
+      jpeg0 = io_ops.read_file(os.path.join(base, "jpeg_merge_test1.jpg"))
+
+      h, w, _ = 256, 128, 3
+      for crop_window in [[-1, 11, 11, 11], [11, 11, 0, 11], [0, 0, h + 1, w],
+                          [0, 0, h, w + 1]]:
+        result = image_ops.decode_and_resize_jpeg(jpeg0, crop_window, [4, 4])
+        with self.assertRaisesWithPredicateMatch(
+            errors.InvalidArgumentError,
+            lambda e: "Invalid crop window" in str(e)):
+          sess.run(result)
+
+      result = image_ops.decode_and_resize_jpeg(jpeg0, [0, 0, h, w], [0, 4])
+      with self.assertRaisesWithPredicateMatch(
+          errors.InvalidArgumentError,
+          lambda e: "output dimensions must be positive" in str(e)):
+        sess.run(result)
+
   def testSynthetic(self):
     with self.test_session(use_gpu=True) as sess:
       # Encode it, then decode it, then encode it